@@ -28,7 +28,7 @@ SOFTWARE.
 #include "PolyVox/MarchingCubesSurfaceExtractor.h"
 #include "PolyVox/Mesh.h"
 #include "PolyVox/RawVolume.h"
-#include "PolyVox/VolumeResampler.h"
+#include "PolyVox/VolumePyramid.h"
 
 #include <QApplication>
 
@@ -88,13 +88,14 @@ protected:
 		//smoothRegion<PagedVolume, Density8>(volData, volData.getEnclosingRegion());
 		//smoothRegion<PagedVolume, Density8>(volData, volData.getEnclosingRegion());
 
-		RawVolume<uint8_t> volDataLowLOD(PolyVox::Region(Vector3DInt32(0, 0, 0), Vector3DInt32(15, 31, 31)));
-
-		VolumeResampler< RawVolume<uint8_t>, RawVolume<uint8_t> > volumeResampler(&volData, PolyVox::Region(Vector3DInt32(0, 0, 0), Vector3DInt32(31, 63, 63)), &volDataLowLOD, volDataLowLOD.getEnclosingRegion());
-		volumeResampler.execute();
+		//Build a half resolution copy of the part of the volume which is far away. If the volume was edited then only
+		//the affected parts of the copy would need to be rebuilt (see VolumePyramid::markDirty()).
+		VolumePyramid< RawVolume<uint8_t>, uint32_t > pyramid(&volData, PolyVox::Region(Vector3DInt32(0, 0, 0), Vector3DInt32(31, 63, 63)), 1);
+		pyramid.update();
+		RawVolume<uint8_t>* volDataLowLOD = pyramid.getLevel(1);
 
 		//Extract the surface
-		auto meshLowLOD = extractMarchingCubesMesh(&volDataLowLOD, volDataLowLOD.getEnclosingRegion());
+		auto meshLowLOD = extractMarchingCubesMesh(volDataLowLOD, volDataLowLOD->getEnclosingRegion());
 		// The returned mesh needs to be decoded to be appropriate for GPU rendering.
 		auto decodedMeshLowLOD = decodeMesh(meshLowLOD);
 
@@ -105,7 +106,7 @@ protected:
 
 		//Pass the surface to the OpenGL window
 		addMesh(decodedMeshHighLOD, Vector3DInt32(30, 0, 0));
-		addMesh(decodedMeshLowLOD, Vector3DInt32(0, 0, 0), 63.0f / 31.0f);
+		addMesh(decodedMeshLowLOD, Vector3DInt32(0, 0, 0), 2.0f);
 
 		setCameraTransform(QVector3D(100.0f, 100.0f, 100.0f), -(PI / 4.0f), PI + (PI / 4.0f));
 	}
@@ -28,10 +28,22 @@
 #include "Region.h"
 #include "Vector.h"
 
+#include <cstddef>
 #include <limits>
 
 namespace PolyVox
 {
+	namespace RegionLayouts
+	{
+		/// Specifies how the voxels of a region are arranged in the buffers used by readRegion() and writeRegion().
+		enum RegionLayout
+		{
+			XYZ = 0, ///< The x coordinate varies fastest and z the slowest. This is the order in which RawVolume stores its data.
+			ZYX = 1 ///< The z coordinate varies fastest and x the slowest.
+		};
+	}
+	typedef RegionLayouts::RegionLayout RegionLayout;
+
 	/// The BaseVolume class provides common functionality and an interface for other volume classes to implement.
 	/// You should not try to create an instance of this class directly. Instead you should use RawVolume or PagedVolume.
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -118,6 +130,13 @@ namespace PolyVox
 		/// Sets the voxel at the position given by a 3D vector
 		void setVoxel(const Vector3DInt32& v3dPos, VoxelType tValue);
 
+		/// Copies the voxels in a region into a buffer
+		void readRegion(const Region& region, VoxelType* pDst, RegionLayout eLayout = RegionLayouts::XYZ) const;
+		/// Copies the voxels in a region from a buffer
+		void writeRegion(const Region& region, const VoxelType* pSrc, RegionLayout eLayout = RegionLayouts::XYZ);
+		/// Sets every voxel in a region to the same value
+		void fill(const Region& region, VoxelType tValue);
+
 		/// Calculates approximatly how many bytes of memory the volume is currently using.
 		uint32_t calculateSizeInBytes(void);
 
@@ -133,6 +152,9 @@ namespace PolyVox
 
 		/// Assignment operator
 		BaseVolume& operator=(const BaseVolume& rhs);
+
+		/// Finds how far apart neighbouring voxels of a region are in a buffer with the given layout.
+		static void calculateRegionStrides(const Region& region, RegionLayout eLayout, size_t& uStrideX, size_t& uStrideY, size_t& uStrideZ);
 	};
 }
 
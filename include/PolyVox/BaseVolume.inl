@@ -118,6 +118,38 @@ namespace PolyVox
 		POLYVOX_THROW(not_implemented, "You should never call the base class version of this function.");
 	}
 
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param region The voxels to copy
+	/// \param pDst A buffer with space for every voxel in the region
+	/// \param eLayout How the voxels should be arranged in the buffer
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void BaseVolume<VoxelType>::readRegion(const Region& /*region*/, VoxelType* /*pDst*/, RegionLayout /*eLayout*/) const
+	{
+		POLYVOX_THROW(not_implemented, "You should never call the base class version of this function.");
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param region The voxels to set
+	/// \param pSrc A buffer containing a value for every voxel in the region
+	/// \param eLayout How the voxels are arranged in the buffer
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void BaseVolume<VoxelType>::writeRegion(const Region& /*region*/, const VoxelType* /*pSrc*/, RegionLayout /*eLayout*/)
+	{
+		POLYVOX_THROW(not_implemented, "You should never call the base class version of this function.");
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param region The voxels to set
+	/// \param tValue The value to give to every voxel in the region
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void BaseVolume<VoxelType>::fill(const Region& /*region*/, VoxelType /*tValue*/)
+	{
+		POLYVOX_THROW(not_implemented, "You should never call the base class version of this function.");
+	}
+
 	////////////////////////////////////////////////////////////////////////////////
 	/// 
 	////////////////////////////////////////////////////////////////////////////////
@@ -127,5 +159,32 @@ namespace PolyVox
 		POLYVOX_THROW(not_implemented, "You should never call the base class version of this function.");
 		return 0;
 	}
-}
 
+	////////////////////////////////////////////////////////////////////////////////
+	/// The voxel at position (x, y, z) of the region is stored at index (x - lowerX) * uStrideX + (y - lowerY) * uStrideY
+	/// + (z - lowerZ) * uStrideZ of the buffer.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void BaseVolume<VoxelType>::calculateRegionStrides(const Region& region, RegionLayout eLayout, size_t& uStrideX, size_t& uStrideY, size_t& uStrideZ)
+	{
+		const size_t uWidth = region.getWidthInVoxels();
+		const size_t uHeight = region.getHeightInVoxels();
+		const size_t uDepth = region.getDepthInVoxels();
+
+		switch (eLayout)
+		{
+		case RegionLayouts::XYZ:
+			uStrideX = 1;
+			uStrideY = uWidth;
+			uStrideZ = uWidth * uHeight;
+			break;
+		case RegionLayouts::ZYX:
+			uStrideZ = 1;
+			uStrideY = uDepth;
+			uStrideX = uDepth * uHeight;
+			break;
+		default:
+			POLYVOX_THROW(std::invalid_argument, "Unknown region layout");
+		}
+	}
+}
@@ -0,0 +1,88 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_ChunkLayout_H__
+#define __PolyVox_ChunkLayout_H__
+
+#include "Impl/Morton.h"
+
+#include <cstdint>
+
+namespace PolyVox
+{
+	/// The chunk layouts decide where each voxel of a PagedVolume chunk is stored in the chunk's data, and are given as the third
+	/// template parameter of the PagedVolume (for example PagedVolume<uint8_t, 32, LinearChunkLayout>). The index of the voxel at
+	/// (x, y, z) within the chunk is getXOffset(x) + getYOffset(y) + getZOffset(z), where each function is also given the power of
+	/// two of the chunk side length. The layout only affects performance, as every voxel can be accessed in the same way with
+	/// each of them, but data which is copied directly to and from Chunk::getData() (such as by a Pager) is in the chosen layout.
+	///
+	/// The default is Morton order, in which voxels that are close together in the volume are usually close together in memory.
+
+	/// Stores the voxels in Morton (Z-order) order, by interleaving the bits of the position.
+	struct MortonChunkLayout
+	{
+		static const uint16_t uMinChunkSideLength = 1;
+
+		static uint32_t getXOffset(uint32_t uXPos, uint8_t /*uSideLengthPower*/) { return morton256_x[uXPos]; }
+		static uint32_t getYOffset(uint32_t uYPos, uint8_t /*uSideLengthPower*/) { return morton256_y[uYPos]; }
+		static uint32_t getZOffset(uint32_t uZPos, uint8_t /*uSideLengthPower*/) { return morton256_z[uZPos]; }
+	};
+
+	/// Stores the voxels in rows along the x axis, which are then ordered by y and then by z. This is the usual order for data on
+	/// disk, and moving along the x axis is fastest.
+	struct LinearChunkLayout
+	{
+		static const uint16_t uMinChunkSideLength = 1;
+
+		static uint32_t getXOffset(uint32_t uXPos, uint8_t /*uSideLengthPower*/) { return uXPos; }
+		static uint32_t getYOffset(uint32_t uYPos, uint8_t uSideLengthPower) { return uYPos << uSideLengthPower; }
+		static uint32_t getZOffset(uint32_t uZPos, uint8_t uSideLengthPower) { return uZPos << (uSideLengthPower * 2); }
+	};
+
+	/// Splits the chunk into bricks of 4x4x4 voxels, each of which is stored as a contiguous block of 64 voxels in linear order.
+	/// The bricks themselves are also in linear order. Each brick fits in a cache line or two for small voxel types, and unlike
+	/// Morton order the offsets can be computed without a table. The chunk side length must be at least four.
+	struct BrickedChunkLayout
+	{
+		static const uint16_t uMinChunkSideLength = 4;
+
+		static uint32_t getXOffset(uint32_t uXPos, uint8_t /*uSideLengthPower*/)
+		{
+			return ((uXPos >> 2) << 6) + (uXPos & 3);
+		}
+
+		static uint32_t getYOffset(uint32_t uYPos, uint8_t uSideLengthPower)
+		{
+			// There are (side length / 4) bricks in each row.
+			return ((uYPos >> 2) << (uSideLengthPower + 4)) + ((uYPos & 3) << 2);
+		}
+
+		static uint32_t getZOffset(uint32_t uZPos, uint8_t uSideLengthPower)
+		{
+			return ((uZPos >> 2) << (uSideLengthPower * 2 + 2)) + ((uZPos & 3) << 4);
+		}
+	};
+}
+
+#endif //__PolyVox_ChunkLayout_H__
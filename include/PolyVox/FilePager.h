@@ -31,10 +31,14 @@
 #include "Region.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <fstream>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 namespace PolyVox
@@ -45,16 +49,36 @@ namespace PolyVox
 	 *
 	 * Note that no compression is performed (mostly to avoid dependancies) so for large
 	 * volumes you may want to consider this class as an example and create a custom version
-	 * with compression.
+	 * with compression. The exception is uniform chunks, for which only the single value is
+	 * stored (and which are restored as uniform chunks when they are paged back in).
+	 *
+	 * The voxels are written in the order given by the volume's chunk layout, so they can be
+	 * copied straight back into the chunk without being reordered. This means that the files
+	 * can only be read by a FilePager whose volume uses the same layout and side length.
+	 *
+	 * The pager remembers which chunks it has written, so chunks which have never been paged out
+	 * are filled with zeros without trying to open a file. By default the file names include the
+	 * time and the address of the pager, so that different pagers never share files, and the files
+	 * are deleted when the pager is destroyed. A persistent pager instead uses the same file names
+	 * every time and keeps its files, along with an index of which chunks have been written (in a
+	 * file called 'chunks.idx' in the same folder). A persistent FilePager which is later given the
+	 * same folder then pages the chunks back in. Only one persistent pager should use a folder at once.
+	 * The index also records the voxel size and chunk side length, and a pager whose volume does not
+	 * match them throws rather than reading the files.
 	 */
-	template <typename VoxelType>
-	class FilePager : public PagedVolume<VoxelType>::Pager
+	template <typename VoxelType, uint16_t ChunkSideLength = 0, typename ChunkLayout = MortonChunkLayout>
+	class FilePager : public PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Pager
 	{
 	public:
 		/// Constructor
-		FilePager(const std::string& strFolderName = ".")
-			:PagedVolume<VoxelType>::Pager()
+		/// \param strFolderName The folder in which the files are stored, which must already exist.
+		/// \param bPersistent Whether the files are kept (and found again by later pagers), rather than being deleted.
+		FilePager(const std::string& strFolderName = ".", bool bPersistent = false)
+			:PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Pager()
 			, m_strFolderName(strFolderName)
+			, m_bPersistent(bPersistent)
+			, m_uChunkSideLength(ChunkSideLength)
+			, m_pIndexFile(nullptr)
 		{
 				// Add the trailing slash, assuming the user dind't already do it.
 				if ((m_strFolderName.back() != '/') && (m_strFolderName.back() != '\\'))
@@ -62,10 +86,16 @@ namespace PolyVox
 					m_strFolderName.append("/");
 				}
 
+				if (m_bPersistent)
+				{
+					loadIndex();
+					return;
+				}
+
 				// Build a unique postfix to avoid filename conflicts between multiple pagers/runs.
 				// Not a very robust solution but this class is meant as an example for testing really.
 				std::stringstream ss;
-				ss << time(0) << "--"; // Avoid multiple runs using the same filenames.
+				ss << "--" << time(0) << "--"; // Avoid multiple runs using the same filenames.
 				ss << this; // Avoid multiple FilePagers using the same filenames.
 				m_strPostfix = ss.str();
 		}
@@ -73,6 +103,11 @@ namespace PolyVox
 		/// Destructor
 		virtual ~FilePager()
 		{
+			if (m_pIndexFile)
+			{
+				fclose(m_pIndexFile);
+			}
+
 			for (std::vector<std::string>::iterator iter = m_vecCreatedFiles.begin(); iter < m_vecCreatedFiles.end(); iter++)
 			{
 				POLYVOX_LOG_WARNING_IF(std::remove(iter->c_str()) != 0, "Failed to delete '", *iter, "' when destroying FilePager");
@@ -81,37 +116,49 @@ namespace PolyVox
 			m_vecCreatedFiles.clear();
 		}
 
-		virtual void pageIn(const Region& region, typename PagedVolume<VoxelType>::Chunk* pChunk)
+		/// The number of chunks which have been written to files (including by earlier runs, for a persistent pager).
+		uint32_t getNoOfChunksOnDisk(void) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return static_cast<uint32_t>(m_setChunksOnDisk.size());
+		}
+
+		virtual void pageIn(const Region& region, typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk* pChunk)
 		{
 			POLYVOX_ASSERT(pChunk, "Attempting to page in NULL chunk");
-			POLYVOX_ASSERT(pChunk->getData(), "Chunk must have valid data");
 
-			std::stringstream ssFilename;
-			ssFilename << m_strFolderName << "/"
-				<< region.getLowerX() << "_" << region.getLowerY() << "_" << region.getLowerZ() << "_"
-				<< region.getUpperX() << "_" << region.getUpperY() << "_" << region.getUpperZ()
-				<< "--" << m_strPostfix;
+			// In a newly generated world most chunks have never been written, and can be filled without looking for a file.
+			bool bOnDisk = false;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				bOnDisk = m_setChunksOnDisk.find(getChunkPosition(region)) != m_setChunksOnDisk.end();
+			}
 
-			std::string filename = ssFilename.str();
+			std::string filename = getFileName(region);
 
 			// FIXME - This should be replaced by C++ style IO, but currently this causes problems with
 			// the gameplay-cubiquity integration. See: https://github.com/blackberry/GamePlay/issues/919
 
-			FILE* pFile = fopen(filename.c_str(), "rb");
+			FILE* pFile = bOnDisk ? fopen(filename.c_str(), "rb") : nullptr;
 			if (pFile)
 			{
 				POLYVOX_LOG_TRACE("Paging in data for ", region);
 
-				/*fseek(pFile, 0L, SEEK_END);
-				size_t fileSizeInBytes = ftell(pFile);
+				fseek(pFile, 0L, SEEK_END);
+				long fileSizeInBytes = ftell(pFile);
 				fseek(pFile, 0L, SEEK_SET);
 
-				uint8_t* buffer = new uint8_t[fileSizeInBytes];
-				fread(buffer, sizeof(uint8_t), fileSizeInBytes, pFile);
-				pChunk->setData(buffer, fileSizeInBytes);
-				delete[] buffer;*/
-
-				fread(pChunk->getData(), sizeof(uint8_t), pChunk->getDataSizeInBytes(), pFile);
+				// A file containing a single voxel was written for a uniform chunk.
+				if (fileSizeInBytes == static_cast<long>(sizeof(VoxelType)))
+				{
+					VoxelType tUniformValue;
+					fread(&tUniformValue, sizeof(VoxelType), 1, pFile);
+					pChunk->fill(tUniformValue);
+				}
+				else
+				{
+					fread(pChunk->getData(), sizeof(uint8_t), pChunk->getDataSizeInBytes(), pFile);
+				}
 
 				if (ferror(pFile))
 				{
@@ -126,25 +173,17 @@ namespace PolyVox
 
 				// Just fill with zeros. This feels hacky... perhaps we should just throw
 				// an exception and let the calling code handle it and fill with zeros.
-				uint32_t noOfVoxels = region.getWidthInVoxels() * region.getHeightInVoxels() * region.getDepthInVoxels();
-				std::fill(pChunk->getData(), pChunk->getData() + noOfVoxels, VoxelType());
+				pChunk->fill(VoxelType());
 			}
 		}
 
-		virtual void pageOut(const Region& region, typename PagedVolume<VoxelType>::Chunk* pChunk)
+		virtual void pageOut(const Region& region, typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk* pChunk)
 		{
 			POLYVOX_ASSERT(pChunk, "Attempting to page out NULL chunk");
-			POLYVOX_ASSERT(pChunk->getData(), "Chunk must have valid data");
 
 			POLYVOX_LOG_TRACE("Paging out data for ", region);
 
-			std::stringstream ssFilename;
-			ssFilename << m_strFolderName << "/"
-				<< region.getLowerX() << "_" << region.getLowerY() << "_" << region.getLowerZ() << "_"
-				<< region.getUpperX() << "_" << region.getUpperY() << "_" << region.getUpperZ()
-				<< "--" << m_strPostfix;
-
-			std::string filename = ssFilename.str();
+			std::string filename = getFileName(region);
 
 			// FIXME - This should be replaced by C++ style IO, but currently this causes problems with
 			// the gameplay-cubiquity integration. See: https://github.com/blackberry/GamePlay/issues/919
@@ -155,10 +194,16 @@ namespace PolyVox
 				POLYVOX_THROW(std::runtime_error, "Unable to open file to write out chunk data.");
 			}
 
-			//The file has been created, so add it to the list to delete on shutdown.
-			m_vecCreatedFiles.push_back(filename);
-
-			fwrite(pChunk->getData(), sizeof(uint8_t), pChunk->getDataSizeInBytes(), pFile);
+			if (pChunk->isUniform())
+			{
+				// Calling getData() would allocate the data, so we write the single value instead.
+				VoxelType tUniformValue = pChunk->getVoxel(0, 0, 0);
+				fwrite(&tUniformValue, sizeof(VoxelType), 1, pFile);
+			}
+			else
+			{
+				fwrite(pChunk->getData(), sizeof(uint8_t), pChunk->getDataSizeInBytes(), pFile);
+			}
 
 			if (ferror(pFile))
 			{
@@ -166,13 +211,193 @@ namespace PolyVox
 			}
 
 			fclose(pFile);
+
+			// The chunk is only recorded once its file is complete, so that an interrupted run never leaves an index entry without the data.
+			std::lock_guard<std::mutex> lock(m_mutex);
+			const Vector3DInt32 v3dChunkPos = getChunkPosition(region);
+			if (m_setChunksOnDisk.insert(v3dChunkPos).second)
+			{
+				if (m_bPersistent)
+				{
+					// The index is only created once the chunk side length is known, as it is stored in the header.
+					if (m_pIndexFile)
+					{
+						appendToIndex(v3dChunkPos);
+					}
+					else
+					{
+						writeIndex();
+					}
+				}
+				else
+				{
+					// The file has been created, so add it to the list to delete on shutdown.
+					m_vecCreatedFiles.push_back(filename);
+				}
+			}
 		}
 
 	protected:
+		std::string getFileName(const Region& region) const
+		{
+			std::stringstream ssFilename;
+			ssFilename << m_strFolderName
+				<< region.getLowerX() << "_" << region.getLowerY() << "_" << region.getLowerZ() << "_"
+				<< region.getUpperX() << "_" << region.getUpperY() << "_" << region.getUpperZ()
+				<< m_strPostfix;
+			return ssFilename.str();
+		}
+
+		// Chunks are identified by their position in chunk space, which requires the mutex to be locked. The first chunk
+		// gives the side length if it was not known, and after that every chunk must have the same one.
+		Vector3DInt32 getChunkPosition(const Region& region)
+		{
+			const uint32_t uSideLength = region.getWidthInVoxels();
+			if (m_uChunkSideLength == 0)
+			{
+				m_uChunkSideLength = uSideLength;
+			}
+			else if (m_uChunkSideLength != uSideLength)
+			{
+				POLYVOX_THROW(std::runtime_error, "The chunk side length of the FilePager in '" + m_strFolderName + "' does not match the volume.");
+			}
+
+			// The lower corner of a chunk is always a multiple of the side length.
+			return region.getLowerCorner() / static_cast<int32_t>(uSideLength);
+		}
+
+		// The index starts with a header and then holds the position of each chunk which has been written, as three 32-bit
+		// integers.
+		void loadIndex(void)
+		{
+			std::string strIndexFileName = m_strFolderName + "chunks.idx";
+			bool bValidIndex = false;
+			bool bPartialEntry = false;
+			FILE* pIndexFile = fopen(strIndexFileName.c_str(), "rb");
+			if (pIndexFile)
+			{
+				// A file which is too short for the header was left by a run which was interrupted while creating it.
+				IndexHeader header;
+				if (fread(&header, sizeof(header), 1, pIndexFile) == 1)
+				{
+					if ((memcmp(header.acMagic, "PVFI", 4) != 0) || (header.uVersion != uIndexVersion))
+					{
+						fclose(pIndexFile);
+						POLYVOX_THROW(std::runtime_error, "'" + strIndexFileName + "' is not a FilePager index or has an unsupported version.");
+					}
+					if (header.uVoxelSizeInBytes != sizeof(VoxelType))
+					{
+						fclose(pIndexFile);
+						POLYVOX_THROW(std::runtime_error, "The voxel size of '" + strIndexFileName + "' does not match the volume.");
+					}
+					if ((ChunkSideLength != 0) && (header.uChunkSideLength != ChunkSideLength))
+					{
+						fclose(pIndexFile);
+						POLYVOX_THROW(std::runtime_error, "The chunk side length of '" + strIndexFileName + "' does not match the volume.");
+					}
+					m_uChunkSideLength = header.uChunkSideLength;
+					bValidIndex = true;
+
+					int32_t aiEntry[3];
+					size_t uNoOfBytesRead = 0;
+					while ((uNoOfBytesRead = fread(aiEntry, 1, sizeof(aiEntry), pIndexFile)) == sizeof(aiEntry))
+					{
+						m_setChunksOnDisk.insert(Vector3DInt32(aiEntry[0], aiEntry[1], aiEntry[2]));
+					}
+					bPartialEntry = uNoOfBytesRead > 0;
+				}
+				fclose(pIndexFile);
+			}
+
+			// A partial entry at the end is left by a run which was interrupted while writing it. New entries can't be appended
+			// after it, so in this (rare) case the index is written out again. Otherwise it is created when the first chunk is
+			// paged out.
+			if (bPartialEntry)
+			{
+				writeIndex();
+			}
+			else if (bValidIndex)
+			{
+				m_pIndexFile = fopen(strIndexFileName.c_str(), "ab");
+				if (!m_pIndexFile)
+				{
+					POLYVOX_THROW(std::runtime_error, "Unable to open the index file of the FilePager.");
+				}
+			}
+		}
+
+		// Writes the header and all of the chunks to a new index file, which is then kept open so that chunks can be appended.
+		void writeIndex(void)
+		{
+			if (m_pIndexFile)
+			{
+				fclose(m_pIndexFile);
+			}
+
+			std::string strIndexFileName = m_strFolderName + "chunks.idx";
+			m_pIndexFile = fopen(strIndexFileName.c_str(), "wb");
+			if (!m_pIndexFile)
+			{
+				POLYVOX_THROW(std::runtime_error, "Unable to open the index file of the FilePager.");
+			}
+
+			IndexHeader header;
+			memcpy(header.acMagic, "PVFI", 4);
+			header.uVersion = uIndexVersion;
+			header.uVoxelSizeInBytes = sizeof(VoxelType);
+			header.uChunkSideLength = m_uChunkSideLength;
+			fwrite(&header, sizeof(header), 1, m_pIndexFile);
+			for (const Vector3DInt32& v3dChunkPos : m_setChunksOnDisk)
+			{
+				appendToIndex(v3dChunkPos);
+			}
+		}
+
+		void appendToIndex(const Vector3DInt32& v3dChunkPos)
+		{
+			int32_t aiEntry[3] = { v3dChunkPos.getX(), v3dChunkPos.getY(), v3dChunkPos.getZ() };
+			fwrite(aiEntry, sizeof(aiEntry), 1, m_pIndexFile);
+			fflush(m_pIndexFile);
+			if (ferror(m_pIndexFile))
+			{
+				POLYVOX_THROW(std::runtime_error, "Error writing to the index file of the FilePager.");
+			}
+		}
+
 		std::string m_strFolderName;
 		std::string m_strPostfix;
+		bool m_bPersistent;
 
 		std::vector<std::string> m_vecCreatedFiles;
+
+		// Written to the index as it is, so it only uses fixed size types and has no padding.
+		struct IndexHeader
+		{
+			char acMagic[4];
+			uint32_t uVersion;
+			uint32_t uVoxelSizeInBytes;
+			uint32_t uChunkSideLength;
+		};
+
+		static const uint32_t uIndexVersion = 1;
+
+		// The std::hash of a Vector3DInt32 only uses the lowest eight bits of each component.
+		struct ChunkPositionHasher
+		{
+			size_t operator()(const Vector3DInt32& v3dPos) const
+			{
+				return (static_cast<uint32_t>(v3dPos.getX()) * 73856093u) ^ (static_cast<uint32_t>(v3dPos.getY()) * 19349663u) ^ (static_cast<uint32_t>(v3dPos.getZ()) * 83492791u);
+			}
+		};
+
+		// The chunk side length is zero until the first chunk is paged (unless it is a template parameter or is read from the index).
+		uint32_t m_uChunkSideLength;
+
+		// The positions (in chunk space) of the chunks which have been written to files, protected by the mutex as the pager may
+		// be called by several threads at once.
+		std::unordered_set<Vector3DInt32, ChunkPositionHasher> m_setChunksOnDisk;
+		FILE* m_pIndexFile;
+		mutable std::mutex m_mutex;
 	};
 }
 
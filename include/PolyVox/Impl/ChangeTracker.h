@@ -0,0 +1,269 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_ChangeTracker_H__
+#define __PolyVox_ChangeTracker_H__
+
+#include "ErrorHandling.h"
+
+#include "../Region.h"
+#include "../Vector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept> //For invalid_argument
+#include <unordered_map>
+#include <vector>
+
+namespace PolyVox
+{
+	/// Records which parts of a volume have been modified, so that only the meshes which they affect need to be extracted again.
+	/// The volume is divided into chunks, and for each chunk which has been modified the tracker keeps the bounds of the modified
+	/// voxels and a version number which is incremented whenever more changes are added.
+	///
+	/// Recording a modified voxel has to be cheap, so volumes accumulate the bounds for each chunk in a single atomic word (see
+	/// recordChange()) and only add them to the tracker when they are needed. The tracker itself is not thread safe.
+	class ChangeTracker
+	{
+	public:
+		/// Describes the changes which have been made to a single chunk.
+		struct ChangedChunk
+		{
+			Vector3DInt32 v3dChunkPos;
+			Region regChanged; ///< The bounds of the modified voxels, in volume space.
+			uint32_t uVersion;
+		};
+
+		/// Chunks can be at most this long on each side for their bounds to be recorded by recordChange().
+		static const uint32_t uMaxChunkSideLength = 256;
+
+		/// Expands the packed bounds of the changes to a chunk to include the given position within it. This can be called by
+		/// several threads at once, and only writes to the bounds if the position is not already inside them.
+		static void recordChange(std::atomic<uint64_t>& uBounds, uint32_t uXPos, uint32_t uYPos, uint32_t uZPos)
+		{
+			// Most writes are close to earlier ones, so the position is usually inside the bounds already.
+			const uint64_t uPos = uXPos | (uYPos << 9) | (uZPos << 18);
+			uint64_t uOldBounds = uBounds.load(std::memory_order_relaxed);
+			while (!contains(uOldBounds, uPos))
+			{
+				if (uBounds.compare_exchange_weak(uOldBounds, expandBounds(uOldBounds, uXPos, uYPos, uZPos), std::memory_order_relaxed))
+				{
+					return;
+				}
+			}
+		}
+
+		/// Converts bounds built by recordChange() into a region in volume space. The bounds must not be zero.
+		static Region unpackBounds(uint64_t uBounds, const Vector3DInt32& v3dChunkLowerCorner)
+		{
+			POLYVOX_ASSERT(uBounds != 0, "Attempting to unpack the bounds of a chunk which has not been changed");
+			Region regChanged(
+				getComponent(uBounds, 0), getComponent(uBounds, 1), getComponent(uBounds, 2),
+				getComponent(uBounds, 3), getComponent(uBounds, 4), getComponent(uBounds, 5));
+			regChanged.shift(v3dChunkLowerCorner);
+			return regChanged;
+		}
+
+		/// Adds changes to the chunk at the given position (in chunk space), and increments its version.
+		void addChanges(const Vector3DInt32& v3dChunkPos, const Region& regChanged)
+		{
+			ChunkRecord& record = m_mapChunkRecords[v3dChunkPos];
+			if (record.bChanged)
+			{
+				record.regChanged.accumulate(regChanged);
+			}
+			else
+			{
+				record.regChanged = regChanged;
+				record.bChanged = true;
+			}
+			record.uVersion++;
+		}
+
+		/// Returns how many times changes have been added to the chunk at the given position. This is zero for chunks which
+		/// have never been changed, and is not reset when the changes are consumed.
+		uint32_t getVersion(const Vector3DInt32& v3dChunkPos) const
+		{
+			auto iter = m_mapChunkRecords.find(v3dChunkPos);
+			return (iter != m_mapChunkRecords.end()) ? iter->second.uVersion : 0;
+		}
+
+		/// Returns the chunks which have changes that have not yet been consumed, ordered by position.
+		std::vector<ChangedChunk> getChangedChunks(void) const
+		{
+			std::vector<ChangedChunk> vecChangedChunks;
+			for (const auto& entry : m_mapChunkRecords)
+			{
+				if (entry.second.bChanged)
+				{
+					ChangedChunk changedChunk = { entry.first, entry.second.regChanged, entry.second.uVersion };
+					vecChangedChunks.push_back(changedChunk);
+				}
+			}
+
+			std::sort(vecChangedChunks.begin(), vecChangedChunks.end(), [](const ChangedChunk& a, const ChangedChunk& b)
+			{
+				return isLessThan(a.v3dChunkPos, b.v3dChunkPos);
+			});
+			return vecChangedChunks;
+		}
+
+		/// Returns the extraction regions which contain changes, and then forgets about those changes. See
+		/// PagedVolume::consumeChangedRegions() for a description of how the regions are chosen.
+		std::vector<Region> consumeChangedRegions(const Vector3DInt32& v3dRegionSize)
+		{
+			POLYVOX_THROW_IF((v3dRegionSize.getX() <= 0) || (v3dRegionSize.getY() <= 0) || (v3dRegionSize.getZ() <= 0),
+				std::invalid_argument, "Extraction regions must be at least one voxel on each side");
+
+			std::vector<Vector3DInt32> vecRegionKeys;
+			for (auto& entry : m_mapChunkRecords)
+			{
+				ChunkRecord& record = entry.second;
+				if (!record.bChanged)
+				{
+					continue;
+				}
+
+				// Extracting a region also reads the voxels just below its lower faces, so a change on the upper face of one
+				// region affects the region above it as well.
+				Region regAffected = record.regChanged;
+				regAffected.shiftUpperCorner(1, 1, 1);
+
+				Vector3DInt32 v3dLowerKey, v3dUpperKey;
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					v3dLowerKey.setElement(i, floorDivide(regAffected.getLowerCorner().getElement(i), v3dRegionSize.getElement(i)));
+					v3dUpperKey.setElement(i, floorDivide(regAffected.getUpperCorner().getElement(i), v3dRegionSize.getElement(i)));
+				}
+
+				for (int32_t z = v3dLowerKey.getZ(); z <= v3dUpperKey.getZ(); z++)
+				{
+					for (int32_t y = v3dLowerKey.getY(); y <= v3dUpperKey.getY(); y++)
+					{
+						for (int32_t x = v3dLowerKey.getX(); x <= v3dUpperKey.getX(); x++)
+						{
+							vecRegionKeys.push_back(Vector3DInt32(x, y, z));
+						}
+					}
+				}
+
+				record.bChanged = false;
+			}
+
+			// Several chunks (or one chunk and its neighbours) usually map to the same regions.
+			std::sort(vecRegionKeys.begin(), vecRegionKeys.end(), isLessThan);
+			vecRegionKeys.erase(std::unique(vecRegionKeys.begin(), vecRegionKeys.end()), vecRegionKeys.end());
+
+			std::vector<Region> vecRegions;
+			vecRegions.reserve(vecRegionKeys.size());
+			for (const auto& v3dKey : vecRegionKeys)
+			{
+				Vector3DInt32 v3dLowerCorner(v3dKey.getX() * v3dRegionSize.getX(), v3dKey.getY() * v3dRegionSize.getY(), v3dKey.getZ() * v3dRegionSize.getZ());
+				vecRegions.push_back(Region(v3dLowerCorner, v3dLowerCorner + v3dRegionSize - Vector3DInt32(1, 1, 1)));
+			}
+			return vecRegions;
+		}
+
+		/// Forgets all changes and versions.
+		void clear(void)
+		{
+			m_mapChunkRecords.clear();
+		}
+
+	private:
+		struct ChunkRecord
+		{
+			Region regChanged;
+			uint32_t uVersion = 0;
+			bool bChanged = false;
+		};
+
+		struct PositionHasher
+		{
+			size_t operator()(const Vector3DInt32& v3dPos) const
+			{
+				return (static_cast<uint32_t>(v3dPos.getX()) * 73856093u) ^ (static_cast<uint32_t>(v3dPos.getY()) * 19349663u) ^ (static_cast<uint32_t>(v3dPos.getZ()) * 83492791u);
+			}
+		};
+
+		// The packed bounds hold the lower corner in bits 0-26 and the upper corner in bits 27-53. Each component has nine bits, of
+		// which the top one is always zero so that all three can be compared with a single subtraction (see contains()). Bit 54 is
+		// set once anything has been recorded, so that zero can mean there are no changes.
+		static const uint64_t uHasChangesBit = uint64_t(1) << 54;
+		static const uint64_t uCornerMask = (uint64_t(1) << 27) - 1;
+		static const uint64_t uGuardBits = (uint64_t(1) << 8) | (uint64_t(1) << 17) | (uint64_t(1) << 26);
+
+		// Setting the guard bit of each component before subtracting means a component which is too small borrows from its own
+		// guard bit, rather than from the next component.
+		static bool contains(uint64_t uBounds, uint64_t uPos)
+		{
+			const uint64_t uLower = uBounds & uCornerMask;
+			const uint64_t uUpper = (uBounds >> 27) & uCornerMask;
+			return (uBounds != 0) && ((((uPos | uGuardBits) - uLower) & ((uUpper | uGuardBits) - uPos) & uGuardBits) == uGuardBits);
+		}
+
+		static uint64_t expandBounds(uint64_t uBounds, uint32_t uXPos, uint32_t uYPos, uint32_t uZPos)
+		{
+			POLYVOX_ASSERT((uXPos < uMaxChunkSideLength) && (uYPos < uMaxChunkSideLength) && (uZPos < uMaxChunkSideLength), "Position is outside the chunk");
+
+			if (uBounds == 0)
+			{
+				const uint64_t uPos = uXPos | (uYPos << 9) | (uZPos << 18);
+				return uHasChangesBit | uPos | (uPos << 27);
+			}
+
+			const uint32_t auPos[3] = { uXPos, uYPos, uZPos };
+			uint64_t uNewBounds = uHasChangesBit;
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				uNewBounds |= uint64_t((std::min)(getComponent(uBounds, i), auPos[i])) << (i * 9);
+				uNewBounds |= uint64_t((std::max)(getComponent(uBounds, i + 3), auPos[i])) << (i * 9 + 27);
+			}
+			return uNewBounds;
+		}
+
+		// Components 0-2 are the lower corner and 3-5 are the upper corner.
+		static uint32_t getComponent(uint64_t uBounds, uint32_t uComponent)
+		{
+			return static_cast<uint32_t>(uBounds >> (uComponent * 9)) & 0xFF;
+		}
+
+		static int32_t floorDivide(int32_t iValue, int32_t iDivisor)
+		{
+			return (iValue >= 0) ? (iValue / iDivisor) : -((-iValue + iDivisor - 1) / iDivisor);
+		}
+
+		static bool isLessThan(const Vector3DInt32& a, const Vector3DInt32& b)
+		{
+			if (a.getZ() != b.getZ()) return a.getZ() < b.getZ();
+			if (a.getY() != b.getY()) return a.getY() < b.getY();
+			return a.getX() < b.getX();
+		}
+
+		std::unordered_map<Vector3DInt32, ChunkRecord, PositionHasher> m_mapChunkRecords;
+	};
+}
+
+#endif //__PolyVox_ChangeTracker_H__
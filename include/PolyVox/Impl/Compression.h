@@ -0,0 +1,245 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_Compression_H__
+#define __PolyVox_Compression_H__
+
+#include "PlatformDefinitions.h"
+
+#include "ErrorHandling.h"
+#include "Utility.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// These functions implement the simple codec which the PagedVolume uses to keep chunks compressed in memory. It is deliberately
+// dependency-free and favours speed over compression ratio. Voxel data is first run-length encoded, which works well because chunks
+// are stored in Morton order and so neighbouring voxels (which are often identical) are usually close together in memory. The runs
+// can then optionally be passed through an LZ-style stage, which finds repeated sequences of runs (such as layers of terrain).
+namespace PolyVox
+{
+	// Writes an unsigned value using seven bits per byte, with the high bit set on all but the last byte.
+	inline void writeVarUInt(uint32_t uValue, std::vector<uint8_t>& vecOutput)
+	{
+		while (uValue >= 0x80)
+		{
+			vecOutput.push_back(static_cast<uint8_t>(uValue | 0x80));
+			uValue >>= 7;
+		}
+		vecOutput.push_back(static_cast<uint8_t>(uValue));
+	}
+
+	// Reads a value written by writeVarUInt(), advancing the read position past it.
+	inline uint32_t readVarUInt(const uint8_t*& pInput, const uint8_t* pInputEnd)
+	{
+		uint32_t uValue = 0;
+		uint32_t uShift = 0;
+		uint8_t uByte = 0;
+		do
+		{
+			POLYVOX_ASSERT(pInput < pInputEnd, "Compressed data is truncated");
+			POLYVOX_UNUSED(pInputEnd);
+			uByte = *pInput++;
+			uValue |= static_cast<uint32_t>(uByte & 0x7F) << uShift;
+			uShift += 7;
+		} while (uByte & 0x80);
+		return uValue;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Run-length encodes the given voxels. Each run is written as its length followed by the bytes of the voxel, and voxels are compared
+	/// with isBytewiseEqual().
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void encodeRLE(const VoxelType* pVoxels, uint32_t uNoOfVoxels, std::vector<uint8_t>& vecOutput)
+	{
+		vecOutput.clear();
+
+		uint32_t uRunStart = 0;
+		while (uRunStart < uNoOfVoxels)
+		{
+			uint32_t uRunEnd = uRunStart + 1;
+			while ((uRunEnd < uNoOfVoxels) && isBytewiseEqual(pVoxels[uRunStart], pVoxels[uRunEnd]))
+			{
+				uRunEnd++;
+			}
+
+			writeVarUInt(uRunEnd - uRunStart, vecOutput);
+			const uint8_t* pVoxelBytes = reinterpret_cast<const uint8_t*>(&pVoxels[uRunStart]);
+			vecOutput.insert(vecOutput.end(), pVoxelBytes, pVoxelBytes + sizeof(VoxelType));
+
+			uRunStart = uRunEnd;
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Produces the same output as encodeRLE() would for the given number of voxels which all have the same value.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void encodeUniformRLE(const VoxelType& tValue, uint32_t uNoOfVoxels, std::vector<uint8_t>& vecOutput)
+	{
+		vecOutput.clear();
+
+		writeVarUInt(uNoOfVoxels, vecOutput);
+		const uint8_t* pVoxelBytes = reinterpret_cast<const uint8_t*>(&tValue);
+		vecOutput.insert(vecOutput.end(), pVoxelBytes, pVoxelBytes + sizeof(VoxelType));
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Checks whether the output of encodeRLE() consists of a single run of all the voxels, and if so returns their value.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool decodeUniformRLE(const uint8_t* pInput, size_t uInputSize, uint32_t uNoOfVoxels, VoxelType& tValue)
+	{
+		const uint8_t* pInputEnd = pInput + uInputSize;
+		if ((uInputSize == 0) || (readVarUInt(pInput, pInputEnd) != uNoOfVoxels))
+		{
+			return false;
+		}
+
+		POLYVOX_ASSERT(pInput + sizeof(VoxelType) == pInputEnd, "Compressed data has an unexpected size");
+		memcpy(&tValue, pInput, sizeof(VoxelType));
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Reverses encodeRLE(). The output must have space for exactly the number of voxels which were encoded.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void decodeRLE(const uint8_t* pInput, size_t uInputSize, VoxelType* pVoxels, uint32_t uNoOfVoxels)
+	{
+		const uint8_t* pInputEnd = pInput + uInputSize;
+		uint32_t uVoxel = 0;
+		while (pInput < pInputEnd)
+		{
+			uint32_t uRunLength = readVarUInt(pInput, pInputEnd);
+			POLYVOX_ASSERT(uVoxel + uRunLength <= uNoOfVoxels, "Compressed data contains too many voxels");
+			POLYVOX_ASSERT(pInput + sizeof(VoxelType) <= pInputEnd, "Compressed data is truncated");
+
+			VoxelType tValue;
+			memcpy(&tValue, pInput, sizeof(VoxelType));
+			pInput += sizeof(VoxelType);
+
+			std::fill(pVoxels + uVoxel, pVoxels + uVoxel + uRunLength, tValue);
+			uVoxel += uRunLength;
+		}
+
+		POLYVOX_ASSERT(uVoxel == uNoOfVoxels, "Compressed data contains too few voxels");
+		POLYVOX_UNUSED(uNoOfVoxels);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Compresses a sequence of bytes by replacing repeated sequences with references to their previous occurrence. The output is a
+	/// series of blocks, each of which holds a number of literal bytes and then the length and offset of a match. The final block
+	/// has a match length of zero and no offset. Potential matches are found through a small hash table of four-byte sequences.
+	////////////////////////////////////////////////////////////////////////////////
+	inline void compressLZ(const std::vector<uint8_t>& vecInput, std::vector<uint8_t>& vecOutput)
+	{
+		const uint32_t uMinMatchLength = 4;
+		const uint32_t uHashTableSizePower = 12;
+
+		vecOutput.clear();
+
+		const uint8_t* pInput = vecInput.data();
+		const uint32_t uInputSize = static_cast<uint32_t>(vecInput.size());
+
+		// Holds the most recent position of each hashed four-byte sequence, offset by one so that zero means 'none'.
+		std::vector<uint32_t> vecHashTable(1 << uHashTableSizePower, 0);
+
+		uint32_t uLiteralStart = 0;
+		uint32_t uPos = 0;
+		while (uPos + uMinMatchLength <= uInputSize)
+		{
+			uint32_t uSequence;
+			memcpy(&uSequence, pInput + uPos, sizeof(uSequence));
+			const uint32_t uHash = (uSequence * 2654435761u) >> (32 - uHashTableSizePower);
+
+			const uint32_t uCandidate = vecHashTable[uHash];
+			vecHashTable[uHash] = uPos + 1;
+
+			if ((uCandidate == 0) || (memcmp(pInput + uCandidate - 1, pInput + uPos, uMinMatchLength) != 0))
+			{
+				uPos++;
+				continue;
+			}
+
+			const uint32_t uMatchPos = uCandidate - 1;
+			uint32_t uMatchLength = uMinMatchLength;
+			while ((uPos + uMatchLength < uInputSize) && (pInput[uMatchPos + uMatchLength] == pInput[uPos + uMatchLength]))
+			{
+				uMatchLength++;
+			}
+
+			writeVarUInt(uPos - uLiteralStart, vecOutput);
+			vecOutput.insert(vecOutput.end(), pInput + uLiteralStart, pInput + uPos);
+			writeVarUInt(uMatchLength, vecOutput);
+			writeVarUInt(uPos - uMatchPos, vecOutput);
+
+			uPos += uMatchLength;
+			uLiteralStart = uPos;
+		}
+
+		// Whatever remains is written as literals.
+		writeVarUInt(uInputSize - uLiteralStart, vecOutput);
+		vecOutput.insert(vecOutput.end(), pInput + uLiteralStart, pInput + uInputSize);
+		writeVarUInt(0, vecOutput);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Reverses compressLZ().
+	////////////////////////////////////////////////////////////////////////////////
+	inline void decompressLZ(const uint8_t* pInput, size_t uInputSize, std::vector<uint8_t>& vecOutput)
+	{
+		const uint8_t* pInputEnd = pInput + uInputSize;
+		vecOutput.clear();
+
+		while (true)
+		{
+			uint32_t uLiteralLength = readVarUInt(pInput, pInputEnd);
+			POLYVOX_ASSERT(pInput + uLiteralLength <= pInputEnd, "Compressed data is truncated");
+			vecOutput.insert(vecOutput.end(), pInput, pInput + uLiteralLength);
+			pInput += uLiteralLength;
+
+			uint32_t uMatchLength = readVarUInt(pInput, pInputEnd);
+			if (uMatchLength == 0)
+			{
+				break;
+			}
+
+			uint32_t uOffset = readVarUInt(pInput, pInputEnd);
+			POLYVOX_ASSERT((uOffset > 0) && (uOffset <= vecOutput.size()), "Compressed data contains an invalid match offset");
+
+			// The match may overlap the data it is producing (this is how long runs are encoded) so it is copied a byte at a time.
+			size_t uMatchPos = vecOutput.size() - uOffset;
+			for (uint32_t uByte = 0; uByte < uMatchLength; uByte++)
+			{
+				vecOutput.push_back(vecOutput[uMatchPos + uByte]);
+			}
+		}
+	}
+}
+
+#endif //__PolyVox_Compression_H__
@@ -82,4 +82,18 @@
 // Implementation from here: http://stackoverflow.com/a/4851173/2337254
 #define POLYVOX_UNUSED(x) do { (void)sizeof(x); } while(0)
 
+// Declares thread-local storage. Visual Studio 2013 and GCC 4.7 do not support the C++11 'thread_local' keyword, but they
+// do provide equivalent extensions. These only work for plain-old-data types, so that is all we use this macro with.
+// POLYVOX_HAS_THREAD_LOCAL_OBJECTS tells whether 'thread_local' itself is available for objects with destructors.
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+	#define POLYVOX_THREAD_LOCAL __declspec(thread)
+	#define POLYVOX_HAS_THREAD_LOCAL_OBJECTS 0
+#elif defined(__GNUC__) && !defined(__clang__) && (__GNUC__ == 4) && (__GNUC_MINOR__ < 8)
+	#define POLYVOX_THREAD_LOCAL __thread
+	#define POLYVOX_HAS_THREAD_LOCAL_OBJECTS 0
+#else
+	#define POLYVOX_THREAD_LOCAL thread_local
+	#define POLYVOX_HAS_THREAD_LOCAL_OBJECTS 1
+#endif
+
 #endif //__PolyVox_PlatformDefinitions_H__
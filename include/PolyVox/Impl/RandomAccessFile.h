@@ -0,0 +1,199 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_RandomAccessFile_H__
+#define __PolyVox_RandomAccessFile_H__
+
+#include "PlatformDefinitions.h"
+
+#include "ErrorHandling.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+	#include <fcntl.h>
+	#include <io.h>
+	#include <sys/stat.h>
+#else
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <sys/types.h>
+	#include <unistd.h>
+#endif
+
+namespace PolyVox
+{
+	namespace Impl
+	{
+		/// A file which is opened once and then read and written at given offsets, without a shared file position. On POSIX systems
+		/// this uses pread() and pwrite(), so multiple threads can read and write at once. Elsewhere it seeks before each read or
+		/// write, and a mutex stops other threads from moving the file position in between.
+		class RandomAccessFile
+		{
+		public:
+			/// Opens the file for reading and writing, creating it if it does not exist.
+			RandomAccessFile(const std::string& strFileName)
+				:m_strFileName(strFileName)
+			{
+#if defined(_WIN32)
+				m_iDescriptor = _open(strFileName.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+				m_iDescriptor = open(strFileName.c_str(), O_RDWR | O_CREAT, 0644);
+#endif
+				POLYVOX_THROW_IF(m_iDescriptor < 0, std::runtime_error, "Unable to open '" + strFileName + "'.");
+			}
+
+			~RandomAccessFile()
+			{
+#if defined(_WIN32)
+				_close(m_iDescriptor);
+#else
+				close(m_iDescriptor);
+#endif
+			}
+
+			const std::string& getFileName(void) const
+			{
+				return m_strFileName;
+			}
+
+			/// The file descriptor, for mapping the file into memory.
+			int getDescriptor(void) const
+			{
+				return m_iDescriptor;
+			}
+
+			uint64_t getSizeInBytes(void) const
+			{
+#if defined(_WIN32)
+				struct _stat64 fileStatus;
+				POLYVOX_THROW_IF(_fstat64(m_iDescriptor, &fileStatus) != 0, std::runtime_error, "Unable to get the size of '" + m_strFileName + "'.");
+#else
+				struct stat fileStatus;
+				POLYVOX_THROW_IF(fstat(m_iDescriptor, &fileStatus) != 0, std::runtime_error, "Unable to get the size of '" + m_strFileName + "'.");
+#endif
+				return static_cast<uint64_t>(fileStatus.st_size);
+			}
+
+			/// Reads exactly uSizeInBytes bytes, throwing if the file is too short or an error occurs.
+			void read(void* pData, uint64_t uSizeInBytes, uint64_t uOffset) const
+			{
+				uint8_t* pBytes = static_cast<uint8_t*>(pData);
+				while (uSizeInBytes > 0)
+				{
+#if defined(_WIN32)
+					std::lock_guard<std::mutex> lock(m_seekMutex);
+					int64_t iResult = -1;
+					if (_lseeki64(m_iDescriptor, static_cast<__int64>(uOffset), SEEK_SET) >= 0)
+					{
+						iResult = _read(m_iDescriptor, pBytes, static_cast<unsigned int>(std::min<uint64_t>(uSizeInBytes, 1 << 30)));
+					}
+#else
+					int64_t iResult = pread(m_iDescriptor, pBytes, static_cast<size_t>(uSizeInBytes), static_cast<off_t>(uOffset));
+					if ((iResult < 0) && (errno == EINTR))
+					{
+						continue;
+					}
+#endif
+					if (iResult <= 0)
+					{
+						POLYVOX_THROW(std::runtime_error, "Error reading from '" + m_strFileName + "'.");
+					}
+					pBytes += iResult;
+					uOffset += iResult;
+					uSizeInBytes -= iResult;
+				}
+			}
+
+			void write(const void* pData, uint64_t uSizeInBytes, uint64_t uOffset)
+			{
+				const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+				while (uSizeInBytes > 0)
+				{
+#if defined(_WIN32)
+					std::lock_guard<std::mutex> lock(m_seekMutex);
+					int64_t iResult = -1;
+					if (_lseeki64(m_iDescriptor, static_cast<__int64>(uOffset), SEEK_SET) >= 0)
+					{
+						iResult = _write(m_iDescriptor, pBytes, static_cast<unsigned int>(std::min<uint64_t>(uSizeInBytes, 1 << 30)));
+					}
+#else
+					int64_t iResult = pwrite(m_iDescriptor, pBytes, static_cast<size_t>(uSizeInBytes), static_cast<off_t>(uOffset));
+					if ((iResult < 0) && (errno == EINTR))
+					{
+						continue;
+					}
+#endif
+					if (iResult <= 0)
+					{
+						POLYVOX_THROW(std::runtime_error, "Error writing to '" + m_strFileName + "'.");
+					}
+					pBytes += iResult;
+					uOffset += iResult;
+					uSizeInBytes -= iResult;
+				}
+			}
+
+			/// Changes the size of the file, discarding any data past the new end.
+			void resize(uint64_t uSizeInBytes)
+			{
+#if defined(_WIN32)
+				bool bSucceeded = _chsize_s(m_iDescriptor, static_cast<__int64>(uSizeInBytes)) == 0;
+#else
+				bool bSucceeded = ftruncate(m_iDescriptor, static_cast<off_t>(uSizeInBytes)) == 0;
+#endif
+				POLYVOX_THROW_IF(!bSucceeded, std::runtime_error, "Unable to resize '" + m_strFileName + "'.");
+			}
+
+			/// Makes sure that everything written so far has reached the disk.
+			void sync(void)
+			{
+#if defined(_WIN32)
+				bool bSucceeded = _commit(m_iDescriptor) == 0;
+#else
+				bool bSucceeded = fsync(m_iDescriptor) == 0;
+#endif
+				POLYVOX_THROW_IF(!bSucceeded, std::runtime_error, "Unable to flush '" + m_strFileName + "' to disk.");
+			}
+
+		private:
+			// Not copyable, as the copies would close the same file.
+			RandomAccessFile(const RandomAccessFile&);
+			RandomAccessFile& operator=(const RandomAccessFile&);
+
+			std::string m_strFileName;
+			int m_iDescriptor;
+#if defined(_WIN32)
+			mutable std::mutex m_seekMutex;
+#endif
+		};
+	}
+}
+
+#endif //__PolyVox_RandomAccessFile_H__
@@ -0,0 +1,330 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_SlabAllocator_H__
+#define __PolyVox_SlabAllocator_H__
+
+#include "PlatformDefinitions.h"
+
+#include "ErrorHandling.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__linux__)
+	#include <sys/mman.h>
+	#include <sys/types.h>
+	#include <unistd.h>
+#endif
+
+// Transparent huge pages are requested with madvise(), which is only available on Linux.
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	#define POLYVOX_HUGE_PAGES_SUPPORTED 1
+#else
+	#define POLYVOX_HUGE_PAGES_SUPPORTED 0
+#endif
+
+// Files are mapped into slabs with mmap(), which is also only done on Linux.
+#if defined(__linux__)
+	#define POLYVOX_FILE_MAPPING_SUPPORTED 1
+#else
+	#define POLYVOX_FILE_MAPPING_SUPPORTED 0
+#endif
+
+namespace PolyVox
+{
+	/// Hands out fixed-size blocks of memory ('slabs') which are aligned to cache lines. Slabs which are released are kept and
+	/// reused, so repeatedly allocating and freeing them (as a PagedVolume does when it pages chunks in and out) does not go
+	/// through the heap or fragment it. Memory is only returned to the system when the allocator is destroyed, so its size is
+	/// bounded by the largest number of slabs which were in use at once. All functions are safe to call from multiple threads.
+	///
+	/// On Linux the slabs can optionally be carved out of larger blocks which are backed by transparent huge pages. This reduces
+	/// TLB misses when accessing many large chunks, though whether huge pages are actually used depends on the system settings.
+	///
+	/// Also on Linux, slabs which are a whole number of memory pages are aligned to the pages, and part of a file can be mapped into
+	/// them (see mapFile()) so that they are backed by the file cache rather than by their own memory. They go back to being normal
+	/// memory when they are deallocated.
+	class SlabAllocator
+	{
+	public:
+		/// Describes the memory which has been allocated.
+		struct Statistics
+		{
+			uint32_t uSlabSizeInBytes = 0;
+			uint32_t uNoOfSlabsInUse = 0;
+			uint32_t uNoOfFreeSlabs = 0;
+			uint64_t uReservedSizeInBytes = 0; ///< The total memory obtained from the system, including free slabs.
+			uint64_t uNoOfAllocations = 0;
+			uint64_t uNoOfRecycledAllocations = 0; ///< How many allocations were satisfied by reusing a released slab.
+			uint32_t uNoOfHugePageBlocks = 0;
+			uint32_t uNoOfMappedSlabs = 0; ///< Slabs in use which have a file mapped into them.
+		};
+
+		static const uint32_t uCacheLineSize = 64;
+		static const uint32_t uHugePageSize = 2 * 1024 * 1024;
+
+		SlabAllocator(uint32_t uSlabSizeInBytes)
+			:m_uSlabSizeInBytes((uSlabSizeInBytes + uCacheLineSize - 1) & ~(uCacheLineSize - 1))
+		{
+			m_uNoOfSlabsInUse = 0;
+		}
+
+		~SlabAllocator()
+		{
+			POLYVOX_LOG_WARNING_IF(m_uNoOfSlabsInUse > 0, m_uNoOfSlabsInUse.load(), " slabs are still in use when destroying SlabAllocator");
+
+			// The blocks go back to the heap, which must not be left with the files mapped into it.
+			for (void* pSlab : m_setMappedSlabs)
+			{
+				unmapFile(pSlab);
+			}
+
+			for (void* pBlock : m_vecBlocks)
+			{
+				freeAligned(pBlock);
+			}
+		}
+
+		void* allocate(void)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_uNoOfAllocations++;
+			if (m_vecFreeSlabs.empty())
+			{
+				allocateBlock();
+			}
+			else
+			{
+				m_uNoOfRecycledAllocations++;
+			}
+
+			void* pSlab = m_vecFreeSlabs.back();
+			m_vecFreeSlabs.pop_back();
+			m_uNoOfSlabsInUse++;
+			return pSlab;
+		}
+
+		void deallocate(void* pSlab)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!m_setMappedSlabs.empty() && (m_setMappedSlabs.erase(pSlab) > 0))
+			{
+				unmapFile(pSlab);
+			}
+
+			m_vecFreeSlabs.push_back(pSlab);
+			m_uNoOfSlabsInUse--;
+		}
+
+		/// The size of the system's memory pages. Where files cannot be mapped this is a typical size rather than the real one.
+		static size_t getPageSize(void)
+		{
+#if POLYVOX_FILE_MAPPING_SUPPORTED
+			static const size_t uPageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			return uPageSize;
+#else
+			return 4096;
+#endif
+		}
+
+		/// Whether mapFile() can be used, which requires Linux and slabs which are a whole number of memory pages.
+		bool canMapFiles(void) const
+		{
+			return POLYVOX_FILE_MAPPING_SUPPORTED && ((m_uSlabSizeInBytes % getPageSize()) == 0);
+		}
+
+		/// Replaces the contents of an allocated slab with a private mapping of part of a file, starting at uOffset (which must be
+		/// a multiple of the page size). Reading the slab then reads the file through the system's file cache, and each page is only
+		/// copied into memory of its own when it is first written to. Writes never reach the file. The part of the file which is
+		/// mapped must not be changed until the slab is deallocated, as pages which have not been written to would see the change.
+		/// Returns false if the file could not be mapped, in which case the contents of the slab are undefined.
+		bool mapFile(void* pSlab, int iFileDescriptor, uint64_t uOffset)
+		{
+#if POLYVOX_FILE_MAPPING_SUPPORTED
+			if (!canMapFiles() || ((uOffset % getPageSize()) != 0))
+			{
+				return false;
+			}
+
+			void* pMapping = mmap(pSlab, m_uSlabSizeInBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, iFileDescriptor, static_cast<off_t>(uOffset));
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (pMapping == MAP_FAILED)
+			{
+				// A failed mapping may still have removed the memory which was there before.
+				unmapFile(pSlab);
+				m_setMappedSlabs.erase(pSlab);
+				return false;
+			}
+
+			m_setMappedSlabs.insert(pSlab);
+			return true;
+#else
+			POLYVOX_UNUSED(pSlab);
+			POLYVOX_UNUSED(iFileDescriptor);
+			POLYVOX_UNUSED(uOffset);
+			return false;
+#endif
+		}
+
+		/// Sets whether new memory is requested from the system as transparent huge pages. Slabs which have already been allocated
+		/// are not affected. This has no effect on platforms other than Linux.
+		void setUseHugePages(bool bUseHugePages)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bUseHugePages = bUseHugePages;
+		}
+
+		bool getUseHugePages(void) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_bUseHugePages && POLYVOX_HUGE_PAGES_SUPPORTED;
+		}
+
+		/// This does not take the lock, so that it is cheap enough for the PagedVolume to call whenever it checks its memory usage.
+		uint32_t getNoOfSlabsInUse(void) const
+		{
+			return m_uNoOfSlabsInUse;
+		}
+
+		uint32_t getSlabSizeInBytes(void) const
+		{
+			return m_uSlabSizeInBytes;
+		}
+
+		Statistics getStatistics(void) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			Statistics statistics;
+			statistics.uSlabSizeInBytes = m_uSlabSizeInBytes;
+			statistics.uNoOfSlabsInUse = m_uNoOfSlabsInUse;
+			statistics.uNoOfFreeSlabs = static_cast<uint32_t>(m_vecFreeSlabs.size());
+			statistics.uReservedSizeInBytes = m_uReservedSizeInBytes;
+			statistics.uNoOfAllocations = m_uNoOfAllocations;
+			statistics.uNoOfRecycledAllocations = m_uNoOfRecycledAllocations;
+			statistics.uNoOfHugePageBlocks = m_uNoOfHugePageBlocks;
+			statistics.uNoOfMappedSlabs = static_cast<uint32_t>(m_setMappedSlabs.size());
+			return statistics;
+		}
+
+	private:
+		// Gets a new block of memory from the system and splits it into free slabs. Without huge pages each block holds a single
+		// slab, while huge page blocks are a whole number of huge pages and hold as many slabs as will fit.
+		void allocateBlock(void)
+		{
+			bool bUseHugePages = m_bUseHugePages && POLYVOX_HUGE_PAGES_SUPPORTED;
+
+			size_t uBlockSize = m_uSlabSizeInBytes;
+			size_t uAlignment = canMapFiles() ? getPageSize() : uCacheLineSize;
+			if (bUseHugePages)
+			{
+				uBlockSize = (m_uSlabSizeInBytes + uHugePageSize - 1) & ~(static_cast<size_t>(uHugePageSize) - 1);
+				uAlignment = uHugePageSize;
+			}
+
+			void* pBlock = allocateAligned(uBlockSize, uAlignment);
+			if (!pBlock)
+			{
+				POLYVOX_LOG_ERROR("Failed to allocate memory for chunk data");
+				throw std::bad_alloc();
+			}
+
+#if POLYVOX_HUGE_PAGES_SUPPORTED
+			if (bUseHugePages)
+			{
+				// This is only advice, so if it fails we simply continue with normal pages.
+				int iResult = madvise(pBlock, uBlockSize, MADV_HUGEPAGE);
+				POLYVOX_LOG_DEBUG_IF(iResult != 0, "Transparent huge pages are not available for chunk data");
+				POLYVOX_UNUSED(iResult);
+				m_uNoOfHugePageBlocks++;
+			}
+#endif
+
+			m_vecBlocks.push_back(pBlock);
+			m_uReservedSizeInBytes += uBlockSize;
+
+			// Slabs are taken from the back of the list, so we add them in reverse to use the start of the block first.
+			size_t uNoOfSlabs = uBlockSize / m_uSlabSizeInBytes;
+			for (size_t uSlab = uNoOfSlabs; uSlab > 0; uSlab--)
+			{
+				m_vecFreeSlabs.push_back(static_cast<uint8_t*>(pBlock) + (uSlab - 1) * m_uSlabSizeInBytes);
+			}
+		}
+
+		static void* allocateAligned(size_t uSize, size_t uAlignment)
+		{
+#if defined(_WIN32)
+			return _aligned_malloc(uSize, uAlignment);
+#else
+			void* pMemory = nullptr;
+			return (posix_memalign(&pMemory, uAlignment, uSize) == 0) ? pMemory : nullptr;
+#endif
+		}
+
+		// Gives a slab which had a file mapped into it normal memory again, which also releases the file cache pages it was using.
+		void unmapFile(void* pSlab)
+		{
+#if POLYVOX_FILE_MAPPING_SUPPORTED
+			void* pMemory = mmap(pSlab, m_uSlabSizeInBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
+			POLYVOX_LOG_ERROR_IF(pMemory == MAP_FAILED, "Failed to replace a file mapping with normal memory");
+			POLYVOX_UNUSED(pMemory);
+#else
+			POLYVOX_UNUSED(pSlab);
+#endif
+		}
+
+		static void freeAligned(void* pMemory)
+		{
+#if defined(_WIN32)
+			_aligned_free(pMemory);
+#else
+			free(pMemory);
+#endif
+		}
+
+		const uint32_t m_uSlabSizeInBytes;
+		bool m_bUseHugePages = false;
+
+		mutable std::mutex m_mutex;
+		std::vector<void*> m_vecBlocks;
+		std::vector<void*> m_vecFreeSlabs;
+		std::unordered_set<void*> m_setMappedSlabs;
+		std::atomic<uint32_t> m_uNoOfSlabsInUse;
+
+		uint64_t m_uReservedSizeInBytes = 0;
+		uint64_t m_uNoOfAllocations = 0;
+		uint64_t m_uNoOfRecycledAllocations = 0;
+		uint32_t m_uNoOfHugePageBlocks = 0;
+	};
+}
+
+#endif //__PolyVox_SlabAllocator_H__
@@ -0,0 +1,152 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_ThreadPool_H__
+#define __PolyVox_ThreadPool_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace PolyVox
+{
+	/// A simple pool of worker threads which run tasks in order of priority (higher values first). Tasks with the
+	/// same priority are run in the order they were added. Tasks must not throw, as there is nowhere to report it.
+	/// The destructor runs any tasks which are still queued, so call discardPendingTasks() first if they are not needed.
+	class ThreadPool
+	{
+	public:
+		ThreadPool(uint32_t uNoOfThreads)
+		{
+			for (uint32_t ct = 0; ct < uNoOfThreads; ct++)
+			{
+				m_vecThreads.push_back(std::thread(&ThreadPool::run, this));
+			}
+		}
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_bStopping = true;
+			}
+			m_cvTaskAdded.notify_all();
+
+			for (auto& thread : m_vecThreads)
+			{
+				thread.join();
+			}
+		}
+
+		void enqueue(std::function<void()> task, int32_t iPriority = 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_queueTasks.push(Task(task, iPriority, m_uNextSequenceNumber++));
+			}
+			m_cvTaskAdded.notify_one();
+		}
+
+		/// Removes all tasks which have not yet started running.
+		void discardPendingTasks(void)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queueTasks = std::priority_queue<Task>();
+			m_cvIdle.notify_all();
+		}
+
+		/// Blocks until all queued tasks have finished running.
+		void waitForIdle(void)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cvIdle.wait(lock, [this]{ return m_queueTasks.empty() && (m_uNoOfRunningTasks == 0); });
+		}
+
+	private:
+		struct Task
+		{
+			Task(std::function<void()> function, int32_t iPriority, uint64_t uSequenceNumber)
+				:m_function(function)
+				, m_iPriority(iPriority)
+				, m_uSequenceNumber(uSequenceNumber)
+			{
+			}
+
+			// The priority queue returns the largest element first, so the earliest task compares as largest when priorities are equal.
+			bool operator<(const Task& rhs) const
+			{
+				return (m_iPriority != rhs.m_iPriority) ? (m_iPriority < rhs.m_iPriority) : (m_uSequenceNumber > rhs.m_uSequenceNumber);
+			}
+
+			std::function<void()> m_function;
+			int32_t m_iPriority;
+			uint64_t m_uSequenceNumber;
+		};
+
+		void run(void)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (true)
+			{
+				m_cvTaskAdded.wait(lock, [this]{ return m_bStopping || !m_queueTasks.empty(); });
+				if (m_queueTasks.empty())
+				{
+					// We only get here if we are stopping and there is nothing left to do.
+					return;
+				}
+
+				Task task = m_queueTasks.top();
+				m_queueTasks.pop();
+				m_uNoOfRunningTasks++;
+
+				lock.unlock();
+				task.m_function();
+				lock.lock();
+
+				m_uNoOfRunningTasks--;
+				if (m_queueTasks.empty() && (m_uNoOfRunningTasks == 0))
+				{
+					m_cvIdle.notify_all();
+				}
+			}
+		}
+
+		std::vector<std::thread> m_vecThreads;
+
+		std::mutex m_mutex;
+		std::condition_variable m_cvTaskAdded;
+		std::condition_variable m_cvIdle;
+
+		std::priority_queue<Task> m_queueTasks;
+		uint64_t m_uNextSequenceNumber = 0;
+		uint32_t m_uNoOfRunningTasks = 0;
+		bool m_bStopping = false;
+	};
+}
+
+#endif //__PolyVox_ThreadPool_H__
@@ -64,8 +64,15 @@ namespace PolyVox
 			return elapsed_microseconds.count();
 		}
 
+		// Unlike the functions above this is exact, so it can be used to accumulate many short times.
+		uint64_t elapsedTimeInNanoSeconds(void)
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_start).count());
+		}
+
 	private:
-		typedef std::chrono::system_clock clock;
+		// The steady clock is used so that changes to the system time do not affect the measurements.
+		typedef std::chrono::steady_clock clock;
 		std::chrono::time_point<clock> m_start;
 	};
 }
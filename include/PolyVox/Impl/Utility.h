@@ -28,6 +28,7 @@
 #include "PlatformDefinitions.h"
 
 #include <cstdint>
+#include <cstring>
 
 namespace PolyVox
 {
@@ -61,6 +62,19 @@ namespace PolyVox
 		return static_cast<uint8_t>(uResult - 1);
 	}
 
+	// Computes logBase2() at compile time. The input must be a power of two.
+	template <uint32_t uInput>
+	struct StaticLogBase2
+	{
+		static const uint8_t value = 1 + StaticLogBase2<uInput / 2>::value;
+	};
+
+	template <>
+	struct StaticLogBase2<1>
+	{
+		static const uint8_t value = 0;
+	};
+
 	// http://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
 	inline uint32_t upperPowerOfTwo(uint32_t v)
 	{
@@ -84,6 +98,14 @@ namespace PolyVox
 		return (r >= 0.0) ? static_cast<int32_t>(r + 0.5f) : static_cast<int32_t>(r - 0.5f);
 	}
 
+	// Voxels are compared bytewise so that the VoxelType does not need to provide an equality operator. This is also how the
+	// volumes store them, so two values which are the same here are stored identically (and in practice it is faster).
+	template <typename Type>
+	inline bool isBytewiseEqual(const Type& value1, const Type& value2)
+	{
+		return memcmp(&value1, &value2, sizeof(Type)) == 0;
+	}
+
 	template <typename Type>
 	inline Type clamp(const Type& value, const Type& low, const Type& high)
 	{
@@ -136,18 +136,7 @@ namespace PolyVox
 		RawVolume<AccumulationType> satVolume(Region(satLowerCorner, satUpperCorner));
 
 		//Clear to zeros (necessary?)
-		//FIXME - use Volume::fill() method. Implemented in base class as below
-		//but with optimised implementations in subclasses?
-		for (int32_t z = satLowerCorner.getZ(); z <= satUpperCorner.getZ(); z++)
-		{
-			for (int32_t y = satLowerCorner.getY(); y <= satUpperCorner.getY(); y++)
-			{
-				for (int32_t x = satLowerCorner.getX(); x <= satUpperCorner.getX(); x++)
-				{
-					satVolume.setVoxel(x, y, z, 0);
-				}
-			}
-		}
+		satVolume.fill(Region(satLowerCorner, satUpperCorner), 0);
 
 		typename RawVolume<AccumulationType>::Sampler satVolumeIter(&satVolume);
 
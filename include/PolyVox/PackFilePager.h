@@ -0,0 +1,821 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_PackFilePager_H__
+#define __PolyVox_PackFilePager_H__
+
+#include "Impl/PlatformDefinitions.h"
+
+#include "Impl/RandomAccessFile.h"
+#include "Impl/ThreadPool.h"
+
+#include "PagedVolume.h"
+#include "Region.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace PolyVox
+{
+	/**
+	 * An implementation of Pager which stores every chunk in a single 'pack' file, rather than writing a separate file
+	 * for each chunk as FilePager does. The file is opened once, and the chunks are read and written at known offsets
+	 * (with pread() and pwrite() where they are available), so paging does not have to open, create or delete files.
+	 * The file is kept when the pager is destroyed, and a new PackFilePager given the same file name will page the
+	 * chunks back in.
+	 *
+	 * The file starts with a small header, which gives the location of an index of the chunk positions and the offsets
+	 * of their data. The index is held in memory while the pager is in use and is written back by flush() (which is also
+	 * called by the destructor). Space which is freed when a chunk changes size (such as by becoming uniform, in which
+	 * case only the single value is stored) is reused by later chunks, but only once the index which referred to it has
+	 * been replaced by flush(). The file as of the last flush() is therefore never overwritten by anything except newer
+	 * versions of the same chunks. When a large part of the file is unused it is compacted in the background, by moving
+	 * the chunks at the end of the file into the gaps and then truncating it.
+	 *
+	 * The pager is safe to use from several threads. Its mutex only protects the index and the free space, and the chunk data
+	 * (and the index, when it is written by flush()) is read and written after releasing it, so threads do not wait for each
+	 * other's disk accesses. Compaction does not move a chunk while it is being paged, and paging a chunk which compaction is
+	 * moving waits for the move to finish.
+	 *
+	 * Chunk data which is a whole number of memory pages is aligned to the pages within the file, so that on Linux the pager can
+	 * optionally map the chunks into memory rather than reading them (see Chunk::mapData()). The page size of the machine which
+	 * created the file is recorded in it, and if a machine with larger pages opens it then the chunks are read instead. Unmodified chunks are then read
+	 * straight from the system's file cache without being copied, which suits volumes which are mostly read. As the mapped parts of
+	 * the file must not change, in this mode modified chunks are always written to new space at the end of the file and the space
+	 * they used is not reused or compacted until the file is next opened without mapping.
+	 *
+	 * As with FilePager, the voxels are written in the order given by the volume's chunk layout and in the byte order of
+	 * the machine, so the file can only be read by a PackFilePager whose volume has the same voxel type, chunk layout and
+	 * chunk side length. The voxel size and side length are checked, but the layout is not.
+	 */
+	template <typename VoxelType, uint16_t ChunkSideLength = 0, typename ChunkLayout = MortonChunkLayout>
+	class PackFilePager : public PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Pager
+	{
+	public:
+		/// Describes the contents of the pack file.
+		struct Statistics
+		{
+			uint32_t uNoOfChunks = 0;
+			uint64_t uFileSizeInBytes = 0; ///< The size which the file will have after the next flush().
+			uint64_t uFreeSizeInBytes = 0; ///< Space within the file which is not used by any chunk or by the index.
+			uint32_t uNoOfCompactions = 0;
+			uint64_t uNoOfChunksMovedByCompaction = 0;
+			uint64_t uNoOfMappedPageIns = 0; ///< Chunks which were paged in by mapping the file rather than reading it.
+		};
+
+		/// Opens the pack file, or creates it if it does not exist.
+		/// \param strFileName The name of the pack file.
+		/// \param fCompactionThreshold The pack file is compacted in the background when more than this fraction of
+		/// it is free space. Zero disables automatic compaction, though compact() can still be called.
+		/// \param bMapChunks Whether chunks are mapped into memory from the file rather than read from it, where possible.
+		PackFilePager(const std::string& strFileName, float fCompactionThreshold = 0.5f, bool bMapChunks = false)
+			:PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Pager()
+			, m_file(strFileName)
+			, m_fCompactionThreshold(fCompactionThreshold)
+			, m_bMapChunks(bMapChunks)
+		{
+			m_bStopping = false;
+			m_bCompactionQueued = false;
+
+			if (m_file.getSizeInBytes() == 0)
+			{
+				m_uChunkSideLength = ChunkSideLength;
+				m_uPageSizeInBytes = static_cast<uint32_t>(SlabAllocator::getPageSize());
+				FileHeader header = createHeader();
+				m_file.write(&header, sizeof(header), 0);
+			}
+			else
+			{
+				readIndex();
+			}
+		}
+
+		/// Destructor. Waits for any compaction to stop and then writes the index to the file.
+		virtual ~PackFilePager()
+		{
+			m_bStopping = true;
+			if (m_pCompactionThreadPool)
+			{
+				m_pCompactionThreadPool->discardPendingTasks();
+				m_pCompactionThreadPool->waitForIdle();
+			}
+
+			try
+			{
+				flush();
+			}
+			catch (const std::exception& e)
+			{
+				POLYVOX_LOG_ERROR("Failed to write the index of '", m_file.getFileName(), "' when destroying PackFilePager: ", e.what());
+			}
+		}
+
+		virtual void pageIn(const Region& region, typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk* pChunk)
+		{
+			POLYVOX_ASSERT(pChunk, "Attempting to page in NULL chunk");
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			Record* pRecord = findRecord(lock, getChunkPosition(region));
+			if (!pRecord)
+			{
+				lock.unlock();
+				POLYVOX_LOG_TRACE("No data found for ", region, " during paging in.");
+				pChunk->fill(VoxelType());
+				return;
+			}
+
+			POLYVOX_LOG_TRACE("Paging in data for ", region);
+
+			// The record is copied so that the data can be read without the mutex, while compaction is kept away from it.
+			const Record record = *pRecord;
+			pRecord->uNoOfUsers++;
+			lock.unlock();
+
+			bool bMapped = false;
+			try
+			{
+				if (record.uSizeInBytes == pChunk->getDataSizeInBytes())
+				{
+					bMapped = m_bMapChunks && pChunk->mapData(m_file.getDescriptor(), record.uOffset);
+					if (!bMapped)
+					{
+						m_file.read(pChunk->getData(), record.uSizeInBytes, record.uOffset);
+					}
+				}
+				else if (record.uSizeInBytes == sizeof(VoxelType))
+				{
+					// A single voxel was written for a uniform chunk.
+					VoxelType tUniformValue;
+					m_file.read(&tUniformValue, sizeof(VoxelType), record.uOffset);
+					pChunk->fill(tUniformValue);
+				}
+				else
+				{
+					POLYVOX_THROW(std::runtime_error, "The size of a chunk in '" + m_file.getFileName() + "' does not match the volume.");
+				}
+			}
+			catch (...)
+			{
+				lock.lock();
+				pRecord->uNoOfUsers--;
+				throw;
+			}
+
+			lock.lock();
+			pRecord->uNoOfUsers--;
+			if (bMapped)
+			{
+				m_uNoOfMappedPageIns++;
+			}
+		}
+
+		virtual void pageOut(const Region& region, typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk* pChunk)
+		{
+			POLYVOX_ASSERT(pChunk, "Attempting to page out NULL chunk");
+
+			POLYVOX_LOG_TRACE("Paging out data for ", region);
+
+			// Calling getData() on a uniform chunk would allocate the data, so we write the single value instead.
+			VoxelType tUniformValue;
+			const void* pData = &tUniformValue;
+			uint32_t uSizeInBytes = sizeof(VoxelType);
+			if (pChunk->isUniform())
+			{
+				tUniformValue = pChunk->getVoxel(0, 0, 0);
+			}
+			else
+			{
+				pData = pChunk->getData();
+				uSizeInBytes = pChunk->getDataSizeInBytes();
+			}
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			const Vector3DInt32 v3dChunkPos = getChunkPosition(region);
+			Record* pRecord = findRecord(lock, v3dChunkPos);
+
+			// Overwriting the previous version of the same chunk is the one change which the last flush() allows. Otherwise the
+			// chunk is written to new space, and the record only refers to it once the data is there.
+			const bool bOverwrite = pRecord && (pRecord->uSizeInBytes == uSizeInBytes) && !m_bMapChunks;
+			const uint64_t uOffset = bOverwrite ? pRecord->uOffset : allocateExtent(uSizeInBytes);
+			if (pRecord)
+			{
+				pRecord->uNoOfUsers++;
+			}
+			lock.unlock();
+
+			try
+			{
+				m_file.write(pData, uSizeInBytes, uOffset);
+			}
+			catch (...)
+			{
+				lock.lock();
+				if (pRecord)
+				{
+					pRecord->uNoOfUsers--;
+				}
+				if (!bOverwrite)
+				{
+					discardExtent(uOffset, uSizeInBytes);
+				}
+				throw;
+			}
+
+			lock.lock();
+			if (pRecord)
+			{
+				pRecord->uNoOfUsers--;
+			}
+			if (bOverwrite)
+			{
+				return;
+			}
+
+			if (pRecord)
+			{
+				m_mapRecordsByOffset.erase(pRecord->uOffset);
+				releaseExtent(pRecord->uOffset, pRecord->uSizeInBytes);
+				m_mapRecords.erase(v3dChunkPos);
+			}
+
+			Record record;
+			record.uOffset = uOffset;
+			record.uSizeInBytes = uSizeInBytes;
+			m_mapRecords[v3dChunkPos] = record;
+			m_mapRecordsByOffset[record.uOffset] = v3dChunkPos;
+
+			queueCompactionIfNeeded();
+		}
+
+		/// Writes the index to the file, so that the file contains every chunk which has been paged out so far, and makes the space
+		/// which has been freed since the last call available for reuse. This is called by the destructor, but calling it regularly
+		/// (such as after flushing the volume) limits what can be lost if the application does not exit cleanly.
+		void flush(void)
+		{
+			writeIndex();
+		}
+
+		/// Moves the chunks at the end of the file into any gaps before them and then shrinks the file. This normally happens in
+		/// the background (see the constructor), but can be called directly. Other threads can continue paging while it runs.
+		/// This does nothing when the chunks are being mapped into memory, as the mapped chunks must stay where they are.
+		void compact(void)
+		{
+			if (m_bMapChunks)
+			{
+				return;
+			}
+
+			std::vector<uint8_t> vecBuffer;
+			bool bMovedSinceFlush = false;
+
+			while (!m_bStopping)
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				if (moveLastRecord(lock, vecBuffer))
+				{
+					bMovedSinceFlush = true;
+					continue;
+				}
+				lock.unlock();
+
+				// The space freed by the moves can only be reused once the index no longer refers to it.
+				if (!bMovedSinceFlush)
+				{
+					break;
+				}
+				writeIndex();
+				bMovedSinceFlush = false;
+			}
+
+			writeIndex();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_uNoOfCompactions++;
+		}
+
+		/// Blocks until any compaction which is running in the background has finished.
+		void waitForCompaction(void)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			ThreadPool* pThreadPool = m_pCompactionThreadPool.get();
+			lock.unlock();
+
+			if (pThreadPool)
+			{
+				pThreadPool->waitForIdle();
+			}
+		}
+
+		Statistics getStatistics(void) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			Statistics stats;
+			stats.uNoOfChunks = static_cast<uint32_t>(m_mapRecords.size());
+			stats.uFileSizeInBytes = m_uEndOfData;
+			stats.uFreeSizeInBytes = m_uFreeSizeInBytes;
+			stats.uNoOfCompactions = m_uNoOfCompactions;
+			stats.uNoOfChunksMovedByCompaction = m_uNoOfChunksMovedByCompaction;
+			stats.uNoOfMappedPageIns = m_uNoOfMappedPageIns;
+			return stats;
+		}
+
+	private:
+		// These are written to the file as they are, so they only use fixed size types and have no padding.
+		struct FileHeader
+		{
+			char acMagic[4];
+			uint32_t uVersion;
+			uint32_t uVoxelSizeInBytes;
+			uint32_t uChunkSideLength;
+			uint32_t uPageSizeInBytes;
+			uint32_t uReserved;
+			uint64_t uIndexOffset;
+			uint64_t uNoOfIndexEntries;
+		};
+
+		struct IndexEntry
+		{
+			int32_t iX;
+			int32_t iY;
+			int32_t iZ;
+			uint32_t uSizeInBytes;
+			uint64_t uOffset;
+		};
+
+		struct Record
+		{
+			uint64_t uOffset;
+			uint32_t uSizeInBytes;
+			// The number of threads which are paging the chunk without holding the mutex. Compaction does not move it until this is zero.
+			uint32_t uNoOfUsers = 0;
+			// Set while compaction is copying the chunk to its new place, during which it can't be paged.
+			bool bMoving = false;
+		};
+
+		static const uint32_t uFileVersion = 2;
+
+		// Chunk data which is a multiple of the file's page size is aligned to it, so that it can be mapped into memory.
+		uint64_t getAlignment(uint64_t uSizeInBytes) const
+		{
+			return ((uSizeInBytes % m_uPageSizeInBytes) == 0) ? m_uPageSizeInBytes : 1;
+		}
+
+		static uint64_t alignOffset(uint64_t uOffset, uint64_t uAlignment)
+		{
+			return ((uOffset + uAlignment - 1) / uAlignment) * uAlignment;
+		}
+
+		Vector3DInt32 getChunkPosition(const Region& region)
+		{
+			uint32_t uSideLength = region.getWidthInVoxels();
+			if (m_uChunkSideLength == 0)
+			{
+				m_uChunkSideLength = uSideLength;
+			}
+			else if (m_uChunkSideLength != uSideLength)
+			{
+				POLYVOX_THROW(std::runtime_error, "The chunk side length of '" + m_file.getFileName() + "' does not match the volume.");
+			}
+
+			// The lower corner of a chunk is always a multiple of the side length.
+			return Vector3DInt32(region.getLowerX(), region.getLowerY(), region.getLowerZ()) / static_cast<int32_t>(uSideLength);
+		}
+
+		FileHeader createHeader(void) const
+		{
+			FileHeader header;
+			memcpy(header.acMagic, "PVPK", 4);
+			header.uVersion = uFileVersion;
+			header.uVoxelSizeInBytes = sizeof(VoxelType);
+			header.uChunkSideLength = m_uChunkSideLength;
+			header.uPageSizeInBytes = m_uPageSizeInBytes;
+			header.uReserved = 0;
+			header.uIndexOffset = m_indexRecord.uOffset;
+			header.uNoOfIndexEntries = m_indexRecord.uSizeInBytes / sizeof(IndexEntry);
+			return header;
+		}
+
+		/// Returns the record of a chunk, or null if it has not been written, after waiting for compaction to finish moving it. The
+		/// record stays valid after the mutex is released, as only paging the same chunk out again can remove it.
+		Record* findRecord(std::unique_lock<std::mutex>& lock, const Vector3DInt32& v3dChunkPos)
+		{
+			while (true)
+			{
+				auto iterRecord = m_mapRecords.find(v3dChunkPos);
+				if (iterRecord == m_mapRecords.end())
+				{
+					return nullptr;
+				}
+				if (!iterRecord->second.bMoving)
+				{
+					return &(iterRecord->second);
+				}
+				m_cvRecordMoved.wait(lock);
+			}
+		}
+
+		void readIndex(void)
+		{
+			FileHeader header;
+			m_file.read(&header, sizeof(header), 0);
+			if ((memcmp(header.acMagic, "PVPK", 4) != 0) || (header.uVersion != uFileVersion))
+			{
+				POLYVOX_THROW(std::runtime_error, "'" + m_file.getFileName() + "' is not a PackFilePager file.");
+			}
+			if (header.uVoxelSizeInBytes != sizeof(VoxelType))
+			{
+				POLYVOX_THROW(std::runtime_error, "The voxel size of '" + m_file.getFileName() + "' does not match the volume.");
+			}
+			if ((ChunkSideLength != 0) && (header.uChunkSideLength != 0) && (header.uChunkSideLength != ChunkSideLength))
+			{
+				POLYVOX_THROW(std::runtime_error, "The chunk side length of '" + m_file.getFileName() + "' does not match the volume.");
+			}
+			if ((header.uPageSizeInBytes == 0) || !isPowerOf2(header.uPageSizeInBytes))
+			{
+				POLYVOX_THROW(std::runtime_error, "The page size of '" + m_file.getFileName() + "' is not valid.");
+			}
+			m_uChunkSideLength = header.uChunkSideLength;
+			m_uPageSizeInBytes = header.uPageSizeInBytes;
+
+			std::vector<IndexEntry> vecEntries(static_cast<size_t>(header.uNoOfIndexEntries));
+			if (!vecEntries.empty())
+			{
+				m_indexRecord.uOffset = header.uIndexOffset;
+				m_indexRecord.uSizeInBytes = static_cast<uint32_t>(vecEntries.size() * sizeof(IndexEntry));
+				m_file.read(&(vecEntries[0]), m_indexRecord.uSizeInBytes, m_indexRecord.uOffset);
+			}
+
+			// Everything between the chunks (and the index) is free. Anything after the last of them is left over from an earlier
+			// run which did not flush, and is removed by the next flush().
+			std::map<uint64_t, uint64_t> mapUsedExtents;
+			mapUsedExtents[m_indexRecord.uOffset] = m_indexRecord.uSizeInBytes;
+			for (const IndexEntry& entry : vecEntries)
+			{
+				Vector3DInt32 v3dChunkPos(entry.iX, entry.iY, entry.iZ);
+				Record record;
+				record.uOffset = entry.uOffset;
+				record.uSizeInBytes = entry.uSizeInBytes;
+				m_mapRecords[v3dChunkPos] = record;
+				m_mapRecordsByOffset[record.uOffset] = v3dChunkPos;
+				mapUsedExtents[record.uOffset] = record.uSizeInBytes;
+			}
+
+			for (const auto& usedExtent : mapUsedExtents)
+			{
+				if (usedExtent.second == 0)
+				{
+					continue;
+				}
+				if (usedExtent.first > m_uEndOfData)
+				{
+					addFreeExtent(m_uEndOfData, usedExtent.first - m_uEndOfData);
+					m_uFreeSizeInBytes += usedExtent.first - m_uEndOfData;
+				}
+				m_uEndOfData = usedExtent.first + usedExtent.second;
+			}
+		}
+
+		/// Writes the index to a new place in the file and then points the header at it. The space used by the old index and the
+		/// chunks which have moved since the last flush is only made available afterwards, so the old index is valid until then.
+		/// The mutex is only held while taking a copy of the index and while releasing the space, not while writing to the file.
+		void writeIndex(void)
+		{
+			// Only one index is written at a time, so that each replaces the one before it in the order they were taken.
+			std::lock_guard<std::mutex> indexLock(m_indexMutex);
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			std::vector<IndexEntry> vecEntries;
+			vecEntries.reserve(m_mapRecords.size());
+			for (const auto& record : m_mapRecords)
+			{
+				IndexEntry entry;
+				entry.iX = record.first.getX();
+				entry.iY = record.first.getY();
+				entry.iZ = record.first.getZ();
+				entry.uSizeInBytes = record.second.uSizeInBytes;
+				entry.uOffset = record.second.uOffset;
+				vecEntries.push_back(entry);
+			}
+
+			Record oldIndexRecord = m_indexRecord;
+			m_indexRecord = Record();
+			m_indexRecord.uSizeInBytes = static_cast<uint32_t>(vecEntries.size() * sizeof(IndexEntry));
+			m_indexRecord.uOffset = m_indexRecord.uSizeInBytes > 0 ? allocateExtent(m_indexRecord.uSizeInBytes) : 0;
+			const FileHeader header = createHeader();
+
+			// Space which is released from now on may still be used by this index, so it waits for the next one.
+			std::vector< std::pair<uint64_t, uint64_t> > vecReleasedExtents;
+			vecReleasedExtents.swap(m_vecReleasedExtents);
+			lock.unlock();
+
+			try
+			{
+				if (!vecEntries.empty())
+				{
+					m_file.write(&(vecEntries[0]), header.uNoOfIndexEntries * sizeof(IndexEntry), header.uIndexOffset);
+				}
+
+				// The chunks and the index must be on the disk before the header which refers to them.
+				m_file.sync();
+				m_file.write(&header, sizeof(header), 0);
+			}
+			catch (...)
+			{
+				// The file still refers to the old index, so nothing which it uses can be reused yet.
+				lock.lock();
+				if (m_indexRecord.uSizeInBytes > 0)
+				{
+					discardExtent(m_indexRecord.uOffset, m_indexRecord.uSizeInBytes);
+				}
+				m_indexRecord = oldIndexRecord;
+				m_vecReleasedExtents.insert(m_vecReleasedExtents.end(), vecReleasedExtents.begin(), vecReleasedExtents.end());
+				throw;
+			}
+
+			lock.lock();
+			if (oldIndexRecord.uSizeInBytes > 0)
+			{
+				releaseExtent(oldIndexRecord.uOffset, oldIndexRecord.uSizeInBytes);
+			}
+			for (const auto& releasedExtent : vecReleasedExtents)
+			{
+				addFreeExtent(releasedExtent.first, releasedExtent.second);
+			}
+
+			// Freed space at the end of the file has been removed from the free extents, so the file can now be shortened.
+			if (m_file.getSizeInBytes() > m_uEndOfData)
+			{
+				m_file.resize(m_uEndOfData);
+			}
+		}
+
+		/// Moves the chunk at the end of the file into the first free extent which is large enough for it. Returns false if there is
+		/// no such extent, or if the chunk is being paged (in which case a later compaction will move it). The chunk is copied
+		/// without holding the mutex, and the lock is held again when this returns.
+		bool moveLastRecord(std::unique_lock<std::mutex>& lock, std::vector<uint8_t>& vecBuffer)
+		{
+			if (m_mapRecordsByOffset.empty())
+			{
+				return false;
+			}
+
+			auto iterLast = --m_mapRecordsByOffset.end();
+			const Vector3DInt32 v3dChunkPos = iterLast->second;
+			Record& record = m_mapRecords[v3dChunkPos];
+			if ((record.uNoOfUsers > 0) || record.bMoving)
+			{
+				return false;
+			}
+
+			const uint64_t uAlignment = getAlignment(record.uSizeInBytes);
+			auto iterFreeExtent = m_mapFreeExtents.begin();
+			uint64_t uNewOffset = 0;
+			while (true)
+			{
+				// The free extents don't overlap the chunk, so one which starts before it also ends before it.
+				if ((iterFreeExtent == m_mapFreeExtents.end()) || (iterFreeExtent->first > record.uOffset))
+				{
+					return false;
+				}
+
+				uNewOffset = alignOffset(iterFreeExtent->first, uAlignment);
+				if (uNewOffset + record.uSizeInBytes <= iterFreeExtent->first + iterFreeExtent->second)
+				{
+					break;
+				}
+				++iterFreeExtent;
+			}
+
+			claimFreeExtent(iterFreeExtent->first, iterFreeExtent->second, uNewOffset, record.uSizeInBytes);
+
+			// Paging the chunk waits while it is moving, so the record can't be removed until the flag is cleared.
+			const uint64_t uOldOffset = record.uOffset;
+			const uint32_t uSizeInBytes = record.uSizeInBytes;
+			record.bMoving = true;
+			lock.unlock();
+
+			try
+			{
+				vecBuffer.resize(uSizeInBytes);
+				m_file.read(&(vecBuffer[0]), uSizeInBytes, uOldOffset);
+				m_file.write(&(vecBuffer[0]), uSizeInBytes, uNewOffset);
+			}
+			catch (...)
+			{
+				lock.lock();
+				discardExtent(uNewOffset, uSizeInBytes);
+				record.bMoving = false;
+				m_cvRecordMoved.notify_all();
+				throw;
+			}
+
+			lock.lock();
+			m_mapRecordsByOffset.erase(uOldOffset);
+			releaseExtent(uOldOffset, uSizeInBytes);
+			record.uOffset = uNewOffset;
+			record.bMoving = false;
+			m_mapRecordsByOffset[uNewOffset] = v3dChunkPos;
+			m_cvRecordMoved.notify_all();
+
+			m_uNoOfChunksMovedByCompaction++;
+			return true;
+		}
+
+		/// Finds space for uSizeInBytes bytes, using the smallest free extent which is large enough or else extending the file.
+		uint64_t allocateExtent(uint64_t uSizeInBytes)
+		{
+			const uint64_t uAlignment = getAlignment(uSizeInBytes);
+			for (auto iterFreeExtent = m_mapFreeExtentsBySize.lower_bound(uSizeInBytes); iterFreeExtent != m_mapFreeExtentsBySize.end(); ++iterFreeExtent)
+			{
+				uint64_t uOffset = alignOffset(iterFreeExtent->second, uAlignment);
+				if (uOffset + uSizeInBytes <= iterFreeExtent->second + iterFreeExtent->first)
+				{
+					claimFreeExtent(iterFreeExtent->second, iterFreeExtent->first, uOffset, uSizeInBytes);
+					return uOffset;
+				}
+			}
+
+			// Any space which is skipped to align the data can be used by something smaller later.
+			uint64_t uPaddingOffset = m_uEndOfData;
+			uint64_t uOffset = alignOffset(m_uEndOfData, uAlignment);
+			m_uEndOfData = uOffset + uSizeInBytes;
+			if (uOffset > uPaddingOffset)
+			{
+				addFreeExtent(uPaddingOffset, uOffset - uPaddingOffset);
+				m_uFreeSizeInBytes += uOffset - uPaddingOffset;
+			}
+			return uOffset;
+		}
+
+		/// Takes uSizeInBytes bytes at uOffset from the given free extent, leaving the rest of the extent free.
+		void claimFreeExtent(uint64_t uExtentOffset, uint64_t uExtentSizeInBytes, uint64_t uOffset, uint64_t uSizeInBytes)
+		{
+			removeFreeExtent(uExtentOffset, uExtentSizeInBytes);
+			if (uOffset > uExtentOffset)
+			{
+				addFreeExtent(uExtentOffset, uOffset - uExtentOffset);
+			}
+			if (uExtentOffset + uExtentSizeInBytes > uOffset + uSizeInBytes)
+			{
+				addFreeExtent(uOffset + uSizeInBytes, uExtentOffset + uExtentSizeInBytes - (uOffset + uSizeInBytes));
+			}
+			m_uFreeSizeInBytes -= uSizeInBytes;
+		}
+
+		/// Records that an extent is no longer used. It is not reused until after the next flush(), or at all while the chunks are
+		/// being mapped into memory (as some of them may still be using it).
+		void releaseExtent(uint64_t uOffset, uint64_t uSizeInBytes)
+		{
+			if (!m_bMapChunks)
+			{
+				m_vecReleasedExtents.push_back(std::make_pair(uOffset, uSizeInBytes));
+			}
+			m_uFreeSizeInBytes += uSizeInBytes;
+		}
+
+		/// Makes an extent which nothing has referred to (such as one which could not be written) available again straight away.
+		void discardExtent(uint64_t uOffset, uint64_t uSizeInBytes)
+		{
+			m_uFreeSizeInBytes += uSizeInBytes;
+			addFreeExtent(uOffset, uSizeInBytes);
+		}
+
+		/// Makes an extent available for allocation, merging it with its neighbours. Free space at the end of the file is removed.
+		void addFreeExtent(uint64_t uOffset, uint64_t uSizeInBytes)
+		{
+			auto iterNext = m_mapFreeExtents.find(uOffset + uSizeInBytes);
+			if (iterNext != m_mapFreeExtents.end())
+			{
+				uSizeInBytes += iterNext->second;
+				removeFreeExtent(iterNext->first, iterNext->second);
+			}
+
+			auto iterPrevious = m_mapFreeExtents.lower_bound(uOffset);
+			if (iterPrevious != m_mapFreeExtents.begin())
+			{
+				--iterPrevious;
+				if (iterPrevious->first + iterPrevious->second == uOffset)
+				{
+					uOffset = iterPrevious->first;
+					uSizeInBytes += iterPrevious->second;
+					removeFreeExtent(iterPrevious->first, iterPrevious->second);
+				}
+			}
+
+			if (uOffset + uSizeInBytes == m_uEndOfData)
+			{
+				m_uEndOfData = uOffset;
+				m_uFreeSizeInBytes -= uSizeInBytes;
+			}
+			else
+			{
+				m_mapFreeExtents[uOffset] = uSizeInBytes;
+				m_mapFreeExtentsBySize.insert(std::make_pair(uSizeInBytes, uOffset));
+			}
+		}
+
+		void removeFreeExtent(uint64_t uOffset, uint64_t uSizeInBytes)
+		{
+			m_mapFreeExtents.erase(uOffset);
+			auto range = m_mapFreeExtentsBySize.equal_range(uSizeInBytes);
+			for (auto iter = range.first; iter != range.second; ++iter)
+			{
+				if (iter->second == uOffset)
+				{
+					m_mapFreeExtentsBySize.erase(iter);
+					break;
+				}
+			}
+		}
+
+		void queueCompactionIfNeeded(void)
+		{
+			if ((m_fCompactionThreshold <= 0.0f) || m_bMapChunks || m_bCompactionQueued || (m_uFreeSizeInBytes <= m_fCompactionThreshold * m_uEndOfData))
+			{
+				return;
+			}
+
+			if (!m_pCompactionThreadPool)
+			{
+				m_pCompactionThreadPool.reset(new ThreadPool(1));
+			}
+
+			m_bCompactionQueued = true;
+			m_pCompactionThreadPool->enqueue([this]
+			{
+				try
+				{
+					compact();
+				}
+				catch (const std::exception& e)
+				{
+					POLYVOX_LOG_ERROR("Failed to compact '", m_file.getFileName(), "': ", e.what());
+				}
+				m_bCompactionQueued = false;
+			});
+		}
+
+		Impl::RandomAccessFile m_file;
+		float m_fCompactionThreshold;
+		bool m_bMapChunks;
+		uint32_t m_uChunkSideLength = 0;
+		uint32_t m_uPageSizeInBytes = 0;
+
+		// The chunks are looked up by their position when paging, and by their offset when compacting.
+		std::unordered_map<Vector3DInt32, Record> m_mapRecords;
+		std::map<uint64_t, Vector3DInt32> m_mapRecordsByOffset;
+		Record m_indexRecord = Record();
+
+		// The free extents are kept both by offset (so that neighbours can be merged) and by size (for finding the best fit).
+		std::map<uint64_t, uint64_t> m_mapFreeExtents;
+		std::multimap<uint64_t, uint64_t> m_mapFreeExtentsBySize;
+		std::vector< std::pair<uint64_t, uint64_t> > m_vecReleasedExtents;
+		uint64_t m_uEndOfData = sizeof(FileHeader);
+		uint64_t m_uFreeSizeInBytes = 0;
+
+		uint32_t m_uNoOfCompactions = 0;
+		uint64_t m_uNoOfChunksMovedByCompaction = 0;
+		uint64_t m_uNoOfMappedPageIns = 0;
+
+		mutable std::mutex m_mutex;
+		std::condition_variable m_cvRecordMoved;
+		std::mutex m_indexMutex;
+		std::atomic<bool> m_bStopping;
+		std::atomic<bool> m_bCompactionQueued;
+		std::unique_ptr<ThreadPool> m_pCompactionThreadPool;
+	};
+}
+
+#endif //__PolyVox_PackFilePager_H__
@@ -26,21 +26,51 @@
 #define __PolyVox_PagedVolume_H__
 
 #include "BaseVolume.h"
+#include "ChunkLayout.h"
 #include "Region.h"
 #include "Vector.h"
 
+#include "Impl/ChangeTracker.h"
+#include "Impl/Compression.h"
+#include "Impl/SlabAllocator.h"
+#include "Impl/ThreadPool.h"
+#include "Impl/Timer.h"
+#include "Impl/Utility.h"
+
+#include <array>
+#include <atomic>
 #include <limits>
+#include <condition_variable>
 #include <cstdlib> //For abort()
 #include <cstring> //For memcpy
+#include <exception>
+#include <future>
 #include <unordered_map>
+#include <iterator>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept> //For invalid_argument
+#include <thread>
 #include <vector>
 
 namespace PolyVox
 {
+	/// Specifies whether chunks which have not been used recently are kept in memory in a compressed form. See PagedVolume::setChunkCompression().
+	namespace ChunkCompressions
+	{
+		enum ChunkCompression
+		{
+			None = 0, ///< Chunks are passed to the Pager as soon as they are evicted.
+			RLE = 1, ///< Evicted chunks are run-length encoded.
+			RLEAndLZ = 2 ///< Evicted chunks are run-length encoded, and the runs are then compressed further. This is slower but uses less memory.
+		};
+	}
+	typedef ChunkCompressions::ChunkCompression ChunkCompression;
+
+	template <typename VoxelType, uint16_t ChunkSideLength = 0, typename ChunkLayout = MortonChunkLayout> class PagedVolumeSnapshot;
+
 	/// This class provide a volume implementation which avoids storing all the data in memory at all times. Instead it breaks the volume
 	/// down into a set of chunks and moves these into and out of memory on demand. This means it is much more memory efficient than the
 	/// RawVolume, but may also be slower and is more complicated We encourage uses to work with RawVolume initially, and then switch to
@@ -53,8 +83,26 @@ namespace PolyVox
 	///
 	/// A consequence of this paging approach is that (unlike the RawVolume) the PagedVolume does not need to have a predefined size. After
 	/// the volume has been created you can begin acessing voxels anywhere in space and the required data will be created automatically.
+	///
+	/// By default the PagedVolume should only be accessed from a single thread. If you pass 'true' for the 'bThreadSafe' constructor
+	/// parameter then multiple threads can read and write voxels (directly or via samplers) at the same time. In this mode each thread
+	/// gets its own record of the most recently accessed chunk, and a chunk is never evicted while another thread (or a sampler) is
+	/// still using it. Note that the volume does not serialise writes to the same voxel - if two threads write the same voxel, or one
+	/// thread reads a voxel while another writes it, then the result is undefined just as it would be for any other shared variable.
+	/// The Pager's pageIn() function may also be called from several threads at once (always for different chunks) in this mode, so it
+	/// must be safe to use concurrently. Calls to pageOut() are never made concurrently with each other, but see setPageOutQueueLength()
+	/// for how they can overlap with calls to pageIn().
+	///
+	/// The chunk side length is normally passed to the constructor, but it can also be fixed at compile time by giving it as the second
+	/// template parameter (for example PagedVolume<uint8_t, 32>). The shifts and masks which convert positions into chunks and offsets
+	/// within them then become constants, which makes voxel access and samplers a little faster. Note that such a volume has its own
+	/// Chunk and Pager types, so a FilePager for it must be declared with the same side length.
+	///
+	/// The order in which each chunk stores its voxels is given by the third template parameter, which is one of the layouts in
+	/// ChunkLayout.h (for example PagedVolume<uint8_t, 32, LinearChunkLayout>). The default is Morton order, but other orders may
+	/// suit some access patterns better, and a Pager whose data is already in the chosen order can copy it directly into the chunk.
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
+	template <typename VoxelType, uint16_t ChunkSideLength = 0, typename ChunkLayout = MortonChunkLayout>
 	class PagedVolume : public BaseVolume<VoxelType>
 	{
 	public:
@@ -63,6 +111,13 @@ namespace PolyVox
 		/// The Pager class is responsible for the loading and unloading of Chunks, and can be subclassed by the user.
 		class Pager;
 
+	private:
+		friend class PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>;
+		struct PreservedChunk;
+		struct ApronCopy;
+		struct Palette;
+
+	public:
 		class Chunk
 		{
 			friend class PagedVolume;
@@ -74,6 +129,10 @@ namespace PolyVox
 			VoxelType* getData(void) const;
 			uint32_t getDataSizeInBytes(void) const;
 
+			bool isUniform(void) const;
+			void fill(VoxelType tValue);
+			bool mapData(int iFileDescriptor, uint64_t uOffset);
+
 			VoxelType getVoxel(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos) const;
 			VoxelType getVoxel(const Vector3DUint16& v3dPos) const;
 
@@ -83,8 +142,6 @@ namespace PolyVox
 			void changeLinearOrderingToMorton(void);
 			void changeMortonOrderingToLinear(void);
 
-			FCriticalSection m_mutex;
-
 		private:
 			/// Private copy constructor to prevent accisdental copying
 			Chunk(const Chunk& /*rhs*/) {};
@@ -92,17 +149,87 @@ namespace PolyVox
 			/// Private assignment operator to prevent accisdental copying
 			Chunk& operator=(const Chunk& /*rhs*/) {};
 
-			// This is updated by the PagedVolume and used to discard the least recently used chunks.
-			uint32_t m_uChunkLastAccessed;
+			// The PagedVolume keeps its chunks in a list ordered by when they were last accessed, so that it can find the least
+			// recently used chunk without searching. These links are maintained by the PagedVolume under its chunk mutex.
+			Chunk* m_pMoreRecentChunk;
+			Chunk* m_pLessRecentChunk;
+
+			// The position of this chunk in the PagedVolume's chunk array.
+			uint32_t m_uChunkArrayIndex;
 
 			// This is so we can tell whether a uncompressed chunk has to be recompressed and whether
 			// a compressed chunk has to be paged back to disk, or whether they can just be discarded.
-			bool m_bDataModified;
+			// It is atomic because several threads may write to the same chunk in a thread safe volume.
+			std::atomic<bool> m_bDataModified;
+
+			// A chunk is added to the volume before its data is paged in, so that other threads which need it will wait for the
+			// pager to finish rather than paging it in a second time. These flags are protected by the volume's chunk mutex.
+			bool m_bLoaded;
+			bool m_bLoadFailed;
+
+			// Set while a modified chunk which has been evicted is waiting for (or undergoing) a background page-out.
+			// These are also protected by the volume's chunk mutex.
+			bool m_bPageOutQueued;
+			bool m_bBeingPagedOut;
+
+			// The number of PinnedRegions which include this chunk. Pinned chunks are taken out of the list of chunks, so they are
+			// never considered for eviction. This is also protected by the volume's chunk mutex.
+			uint32_t m_uNoOfPins;
+
+			// The epoch of the latest snapshot (see PagedVolume::snapshot()) when the chunk was last checked before being written to.
+			// If a newer snapshot has been taken then its contents have to be preserved for that snapshot before the next write.
+			// This is only changed under the volume's chunk mutex, but writers compare it with the volume's epoch without locking.
+			std::atomic<uint64_t> m_uSnapshotEpoch;
+
+			// The number of snapshots which are reading this chunk's data directly, because it has not been written to since they
+			// were taken. This is protected by the volume's chunk mutex.
+			uint32_t m_uNoOfSnapshotReaders;
+
+			// The number of samplers which are currently inside this chunk, and so may be pointing at its data.
+			mutable std::atomic<uint32_t> m_uNoOfSamplers;
+
+			// Data which has been handed over to snapshots, but which samplers were still pointing at. This is kept until the chunk
+			// is destroyed or there are no samplers left in it, and is also protected by the volume's chunk mutex.
+			std::vector< std::shared_ptr<const PreservedChunk> > m_vecRetainedChunks;
+
+			// The bounds of the voxels which have been written through the volume since its changes were last collected, packed
+			// by ChangeTracker::recordChange(). This is zero if there are none, or if the volume is not tracking changes.
+			std::atomic<uint64_t> m_uChangedBounds;
+
+			// A copy of the chunk which also includes the voxels around it, made for samplers when the volume's chunk aprons are
+			// enabled. It is replaced and read by several threads at once in a thread safe volume, so use std::atomic_load() and
+			// std::atomic_store() to access it.
+			std::shared_ptr<ApronCopy> m_pApronCopy;
+
+			uint64_t calculateSizeInBytes(void);
+			static uint64_t calculateSizeInBytes(uint32_t uSideLength);
+
+			VoxelType* allocateData(void) const;
+			VoxelType* createData(void) const;
+			VoxelType* copyData(void) const;
+			void freeData(VoxelType* pData) const;
+
+			VoxelType* loadData(const Palette*& pPalette) const;
+			VoxelType getVoxelWithoutData(uint32_t uVoxelIndex) const;
+			VoxelType* decodePalette(const Palette& palette) const;
+			bool setPaletteVoxel(uint32_t uVoxelIndex, const VoxelType& tValue);
+			bool packPalette(void);
+			void replacePalette(Palette* pNewPalette) const;
+
+			void setDataModified(bool bModified);
 
-			uint32_t calculateSizeInBytes(void);
-			static uint32_t calculateSizeInBytes(uint32_t uSideLength);
+			// A chunk in which every voxel has the same value does not allocate any voxel data, and instead just stores that value.
+			// The data is allocated when a voxel is changed (or when it is requested through getData()), which may happen on several
+			// threads at once in a thread safe volume. The pointer is atomic so that exactly one of the allocations is kept.
+			mutable std::atomic<VoxelType*> m_tData;
+			VoxelType m_tUniformValue;
+
+			// Provides the memory for the voxel data. This is owned by the volume, and is null for chunks which don't belong to one.
+			SlabAllocator* m_pAllocator;
+
+			// The volume which owns this chunk (if any), which counts the modified chunks and the time spent paging them out.
+			const PagedVolume* m_pVolume;
 
-			VoxelType* m_tData;
 			uint16_t m_uSideLength;
 			uint8_t m_uSideLengthPower;
 			Pager* m_pPager;
@@ -110,6 +237,16 @@ namespace PolyVox
 			// Note: Do we really need to store this position here as well as in the block maps?
 			Vector3DInt32 m_v3dChunkSpacePosition;
 
+			// A chunk which only holds a few different values can store them in a palette instead of allocating its data. Readers check
+			// for the data first, so the data is set before the palette is released when the palette is expanded. The palette and the
+			// data are only created under the mutex, so that a write to the palette can't be lost to another thread allocating the data.
+			// Replaced palettes may still be being read by other threads in a thread safe volume, so they are kept until it is safe
+			// to delete them (when the volume finds the chunk unused while looking for chunks to pack, or the chunk is destroyed).
+			mutable std::atomic<Palette*> m_pPalette;
+			mutable std::vector< std::unique_ptr<Palette> > m_vecRetiredPalettes;
+			// Incremented after each change to the voxels in the palette, so that samplers know when their copies of it are out of date.
+			std::atomic<uint32_t> m_uPaletteVersion;
+			mutable std::mutex m_mutexPalette;
 		};
 
 		/**
@@ -135,18 +272,21 @@ namespace PolyVox
 		//option. For now it seems best to 'fix' it with the preprocessor insstead, but maybe the workaround can be reinstated
 		//in the future
 		//typedef Volume<VoxelType> VolumeOfVoxelType; //Workaround for GCC/VS2010 differences.
-		//class Sampler : public VolumeOfVoxelType::template Sampler< PagedVolume<VoxelType> >
+		//class Sampler : public VolumeOfVoxelType::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >
 #ifndef SWIG
 #if defined(_MSC_VER)
-		class Sampler : public BaseVolume<VoxelType>::Sampler< PagedVolume<VoxelType> > //This line works on VS2010
+		class Sampler : public BaseVolume<VoxelType>::Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> > //This line works on VS2010
 #else
-		class Sampler : public BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> > //This line works on GCC
+		class Sampler : public BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> > //This line works on GCC
 #endif
 		{
 		public:
-			Sampler(PagedVolume<VoxelType>* volume);
+			Sampler(PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>* volume);
+			Sampler(const Sampler& rhs);
 			~Sampler();
 
+			Sampler& operator=(const Sampler& rhs);
+
 			inline VoxelType getVoxel(void) const;
 
 			void setPosition(const Vector3DInt32& v3dNewPos);
@@ -192,6 +332,12 @@ namespace PolyVox
 			inline VoxelType peekVoxel1px1py1pz(void) const;
 
 		private:
+			Chunk* getCachedChunk(uint32_t uSlot, int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const;
+			void setCachedChunks(const std::array<std::shared_ptr<Chunk>, 27>& arrayChunks);
+			void releaseCachedChunks(void);
+			VoxelType* getPaletteCopy(uint32_t uSlot, const Chunk* pChunk) const;
+			VoxelType peekVoxelInNeighbour(int32_t iDeltaX, int32_t iDeltaY, int32_t iDeltaZ) const;
+
 			//Other current position information
 			VoxelType* mCurrentVoxel;
 
@@ -199,17 +345,111 @@ namespace PolyVox
 			uint16_t m_uYPosInChunk;
 			uint16_t m_uZPosInChunk;
 
-			// This should ideally be const, but that prevent automatic generation of an assignment operator (https://goo.gl/Sn7KpZ).
-			// We could provide one manually, but it's currently unused so there is no real test for if it works. I'm putting
-			// together a new release at the moment so I'd rathern not make 'risky' changes.
+			// Holding a reference to the current chunk prevents it from being evicted while we are pointing into its data. We also
+			// hold on to the neighbouring chunks which we have peeked into, so that peeking across a chunk boundary does not need to
+			// ask the volume for the chunk every time. Chunk (x, y, z) is kept in slot (x mod 3) + 3(y mod 3) + 9(z mod 3), so that
+			// a chunk and its 26 neighbours never share a slot, and chunks stay where they are as the sampler moves between them.
+			uint8_t m_uXChunkSlot;
+			uint8_t m_uYChunkSlot;
+			uint8_t m_uZChunkSlot;
+			Chunk* m_pCurrentChunk;
+			mutable std::array<std::shared_ptr<Chunk>, 27> m_arrayCachedChunks;
+
+			// The offsets used to move between voxels in the current chunk. If the chunk is uniform then we point at its single
+			// value, and these are all zero so that moving and peeking inside the chunk always finds that value.
+			const int32_t* m_pDeltaX;
+			const int32_t* m_pDeltaY;
+			const int32_t* m_pDeltaZ;
+
+			// When the volume's chunk aprons are enabled we point into a copy of the current chunk which includes the voxels around
+			// it, so a peek into a neighbouring chunk is a fixed offset from the current voxel. The deltas then come from the volume,
+			// and these are the copy's row and slice sizes. The copy is null when aprons are disabled.
+			std::shared_ptr<ApronCopy> m_pApronCopy;
+			int32_t m_iApronStrideY;
+			int32_t m_iApronStrideZ;
+
+			// A chunk which is storing its voxels in a palette has no data to point into, so we decode the palette into a copy of our
+			// own rather than expanding the chunk. There is a copy for each chunk slot, which is kept until the slot is given another
+			// chunk and reused while the palette is unchanged. Copies of the sampler share them, but a copy is never overwritten (a
+			// new one is made instead) except to add the sampler's own writes.
+			struct PaletteCopy
+			{
+				uint32_t m_uPaletteVersion;
+				std::vector<VoxelType> m_vecData;
+			};
+			mutable std::array<std::shared_ptr<PaletteCopy>, 27> m_arrayPaletteCopies;
+
+			// This should ideally be const, but that would prevent assignment (https://goo.gl/Sn7KpZ).
 			uint16_t m_uChunkSideLengthMinusOne;
+
+			uint16_t getChunkSideLengthMinusOne(void) const { return (ChunkSideLength != 0) ? (ChunkSideLength - 1) : m_uChunkSideLengthMinusOne; }
 		};
 
 #endif // SWIG
 
 	public:
+		/// Keeps the chunks which cover a region in memory for as long as it exists. These are created by PagedVolume::pin(), and
+		/// must not outlive the volume. They can be moved but not copied.
+		class PinnedRegion
+		{
+			friend class PagedVolume;
+
+		public:
+			PinnedRegion();
+			PinnedRegion(PinnedRegion&& rhs);
+			~PinnedRegion();
+
+			PinnedRegion& operator=(PinnedRegion&& rhs);
+
+			PinnedRegion(const PinnedRegion&) = delete;
+			PinnedRegion& operator=(const PinnedRegion&) = delete;
+
+			/// Returns the region which was pinned.
+			const Region& getRegion(void) const;
+			/// Unpins the chunks before the PinnedRegion is destroyed.
+			void release(void);
+
+		private:
+			PagedVolume* m_pVolume;
+			Region m_region;
+			std::vector< std::shared_ptr<Chunk> > m_vecChunks;
+		};
+
+		/// A snapshot of the volume's memory usage and paging activity, as returned by getStatistics().
+		struct Statistics
+		{
+			uint32_t uNoOfResidentChunks = 0; ///< Uncompressed chunks which can be accessed directly.
+			uint32_t uNoOfQueuedChunks = 0; ///< Evicted chunks which are waiting to be paged out by the writer thread.
+			uint32_t uNoOfCompressedChunks = 0;
+			uint32_t uNoOfDirtyChunks = 0; ///< Chunks in any of the above which have been modified since they were paged in.
+			uint32_t uNoOfPinnedChunks = 0; ///< Resident chunks which are covered by at least one PinnedRegion.
+
+			uint64_t uResidentSizeInBytes = 0;
+			uint64_t uQueuedSizeInBytes = 0;
+			uint64_t uCompressedSizeInBytes = 0;
+
+			uint64_t uNoOfChunkCacheHits = 0; ///< Accesses which found their chunk in the (per-thread) record of the last chunk accessed.
+			uint64_t uNoOfChunkCacheMisses = 0;
+			float fChunkCacheHitRate = 0.0f;
+
+			uint64_t uNoOfPageIns = 0; ///< Calls to Pager::pageIn(), which does not include chunks restored from the other tiers.
+			uint64_t uPageInTimeInNanoSeconds = 0;
+			uint64_t uNoOfPageOuts = 0;
+			uint64_t uPageOutTimeInNanoSeconds = 0;
+			uint64_t uNoOfEvictions = 0; ///< Chunks which were removed from the resident chunks to stay within the memory limit.
+
+			uint32_t uNoOfSnapshots = 0;
+			uint64_t uSnapshotSizeInBytes = 0; ///< Copies of chunks which are only kept for snapshots, and are not part of the sizes above.
+
+			uint32_t uNoOfApronCopies = 0;
+			uint64_t uApronSizeInBytes = 0; ///< Copies of chunks with their neighbouring voxels (see setChunkApronEnabled()), which are not part of the sizes above.
+
+			uint32_t uNoOfPaletteChunks = 0; ///< Resident chunks which are storing their voxels as a palette (see setChunkPaletteEnabled()).
+			uint64_t uPaletteSizeInBytes = 0; ///< The memory used by the palettes, which is included in uResidentSizeInBytes.
+		};
+
 		/// Constructor for creating a fixed size volume.
-		PagedVolume(Pager* pPager, uint32_t uTargetMemoryUsageInBytes = 256 * 1024 * 1024, uint16_t uChunkSideLength = 32);
+		PagedVolume(Pager* pPager, uint64_t uTargetMemoryUsageInBytes = 256 * 1024 * 1024, uint16_t uChunkSideLength = (ChunkSideLength != 0) ? ChunkSideLength : 32, bool bThreadSafe = false);
 		/// Destructor
 		~PagedVolume();
 
@@ -223,15 +463,68 @@ namespace PolyVox
 		/// Sets the voxel at the position given by a 3D vector
 		void setVoxel(const Vector3DInt32& v3dPos, VoxelType tValue);
 
+		/// Copies the voxels in a region into a buffer
+		void readRegion(const Region& region, VoxelType* pDst, RegionLayout eLayout = RegionLayouts::XYZ) const;
+		/// Copies the voxels in a region from a buffer
+		void writeRegion(const Region& region, const VoxelType* pSrc, RegionLayout eLayout = RegionLayouts::XYZ);
+		/// Sets every voxel in a region to the same value
+		void fill(const Region& region, VoxelType tValue);
+
 		/// Tries to ensure that the voxels within the specified Region are loaded into memory.
 		void prefetch(Region regPrefetch);
+		/// Loads the voxels within the specified Region into memory using background threads.
+		std::future<void> prefetchAsync(Region regPrefetch, int32_t iPriority = 0);
 		/// Removes all voxels from memory
 		void flushAll();
 
+		/// Loads the voxels within the specified Region and keeps them in memory until the returned PinnedRegion is destroyed.
+		PinnedRegion pin(const Region& regPin);
+		/// Returns a read-only view of the volume as it is now, which is not affected by later writes.
+		std::unique_ptr< PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout> > snapshot(void);
+
+		/// Describes the changes which have been made to a single chunk, as returned by getChangedChunks().
+		typedef ChangeTracker::ChangedChunk ChangedChunk;
+
+		/// Sets whether the volume records which voxels are modified.
+		void setChangeTrackingEnabled(bool bEnabled);
+		/// Returns whether the volume records which voxels are modified.
+		bool isChangeTrackingEnabled(void) const;
+		/// Returns the chunks which have been modified since the changes were last consumed.
+		std::vector<ChangedChunk> getChangedChunks(void) const;
+		/// Returns how many times changes to the chunk at the given position (in chunk space) have been recorded.
+		uint32_t getChunkVersion(const Vector3DInt32& v3dChunkPos) const;
+		/// Returns the extraction regions which need updating because of the changes since this was last called.
+		std::vector<Region> consumeChangedRegions(const Vector3DInt32& v3dRegionSize);
+
+		/// Sets whether samplers work from copies of the chunks which include the neighbouring voxels.
+		void setChunkApronEnabled(bool bEnabled);
+		/// Returns whether samplers work from copies of the chunks which include the neighbouring voxels.
+		bool isChunkApronEnabled(void) const;
+
+		/// Sets whether chunks which hold only a few different values store them as a palette of values and packed indices.
+		void setChunkPaletteEnabled(bool bEnabled);
+		/// Returns whether chunks which hold only a few different values store them as a palette of values and packed indices.
+		bool isChunkPaletteEnabled(void) const;
+
+		/// Sets how many modified chunks can be waiting to be paged out by a background thread.
+		void setPageOutQueueLength(uint32_t uMaxQueuedChunks);
+		/// Sets whether evicted chunks are kept in memory in a compressed form before being passed to the Pager.
+		void setChunkCompression(ChunkCompression eCompression);
+
 		/// Calculates approximatly how many bytes of memory the volume is currently using.
-		uint32_t calculateSizeInBytes(void);
+		uint64_t calculateSizeInBytes(void);
+		/// Returns the volume's current memory usage and counts of its paging activity.
+		Statistics getStatistics(void) const;
 
-		FCriticalSection Mutex;
+		/// Sets whether the chunk data is stored in transparent huge pages, where the platform supports this.
+		void setUseHugePages(bool bUseHugePages);
+		/// Returns statistics about the memory which has been allocated for chunk data.
+		SlabAllocator::Statistics getChunkAllocatorStatistics(void) const;
+
+		/// Returns whether the volume can be accessed from multiple threads at the same time.
+		bool isThreadSafe(void) const;
+		/// Gets the side length of the chunks which the volume is divided into.
+		uint16_t getChunkSideLength(void) const;
 
 	protected:
 		/// Copy constructor
@@ -241,37 +534,322 @@ namespace PolyVox
 		PagedVolume& operator=(const PagedVolume& rhs);
 
 	private:
-		bool canReuseLastAccessedChunk(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const;
-		Chunk* getChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const;
+		// Records the chunk which was most recently accessed, so that repeated accesses to the same chunk can skip the lookup.
+		// Storing these properties individually has proved to be faster than keeping them in a Vector3DInt32 as it avoids
+		// constructions and comparison overheads. The cache also holds a reference to the chunk so that it cannot be evicted.
+		struct ChunkCache
+		{
+			int32_t m_iChunkX = 0;
+			int32_t m_iChunkY = 0;
+			int32_t m_iChunkZ = 0;
+			std::shared_ptr<Chunk> m_pChunk;
+			// The value of the volume's flush count when the chunk was cached. A flush makes the cached chunk stale, so that
+			// threads release it on their next access.
+			uint32_t m_uFlushCount = 0;
+
+			// Only the thread which owns the cache updates these, so they do not need atomic increments. They are atomic so
+			// that getStatistics() can read them from another thread.
+			std::atomic<uint64_t> m_uNoOfHits{ 0 };
+			std::atomic<uint64_t> m_uNoOfMisses{ 0 };
+		};
+
+		// Each thread remembers which cache it uses for a few recently accessed volumes. Volumes are identified by a unique
+		// id rather than by address, so a slot can never refer to the cache of a volume which has since been destroyed.
+		struct ThreadChunkCacheSlot
+		{
+			uint64_t uVolumeId;
+			ChunkCache* pChunkCache;
+		};
+		static const uint32_t uThreadChunkCacheSlotCount = 4;
+
+		// Shared between a volume and the threads which have a cache for it. The volume clears the pointer when it is destroyed,
+		// and a thread which exits first uses it to remove its cache. The mutex stops both from happening at the same time.
+		struct ThreadChunkCacheLink
+		{
+			std::mutex mutex;
+			const PagedVolume* pVolume;
+		};
+
+		// Each thread keeps the links to the volumes it has a cache for, and removes those caches when it exits.
+		struct ThreadChunkCacheOwner
+		{
+			~ThreadChunkCacheOwner();
+			void addLink(const std::shared_ptr<ThreadChunkCacheLink>& pLink);
+
+			std::vector< std::shared_ptr<ThreadChunkCacheLink> > vecLinks;
+		};
+
+		struct CompressedChunk;
+
+		ChunkCache& getChunkCache(void) const;
+		ChunkCache& getThreadChunkCache(void) const;
+		static ThreadChunkCacheSlot* getThreadChunkCacheSlots(void);
+		void removeThreadChunkCache(void) const;
+
+		bool canReuseLastAccessedChunk(ChunkCache& cache, int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const;
+		Chunk* getChunk(ChunkCache& cache, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, const VoxelType* pFillValue = nullptr) const;
+		std::shared_ptr<Chunk> acquireChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, const VoxelType* pFillValue = nullptr) const;
+		bool canOverwriteChunk(const Vector3DInt32& v3dChunkPos) const;
+		void pageInChunk(std::unique_lock<std::mutex>& lock, const std::shared_ptr<Chunk>& pChunk, const CompressedChunk* pCompressedChunk = nullptr) const;
+
+		static uint32_t hashChunkPosition(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ);
+		uint32_t findChunk(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const;
+		void insertChunk(const std::shared_ptr<Chunk>& pChunk) const;
+		void resizeChunkArray(uint32_t uNewSize) const;
+
+		std::shared_ptr<Chunk> createChunk(const Vector3DInt32& v3dChunkPos) const;
+		uint64_t calculateUncompressedSizeInBytes(void) const;
+		void evictChunks(std::unique_lock<std::mutex>& lock) const;
+		void queuePageOut(const std::shared_ptr<Chunk>& pChunk) const;
+		void deferPageOut(const std::shared_ptr<Chunk>& pChunk, std::vector< std::shared_ptr<Chunk> >& vecDeferredPageOuts) const;
+		void pageOutChunk(const std::shared_ptr<Chunk>& pChunk) const;
+		void flushChunks(void);
+
+		void compressChunk(const std::shared_ptr<Chunk>& pChunk) const;
+		void decompressChunk(const CompressedChunk& compressedChunk, Chunk* pChunk) const;
+		std::shared_ptr<Chunk> discardOldestCompressedChunk(void) const;
+
+		uint32_t getMaxNoOfPinnedChunks(void) const;
+		void unpinChunks(std::vector< std::shared_ptr<Chunk> >& vecChunks);
+
+		void preserveChunkForSnapshots(Chunk* pChunk) const;
+		std::shared_ptr<const PreservedChunk> preserveChunk(Chunk* pChunk) const;
+		void setSnapshotChunk(const PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>& snapshot, int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const;
+		void releaseSnapshotChunk(const PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>& snapshot) const;
+		void releaseSnapshot(PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>& snapshot) const;
+
+		void collectChanges(void) const;
+		void collectChunkChanges(Chunk* pChunk) const;
 
-		// Storing these properties individually has proved to be faster than keeping
-		// them in a Vector3DInt32 as it avoids constructions and comparison overheads.
-		// They are also at the start of the class in the hope that they will be pulled
-		// into cache - I've got no idea if this actually makes a difference.
-		mutable int32_t m_v3dLastAccessedChunkX = 0;
-		mutable int32_t m_v3dLastAccessedChunkY = 0;
-		mutable int32_t m_v3dLastAccessedChunkZ = 0;
-		mutable Chunk* m_pLastAccessedChunk = nullptr;
+		std::shared_ptr<ApronCopy> getApronCopy(Chunk* pChunk) const;
+		void updateApronCopies(Chunk* pChunk, uint16_t uXPos, uint16_t uYPos, uint16_t uZPos, const VoxelType& tValue) const;
+		void refreshApronCopies(const Region& region) const;
+		Region getApronRegion(const Vector3DInt32& v3dChunkPos) const;
 
-		mutable uint32_t m_uTimestamper = 0;
+		Region getChunkRegion(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ, const Region& region) const;
+		static bool isUniformRegion(const Region& region, const VoxelType* pSrc, size_t uStrideX, size_t uStrideY, size_t uStrideZ, const VoxelType& tValue);
+		void makeChunkUniform(Chunk* pChunk, const VoxelType& tValue) const;
 
+		void linkChunk(Chunk* pChunk) const;
+		void unlinkChunk(Chunk* pChunk) const;
+		std::shared_ptr<Chunk> eraseChunk(uint32_t uChunkIndex) const;
+
+		// Used when the volume is not thread safe, in which case all accesses share a single cache.
+		mutable ChunkCache m_defaultChunkCache;
+
+		// Used when the volume is thread safe. There is one cache per thread which has accessed the volume.
+		mutable std::unordered_map< std::thread::id, std::unique_ptr<ChunkCache> > m_mapThreadChunkCaches;
+		std::shared_ptr<ThreadChunkCacheLink> m_pThreadChunkCacheLink;
+
+		// Incremented by each flush, which makes the chunks in all the caches stale.
+		std::atomic<uint32_t> m_uFlushCount{ 0 };
+
+		bool m_bThreadSafe;
+		uint64_t m_uVolumeId;
+
+		static const uint32_t uMinPracticalNoOfChunks = 32; // Enough to make sure a chunks and it's neighbours can be loaded, with a few to spare.
+		uint64_t m_uTargetMemoryUsageInBytes;
 		uint32_t m_uChunkCountLimit = 0;
 
-		// Chunks are stored in the following array which is used as a hash-table. Conventional wisdom is that such a hash-table
-		// should not be more than half full to avoid conflicts, and a practical chunk size seems to be 64^3. With this configuration
-		// there can be up to 32768*64^3 = 8 gigavoxels (with each voxel perhaps being many bytes). This should effectively make use 
-		// of even high end machines. Of course, the user can choose to limit the memory usage in which case much less of the chunk 
-		// array will actually be used. None-the-less, we have chosen to use a fixed size array (rather than a vector) as it appears to 
-		// be slightly faster (probably due to the extra pointer indirection in a vector?) and the actual size of this array should
-		// just be 1Mb or so.
-		static const uint32_t uChunkArraySize = 65536;
-		mutable std::unique_ptr< Chunk > m_arrayChunks[uChunkArraySize];
-
-		// The size of the chunks
+		// The ends of the list of chunks ordered by when they were last accessed, and the number of chunks in the list.
+		mutable Chunk* m_pMostRecentChunk = nullptr;
+		mutable Chunk* m_pLeastRecentChunk = nullptr;
+		mutable uint32_t m_uChunkCount = 0;
+
+		// When palettes are enabled, the most recently used chunk which has been considered for packing into a palette. All the chunks
+		// which are less recently used have been considered too, and chunks which are used again move ahead of it in the list.
+		mutable Chunk* m_pPackCursor = nullptr;
+
+		// Pinned chunks are still counted in m_uChunkCount, but are not in the list.
+		uint32_t m_uNoOfPinnedChunks = 0;
+
+		// Counters for getStatistics(). Those which are updated without holding the chunk mutex are atomic.
+		mutable std::atomic<uint32_t> m_uNoOfModifiedChunks{ 0 };
+		mutable uint32_t m_uNoOfModifiedCompressedChunks = 0;
+		mutable std::atomic<uint64_t> m_uNoOfPageIns{ 0 };
+		mutable std::atomic<uint64_t> m_uPageInTimeInNanoSeconds{ 0 };
+		mutable std::atomic<uint64_t> m_uNoOfPageOuts{ 0 };
+		mutable std::atomic<uint64_t> m_uPageOutTimeInNanoSeconds{ 0 };
+		mutable uint64_t m_uNoOfEvictions = 0;
+		mutable std::atomic<uint32_t> m_uNoOfPreservedChunks{ 0 };
+		mutable std::atomic<uint32_t> m_uNoOfPreservedSlabs{ 0 };
+
+		// Provides the memory for the chunks' voxel data. Uniform chunks use much less memory than those which have allocated
+		// their data, so this also tells us how much memory the chunks are using. It must outlive all the chunks.
+		std::unique_ptr<SlabAllocator> m_pChunkAllocator;
+
+		// Protects the chunk array, the list of chunks, and the map of thread caches. It is only locked when the cache
+		// does not contain the required chunk, so accesses which hit the cache do not contend with other threads.
+		mutable std::mutex m_mutexChunks;
+
+		// Signalled whenever a chunk finishes being paged in.
+		mutable std::condition_variable m_cvChunkLoaded;
+
+		// Tracks the progress of a call to prefetchAsync(). The promise is fulfilled by whichever thread loads the last chunk.
+		struct PrefetchRequest
+		{
+			std::atomic<uint64_t> uNoOfPendingChunks;
+			std::mutex mutexException;
+			std::exception_ptr pException;
+			std::promise<void> promise;
+		};
+
+		// The threads which are used by prefetchAsync(). They are only created the first time they are needed.
+		std::unique_ptr<ThreadPool> m_pPrefetchThreadPool;
+
+		// Modified chunks which have been evicted but are still waiting to be paged out, by the writer thread or by the thread
+		// which evicted them. The queue is short, so we simply search it when a chunk is not found in the chunk array.
+		mutable std::vector< std::shared_ptr<Chunk> > m_vecQueuedPageOuts;
+		// Modified chunks which the Pager failed to page out. They are queued again by the next flush.
+		mutable std::vector< std::shared_ptr<Chunk> > m_vecFailedPageOuts;
+		uint32_t m_uMaxQueuedPageOuts = 0;
+		std::unique_ptr<ThreadPool> m_pPageOutThreadPool;
+
+		// Signalled whenever a background page-out finishes.
+		mutable std::condition_variable m_cvPageOut;
+
+		// The contents of a chunk at the time one or more snapshots were taken, which is kept for those snapshots when the chunk
+		// is written to. The data comes from the volume's allocator but is not counted as part of the volume's memory usage.
+		struct PreservedChunk
+		{
+			PreservedChunk(const PagedVolume* pVolume, VoxelType* pData, const VoxelType& tUniformValue);
+			~PreservedChunk();
+
+			PreservedChunk(const PreservedChunk&) = delete;
+			PreservedChunk& operator=(const PreservedChunk&) = delete;
+
+			const PagedVolume* m_pVolume;
+			VoxelType* m_pData; // Null if the chunk was uniform.
+			VoxelType m_tUniformValue;
+		};
+
+		// The snapshots which currently exist, and the epoch of the most recent one. The list is protected by the chunk mutex, and
+		// the epoch is only changed under it.
+		mutable std::vector<PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>*> m_vecSnapshots;
+		std::atomic<uint64_t> m_uSnapshotEpoch{ 0 };
+
+		// Writes only record their position in the chunk when this is set. The changes are moved from the chunks to the tracker
+		// when they are requested and when chunks are evicted. The tracker is protected by the chunk mutex.
+		std::atomic<bool> m_bTrackChanges{ false };
+		mutable ChangeTracker m_changeTracker;
+
+		// A chunk together with a layer of one voxel from each of its neighbours, stored in linear order (x varies fastest). The
+		// chunk layouts have no room for such a layer, and most would not give a constant offset to each neighbour.
+		struct ApronCopy
+		{
+			ApronCopy(const PagedVolume* pVolume, uint32_t uNoOfVoxels);
+			~ApronCopy();
+
+			ApronCopy(const ApronCopy&) = delete;
+			ApronCopy& operator=(const ApronCopy&) = delete;
+
+			const PagedVolume* m_pVolume;
+			std::vector<VoxelType> m_vecData;
+		};
+
+		// When this is set, samplers use the chunks' apron copies and writes keep them up to date. It is never set for a thread safe
+		// volume, so the copies are only read and written by one thread.
+		std::atomic<bool> m_bApronsEnabled{ false };
+		mutable std::atomic<uint32_t> m_uNoOfApronCopies{ 0 };
+
+		// The values in a chunk together with an index into them for each voxel, which is used in place of the chunk's data when
+		// there are few enough values. The indices are packed into words in the order given by the chunk layout, and each index
+		// has 1, 2, 4 or 8 bits so that they never straddle two words. The number of bits is fixed, so a palette is replaced
+		// by one with wider indices when its values run out. The words are atomic so that a thread safe volume can read them while
+		// they are being written, but the values are never changed once they have been added.
+		struct Palette
+		{
+			Palette(const PagedVolume* pVolume, uint8_t uIndexBitsPower, uint32_t uNoOfVoxels);
+			~Palette();
+
+			Palette(const Palette&) = delete;
+			Palette& operator=(const Palette&) = delete;
+
+			uint32_t getIndex(uint32_t uVoxelIndex) const
+			{
+				const uint8_t uShift = static_cast<uint8_t>((uVoxelIndex & m_uIndicesPerWordMinusOne) << m_uIndexBitsPower);
+				return (m_arrayWords[uVoxelIndex >> m_uIndicesPerWordPower].load(std::memory_order_acquire) >> uShift) & m_uIndexMask;
+			}
+
+			VoxelType getVoxel(uint32_t uVoxelIndex) const { return m_arrayValues[getIndex(uVoxelIndex)]; }
+
+			void setIndex(uint32_t uVoxelIndex, uint32_t uIndex);
+			uint32_t findValue(const VoxelType& tValue) const;
+			uint32_t getCapacity(void) const { return m_uIndexMask + 1; }
+			uint64_t calculateSizeInBytes(void) const;
+
+			const PagedVolume* m_pVolume;
+			uint32_t m_uNoOfWords;
+			uint8_t m_uIndexBitsPower;
+			uint8_t m_uIndicesPerWordPower;
+			uint32_t m_uIndicesPerWordMinusOne;
+			uint32_t m_uIndexMask;
+			uint32_t m_uNoOfValues;
+			std::unique_ptr<VoxelType[]> m_arrayValues;
+			std::unique_ptr<std::atomic<uint32_t>[]> m_arrayWords;
+		};
+
+		// When this is set, writes to uniform chunks create palettes rather than allocating data, and chunks are packed into palettes
+		// before they are evicted. The size includes the replaced palettes which are waiting to be deleted.
+		std::atomic<bool> m_bPalettesEnabled{ false };
+		mutable std::atomic<uint32_t> m_uNoOfPaletteChunks{ 0 };
+		mutable std::atomic<uint64_t> m_uPaletteSizeInBytes{ 0 };
+
+		// The offsets which samplers use to move from each position in a chunk to the next one along, which depend on the layout.
+		std::vector<int32_t> m_vecDeltaX;
+		std::vector<int32_t> m_vecDeltaY;
+		std::vector<int32_t> m_vecDeltaZ;
+
+		// The offsets which samplers use to move through an apron copy, which are the same at every position.
+		std::vector<int32_t> m_vecApronDeltaX;
+		std::vector<int32_t> m_vecApronDeltaY;
+		std::vector<int32_t> m_vecApronDeltaZ;
+
+		// Holds the data of an evicted chunk in compressed form, along with whether it still needs to be paged out.
+		struct CompressedChunk
+		{
+			Vector3DInt32 m_v3dChunkSpacePosition;
+			std::vector<uint8_t> m_vecData;
+			bool m_bUsesLZ;
+			bool m_bDataModified;
+
+			uint64_t calculateSizeInBytes(void) const { return m_vecData.size() + sizeof(CompressedChunk); }
+		};
+
+		struct ChunkPositionHasher
+		{
+			size_t operator()(const Vector3DInt32& v3dPos) const { return hashChunkPosition(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ()); }
+		};
+
+		// Compressed chunks are kept in the order they were evicted (the oldest at the front), and are also indexed by their position.
+		// They share the memory budget with the uncompressed chunks, and the oldest are passed to the Pager when there is no space.
+		ChunkCompression m_eChunkCompression = ChunkCompressions::None;
+		mutable std::list<CompressedChunk> m_listCompressedChunks;
+		mutable std::unordered_map<Vector3DInt32, typename std::list<CompressedChunk>::iterator, ChunkPositionHasher> m_mapCompressedChunks;
+		mutable uint64_t m_uCompressedSizeInBytes = 0;
+		uint64_t m_uCompressedSizeLimit = 0;
+
+		// Chunks are stored in the following array which is used as a hash-table with linear probing. Its size is always a power
+		// of two, and it grows as required to stay at most half full. It is only searched when the chunk cache misses.
+		static const uint32_t uInitialChunkArraySize = 256;
+		static const uint32_t uMaxProbeLength = 32;
+		static const uint32_t uInvalidChunkIndex = 0xFFFFFFFF;
+		mutable std::vector< std::shared_ptr< Chunk > > m_arrayChunks;
+
+		// The size of the chunks. Use the functions below rather than these, as they are constants when the side length is a template parameter.
 		uint16_t m_uChunkSideLength;
 		uint8_t m_uChunkSideLengthPower;
 		int32_t m_iChunkMask;
 
+		uint8_t getChunkSideLengthPower(void) const { return (ChunkSideLength != 0) ? StaticLogBase2<(ChunkSideLength != 0) ? ChunkSideLength : 1>::value : m_uChunkSideLengthPower; }
+		int32_t getChunkMask(void) const { return (ChunkSideLength != 0) ? (ChunkSideLength - 1) : m_iChunkMask; }
+
+		// The index of a voxel in a chunk's data, as given by the chunk layout.
+		static uint32_t getVoxelIndexInChunk(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos, uint8_t uSideLengthPower)
+		{
+			return ChunkLayout::getXOffset(uXPos, uSideLengthPower) + ChunkLayout::getYOffset(uYPos, uSideLengthPower) + ChunkLayout::getZOffset(uZPos, uSideLengthPower);
+		}
+
 		Pager* m_pPager = nullptr;
 	};
 }
@@ -280,4 +858,6 @@ namespace PolyVox
 #include "PagedVolumeChunk.inl"
 #include "PagedVolumeSampler.inl"
 
+#include "PagedVolumeSnapshot.h"
+
 #endif //__PolyVox_PagedVolume_H__
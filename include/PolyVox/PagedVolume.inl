@@ -34,10 +34,14 @@ namespace PolyVox
 	/// \param pPager Called by PolyVox to load and unload data on demand.
 	/// \param uTargetMemoryUsageInBytes The upper limit to how much memory this PagedVolume should aim to use.
 	/// \param uChunkSideLength The size of the chunks making up the volume. Small chunks will compress/decompress faster, but there will also be more of them meaning voxel access could be slower.
+	/// \param bThreadSafe Allows the volume to be accessed from multiple threads at the same time. This has a small cost even when only one thread is used.
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	PagedVolume<VoxelType>::PagedVolume(Pager* pPager, uint32_t uTargetMemoryUsageInBytes, uint16_t uChunkSideLength)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PagedVolume(Pager* pPager, uint64_t uTargetMemoryUsageInBytes, uint16_t uChunkSideLength, bool bThreadSafe)
 		:BaseVolume<VoxelType>()
+		, m_bThreadSafe(bThreadSafe)
+		, m_uTargetMemoryUsageInBytes(uTargetMemoryUsageInBytes)
+		, m_arrayChunks(uInitialChunkArraySize)
 		, m_uChunkSideLength(uChunkSideLength)
 		, m_pPager(pPager)
 	{
@@ -47,6 +51,8 @@ namespace PolyVox
 			POLYVOX_THROW_IF(m_uChunkSideLength == 0, std::invalid_argument, "Chunk side length cannot be zero.");
 			POLYVOX_THROW_IF(m_uChunkSideLength > 256, std::invalid_argument, "Chunk size is too large to be practical.");
 			POLYVOX_THROW_IF(!isPowerOf2(m_uChunkSideLength), std::invalid_argument, "Chunk side length must be a power of two.");
+			POLYVOX_THROW_IF((ChunkSideLength != 0) && (m_uChunkSideLength != ChunkSideLength), std::invalid_argument, "Chunk side length does not match the one given as a template parameter.");
+			POLYVOX_THROW_IF(m_uChunkSideLength < ChunkLayout::uMinChunkSideLength, std::invalid_argument, "Chunk side length is too small for the chunk layout.");
 
 			// Used to perform multiplications and divisions by bit shifting.
 			m_uChunkSideLengthPower = logBase2(m_uChunkSideLength);
@@ -54,20 +60,43 @@ namespace PolyVox
 			m_iChunkMask = m_uChunkSideLength - 1;
 
 			// Calculate the number of chunks based on the memory limit and the size of each chunk.
-			uint32_t uChunkSizeInBytes = PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(m_uChunkSideLength);
-			m_uChunkCountLimit = uTargetMemoryUsageInBytes / uChunkSizeInBytes;
+			uint64_t uChunkSizeInBytes = PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::calculateSizeInBytes(m_uChunkSideLength);
+			m_uChunkCountLimit = static_cast<uint32_t>(uTargetMemoryUsageInBytes / uChunkSizeInBytes);
 
 			// Enforce sensible limits on the number of chunks.
-			const uint32_t uMinPracticalNoOfChunks = 32; // Enough to make sure a chunks and it's neighbours can be loaded, with a few to spare.
-			const uint32_t uMaxPracticalNoOfChunks = uChunkArraySize / 2; // A hash table should only become half-full to avoid too many clashes.
 			POLYVOX_LOG_WARNING_IF(m_uChunkCountLimit < uMinPracticalNoOfChunks, "Requested memory usage limit of ",
 				uTargetMemoryUsageInBytes / (1024 * 1024), "Mb is too low and cannot be adhered to.");
 			m_uChunkCountLimit = (std::max)(m_uChunkCountLimit, uMinPracticalNoOfChunks);
-			m_uChunkCountLimit = (std::min)(m_uChunkCountLimit, uMaxPracticalNoOfChunks);
 
 			// Inform the user about the chosen memory configuration.
 			POLYVOX_LOG_DEBUG("Memory usage limit for volume now set to ", (m_uChunkCountLimit * uChunkSizeInBytes) / (1024 * 1024),
 				"Mb (", m_uChunkCountLimit, " chunks of ", uChunkSizeInBytes / 1024, "Kb each).");
+
+			m_pChunkAllocator.reset(new SlabAllocator(m_uChunkSideLength * m_uChunkSideLength * m_uChunkSideLength * sizeof(VoxelType)));
+
+			// The sampler deltas are the differences between the offsets of neighbouring positions in the chunk's layout.
+			m_vecDeltaX.assign(m_uChunkSideLength, 0);
+			m_vecDeltaY.assign(m_uChunkSideLength, 0);
+			m_vecDeltaZ.assign(m_uChunkSideLength, 0);
+			for (uint32_t uPos = 0; uPos + 1 < m_uChunkSideLength; uPos++)
+			{
+				m_vecDeltaX[uPos] = ChunkLayout::getXOffset(uPos + 1, m_uChunkSideLengthPower) - ChunkLayout::getXOffset(uPos, m_uChunkSideLengthPower);
+				m_vecDeltaY[uPos] = ChunkLayout::getYOffset(uPos + 1, m_uChunkSideLengthPower) - ChunkLayout::getYOffset(uPos, m_uChunkSideLengthPower);
+				m_vecDeltaZ[uPos] = ChunkLayout::getZOffset(uPos + 1, m_uChunkSideLengthPower) - ChunkLayout::getZOffset(uPos, m_uChunkSideLengthPower);
+			}
+
+			// An apron copy has two more voxels along each side than the chunk.
+			const int32_t iApronSideLength = m_uChunkSideLength + 2;
+			m_vecApronDeltaX.assign(m_uChunkSideLength, 1);
+			m_vecApronDeltaY.assign(m_uChunkSideLength, iApronSideLength);
+			m_vecApronDeltaZ.assign(m_uChunkSideLength, iApronSideLength * iApronSideLength);
+
+			// Threads use this to tell their chunk caches for different volumes apart. Zero is never used as an id.
+			static std::atomic<uint64_t> s_uNextVolumeId(1);
+			m_uVolumeId = s_uNextVolumeId++;
+
+			m_pThreadChunkCacheLink = std::make_shared<ThreadChunkCacheLink>();
+			m_pThreadChunkCacheLink->pVolume = this;
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -77,8 +106,8 @@ namespace PolyVox
 	///
 	/// \sa VolumeResampler
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	PagedVolume<VoxelType>::PagedVolume(const PagedVolume<VoxelType>& /*rhs*/)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PagedVolume(const PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>& /*rhs*/)
 	{
 		POLYVOX_THROW(not_implemented, "Volume copy constructor not implemented to prevent accidental copying.");
 	}
@@ -86,10 +115,44 @@ namespace PolyVox
 	////////////////////////////////////////////////////////////////////////////////
 	/// Destroys the volume The destructor will call flushAll() to ensure that a paging volume has the chance to save it's data via the dataOverflowHandler() if desired.
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	PagedVolume<VoxelType>::~PagedVolume()
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::~PagedVolume()
 	{
-		flushAll();
+		POLYVOX_ASSERT(m_vecSnapshots.empty(), "All snapshots of a volume must be destroyed before the volume itself");
+
+		// Stop any prefetching first, as it would otherwise continue loading chunks into the volume.
+		if (m_pPrefetchThreadPool)
+		{
+			m_pPrefetchThreadPool->discardPendingTasks();
+			m_pPrefetchThreadPool.reset();
+		}
+
+		// Threads which exit from now on must not try to remove their caches from this volume.
+		if (m_pThreadChunkCacheLink)
+		{
+			std::lock_guard<std::mutex> lock(m_pThreadChunkCacheLink->mutex);
+			m_pThreadChunkCacheLink->pVolume = nullptr;
+		}
+
+		// The caches hold references to chunks, so they must be released before the chunks. Destroying
+		// the chunks then gives the Pager a chance to page out any which have been modified.
+		m_defaultChunkCache.m_pChunk = nullptr;
+		m_mapThreadChunkCaches.clear();
+
+		// Compressed chunks and chunks in the page-out queue also need to reach the Pager, so we flush everything first. Chunks
+		// which are somehow still in use (such as by a sampler which outlives the volume) are then paged out as they are cleared.
+		flushChunks();
+		m_pPageOutThreadPool.reset();
+
+		// The Pager has had its final chance with these, and destroying them would only make it throw again.
+		for (const auto& pFailedChunk : m_vecFailedPageOuts)
+		{
+			POLYVOX_LOG_ERROR("Discarding modified chunk data which could not be paged out");
+			pFailedChunk->setDataModified(false);
+		}
+		m_vecFailedPageOuts.clear();
+
+		m_arrayChunks.clear();
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -99,8 +162,8 @@ namespace PolyVox
 	///
 	/// \sa VolumeResampler
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	PagedVolume<VoxelType>& PagedVolume<VoxelType>::operator=(const PagedVolume<VoxelType>& /*rhs*/)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>& PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::operator=(const PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>& /*rhs*/)
 	{
 		POLYVOX_THROW(not_implemented, "Volume assignment operator not implemented to prevent accidental copying.");
 	}
@@ -113,18 +176,19 @@ namespace PolyVox
 	/// \param uZPos The \c z position of the voxel
 	/// \return The voxel value
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::getVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos) const
 	{
-		const int32_t chunkX = uXPos >> m_uChunkSideLengthPower;
-		const int32_t chunkY = uYPos >> m_uChunkSideLengthPower;
-		const int32_t chunkZ = uZPos >> m_uChunkSideLengthPower;
+		const int32_t chunkX = uXPos >> getChunkSideLengthPower();
+		const int32_t chunkY = uYPos >> getChunkSideLengthPower();
+		const int32_t chunkZ = uZPos >> getChunkSideLengthPower();
 
-		const uint16_t xOffset = static_cast<uint16_t>(uXPos & m_iChunkMask);
-		const uint16_t yOffset = static_cast<uint16_t>(uYPos & m_iChunkMask);
-		const uint16_t zOffset = static_cast<uint16_t>(uZPos & m_iChunkMask);
+		const uint16_t xOffset = static_cast<uint16_t>(uXPos & getChunkMask());
+		const uint16_t yOffset = static_cast<uint16_t>(uYPos & getChunkMask());
+		const uint16_t zOffset = static_cast<uint16_t>(uZPos & getChunkMask());
 
-		auto pChunk = canReuseLastAccessedChunk(chunkX, chunkY, chunkZ) ? m_pLastAccessedChunk : getChunk(chunkX, chunkY, chunkZ);
+		ChunkCache& cache = getChunkCache();
+		auto pChunk = canReuseLastAccessedChunk(cache, chunkX, chunkY, chunkZ) ? cache.m_pChunk.get() : getChunk(cache, chunkX, chunkY, chunkZ);
 
 		return pChunk->getVoxel(xOffset, yOffset, zOffset);
 	}
@@ -135,8 +199,8 @@ namespace PolyVox
 	/// \param v3dPos The 3D position of the voxel
 	/// \return The voxel value
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::getVoxel(const Vector3DInt32& v3dPos) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getVoxel(const Vector3DInt32& v3dPos) const
 	{
 		return getVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ());
 	}
@@ -146,217 +210,2379 @@ namespace PolyVox
 	/// \param uYPos the \c y position of the voxel
 	/// \param uZPos the \c z position of the voxel
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::setVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos, VoxelType tValue)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::setVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos, VoxelType tValue)
 	{
-		const int32_t chunkX = uXPos >> m_uChunkSideLengthPower;
-		const int32_t chunkY = uYPos >> m_uChunkSideLengthPower;
-		const int32_t chunkZ = uZPos >> m_uChunkSideLengthPower;
+		const int32_t chunkX = uXPos >> getChunkSideLengthPower();
+		const int32_t chunkY = uYPos >> getChunkSideLengthPower();
+		const int32_t chunkZ = uZPos >> getChunkSideLengthPower();
+
+		const uint16_t xOffset = static_cast<uint16_t>(uXPos - (chunkX << getChunkSideLengthPower()));
+		const uint16_t yOffset = static_cast<uint16_t>(uYPos - (chunkY << getChunkSideLengthPower()));
+		const uint16_t zOffset = static_cast<uint16_t>(uZPos - (chunkZ << getChunkSideLengthPower()));
 
-		const uint16_t xOffset = static_cast<uint16_t>(uXPos - (chunkX << m_uChunkSideLengthPower));
-		const uint16_t yOffset = static_cast<uint16_t>(uYPos - (chunkY << m_uChunkSideLengthPower));
-		const uint16_t zOffset = static_cast<uint16_t>(uZPos - (chunkZ << m_uChunkSideLengthPower));
+		ChunkCache& cache = getChunkCache();
+		auto pChunk = canReuseLastAccessedChunk(cache, chunkX, chunkY, chunkZ) ? cache.m_pChunk.get() : getChunk(cache, chunkX, chunkY, chunkZ);
 
-		auto pChunk = canReuseLastAccessedChunk(chunkX, chunkY, chunkZ) ? m_pLastAccessedChunk : getChunk(chunkX, chunkY, chunkZ);
+		// The first write to a chunk after a snapshot has been taken must keep the chunk's current contents for the snapshot.
+		if (pChunk->m_uSnapshotEpoch.load(std::memory_order_acquire) != m_uSnapshotEpoch.load(std::memory_order_relaxed))
+		{
+			preserveChunkForSnapshots(pChunk);
+		}
 
 		pChunk->setVoxel(xOffset, yOffset, zOffset, tValue);
+
+		if (m_bTrackChanges.load(std::memory_order_relaxed))
+		{
+			ChangeTracker::recordChange(pChunk->m_uChangedBounds, xOffset, yOffset, zOffset);
+		}
+
+		if (m_bApronsEnabled.load(std::memory_order_relaxed))
+		{
+			updateApronCopies(pChunk, xOffset, yOffset, zOffset, tValue);
+		}
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
 	/// \param v3dPos the 3D position of the voxel
 	/// \param tValue the value to which the voxel will be set
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::setVoxel(const Vector3DInt32& v3dPos, VoxelType tValue)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::setVoxel(const Vector3DInt32& v3dPos, VoxelType tValue)
 	{
 		setVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ(), tValue);
 	}
 
+	////////////////////////////////////////////////////////////////////////////////
+	/// This gives the same result as calling getVoxel() for every voxel in the region, but is much faster for large regions as it
+	/// visits each chunk once and copies the voxels it contains in a tight loop. Chunks are paged in as required, and may be evicted
+	/// again before the copy is finished if the region is larger than the volume's memory limit.
+	/// \param region The voxels to copy.
+	/// \param pDst A buffer with space for every voxel in the region.
+	/// \param eLayout How the voxels should be arranged in the buffer.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::readRegion(const Region& region, VoxelType* pDst, RegionLayout eLayout) const
+	{
+		POLYVOX_THROW_IF(!region.isValid(), std::invalid_argument, "Cannot read an invalid region");
+		POLYVOX_THROW_IF(!pDst, std::invalid_argument, "Destination buffer must not be null");
+
+		size_t uStrideX, uStrideY, uStrideZ;
+		this->calculateRegionStrides(region, eLayout, uStrideX, uStrideY, uStrideZ);
+
+		ChunkCache& cache = getChunkCache();
+		for (int32_t iChunkZ = region.getLowerZ() >> getChunkSideLengthPower(); iChunkZ <= (region.getUpperZ() >> getChunkSideLengthPower()); iChunkZ++)
+		{
+			for (int32_t iChunkY = region.getLowerY() >> getChunkSideLengthPower(); iChunkY <= (region.getUpperY() >> getChunkSideLengthPower()); iChunkY++)
+			{
+				for (int32_t iChunkX = region.getLowerX() >> getChunkSideLengthPower(); iChunkX <= (region.getUpperX() >> getChunkSideLengthPower()); iChunkX++)
+				{
+					// The cache holds on to the chunk until we move on to the next one.
+					const Chunk* pChunk = canReuseLastAccessedChunk(cache, iChunkX, iChunkY, iChunkZ) ? cache.m_pChunk.get() : getChunk(cache, iChunkX, iChunkY, iChunkZ);
+					const Palette* pPalette = nullptr;
+					const VoxelType* pData = pChunk->loadData(pPalette);
+					const Region regCopy = getChunkRegion(iChunkX, iChunkY, iChunkZ, region);
+
+					for (int32_t z = regCopy.getLowerZ(); z <= regCopy.getUpperZ(); z++)
+					{
+						for (int32_t y = regCopy.getLowerY(); y <= regCopy.getUpperY(); y++)
+						{
+							VoxelType* pDstRow = pDst + (regCopy.getLowerX() - region.getLowerX()) * uStrideX + (y - region.getLowerY()) * uStrideY + (z - region.getLowerZ()) * uStrideZ;
+							const uint32_t uYZIndex = ChunkLayout::getYOffset(y & getChunkMask(), getChunkSideLengthPower()) + ChunkLayout::getZOffset(z & getChunkMask(), getChunkSideLengthPower());
+							if (pData)
+							{
+								for (int32_t x = regCopy.getLowerX(); x <= regCopy.getUpperX(); x++)
+								{
+									*pDstRow = pData[ChunkLayout::getXOffset(x & getChunkMask(), getChunkSideLengthPower()) + uYZIndex];
+									pDstRow += uStrideX;
+								}
+							}
+							else if (pPalette)
+							{
+								for (int32_t x = regCopy.getLowerX(); x <= regCopy.getUpperX(); x++)
+								{
+									*pDstRow = pPalette->getVoxel(ChunkLayout::getXOffset(x & getChunkMask(), getChunkSideLengthPower()) + uYZIndex);
+									pDstRow += uStrideX;
+								}
+							}
+							else
+							{
+								for (int32_t x = regCopy.getLowerX(); x <= regCopy.getUpperX(); x++)
+								{
+									*pDstRow = pChunk->m_tUniformValue;
+									pDstRow += uStrideX;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This gives the same result as calling setVoxel() for every voxel in the region, but is much faster for large regions as it
+	/// visits each chunk once and copies the voxels into it in a tight loop. Uniform chunks stay uniform if the part of the region
+	/// which they contain only holds the value they already have.
+	/// \param region The voxels to set.
+	/// \param pSrc A buffer containing a value for every voxel in the region.
+	/// \param eLayout How the voxels are arranged in the buffer.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::writeRegion(const Region& region, const VoxelType* pSrc, RegionLayout eLayout)
+	{
+		POLYVOX_THROW_IF(!region.isValid(), std::invalid_argument, "Cannot write an invalid region");
+		POLYVOX_THROW_IF(!pSrc, std::invalid_argument, "Source buffer must not be null");
+
+		size_t uStrideX, uStrideY, uStrideZ;
+		this->calculateRegionStrides(region, eLayout, uStrideX, uStrideY, uStrideZ);
+
+		ChunkCache& cache = getChunkCache();
+		for (int32_t iChunkZ = region.getLowerZ() >> getChunkSideLengthPower(); iChunkZ <= (region.getUpperZ() >> getChunkSideLengthPower()); iChunkZ++)
+		{
+			for (int32_t iChunkY = region.getLowerY() >> getChunkSideLengthPower(); iChunkY <= (region.getUpperY() >> getChunkSideLengthPower()); iChunkY++)
+			{
+				for (int32_t iChunkX = region.getLowerX() >> getChunkSideLengthPower(); iChunkX <= (region.getUpperX() >> getChunkSideLengthPower()); iChunkX++)
+				{
+					Chunk* pChunk = canReuseLastAccessedChunk(cache, iChunkX, iChunkY, iChunkZ) ? cache.m_pChunk.get() : getChunk(cache, iChunkX, iChunkY, iChunkZ);
+					const Region regCopy = getChunkRegion(iChunkX, iChunkY, iChunkZ, region);
+					const VoxelType* pSrcCopy = pSrc + (regCopy.getLowerX() - region.getLowerX()) * uStrideX + (regCopy.getLowerY() - region.getLowerY()) * uStrideY + (regCopy.getLowerZ() - region.getLowerZ()) * uStrideZ;
+
+					// Like Chunk::setVoxel(), this avoids allocating data for a uniform chunk if its value doesn't change.
+					if (pChunk->isUniform() && isUniformRegion(regCopy, pSrcCopy, uStrideX, uStrideY, uStrideZ, pChunk->m_tUniformValue))
+					{
+						continue;
+					}
+
+					if (pChunk->m_uSnapshotEpoch.load(std::memory_order_acquire) != m_uSnapshotEpoch.load(std::memory_order_relaxed))
+					{
+						preserveChunkForSnapshots(pChunk);
+					}
+
+					VoxelType* pData = pChunk->getData();
+					for (int32_t z = regCopy.getLowerZ(); z <= regCopy.getUpperZ(); z++)
+					{
+						for (int32_t y = regCopy.getLowerY(); y <= regCopy.getUpperY(); y++)
+						{
+							const VoxelType* pSrcRow = pSrcCopy + (y - regCopy.getLowerY()) * uStrideY + (z - regCopy.getLowerZ()) * uStrideZ;
+							const uint32_t uYZIndex = ChunkLayout::getYOffset(y & getChunkMask(), getChunkSideLengthPower()) + ChunkLayout::getZOffset(z & getChunkMask(), getChunkSideLengthPower());
+							for (int32_t x = regCopy.getLowerX(); x <= regCopy.getUpperX(); x++)
+							{
+								pData[ChunkLayout::getXOffset(x & getChunkMask(), getChunkSideLengthPower()) + uYZIndex] = *pSrcRow;
+								pSrcRow += uStrideX;
+							}
+						}
+					}
+
+					if (!pChunk->m_bDataModified.load(std::memory_order_relaxed))
+					{
+						pChunk->setDataModified(true);
+					}
+
+					// The changes to a chunk are recorded as a box, so recording two opposite corners of the copy covers all of it.
+					if (m_bTrackChanges.load(std::memory_order_relaxed))
+					{
+						ChangeTracker::recordChange(pChunk->m_uChangedBounds, regCopy.getLowerX() & getChunkMask(), regCopy.getLowerY() & getChunkMask(), regCopy.getLowerZ() & getChunkMask());
+						ChangeTracker::recordChange(pChunk->m_uChangedBounds, regCopy.getUpperX() & getChunkMask(), regCopy.getUpperY() & getChunkMask(), regCopy.getUpperZ() & getChunkMask());
+					}
+				}
+			}
+		}
+		if (m_bApronsEnabled.load(std::memory_order_relaxed))
+		{
+			refreshApronCopies(region);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This gives the same result as calling setVoxel() for every voxel in the region, but is much faster for large regions. Chunks
+	/// which are entirely inside the region become uniform chunks (releasing their data) and only the chunks on the edges of the
+	/// region have their voxels written individually. Only the chunks on the edges are paged in if they are not already loaded.
+	/// \param region The voxels to set.
+	/// \param tValue The value to give to every voxel in the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::fill(const Region& region, VoxelType tValue)
+	{
+		POLYVOX_THROW_IF(!region.isValid(), std::invalid_argument, "Cannot fill an invalid region");
+
+		ChunkCache& cache = getChunkCache();
+		for (int32_t iChunkZ = region.getLowerZ() >> getChunkSideLengthPower(); iChunkZ <= (region.getUpperZ() >> getChunkSideLengthPower()); iChunkZ++)
+		{
+			for (int32_t iChunkY = region.getLowerY() >> getChunkSideLengthPower(); iChunkY <= (region.getUpperY() >> getChunkSideLengthPower()); iChunkY++)
+			{
+				for (int32_t iChunkX = region.getLowerX() >> getChunkSideLengthPower(); iChunkX <= (region.getUpperX() >> getChunkSideLengthPower()); iChunkX++)
+				{
+					const Region regFill = getChunkRegion(iChunkX, iChunkY, iChunkZ, region);
+					const bool bCoversChunk = (regFill.getWidthInVoxels() == static_cast<int32_t>(getChunkSideLength())) &&
+						(regFill.getHeightInVoxels() == static_cast<int32_t>(getChunkSideLength())) && (regFill.getDepthInVoxels() == static_cast<int32_t>(getChunkSideLength()));
+
+					// The old contents of a chunk which is about to be overwritten don't need to be paged in.
+					Chunk* pChunk = canReuseLastAccessedChunk(cache, iChunkX, iChunkY, iChunkZ) ? cache.m_pChunk.get() : getChunk(cache, iChunkX, iChunkY, iChunkZ, bCoversChunk ? &tValue : nullptr);
+
+					// Like Chunk::setVoxel(), this leaves a uniform chunk alone if it already has the value.
+					if (pChunk->isUniform() && isBytewiseEqual(tValue, pChunk->m_tUniformValue))
+					{
+						continue;
+					}
+
+					if (pChunk->m_uSnapshotEpoch.load(std::memory_order_acquire) != m_uSnapshotEpoch.load(std::memory_order_relaxed))
+					{
+						preserveChunkForSnapshots(pChunk);
+					}
+
+					if (bCoversChunk)
+					{
+						makeChunkUniform(pChunk, tValue);
+					}
+					else
+					{
+						VoxelType* pData = pChunk->getData();
+						for (int32_t z = regFill.getLowerZ(); z <= regFill.getUpperZ(); z++)
+						{
+							for (int32_t y = regFill.getLowerY(); y <= regFill.getUpperY(); y++)
+							{
+								const uint32_t uYZIndex = ChunkLayout::getYOffset(y & getChunkMask(), getChunkSideLengthPower()) + ChunkLayout::getZOffset(z & getChunkMask(), getChunkSideLengthPower());
+								for (int32_t x = regFill.getLowerX(); x <= regFill.getUpperX(); x++)
+								{
+									pData[ChunkLayout::getXOffset(x & getChunkMask(), getChunkSideLengthPower()) + uYZIndex] = tValue;
+								}
+							}
+						}
+					}
+
+					if (!pChunk->m_bDataModified.load(std::memory_order_relaxed))
+					{
+						pChunk->setDataModified(true);
+					}
+
+					if (m_bTrackChanges.load(std::memory_order_relaxed))
+					{
+						ChangeTracker::recordChange(pChunk->m_uChangedBounds, regFill.getLowerX() & getChunkMask(), regFill.getLowerY() & getChunkMask(), regFill.getLowerZ() & getChunkMask());
+						ChangeTracker::recordChange(pChunk->m_uChangedBounds, regFill.getUpperX() & getChunkMask(), regFill.getUpperY() & getChunkMask(), regFill.getUpperZ() & getChunkMask());
+					}
+				}
+			}
+		}
+		if (m_bApronsEnabled.load(std::memory_order_relaxed))
+		{
+			refreshApronCopies(region);
+		}
+	}
+
 	////////////////////////////////////////////////////////////////////////////////
 	/// Note that if the memory usage limit is not large enough to support the region this function will only load part of the region. In this case it is undefined which parts will actually be loaded. If all the voxels in the given region are already loaded, this function will not do anything. Other voxels might be unloaded to make space for the new voxels.
 	/// \param regPrefetch The Region of voxels to prefetch into memory.
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::prefetch(Region regPrefetch)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::prefetch(Region regPrefetch)
 	{
 		// Convert the start and end positions into chunk space coordinates
 		Vector3DInt32 v3dStart;
 		for (int i = 0; i < 3; i++)
 		{
-			v3dStart.setElement(i, regPrefetch.getLowerCorner().getElement(i) >> m_uChunkSideLengthPower);
+			v3dStart.setElement(i, regPrefetch.getLowerCorner().getElement(i) >> getChunkSideLengthPower());
 		}
 
 		Vector3DInt32 v3dEnd;
 		for (int i = 0; i < 3; i++)
 		{
-			v3dEnd.setElement(i, regPrefetch.getUpperCorner().getElement(i) >> m_uChunkSideLengthPower);
+			v3dEnd.setElement(i, regPrefetch.getUpperCorner().getElement(i) >> getChunkSideLengthPower());
 		}
 
-		// Ensure we don't page in more chunks than the volume can hold.
+		// Ensure we don't page in more chunks than the volume can hold. The count can be too large for 32 bits.
 		Region region(v3dStart, v3dEnd);
-		uint32_t uNoOfChunks = static_cast<uint32_t>(region.getWidthInVoxels() * region.getHeightInVoxels() * region.getDepthInVoxels());
-		POLYVOX_LOG_WARNING_IF(uNoOfChunks > m_uChunkCountLimit, "Attempting to prefetch more than the maximum number of chunks (this will cause thrashing).");
-		uNoOfChunks = (std::min)(uNoOfChunks, m_uChunkCountLimit);
+		const uint64_t uNoOfChunks = static_cast<uint64_t>(region.getWidthInVoxels()) * static_cast<uint64_t>(region.getHeightInVoxels()) * static_cast<uint64_t>(region.getDepthInVoxels());
+		POLYVOX_LOG_WARNING_IF(region.isValid() && (uNoOfChunks > m_uChunkCountLimit), "Attempting to prefetch more than the maximum number of chunks (this will cause thrashing).");
 
 		// Loops over the specified positions and touch the corresponding chunks.
+		ChunkCache& cache = getChunkCache();
 		for (int32_t x = v3dStart.getX(); x <= v3dEnd.getX(); x++)
 		{
 			for (int32_t y = v3dStart.getY(); y <= v3dEnd.getY(); y++)
 			{
 				for (int32_t z = v3dStart.getZ(); z <= v3dEnd.getZ(); z++)
 				{
-					getChunk(x, y, z);
+					getChunk(cache, x, y, z);
 				}
 			}
 		}
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
-	/// Removes all voxels from memory, and calls dataOverflowHandler() to ensure the application has a chance to store the data.
+	/// This behaves like prefetch(), except that the chunks are paged in by a pool of background threads and the function returns
+	/// immediately. The returned future becomes ready once all the chunks have been loaded, or holds the exception thrown by the
+	/// Pager if any of them failed. Chunks become visible to the rest of the volume as soon as they are loaded, and a thread which
+	/// accesses a chunk while it is still being paged in will wait for that chunk (but is not prevented from accessing others).
+	///
+	/// Requests with a higher priority are processed first, and requests with the same priority are processed in the order they
+	/// were made. Because the Pager is called from the background threads its pageIn() function must be safe to call from several
+	/// threads at once, even if the volume was not constructed in thread safe mode. Any requests which have not been started when
+	/// the volume is destroyed are abandoned, in which case the future will report a broken promise.
+	///
+	/// \param regPrefetch The Region of voxels to prefetch into memory, which must be valid.
+	/// \param iPriority The priority of this request relative to other calls to prefetchAsync().
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::flushAll()
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	std::future<void> PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::prefetchAsync(Region regPrefetch, int32_t iPriority)
 	{
-		// Clear this pointer as all chunks are about to be removed.
-		m_pLastAccessedChunk = nullptr;
+		// An invalid region contains no chunks, so no task would ever complete the request.
+		POLYVOX_THROW_IF(!regPrefetch.isValid(), std::invalid_argument, "Cannot prefetch an invalid region");
+
+		// Convert the start and end positions into chunk space coordinates
+		Vector3DInt32 v3dStart;
+		for (int i = 0; i < 3; i++)
+		{
+			v3dStart.setElement(i, regPrefetch.getLowerCorner().getElement(i) >> getChunkSideLengthPower());
+		}
 
-		// Erase all the most recently used chunks.
-		for (uint32_t uIndex = 0; uIndex < uChunkArraySize; uIndex++)
+		Vector3DInt32 v3dEnd;
+		for (int i = 0; i < 3; i++)
 		{
-			m_arrayChunks[uIndex] = nullptr;
+			v3dEnd.setElement(i, regPrefetch.getUpperCorner().getElement(i) >> getChunkSideLengthPower());
 		}
-	}
 
-	template <typename VoxelType>
-	bool PagedVolume<VoxelType>::canReuseLastAccessedChunk(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const
-	{
-		return ((iChunkX == m_v3dLastAccessedChunkX) &&
-			(iChunkY == m_v3dLastAccessedChunkY) &&
-			(iChunkZ == m_v3dLastAccessedChunkZ) &&
-			(m_pLastAccessedChunk));
-	}
+		// The count can be too large for 32 bits.
+		Region region(v3dStart, v3dEnd);
+		const uint64_t uNoOfChunks = static_cast<uint64_t>(region.getWidthInVoxels()) * static_cast<uint64_t>(region.getHeightInVoxels()) * static_cast<uint64_t>(region.getDepthInVoxels());
+		POLYVOX_LOG_WARNING_IF(uNoOfChunks > m_uChunkCountLimit, "Attempting to prefetch more than the maximum number of chunks (this will cause thrashing).");
 
-	template <typename VoxelType>
-	typename PagedVolume<VoxelType>::Chunk* PagedVolume<VoxelType>::getChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const
-	{
-		Chunk* pChunk = nullptr;
+		auto pRequest = std::make_shared<PrefetchRequest>();
+		pRequest->uNoOfPendingChunks = uNoOfChunks;
+		std::future<void> future = pRequest->promise.get_future();
 
-		// We generate a 16-bit hash here and assume this matches the range available in the chunk
-		// array. The assert here is just to make sure we take care if change this in the future.
-		static_assert(uChunkArraySize == 65536, "Chunk array size has changed, check if the hash calculation needs updating.");
-		// Extract the lower five bits from each position component.
-		const uint32_t uChunkXLowerBits = static_cast<uint32_t>(uChunkX & 0x1F);
-		const uint32_t uChunkYLowerBits = static_cast<uint32_t>(uChunkY & 0x1F);
-		const uint32_t uChunkZLowerBits = static_cast<uint32_t>(uChunkZ & 0x1F);
-		// Combine then to form a 15-bit hash of the position. Also shift by one to spread the values out in the whole 16-bit space.
-		const uint32_t iPosisionHash = (((uChunkXLowerBits)) | ((uChunkYLowerBits) << 5) | ((uChunkZLowerBits) << 10) << 1);
+		{
+			std::lock_guard<std::mutex> lock(m_mutexChunks);
+			if (!m_pPrefetchThreadPool)
+			{
+				// Paging is often limited by IO rather than processing, but we still don't want to swamp the machine.
+				uint32_t uNoOfThreads = (std::min)((std::max)(std::thread::hardware_concurrency(), 2u) - 1, 4u);
+				m_pPrefetchThreadPool.reset(new ThreadPool(uNoOfThreads));
+			}
+		}
 
-		// Starting at the position indicated by the hash, and then search through the whole array looking for a chunk with the correct
-		// position. In most cases we expect to find it in the first place we look. Note that this algorithm is slow in the case that
-		// the chunk is not found because the whole array has to be searched, but in this case we are going to have to page the data in
-		// from an external source which is likely to be slow anyway.
-		uint32_t iIndex = iPosisionHash;
-		do
+		for (int32_t x = v3dStart.getX(); x <= v3dEnd.getX(); x++)
 		{
-			if (m_arrayChunks[iIndex])
+			for (int32_t y = v3dStart.getY(); y <= v3dEnd.getY(); y++)
 			{
-				Vector3DInt32& entryPos = m_arrayChunks[iIndex]->m_v3dChunkSpacePosition;
-				if (entryPos.getX() == uChunkX && entryPos.getY() == uChunkY && entryPos.getZ() == uChunkZ)
+				for (int32_t z = v3dStart.getZ(); z <= v3dEnd.getZ(); z++)
 				{
-					pChunk = m_arrayChunks[iIndex].get();
-					pChunk->m_uChunkLastAccessed = ++m_uTimestamper;
-					break;
+					m_pPrefetchThreadPool->enqueue([this, x, y, z, pRequest]()
+					{
+						try
+						{
+							acquireChunk(x, y, z);
+						}
+						catch (...)
+						{
+							// Only the first failure is reported.
+							std::lock_guard<std::mutex> lock(pRequest->mutexException);
+							if (!pRequest->pException)
+							{
+								pRequest->pException = std::current_exception();
+							}
+						}
+
+						if (--(pRequest->uNoOfPendingChunks) == 0)
+						{
+							std::lock_guard<std::mutex> lock(pRequest->mutexException);
+							if (pRequest->pException)
+							{
+								pRequest->promise.set_exception(pRequest->pException);
+							}
+							else
+							{
+								pRequest->promise.set_value();
+							}
+						}
+					}, iPriority);
 				}
 			}
+		}
+
+		return future;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Removes all voxels from memory, and calls dataOverflowHandler() to ensure the application has a chance to store the data.
+	///
+	/// Chunks which are still in use by a sampler, or (for a thread safe volume) by another thread, are not removed. Other threads
+	/// keep the chunk they accessed most recently until their next access to the volume, so the flush cannot remove those chunks.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::flushAll()
+	{
+		// Release the calling thread's reference to the most recently accessed chunk, as all chunks are about to be removed. Other
+		// threads may be using the chunks in their caches, so flushChunks() only makes those stale.
+		getChunkCache().m_pChunk = nullptr;
+
+		flushChunks();
+	}
 
-			iIndex++;
-			iIndex %= uChunkArraySize;
-		} while (iIndex != iPosisionHash); // Keep searching until we get back to our start position.
+	////////////////////////////////////////////////////////////////////////////////
+	/// Pages in the chunks which cover the given region (as prefetch() does) and then pins them, which means they will not be
+	/// evicted until the returned PinnedRegion is destroyed or released. This is useful for long operations such as surface
+	/// extraction, which would otherwise have to page chunks in again if other accesses caused them to be evicted part way
+	/// through. Regions can overlap, in which case the shared chunks stay pinned until all the regions containing them are released.
+	///
+	/// Pinned chunks still count towards the volume's memory usage, and other chunks are evicted to make space for them. To
+	/// make sure the rest of the volume can still be accessed, the pinned chunks may not use all of the memory for uncompressed
+	/// chunks. If pinning the region would take the volume over this limit then an invalid_operation exception is thrown and
+	/// nothing is pinned.
+	/// \param regPin The Region of voxels to pin in memory.
+	/// \return An object which keeps the chunks pinned for as long as it exists.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PinnedRegion PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::pin(const Region& regPin)
+	{
+		// Convert the start and end positions into chunk space coordinates
+		Vector3DInt32 v3dStart;
+		for (int i = 0; i < 3; i++)
+		{
+			v3dStart.setElement(i, regPin.getLowerCorner().getElement(i) >> getChunkSideLengthPower());
+		}
 
-		// If we still haven't found the chunk then it's time to create a new one and page it in from disk.
-		if (!pChunk)
+		Vector3DInt32 v3dEnd;
+		for (int i = 0; i < 3; i++)
 		{
-			// The chunk was not found so we will create a new one.
-			Vector3DInt32 v3dChunkPos(uChunkX, uChunkY, uChunkZ);
-			pChunk = new PagedVolume<VoxelType>::Chunk(v3dChunkPos, m_uChunkSideLength, m_pPager);
-			pChunk->m_uChunkLastAccessed = ++m_uTimestamper; // Important, as we may soon delete the oldest chunk
+			v3dEnd.setElement(i, regPin.getUpperCorner().getElement(i) >> getChunkSideLengthPower());
+		}
+
+		// Fail early if the region could never be pinned, rather than paging it in first.
+		Region region(v3dStart, v3dEnd);
+		uint64_t uNoOfChunks = static_cast<uint64_t>(region.getWidthInVoxels()) * region.getHeightInVoxels() * region.getDepthInVoxels();
+		POLYVOX_THROW_IF(uNoOfChunks > getMaxNoOfPinnedChunks(), invalid_operation, "Cannot pin ", uNoOfChunks,
+			" chunks as the memory usage limit only allows ", getMaxNoOfPinnedChunks(), " chunks to be pinned");
+
+		PinnedRegion pinnedRegion;
+		pinnedRegion.m_pVolume = this;
+		pinnedRegion.m_region = regPin;
+		pinnedRegion.m_vecChunks.reserve(static_cast<size_t>(uNoOfChunks));
 
-			// Store the chunk at the appropriate place in out chunk array. Ideally this place is
-			// given by the hash, otherwise we do a linear search for the next available location
-			// We always expect to find a free place because we aim to keep the array only half full.
-			uint32_t iIndex = iPosisionHash;
-			bool bInsertedSucessfully = false;
-			do
+		for (int32_t x = v3dStart.getX(); x <= v3dEnd.getX(); x++)
+		{
+			for (int32_t y = v3dStart.getY(); y <= v3dEnd.getY(); y++)
 			{
-				if (m_arrayChunks[iIndex] == nullptr)
+				for (int32_t z = v3dStart.getZ(); z <= v3dEnd.getZ(); z++)
 				{
-					m_arrayChunks[iIndex] = std::move(std::unique_ptr< Chunk >(pChunk));
-					bInsertedSucessfully = true;
-					break;
-				}
+					// We hold a reference to the chunk, so it cannot be evicted before we pin it. If this fails then the
+					// PinnedRegion is destroyed as the exception leaves this function, which unpins the chunks done so far.
+					std::shared_ptr<Chunk> pChunk = acquireChunk(x, y, z);
 
-				iIndex++;
-				iIndex %= uChunkArraySize;
-			} while (iIndex != iPosisionHash); // Keep searching until we get back to our start position.
-
-			// This should never really happen unless we are failing to keep our number of active chunks
-			// significantly under the target amount. Perhaps if chunks are 'pinned' for threading purposes?
-			POLYVOX_THROW_IF(!bInsertedSucessfully, std::logic_error, "No space in chunk array for new chunk.");
-
-			// As we have added a chunk we may have exceeded our target chunk limit. Search through the array to
-			// determine how many chunks we have, as well as finding the oldest timestamp. Note that this is potentially
-			// wasteful and we may instead wish to track how many chunks we have and/or delete a chunk at random (or
-			// just check e.g. 10 and delete the oldest of those) but we'll see if this is a bottleneck first. Paging
-			// the data in is probably more expensive.
-			uint32_t uChunkCount = 0;
-			uint32_t uOldestChunkIndex = 0;
-			uint32_t uOldestChunkTimestamp = std::numeric_limits<uint32_t>::max();
-			for (uint32_t uIndex = 0; uIndex < uChunkArraySize; uIndex++)
-			{
-				if (m_arrayChunks[uIndex])
-				{
-					uChunkCount++;
-					if (m_arrayChunks[uIndex]->m_uChunkLastAccessed < uOldestChunkTimestamp)
+					std::lock_guard<std::mutex> lock(m_mutexChunks);
+					if (pChunk->m_uNoOfPins == 0)
 					{
-						uOldestChunkTimestamp = m_arrayChunks[uIndex]->m_uChunkLastAccessed;
-						uOldestChunkIndex = uIndex;
+						POLYVOX_THROW_IF(m_uNoOfPinnedChunks >= getMaxNoOfPinnedChunks(), invalid_operation, "Cannot pin more than ",
+							getMaxNoOfPinnedChunks(), " chunks, so the region cannot be pinned while other regions are pinned");
+
+						unlinkChunk(pChunk.get());
+						m_uNoOfPinnedChunks++;
 					}
+					pChunk->m_uNoOfPins++;
+					pinnedRegion.m_vecChunks.push_back(pChunk);
 				}
 			}
+		}
+
+		return pinnedRegion;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The snapshot can be read (directly or through its samplers) in the same way as the volume, and always gives the values which
+	/// the voxels had when it was taken. This allows long running tasks such as surface extraction or saving to work on a consistent
+	/// version of the volume on another thread, while the volume itself continues to be modified.
+	///
+	/// Taking a snapshot does not copy anything. Instead, the first time each chunk is written to after a snapshot has been taken its
+	/// contents are copied and kept for the snapshot, which reads all other chunks from the volume. The copies are released when the
+	/// snapshot is destroyed (unless they are also used by other snapshots). They are not counted as part of the volume's memory usage,
+	/// but getStatistics() reports how much memory they are using. Chunks which a snapshot is reading are in use, so they are not evicted.
+	///
+	/// A snapshot should be taken when no other thread is writing to the volume, as any writes which are in progress at the time
+	/// may or may not be included in it. Each snapshot may only be read by one thread at a time, but they are cheap to create so
+	/// several can be taken if needed. Reading a snapshot may cause chunks to be paged in and out of the volume, so (as with
+	/// prefetchAsync()) the Pager must be safe to call from several threads at once if the snapshot is read from another thread.
+	/// Snapshots must be destroyed before the volume.
+	/// \return A snapshot of the volume's current contents.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	std::unique_ptr< PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout> > PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::snapshot(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+
+		// The snapshot doesn't need to do anything to the chunks. Instead, writers compare each chunk's epoch with the volume's to find
+		// out whether any snapshots have been taken since they last checked it.
+		const uint64_t uEpoch = m_uSnapshotEpoch + 1;
+		std::unique_ptr< PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout> > pSnapshot(new PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>(this, uEpoch));
+		m_vecSnapshots.push_back(pSnapshot.get());
+		m_uSnapshotEpoch = uEpoch;
+
+		return pSnapshot;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// When change tracking is enabled the volume records which voxels are written through setVoxel(), so that an application can find
+	/// out which of its meshes are out of date (see consumeChangedRegions()) rather than extracting them all again. This only costs a
+	/// few comparisons per write, and is disabled by default. Writes made directly to a Chunk (such as by the Pager) are not recorded.
+	///
+	/// Disabling change tracking forgets any changes which have not yet been consumed, as well as the chunk versions. This should not be
+	/// called while other threads are writing to the volume.
+	/// \param bEnabled Whether changes should be recorded.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::setChangeTrackingEnabled(bool bEnabled)
+	{
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
 
-			// Check if we have too many chunks, and delete the oldest if so.
-			if (uChunkCount > m_uChunkCountLimit)
+		m_bTrackChanges = bEnabled;
+		if (!bEnabled)
+		{
+			for (auto& pChunk : m_arrayChunks)
 			{
-				m_arrayChunks[uOldestChunkIndex] = nullptr;
+				if (pChunk)
+				{
+					pChunk->m_uChangedBounds = 0;
+				}
 			}
+			m_changeTracker.clear();
 		}
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::isChangeTrackingEnabled(void) const
+	{
+		return m_bTrackChanges;
+	}
 
-		m_pLastAccessedChunk = pChunk;
-		m_v3dLastAccessedChunkX = uChunkX;
-		m_v3dLastAccessedChunkY = uChunkY;
-		m_v3dLastAccessedChunkZ = uChunkZ;
+	////////////////////////////////////////////////////////////////////////////////
+	/// Each chunk which has been written to since the changes were last consumed is returned along with the bounds of the voxels which
+	/// were written (including any which were set to the value they already had) and its current version. Chunks which have been
+	/// evicted are included, as the volume keeps the changes after the chunk's data has gone.
+	/// \return The modified chunks, ordered by position.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	std::vector<typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::ChangedChunk> PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getChangedChunks(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+		collectChanges();
+		return m_changeTracker.getChangedChunks();
+	}
 
-		return pChunk;
+	////////////////////////////////////////////////////////////////////////////////
+	/// The version of a chunk is incremented whenever writes to it are recorded, and is not reset when the changes are consumed. An
+	/// application can store the version of each chunk alongside the meshes which it has extracted from them, and later compare it
+	/// with the current version to find out whether they are out of date. Several writes between calls may only increment the version once.
+	/// \param v3dChunkPos The position of the chunk in chunk space (i.e. the position of a voxel in it divided by the chunk side length).
+	/// \return The chunk's version, which is zero for chunks which have not been modified since change tracking was enabled.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint32_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getChunkVersion(const Vector3DInt32& v3dChunkPos) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+		collectChanges();
+		return m_changeTracker.getVersion(v3dChunkPos);
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
-	/// Calculate the memory usage of the volume.
+	/// The volume is divided into a grid of extraction regions of the given size, with one region starting at the origin. A region is
+	/// returned if any voxel in it has been written since the last call. Because surface extraction also reads the voxels just below
+	/// the lower faces of a region (see extractCubicMesh()), a region is also returned if any of the voxels on those faces have been
+	/// written. Each region is only returned once, however many changes it contains, so the result can be used directly as a list of
+	/// meshes to extract again. The changes are then forgotten.
+	/// \param v3dRegionSize The size of the extraction regions, which must be at least one voxel on each side.
+	/// \return The regions which need extracting, ordered by position.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	std::vector<Region> PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::consumeChangedRegions(const Vector3DInt32& v3dRegionSize)
+	{
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+		collectChanges();
+		return m_changeTracker.consumeChangedRegions(v3dRegionSize);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// With chunk aprons enabled, a sampler which moves into a chunk works from a copy of the chunk which also includes the layer of
+	/// voxels around it (its apron). The sampler can then peek across the chunk's faces with a single offset, rather than looking
+	/// in the neighbouring chunks, which speeds up algorithms such as the MarchingCubesSurfaceExtractor and the LowPassFilter
+	/// which peek around every voxel. The copy is made the first time a sampler enters the chunk (including uniform chunks) and is
+	/// discarded when the chunk is evicted. Each one uses ((n + 2) / n)^3 times the memory of an uncompressed chunk of side length n,
+	/// which is about 20% more for 32^3 chunks and 42% more for 16^3 chunks. This is reported by getStatistics() but is not counted
+	/// towards the target memory usage.
+	///
+	/// Writes made through the volume or its samplers keep the copies of the chunk and of any neighbouring chunks up to date. This
+	/// costs a few operations per write, and a lock when the voxel is on the face of a chunk. Writes made directly to a Chunk (such
+	/// as by the Pager) are not seen by the copies. Changing this setting discards all the copies, and samplers which are already
+	/// inside a chunk only switch to the new mode when they next move into another chunk (or call setPosition()).
+	///
+	/// Aprons cannot be enabled for a thread safe volume, as a write from one thread would have to update copies which other threads
+	/// are reading. An invalid_operation exception is thrown if this is attempted.
+	/// \param bEnabled Whether samplers should use apron copies of the chunks.
 	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	uint32_t PagedVolume<VoxelType>::calculateSizeInBytes(void)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::setChunkApronEnabled(bool bEnabled)
 	{
-		uint32_t uChunkCount = 0;
-		for (uint32_t uIndex = 0; uIndex < uChunkArraySize; uIndex++)
+		POLYVOX_THROW_IF(bEnabled && m_bThreadSafe, invalid_operation, "Chunk aprons cannot be enabled for a thread safe volume");
+
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+
+		m_bApronsEnabled = bEnabled;
+		for (auto& pChunk : m_arrayChunks)
 		{
-			if (m_arrayChunks[uIndex])
+			if (pChunk)
 			{
-				uChunkCount++;
+				std::atomic_store(&(pChunk->m_pApronCopy), std::shared_ptr<ApronCopy>());
 			}
 		}
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::isChunkApronEnabled(void) const
+	{
+		return m_bApronsEnabled;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Chunks often contain only a few different values (such as a handful of materials), and with palettes enabled they can store
+	/// these values once along with a packed index for each voxel. The indices have 1, 2, 4 or 8 bits depending on the number of values,
+	/// so a chunk of 16-bit voxels needs between 1/16 and 1/2 of the memory of its uncompressed data (plus the values themselves). Writes
+	/// to a uniform chunk give it a palette rather than allocating its data, and the indices are widened as more values are written
+	/// until there are more than 256, when the data is allocated after all. When the volume is over its target memory usage the least
+	/// recently used chunks are packed into palettes (if they have few enough values) rather than being evicted, and chunks are only
+	/// evicted once there are none left to pack. This lets many more chunks fit into the same memory.
+	///
+	/// Reading a voxel from a palette is slower than reading it from the data. Samplers need the data, so that they can move through it with
+	/// constant offsets, and so a sampler which moves into a chunk with a palette decodes it into a copy of its own (which it keeps while
+	/// the palette is unchanged) rather than expanding the chunk. Pagers and snapshots see the data as usual, because getData() expands
+	/// the palette. Disabling the palettes does not expand the existing ones, but no new ones are created. This should not be
+	/// called while other threads are using the volume.
+	/// \param bEnabled Whether chunks should be stored as palettes when they have few enough values.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::setChunkPaletteEnabled(bool bEnabled)
+	{
+		m_bPalettesEnabled = bEnabled;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::isChunkPaletteEnabled(void) const
+	{
+		return m_bPalettesEnabled;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PinnedRegion::PinnedRegion()
+		:m_pVolume(nullptr)
+	{
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PinnedRegion::PinnedRegion(PinnedRegion&& rhs)
+		:m_pVolume(rhs.m_pVolume)
+		, m_region(rhs.m_region)
+		, m_vecChunks(std::move(rhs.m_vecChunks))
+	{
+		rhs.m_pVolume = nullptr;
+		rhs.m_vecChunks.clear();
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PinnedRegion::~PinnedRegion()
+	{
+		release();
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PinnedRegion& PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PinnedRegion::operator=(PinnedRegion&& rhs)
+	{
+		if (this != &rhs)
+		{
+			release();
+
+			m_pVolume = rhs.m_pVolume;
+			m_region = rhs.m_region;
+			m_vecChunks = std::move(rhs.m_vecChunks);
+
+			rhs.m_pVolume = nullptr;
+			rhs.m_vecChunks.clear();
+		}
+		return *this;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	const Region& PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PinnedRegion::getRegion(void) const
+	{
+		return m_region;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PinnedRegion::release(void)
+	{
+		if (m_pVolume)
+		{
+			m_pVolume->unpinChunks(m_vecChunks);
+			m_pVolume = nullptr;
+		}
+	}
 
-		// Note: We disregard the size of the other class members as they are likely to be very small compared to the size of the
-		// allocated voxel data. This also keeps the reported size as a power of two, which makes other memory calculations easier.
-		return PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(m_uChunkSideLength) * uChunkCount;
+	////////////////////////////////////////////////////////////////////////////////
+	/// Sets how many modified chunks can be waiting to be paged out by a background thread. By default this is zero, which
+	/// means a modified chunk is paged out as soon as it is evicted. This is done by the thread which caused the eviction, so
+	/// a voxel access which misses the loaded chunks may have to wait for both a page-out and a page-in.
+	///
+	/// With a non-zero value, evicted chunks are instead handed to a writer thread, and accesses to a chunk which is still
+	/// waiting to be paged out simply bring it back into the volume. If the queue is full then the thread causing an eviction
+	/// waits for the writer to catch up, which limits how much memory the queued chunks can use. The Pager's pageOut()
+	/// function is then called on the writer thread, so it must be safe to call while pageIn() runs on another thread.
+	///
+	/// This should not be called while other threads are accessing the volume.
+	/// \param uMaxQueuedChunks The maximum number of chunks waiting to be paged out, or zero to disable the queue.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::setPageOutQueueLength(uint32_t uMaxQueuedChunks)
+	{
+		// Finish any page-outs which were queued under the previous setting.
+		if (m_pPageOutThreadPool)
+		{
+			m_pPageOutThreadPool->waitForIdle();
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+
+		m_uMaxQueuedPageOuts = uMaxQueuedChunks;
+		if ((m_uMaxQueuedPageOuts > 0) && (!m_pPageOutThreadPool))
+		{
+			// A single thread is used so that the Pager's pageOut() function is never called concurrently.
+			m_pPageOutThreadPool.reset(new ThreadPool(1));
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// By default an evicted chunk is passed straight to the Pager. Enabling compression instead splits the target memory usage
+	/// between two tiers. Half of it is used for uncompressed chunks which can be accessed directly (as before), and the rest
+	/// holds evicted chunks in a compressed form. Voxel data usually compresses very well so the second tier can hold many more
+	/// chunks, and accessing one of these only requires it to be decompressed rather than paged in. Chunks are passed to the Pager
+	/// once they are evicted from the compressed tier.
+	///
+	/// The compression is done by the thread which causes the eviction, and decompression by the thread which accesses the chunk.
+	/// Run-length encoding is fast and works well for smooth data. The additional LZ stage finds repeated patterns, which helps
+	/// with more varied data (such as noise or mixed materials) at the cost of being several times slower.
+	///
+	/// This should not be called while other threads are accessing the volume.
+	/// \param eCompression The type of compression to use, or ChunkCompressions::None to disable the compressed tier.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::setChunkCompression(ChunkCompression eCompression)
+	{
+		std::unique_lock<std::mutex> lock(m_mutexChunks);
+
+		m_eChunkCompression = eCompression;
+
+		uint64_t uChunkSizeInBytes = PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::calculateSizeInBytes(getChunkSideLength());
+		uint64_t uUncompressedMemoryInBytes = (m_eChunkCompression == ChunkCompressions::None) ? m_uTargetMemoryUsageInBytes : m_uTargetMemoryUsageInBytes / 2;
+		m_uChunkCountLimit = (std::max)(static_cast<uint32_t>(uUncompressedMemoryInBytes / uChunkSizeInBytes), uMinPracticalNoOfChunks);
+
+		// The compressed tier gets whatever is left, which may be nothing if the target was already too small.
+		uint64_t uUncompressedLimitInBytes = m_uChunkCountLimit * uChunkSizeInBytes;
+		m_uCompressedSizeLimit = (m_eChunkCompression == ChunkCompressions::None) || (uUncompressedLimitInBytes >= m_uTargetMemoryUsageInBytes) ?
+			0 : m_uTargetMemoryUsageInBytes - uUncompressedLimitInBytes;
+
+		POLYVOX_LOG_DEBUG("Memory usage limit for volume now set to ", (m_uChunkCountLimit * uChunkSizeInBytes) / (1024 * 1024), "Mb of uncompressed chunks and ",
+			m_uCompressedSizeLimit / (1024 * 1024), "Mb of compressed chunks.");
+
+		// Apply the new limits straight away. If compression has been disabled this passes all the compressed chunks to the Pager.
+		evictChunks(lock);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Removes (and so pages out) all the chunks which are not referenced from elsewhere.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::flushChunks(void)
+	{
+		m_uFlushCount++;
+
+		// Modified chunks which are not queued for the writer thread are paged out by this thread after the mutex is unlocked.
+		std::vector< std::shared_ptr<Chunk> > vecDeferredPageOuts;
+		{
+			std::lock_guard<std::mutex> lock(m_mutexChunks);
+
+			Chunk* pChunk = m_pLeastRecentChunk;
+			while (pChunk)
+			{
+				Chunk* pMoreRecentChunk = pChunk->m_pMoreRecentChunk;
+				if (m_arrayChunks[pChunk->m_uChunkArrayIndex].use_count() == 1)
+				{
+					// A flush is explicitly requested so we don't limit the length of the page-out queue here.
+					if ((m_uMaxQueuedPageOuts > 0) && (pChunk->m_bDataModified))
+					{
+						queuePageOut(eraseChunk(pChunk->m_uChunkArrayIndex));
+					}
+					else
+					{
+						deferPageOut(eraseChunk(pChunk->m_uChunkArrayIndex), vecDeferredPageOuts);
+					}
+				}
+				pChunk = pMoreRecentChunk;
+			}
+
+			while (!m_listCompressedChunks.empty())
+			{
+				deferPageOut(discardOldestCompressedChunk(), vecDeferredPageOuts);
+			}
+
+			// Try again to page out any chunks which failed before.
+			std::vector< std::shared_ptr<Chunk> > vecFailedPageOuts;
+			vecFailedPageOuts.swap(m_vecFailedPageOuts);
+			for (const auto& pFailedChunk : vecFailedPageOuts)
+			{
+				queuePageOut(pFailedChunk);
+			}
+		}
+
+		for (const auto& pDeferredChunk : vecDeferredPageOuts)
+		{
+			pageOutChunk(pDeferredChunk);
+		}
+
+		if (m_pPageOutThreadPool)
+		{
+			m_pPageOutThreadPool->waitForIdle();
+		}
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::ChunkCache& PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getChunkCache(void) const
+	{
+		return m_bThreadSafe ? getThreadChunkCache() : m_defaultChunkCache;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::ChunkCache& PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getThreadChunkCache(void) const
+	{
+		// The most recently used slot is always kept at the front, so usually only the first comparison is needed.
+		ThreadChunkCacheSlot* pSlots = getThreadChunkCacheSlots();
+
+		for (uint32_t uSlot = 0; uSlot < uThreadChunkCacheSlotCount; uSlot++)
+		{
+			if (pSlots[uSlot].uVolumeId == m_uVolumeId)
+			{
+				if (uSlot > 0)
+				{
+					std::swap(pSlots[0], pSlots[uSlot]);
+				}
+				return *(pSlots[0].pChunkCache);
+			}
+		}
+
+		// This thread has not accessed the volume recently, so we have to look up (or create) its cache.
+		ChunkCache* pChunkCache = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_mutexChunks);
+			std::unique_ptr<ChunkCache>& pThreadChunkCache = m_mapThreadChunkCaches[std::this_thread::get_id()];
+			if (!pThreadChunkCache)
+			{
+				pThreadChunkCache.reset(new ChunkCache);
+			}
+			pChunkCache = pThreadChunkCache.get();
+		}
+
+#if POLYVOX_HAS_THREAD_LOCAL_OBJECTS
+		// Without this the cache (and the chunk in it) would only be released when the volume is destroyed.
+		static thread_local ThreadChunkCacheOwner s_owner;
+		s_owner.addLink(m_pThreadChunkCacheLink);
+#endif
+
+		// Discard the least recently used slot and put the new one at the front.
+		for (uint32_t uSlot = uThreadChunkCacheSlotCount - 1; uSlot > 0; uSlot--)
+		{
+			pSlots[uSlot] = pSlots[uSlot - 1];
+		}
+		pSlots[0].uVolumeId = m_uVolumeId;
+		pSlots[0].pChunkCache = pChunkCache;
+
+		return *pChunkCache;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::ThreadChunkCacheSlot* PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getThreadChunkCacheSlots(void)
+	{
+		static POLYVOX_THREAD_LOCAL ThreadChunkCacheSlot s_arraySlots[uThreadChunkCacheSlotCount];
+		return s_arraySlots;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::removeThreadChunkCache(void) const
+	{
+		// The thread may still access the volume (such as from the destructor of another thread-local object), in which case it
+		// must create a new cache rather than use the one which is removed here.
+		ThreadChunkCacheSlot* pSlots = getThreadChunkCacheSlots();
+		for (uint32_t uSlot = 0; uSlot < uThreadChunkCacheSlotCount; uSlot++)
+		{
+			if (pSlots[uSlot].uVolumeId == m_uVolumeId)
+			{
+				pSlots[uSlot].uVolumeId = 0;
+				pSlots[uSlot].pChunkCache = nullptr;
+			}
+		}
+
+		std::unique_ptr<ChunkCache> pChunkCache;
+		{
+			std::lock_guard<std::mutex> lock(m_mutexChunks);
+			auto iter = m_mapThreadChunkCaches.find(std::this_thread::get_id());
+			if (iter == m_mapThreadChunkCaches.end())
+			{
+				return;
+			}
+			pChunkCache = std::move(iter->second);
+			m_mapThreadChunkCaches.erase(iter);
+
+			// The default cache is not used by a thread safe volume, so it keeps the counts for threads which have exited.
+			m_defaultChunkCache.m_uNoOfHits += pChunkCache->m_uNoOfHits;
+			m_defaultChunkCache.m_uNoOfMisses += pChunkCache->m_uNoOfMisses;
+		}
+
+		// Releasing the chunk may page it out, so this is done after unlocking.
+		pChunkCache.reset();
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::ThreadChunkCacheOwner::~ThreadChunkCacheOwner()
+	{
+		for (const auto& pLink : vecLinks)
+		{
+			std::lock_guard<std::mutex> lock(pLink->mutex);
+			if (pLink->pVolume)
+			{
+				pLink->pVolume->removeThreadChunkCache();
+			}
+		}
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::ThreadChunkCacheOwner::addLink(const std::shared_ptr<ThreadChunkCacheLink>& pLink)
+	{
+		if (std::find(vecLinks.begin(), vecLinks.end(), pLink) != vecLinks.end())
+		{
+			return;
+		}
+
+		// Drop the links to volumes which have been destroyed, so a long lived thread does not collect them.
+		vecLinks.erase(std::remove_if(vecLinks.begin(), vecLinks.end(), [](const std::shared_ptr<ThreadChunkCacheLink>& pOldLink)
+		{
+			std::lock_guard<std::mutex> lock(pOldLink->mutex);
+			return pOldLink->pVolume == nullptr;
+		}), vecLinks.end());
+
+		vecLinks.push_back(pLink);
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::canReuseLastAccessedChunk(ChunkCache& cache, int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const
+	{
+		if ((iChunkX == cache.m_iChunkX) &&
+			(iChunkY == cache.m_iChunkY) &&
+			(iChunkZ == cache.m_iChunkZ) &&
+			(cache.m_uFlushCount == m_uFlushCount.load(std::memory_order_relaxed)) &&
+			(cache.m_pChunk))
+		{
+			cache.m_uNoOfHits.store(cache.m_uNoOfHits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		cache.m_uNoOfMisses.store(cache.m_uNoOfMisses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk* PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getChunk(ChunkCache& cache, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, const VoxelType* pFillValue) const
+	{
+		// Read the flush count first, so that a flush which happens during the acquisition makes this chunk stale.
+		cache.m_uFlushCount = m_uFlushCount.load(std::memory_order_relaxed);
+		cache.m_pChunk = acquireChunk(uChunkX, uChunkY, uChunkZ, pFillValue);
+		cache.m_iChunkX = uChunkX;
+		cache.m_iChunkY = uChunkY;
+		cache.m_iChunkZ = uChunkZ;
+
+		return cache.m_pChunk.get();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Finds the chunk at the given position, creating it and paging it in if necessary. If another thread is
+	/// already paging the chunk in then this waits for it to finish. The returned chunk is always fully loaded.
+	///
+	/// If a fill value is given then the caller is about to overwrite the whole chunk, so a chunk which is not in the volume
+	/// is created as a uniform chunk with that value (and marked as modified) instead of being paged in. Any older copy of it
+	/// which is waiting to be compressed or paged out is discarded.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	std::shared_ptr<typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk> PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::acquireChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, const VoxelType* pFillValue) const
+	{
+		std::shared_ptr<Chunk> pChunk;
+
+		std::unique_lock<std::mutex> lock(m_mutexChunks);
+
+		while (!pChunk)
+		{
+			uint32_t uIndex = findChunk(uChunkX, uChunkY, uChunkZ);
+			if (uIndex != uInvalidChunkIndex)
+			{
+				pChunk = m_arrayChunks[uIndex];
+
+				// Move the chunk to the front of the list, as it is now the most recently used. Pinned chunks are not in the list.
+				if (pChunk->m_uNoOfPins == 0)
+				{
+					unlinkChunk(pChunk.get());
+					linkChunk(pChunk.get());
+				}
+
+				if (!pChunk->m_bLoaded)
+				{
+					// Another thread is paging this chunk in, so we wait for it rather than paging the same data in twice.
+					m_cvChunkLoaded.wait(lock, [&pChunk]{ return pChunk->m_bLoaded || pChunk->m_bLoadFailed; });
+
+					// If the other thread failed then the chunk has been removed, so search again (and probably try to load it ourselves).
+					if (pChunk->m_bLoadFailed)
+					{
+						pChunk = nullptr;
+					}
+				}
+				continue;
+			}
+
+			// If the chunk was recently evicted it may still be waiting to be paged out, in which case we can bring it back
+			// into the volume. If the writer is already paging it out then the Pager must not see the data change, so we wait
+			// for it to finish and search again. By then the chunk has usually left the queue and will be paged back in.
+			auto isChunkAtPosition = [=](const std::shared_ptr<Chunk>& pQueuedChunk)
+			{
+				const Vector3DInt32& v3dPos = pQueuedChunk->m_v3dChunkSpacePosition;
+				return (v3dPos.getX() == uChunkX) && (v3dPos.getY() == uChunkY) && (v3dPos.getZ() == uChunkZ);
+			};
+			Vector3DInt32 v3dChunkPos(uChunkX, uChunkY, uChunkZ);
+			const bool bOverwrite = pFillValue && canOverwriteChunk(v3dChunkPos);
+
+			auto iterQueued = std::find_if(m_vecQueuedPageOuts.begin(), m_vecQueuedPageOuts.end(), isChunkAtPosition);
+			if (iterQueued != m_vecQueuedPageOuts.end())
+			{
+				std::shared_ptr<Chunk> pQueuedChunk = *iterQueued;
+				if (pQueuedChunk->m_bBeingPagedOut)
+				{
+					m_cvPageOut.wait(lock, [&pQueuedChunk]{ return !pQueuedChunk->m_bBeingPagedOut; });
+					continue;
+				}
+
+				m_vecQueuedPageOuts.erase(iterQueued);
+				pQueuedChunk->m_bPageOutQueued = false;
+				if (bOverwrite)
+				{
+					// The writer thread will skip it, and it must not be paged out when it is destroyed either.
+					pQueuedChunk->setDataModified(false);
+				}
+				else
+				{
+					pChunk = pQueuedChunk;
+					insertChunk(pChunk);
+					evictChunks(lock);
+					continue;
+				}
+			}
+
+			// Chunks which could not be paged out are kept (still modified) until the next flush, and can also be brought back.
+			auto iterFailed = std::find_if(m_vecFailedPageOuts.begin(), m_vecFailedPageOuts.end(), isChunkAtPosition);
+			if (iterFailed != m_vecFailedPageOuts.end())
+			{
+				std::shared_ptr<Chunk> pFailedChunk = *iterFailed;
+				m_vecFailedPageOuts.erase(iterFailed);
+				if (bOverwrite)
+				{
+					pFailedChunk->setDataModified(false);
+				}
+				else
+				{
+					pChunk = pFailedChunk;
+					insertChunk(pChunk);
+					evictChunks(lock);
+					continue;
+				}
+			}
+
+			// The chunk was not found so we will create a new one.
+			pChunk = createChunk(v3dChunkPos);
+
+			// If the chunk is in the compressed tier then we take it out, and initialise the new chunk from that instead of
+			// the Pager. It is decompressed without holding the lock, just as the Pager would be called without holding it.
+			CompressedChunk compressedChunk;
+			auto iterCompressed = m_mapCompressedChunks.find(v3dChunkPos);
+			const bool bCompressed = (iterCompressed != m_mapCompressedChunks.end());
+			if (bCompressed)
+			{
+				m_uCompressedSizeInBytes -= iterCompressed->second->calculateSizeInBytes();
+				if (iterCompressed->second->m_bDataModified)
+				{
+					m_uNoOfModifiedCompressedChunks--;
+				}
+				compressedChunk = std::move(*(iterCompressed->second));
+				m_listCompressedChunks.erase(iterCompressed->second);
+				m_mapCompressedChunks.erase(iterCompressed);
+			}
+
+			if (bOverwrite)
+			{
+				// Every voxel has been written, and no snapshot needs the old contents.
+				pChunk->m_tUniformValue = *pFillValue;
+				pChunk->setDataModified(true);
+				pChunk->m_uSnapshotEpoch.store(m_uSnapshotEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				if (m_bTrackChanges.load(std::memory_order_relaxed))
+				{
+					ChangeTracker::recordChange(pChunk->m_uChangedBounds, 0, 0, 0);
+					ChangeTracker::recordChange(pChunk->m_uChangedBounds, getChunkMask(), getChunkMask(), getChunkMask());
+				}
+				pChunk->m_bLoaded = true;
+				insertChunk(pChunk);
+				evictChunks(lock);
+				continue;
+			}
+
+			insertChunk(pChunk);
+
+			// As we have added a chunk we may have exceeded our target chunk limit.
+			evictChunks(lock);
+
+			pageInChunk(lock, pChunk, bCompressed ? &compressedChunk : nullptr);
+		}
+
+		return pChunk;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns true if a chunk which is not in the volume can be overwritten without its old contents being paged in. This is not
+	/// possible if a snapshot was taken before the chunk was last written, and has not yet been given its own copy of the chunk.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::canOverwriteChunk(const Vector3DInt32& v3dChunkPos) const
+	{
+		for (auto pSnapshot : m_vecSnapshots)
+		{
+			if (pSnapshot->m_mapPreservedChunks.find(v3dChunkPos) == pSnapshot->m_mapPreservedChunks.end())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Passes a chunk which has just been added to the chunk array to the Pager, so that it can be initialised with any data. The
+	/// lock is released while the Pager runs so that other threads can continue to access chunks which have already been loaded.
+	/// If the chunk's data was in the compressed tier then this is decompressed instead, and the Pager is not called.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::pageInChunk(std::unique_lock<std::mutex>& lock, const std::shared_ptr<Chunk>& pChunk, const CompressedChunk* pCompressedChunk) const
+	{
+		// From the coordinates of the chunk we deduce the coordinates of the contained voxels.
+		Vector3DInt32 v3dLower = pChunk->m_v3dChunkSpacePosition * static_cast<int32_t>(getChunkSideLength());
+		Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(getChunkSideLength() - 1, getChunkSideLength() - 1, getChunkSideLength() - 1);
+		Region reg(v3dLower, v3dUpper);
+
+		lock.unlock();
+		try
+		{
+			if (pCompressedChunk)
+			{
+				decompressChunk(*pCompressedChunk, pChunk.get());
+			}
+			else
+			{
+				Timer timer;
+				m_pPager->pageIn(reg, pChunk.get());
+				m_uPageInTimeInNanoSeconds += timer.elapsedTimeInNanoSeconds();
+				m_uNoOfPageIns++;
+			}
+		}
+		catch (...)
+		{
+			// Remove the chunk so that a later access can try again, and wake any threads which were waiting for it. The
+			// partially loaded data must not be paged out when the last reference to the chunk is released.
+			lock.lock();
+			pChunk->setDataModified(false);
+			pChunk->m_bLoadFailed = true;
+			eraseChunk(pChunk->m_uChunkArrayIndex);
+			m_cvChunkLoaded.notify_all();
+			throw;
+		}
+		lock.lock();
+
+		// We'll use this later to decide if data needs to be paged out again. A compressed chunk may
+		// not have been paged out since it was last modified, in which case that still needs to happen.
+		pChunk->setDataModified(pCompressedChunk ? pCompressedChunk->m_bDataModified : false);
+		pChunk->m_bLoaded = true;
+		m_cvChunkLoaded.notify_all();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Creates a chunk which belongs to this volume but has not yet been added to it.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	std::shared_ptr<typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk> PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::createChunk(const Vector3DInt32& v3dChunkPos) const
+	{
+		auto pChunk = std::make_shared<Chunk>(v3dChunkPos, getChunkSideLength(), m_pPager);
+		pChunk->m_pAllocator = m_pChunkAllocator.get();
+
+		// Chunks which belong to a volume only count as modified once they are written (or overwritten), so that chunks which are
+		// merely being paged in are not included in the volume's count of modified chunks.
+		pChunk->m_bDataModified = false;
+		pChunk->m_pVolume = this;
+		return pChunk;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Calculates how much memory is used by the uncompressed chunks, including those waiting to be paged out. Every chunk is
+	/// counted at the size of the chunk itself, plus the size of its data if it has allocated any or of its palette if it has one. The allocator's count can
+	/// include chunks which have been evicted but are still in use, so it is limited to the number of chunks we actually hold.
+	/// It also includes the data which is kept for snapshots, which is not counted here.
+	/// This only uses counts which are kept up to date as chunks are added and removed, so it does not depend on the number of chunks.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint64_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::calculateUncompressedSizeInBytes(void) const
+	{
+		const uint32_t uNoOfChunks = m_uChunkCount + static_cast<uint32_t>(m_vecQueuedPageOuts.size() + m_vecFailedPageOuts.size());
+		const uint32_t uNoOfSlabsInUse = m_pChunkAllocator->getNoOfSlabsInUse();
+		const uint32_t uNoOfChunkSlabs = uNoOfSlabsInUse - (std::min)(m_uNoOfPreservedSlabs.load(), uNoOfSlabsInUse);
+		const uint32_t uNoOfAllocatedChunks = (std::min)(uNoOfChunkSlabs, uNoOfChunks);
+		return static_cast<uint64_t>(uNoOfAllocatedChunks) * m_pChunkAllocator->getSlabSizeInBytes()
+			+ static_cast<uint64_t>(uNoOfChunks) * sizeof(Chunk) + m_uPaletteSizeInBytes;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Evicts the least recently used chunks until the volume is within its memory limit for uncompressed chunks. Chunks which are referenced from elsewhere
+	/// (by a chunk cache, a sampler, or a thread which is still paging them in) are in use and so are skipped, but these are usually
+	/// near the front of the list. If palettes are enabled then chunks are packed into palettes where possible, and only evicted when
+	/// there are none left to pack. If compression is enabled the evicted chunks are moved to the compressed tier, and then the oldest
+	/// compressed chunks are evicted from that until it is within its own limit. The lock may be released while waiting for space
+	/// in the page-out queue. If there is no page-out queue then it is also released while the modified chunks are paged out.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::evictChunks(std::unique_lock<std::mutex>& lock) const
+	{
+		std::vector< std::shared_ptr<Chunk> > vecDeferredPageOuts;
+
+		const uint64_t uUncompressedSizeLimit = m_uChunkCountLimit * PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::calculateSizeInBytes(getChunkSideLength());
+		while (calculateUncompressedSizeInBytes() > uUncompressedSizeLimit)
+		{
+			// Packing a chunk into a palette frees most of its memory without losing it, so we do this first. The chunks are packed
+			// from the least recently used, and the cursor records how far we have got so they are not all checked every time.
+			if (m_bPalettesEnabled.load(std::memory_order_relaxed))
+			{
+				bool bPacked = false;
+				for (Chunk* pCandidate = m_pPackCursor ? m_pPackCursor->m_pMoreRecentChunk : m_pLeastRecentChunk; pCandidate; pCandidate = pCandidate->m_pMoreRecentChunk)
+				{
+					m_pPackCursor = pCandidate;
+					if ((m_arrayChunks[pCandidate->m_uChunkArrayIndex].use_count() == 1) && pCandidate->packPalette())
+					{
+						bPacked = true;
+						break;
+					}
+				}
+
+				if (bPacked)
+				{
+					continue;
+				}
+			}
+
+			Chunk* pVictim = nullptr;
+			for (Chunk* pCandidate = m_pLeastRecentChunk; pCandidate; pCandidate = pCandidate->m_pMoreRecentChunk)
+			{
+				if (m_arrayChunks[pCandidate->m_uChunkArrayIndex].use_count() == 1)
+				{
+					pVictim = pCandidate;
+					break;
+				}
+			}
+
+			if (!pVictim)
+			{
+				// Everything is in use, so we have to go over the limit for now.
+				break;
+			}
+
+			m_uNoOfEvictions++;
+
+			if (m_eChunkCompression != ChunkCompressions::None)
+			{
+				compressChunk(eraseChunk(pVictim->m_uChunkArrayIndex));
+			}
+			else if ((m_uMaxQueuedPageOuts > 0) && (pVictim->m_bDataModified))
+			{
+				if (m_vecQueuedPageOuts.size() >= m_uMaxQueuedPageOuts)
+				{
+					// Wait for the writer to catch up. Other threads may change the volume meanwhile, so we then choose again.
+					m_cvPageOut.wait(lock, [this]{ return m_vecQueuedPageOuts.size() < m_uMaxQueuedPageOuts; });
+					continue;
+				}
+
+				queuePageOut(eraseChunk(pVictim->m_uChunkArrayIndex));
+			}
+			else
+			{
+				deferPageOut(eraseChunk(pVictim->m_uChunkArrayIndex), vecDeferredPageOuts);
+			}
+		}
+
+		while ((m_uCompressedSizeInBytes > m_uCompressedSizeLimit) && (!m_listCompressedChunks.empty()))
+		{
+			if ((m_uMaxQueuedPageOuts > 0) && (m_listCompressedChunks.front().m_bDataModified) && (m_vecQueuedPageOuts.size() >= m_uMaxQueuedPageOuts))
+			{
+				// As above, but the compressed chunks may also have changed by the time we wake up.
+				m_cvPageOut.wait(lock, [this]{ return m_vecQueuedPageOuts.size() < m_uMaxQueuedPageOuts; });
+				continue;
+			}
+
+			deferPageOut(discardOldestCompressedChunk(), vecDeferredPageOuts);
+		}
+
+		if (!vecDeferredPageOuts.empty())
+		{
+			lock.unlock();
+			for (const auto& pDeferredChunk : vecDeferredPageOuts)
+			{
+				pageOutChunk(pDeferredChunk);
+			}
+			lock.lock();
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Hands a modified chunk (which has already been removed from the volume) to the writer thread to be paged out.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::queuePageOut(const std::shared_ptr<Chunk>& pChunk) const
+	{
+		pChunk->m_bPageOutQueued = true;
+		m_vecQueuedPageOuts.push_back(pChunk);
+
+		m_pPageOutThreadPool->enqueue([this, pChunk]()
+		{
+			pageOutChunk(pChunk);
+		});
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Prepares a chunk which has been removed from the volume to be paged out by the calling thread, once it has released the
+	/// chunk mutex. The chunk is put in the page-out queue (without using the writer thread) so that threads which want it wait
+	/// for the page-out to finish, rather than paging in the old data. Chunks which have not been modified are simply discarded.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::deferPageOut(const std::shared_ptr<Chunk>& pChunk, std::vector< std::shared_ptr<Chunk> >& vecDeferredPageOuts) const
+	{
+		if (pChunk && pChunk->m_bDataModified)
+		{
+			pChunk->m_bPageOutQueued = true;
+			m_vecQueuedPageOuts.push_back(pChunk);
+			vecDeferredPageOuts.push_back(pChunk);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Pages out a chunk which was queued by queuePageOut() or deferPageOut(). This runs on the writer thread, or on the thread
+	/// which deferred the page-out. The chunk mutex must not be held.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::pageOutChunk(const std::shared_ptr<Chunk>& pChunk) const
+	{
+		std::unique_lock<std::mutex> lock(m_mutexChunks);
+
+		// If the chunk has been brought back into the volume then it may be in use, so it will be paged out when next evicted.
+		if (!pChunk->m_bPageOutQueued)
+		{
+			return;
+		}
+
+		pChunk->m_bBeingPagedOut = true;
+		lock.unlock();
+
+		Vector3DInt32 v3dLower = pChunk->m_v3dChunkSpacePosition * static_cast<int32_t>(getChunkSideLength());
+		Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(getChunkSideLength() - 1, getChunkSideLength() - 1, getChunkSideLength() - 1);
+		bool bPagedOut = false;
+		try
+		{
+			Timer timer;
+			m_pPager->pageOut(Region(v3dLower, v3dUpper), pChunk.get());
+			m_uPageOutTimeInNanoSeconds += timer.elapsedTimeInNanoSeconds();
+			m_uNoOfPageOuts++;
+			bPagedOut = true;
+		}
+		catch (const std::exception& e)
+		{
+			// Other chunks may still need paging out, so the chunk is kept and paging it out is tried again by the next flush.
+			POLYVOX_LOG_ERROR("Failed to page out chunk data: ", e.what());
+		}
+
+		lock.lock();
+
+		// Threads which want the chunk wait for the page-out to finish before bringing it back, so nothing can have modified
+		// it meanwhile. If it was paged out then it can now be discarded.
+		POLYVOX_ASSERT(pChunk->m_bPageOutQueued, "A chunk which is being paged out should still be queued");
+		pChunk->m_bBeingPagedOut = false;
+		pChunk->m_bPageOutQueued = false;
+		m_vecQueuedPageOuts.erase(std::find(m_vecQueuedPageOuts.begin(), m_vecQueuedPageOuts.end(), pChunk));
+		if (bPagedOut)
+		{
+			pChunk->setDataModified(false);
+		}
+		else
+		{
+			m_vecFailedPageOuts.push_back(pChunk);
+		}
+
+		m_cvPageOut.notify_all();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Calculate the memory usage of the volume.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint64_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::calculateSizeInBytes(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+
+		// Note: We disregard the size of the volume's other members (such as the chunk array) as they are likely to be very
+		// small compared to the size of the chunks.
+		return calculateUncompressedSizeInBytes() + m_uCompressedSizeInBytes;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The counts of paging activity are totals since the volume was created, and are intended to help with choosing the target
+	/// memory usage and other settings. Each thread which accesses a thread safe volume has its own record of the last chunk it
+	/// accessed, and the cache hits and misses are summed over all of these.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Statistics PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getStatistics(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+
+		Statistics statistics;
+		statistics.uNoOfResidentChunks = m_uChunkCount;
+		statistics.uNoOfQueuedChunks = static_cast<uint32_t>(m_vecQueuedPageOuts.size() + m_vecFailedPageOuts.size());
+		statistics.uNoOfCompressedChunks = static_cast<uint32_t>(m_listCompressedChunks.size());
+		statistics.uNoOfDirtyChunks = m_uNoOfModifiedChunks + m_uNoOfModifiedCompressedChunks;
+		statistics.uNoOfPinnedChunks = m_uNoOfPinnedChunks;
+
+		// The page-out queue is short, so we can simply add up the sizes of the chunks in it.
+		for (const auto& pChunk : m_vecQueuedPageOuts)
+		{
+			statistics.uQueuedSizeInBytes += pChunk->calculateSizeInBytes();
+		}
+		for (const auto& pChunk : m_vecFailedPageOuts)
+		{
+			statistics.uQueuedSizeInBytes += pChunk->calculateSizeInBytes();
+		}
+		const uint64_t uUncompressedSizeInBytes = calculateUncompressedSizeInBytes();
+		statistics.uResidentSizeInBytes = uUncompressedSizeInBytes - (std::min)(statistics.uQueuedSizeInBytes, uUncompressedSizeInBytes);
+		statistics.uCompressedSizeInBytes = m_uCompressedSizeInBytes;
+
+		statistics.uNoOfChunkCacheHits = m_defaultChunkCache.m_uNoOfHits;
+		statistics.uNoOfChunkCacheMisses = m_defaultChunkCache.m_uNoOfMisses;
+		for (const auto& threadChunkCache : m_mapThreadChunkCaches)
+		{
+			statistics.uNoOfChunkCacheHits += threadChunkCache.second->m_uNoOfHits;
+			statistics.uNoOfChunkCacheMisses += threadChunkCache.second->m_uNoOfMisses;
+		}
+		const uint64_t uNoOfChunkCacheAccesses = statistics.uNoOfChunkCacheHits + statistics.uNoOfChunkCacheMisses;
+		statistics.fChunkCacheHitRate = (uNoOfChunkCacheAccesses > 0) ? static_cast<float>(statistics.uNoOfChunkCacheHits) / uNoOfChunkCacheAccesses : 0.0f;
+
+		statistics.uNoOfPageIns = m_uNoOfPageIns;
+		statistics.uPageInTimeInNanoSeconds = m_uPageInTimeInNanoSeconds;
+		statistics.uNoOfPageOuts = m_uNoOfPageOuts;
+		statistics.uPageOutTimeInNanoSeconds = m_uPageOutTimeInNanoSeconds;
+		statistics.uNoOfEvictions = m_uNoOfEvictions;
+
+		statistics.uNoOfSnapshots = static_cast<uint32_t>(m_vecSnapshots.size());
+		statistics.uSnapshotSizeInBytes = static_cast<uint64_t>(m_uNoOfPreservedSlabs) * m_pChunkAllocator->getSlabSizeInBytes()
+			+ static_cast<uint64_t>(m_uNoOfPreservedChunks) * sizeof(PreservedChunk);
+
+		const uint64_t uApronSideLength = getChunkSideLength() + 2;
+		statistics.uNoOfApronCopies = m_uNoOfApronCopies;
+		statistics.uApronSizeInBytes = static_cast<uint64_t>(m_uNoOfApronCopies) * (uApronSideLength * uApronSideLength * uApronSideLength * sizeof(VoxelType) + sizeof(ApronCopy));
+
+		statistics.uNoOfPaletteChunks = m_uNoOfPaletteChunks;
+		statistics.uPaletteSizeInBytes = m_uPaletteSizeInBytes;
+		return statistics;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Chunk data is allocated from a pool of cache-line aligned blocks, which are reused as chunks are paged in and out. On Linux
+	/// these blocks can be carved out of larger allocations which are backed by transparent huge pages, which can reduce the cost
+	/// of TLB misses when accessing large volumes. This only affects memory which is allocated after the call, and has no effect
+	/// on other platforms (see getChunkAllocatorStatistics() to check whether it is in use).
+	/// \param bUseHugePages Whether to request transparent huge pages for chunk data.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::setUseHugePages(bool bUseHugePages)
+	{
+		m_pChunkAllocator->setUseHugePages(bUseHugePages);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Memory which is released by evicted chunks is kept for reuse rather than being returned to the system, so the reserved size
+	/// reflects the largest amount of chunk data which has been needed at once.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	SlabAllocator::Statistics PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getChunkAllocatorStatistics(void) const
+	{
+		return m_pChunkAllocator->getStatistics();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Moves a chunk which has been removed from the volume into the compressed tier. The compressed copy becomes responsible for
+	/// paging out any modifications, so the chunk itself can then be discarded.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::compressChunk(const std::shared_ptr<Chunk>& pChunk) const
+	{
+		CompressedChunk compressedChunk;
+		compressedChunk.m_v3dChunkSpacePosition = pChunk->m_v3dChunkSpacePosition;
+		compressedChunk.m_bDataModified = pChunk->m_bDataModified;
+		compressedChunk.m_bUsesLZ = false;
+
+		const uint32_t uNoOfVoxels = getChunkSideLength() * getChunkSideLength() * getChunkSideLength();
+		if (pChunk->isUniform())
+		{
+			encodeUniformRLE(pChunk->m_tUniformValue, uNoOfVoxels, compressedChunk.m_vecData);
+		}
+		else
+		{
+			encodeRLE(pChunk->getData(), uNoOfVoxels, compressedChunk.m_vecData);
+		}
+
+		if ((m_eChunkCompression == ChunkCompressions::RLEAndLZ) && (!pChunk->isUniform()))
+		{
+			// The LZ stage can make data which has few repeated patterns larger, in which case we just keep the runs.
+			std::vector<uint8_t> vecCompressedRuns;
+			compressLZ(compressedChunk.m_vecData, vecCompressedRuns);
+			if (vecCompressedRuns.size() < compressedChunk.m_vecData.size())
+			{
+				compressedChunk.m_vecData.swap(vecCompressedRuns);
+				compressedChunk.m_bUsesLZ = true;
+			}
+		}
+
+		compressedChunk.m_vecData.shrink_to_fit();
+		pChunk->setDataModified(false);
+		if (compressedChunk.m_bDataModified)
+		{
+			m_uNoOfModifiedCompressedChunks++;
+		}
+
+		m_uCompressedSizeInBytes += compressedChunk.calculateSizeInBytes();
+		m_listCompressedChunks.push_back(std::move(compressedChunk));
+		m_mapCompressedChunks[pChunk->m_v3dChunkSpacePosition] = std::prev(m_listCompressedChunks.end());
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Fills a chunk with the data which was compressed by compressChunk(). Data consisting of a single run gives a uniform chunk.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::decompressChunk(const CompressedChunk& compressedChunk, Chunk* pChunk) const
+	{
+		const uint32_t uNoOfVoxels = getChunkSideLength() * getChunkSideLength() * getChunkSideLength();
+
+		std::vector<uint8_t> vecRuns;
+		if (compressedChunk.m_bUsesLZ)
+		{
+			decompressLZ(compressedChunk.m_vecData.data(), compressedChunk.m_vecData.size(), vecRuns);
+		}
+		const std::vector<uint8_t>& vecRunsToDecode = compressedChunk.m_bUsesLZ ? vecRuns : compressedChunk.m_vecData;
+
+		VoxelType tUniformValue;
+		if (decodeUniformRLE(vecRunsToDecode.data(), vecRunsToDecode.size(), uNoOfVoxels, tUniformValue))
+		{
+			pChunk->fill(tUniformValue);
+		}
+		else
+		{
+			decodeRLE(vecRunsToDecode.data(), vecRunsToDecode.size(), pChunk->getData(), uNoOfVoxels);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Removes the chunk which has been in the compressed tier the longest. If it has been modified then it is decompressed and
+	/// passed to the Pager, either via the page-out queue (which the caller must ensure has space, if required) or by destroying
+	/// the returned chunk. The caller should do that after releasing the chunk mutex.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	std::shared_ptr<typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk> PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::discardOldestCompressedChunk(void) const
+	{
+		const CompressedChunk& compressedChunk = m_listCompressedChunks.front();
+
+		std::shared_ptr<Chunk> pChunk;
+		if (compressedChunk.m_bDataModified)
+		{
+			// Marking the chunk as modified means it will be paged out once we release it.
+			pChunk = createChunk(compressedChunk.m_v3dChunkSpacePosition);
+			decompressChunk(compressedChunk, pChunk.get());
+			pChunk->setDataModified(true);
+			pChunk->m_bLoaded = true;
+		}
+
+		if (compressedChunk.m_bDataModified)
+		{
+			m_uNoOfModifiedCompressedChunks--;
+		}
+
+		m_uCompressedSizeInBytes -= compressedChunk.calculateSizeInBytes();
+		m_mapCompressedChunks.erase(compressedChunk.m_v3dChunkSpacePosition);
+		m_listCompressedChunks.pop_front();
+
+		if (pChunk && (m_uMaxQueuedPageOuts > 0))
+		{
+			queuePageOut(pChunk);
+			pChunk = nullptr;
+		}
+
+		return pChunk;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Computes a hash of a chunk position. All bits of each coordinate contribute to the lower bits of the result,
+	/// which means the hash can be masked to the size of the chunk array.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint32_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::hashChunkPosition(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ)
+	{
+		// Combine the coordinates using large primes, and then mix the result so that the upper bits also affect the lower ones.
+		uint32_t uHash = (static_cast<uint32_t>(iChunkX) * 73856093u) ^ (static_cast<uint32_t>(iChunkY) * 19349663u) ^ (static_cast<uint32_t>(iChunkZ) * 83492791u);
+		uHash ^= uHash >> 16;
+		uHash *= 0x85ebca6bu;
+		uHash ^= uHash >> 13;
+		return uHash;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns the index of the chunk with the given position in the chunk array, or uInvalidChunkIndex if there is no such chunk.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint32_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::findChunk(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const
+	{
+		// Starting at the position indicated by the hash, search forwards until we find the chunk or an empty slot. Because
+		// the array is kept at most half full (and deleting a chunk closes the gap it leaves) the search is usually very short.
+		const uint32_t uMask = static_cast<uint32_t>(m_arrayChunks.size()) - 1;
+		uint32_t uIndex = hashChunkPosition(iChunkX, iChunkY, iChunkZ) & uMask;
+		while (m_arrayChunks[uIndex])
+		{
+			const Vector3DInt32& entryPos = m_arrayChunks[uIndex]->m_v3dChunkSpacePosition;
+			if (entryPos.getX() == iChunkX && entryPos.getY() == iChunkY && entryPos.getZ() == iChunkZ)
+			{
+				return uIndex;
+			}
+
+			uIndex = (uIndex + 1) & uMask;
+		}
+
+		return uInvalidChunkIndex;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Adds a chunk to the chunk array, and to the front of the list of chunks. The chunk must not already be present.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::insertChunk(const std::shared_ptr<Chunk>& pChunk) const
+	{
+		// Conventional wisdom is that a hash-table using linear probing should not be more than half full.
+		if ((m_uChunkCount + 1) * 2 > m_arrayChunks.size())
+		{
+			resizeChunkArray(static_cast<uint32_t>(m_arrayChunks.size()) * 2);
+		}
+
+		const uint32_t uMask = static_cast<uint32_t>(m_arrayChunks.size()) - 1;
+		const Vector3DInt32& v3dPos = pChunk->m_v3dChunkSpacePosition;
+		uint32_t uIndex = hashChunkPosition(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ()) & uMask;
+		uint32_t uProbeLength = 0;
+		while (m_arrayChunks[uIndex])
+		{
+			uIndex = (uIndex + 1) & uMask;
+			uProbeLength++;
+		}
+
+		m_arrayChunks[uIndex] = pChunk;
+		pChunk->m_uChunkArrayIndex = uIndex;
+		linkChunk(pChunk.get());
+		m_uChunkCount++;
+
+		// A long probe sequence means that chunks have clustered together in part of the array. Growing the array spreads
+		// them out again, but we don't let a few unlucky positions make the array grow without limit.
+		if ((uProbeLength > uMaxProbeLength) && (m_uChunkCount * 8 > m_arrayChunks.size()))
+		{
+			resizeChunkArray(static_cast<uint32_t>(m_arrayChunks.size()) * 2);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Moves all chunks into a new chunk array of the given size, which must be a power of two.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::resizeChunkArray(uint32_t uNewSize) const
+	{
+		POLYVOX_ASSERT(isPowerOf2(uNewSize), "Chunk array size must be a power of two");
+		POLYVOX_ASSERT(uNewSize >= m_uChunkCount * 2, "Chunk array is too small for the number of chunks");
+
+		std::vector< std::shared_ptr< Chunk > > arrayOldChunks(uNewSize);
+		arrayOldChunks.swap(m_arrayChunks);
+
+		const uint32_t uMask = uNewSize - 1;
+		for (auto& pChunk : arrayOldChunks)
+		{
+			if (pChunk)
+			{
+				const Vector3DInt32& v3dPos = pChunk->m_v3dChunkSpacePosition;
+				uint32_t uIndex = hashChunkPosition(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ()) & uMask;
+				while (m_arrayChunks[uIndex])
+				{
+					uIndex = (uIndex + 1) & uMask;
+				}
+
+				pChunk->m_uChunkArrayIndex = uIndex;
+				m_arrayChunks[uIndex] = std::move(pChunk);
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Pinned chunks may use the memory for all but uMinPracticalNoOfChunks of the uncompressed chunks, which leaves enough
+	/// space for other accesses to load a chunk and its neighbours.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint32_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getMaxNoOfPinnedChunks(void) const
+	{
+		return m_uChunkCountLimit - uMinPracticalNoOfChunks;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Releases the pins which a PinnedRegion holds on its chunks. Chunks which are no longer pinned by any region go back
+	/// into the list as the most recently used, and can then be evicted if the volume is over its memory limit.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::unpinChunks(std::vector< std::shared_ptr<Chunk> >& vecChunks)
+	{
+		std::unique_lock<std::mutex> lock(m_mutexChunks);
+
+		for (const auto& pChunk : vecChunks)
+		{
+			if (--(pChunk->m_uNoOfPins) == 0)
+			{
+				linkChunk(pChunk.get());
+				m_uNoOfPinnedChunks--;
+			}
+		}
+
+		// Our references would stop the chunks from being evicted.
+		vecChunks.clear();
+		evictChunks(lock);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Moves the changes which have been recorded in the chunks into the change tracker. The chunk mutex must be held.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::collectChanges(void) const
+	{
+		for (auto& pChunk : m_arrayChunks)
+		{
+			if (pChunk)
+			{
+				collectChunkChanges(pChunk.get());
+			}
+		}
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::collectChunkChanges(Chunk* pChunk) const
+	{
+		// Another thread may be writing to the chunk, in which case its change will either be collected now or left for next time.
+		const uint64_t uChangedBounds = pChunk->m_uChangedBounds.exchange(0, std::memory_order_relaxed);
+		if (uChangedBounds != 0)
+		{
+			const Vector3DInt32& v3dChunkPos = pChunk->m_v3dChunkSpacePosition;
+			m_changeTracker.addChanges(v3dChunkPos, ChangeTracker::unpackBounds(uChangedBounds, v3dChunkPos * static_cast<int32_t>(getChunkSideLength())));
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns the apron copy of the given chunk, making it if it doesn't exist yet. The caller must hold a reference to the chunk.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	std::shared_ptr<typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::ApronCopy> PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getApronCopy(Chunk* pChunk) const
+	{
+		std::shared_ptr<ApronCopy> pApronCopy = std::atomic_load(&(pChunk->m_pApronCopy));
+		if (pApronCopy)
+		{
+			return pApronCopy;
+		}
+
+		// Aprons are only enabled for volumes which are used by one thread, so nothing can write to the voxels while we read them.
+		// The pointer is still accessed atomically, because prefetching threads may evict the chunk and discard its copy.
+		const Region regApron = getApronRegion(pChunk->m_v3dChunkSpacePosition);
+		pApronCopy = std::make_shared<ApronCopy>(this, static_cast<uint32_t>(regApron.getWidthInVoxels() * regApron.getHeightInVoxels() * regApron.getDepthInVoxels()));
+		readRegion(regApron, pApronCopy->m_vecData.data());
+		std::atomic_store(&(pChunk->m_pApronCopy), pApronCopy);
+		return pApronCopy;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Writes a voxel which has just been set in the given chunk into the apron copies which contain it. As well as the chunk's own
+	/// copy, a voxel on the face of a chunk is in the aprons of the neighbouring chunks which touch that face (or edge, or corner).
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::updateApronCopies(Chunk* pChunk, uint16_t uXPos, uint16_t uYPos, uint16_t uZPos, const VoxelType& tValue) const
+	{
+		const int32_t iApronSideLength = getChunkSideLength() + 2;
+		std::shared_ptr<ApronCopy> pApronCopy = std::atomic_load(&(pChunk->m_pApronCopy));
+		if (pApronCopy)
+		{
+			pApronCopy->m_vecData[(uXPos + 1) + (uYPos + 1) * iApronSideLength + (uZPos + 1) * iApronSideLength * iApronSideLength] = tValue;
+		}
+
+		const int32_t iMinDeltaX = (uXPos == 0) ? -1 : 0;
+		const int32_t iMinDeltaY = (uYPos == 0) ? -1 : 0;
+		const int32_t iMinDeltaZ = (uZPos == 0) ? -1 : 0;
+		const int32_t iMaxDeltaX = (uXPos == getChunkMask()) ? 1 : 0;
+		const int32_t iMaxDeltaY = (uYPos == getChunkMask()) ? 1 : 0;
+		const int32_t iMaxDeltaZ = (uZPos == getChunkMask()) ? 1 : 0;
+		if ((iMinDeltaX == iMaxDeltaX) && (iMinDeltaY == iMaxDeltaY) && (iMinDeltaZ == iMaxDeltaZ))
+		{
+			// The voxel is inside the chunk.
+			return;
+		}
+
+		// Neighbours which are not in memory don't have copies, and they will see this voxel if they are paged in and copied later.
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+		const Vector3DInt32& v3dChunkPos = pChunk->m_v3dChunkSpacePosition;
+		for (int32_t iDeltaZ = iMinDeltaZ; iDeltaZ <= iMaxDeltaZ; iDeltaZ++)
+		{
+			for (int32_t iDeltaY = iMinDeltaY; iDeltaY <= iMaxDeltaY; iDeltaY++)
+			{
+				for (int32_t iDeltaX = iMinDeltaX; iDeltaX <= iMaxDeltaX; iDeltaX++)
+				{
+					if ((iDeltaX == 0) && (iDeltaY == 0) && (iDeltaZ == 0))
+					{
+						continue;
+					}
+
+					const uint32_t uIndex = findChunk(v3dChunkPos.getX() + iDeltaX, v3dChunkPos.getY() + iDeltaY, v3dChunkPos.getZ() + iDeltaZ);
+					if (uIndex == uInvalidChunkIndex)
+					{
+						continue;
+					}
+
+					std::shared_ptr<ApronCopy> pNeighbourApronCopy = std::atomic_load(&(m_arrayChunks[uIndex]->m_pApronCopy));
+					if (pNeighbourApronCopy)
+					{
+						// The position of the voxel relative to the neighbour, plus one for the apron.
+						const int32_t iApronX = uXPos - (iDeltaX << getChunkSideLengthPower()) + 1;
+						const int32_t iApronY = uYPos - (iDeltaY << getChunkSideLengthPower()) + 1;
+						const int32_t iApronZ = uZPos - (iDeltaZ << getChunkSideLengthPower()) + 1;
+						pNeighbourApronCopy->m_vecData[iApronX + iApronY * iApronSideLength + iApronZ * iApronSideLength * iApronSideLength] = tValue;
+					}
+				}
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Reads the voxels of every apron copy which overlaps the given region again, after the region has been written in bulk.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::refreshApronCopies(const Region& region) const
+	{
+		// We can't read the voxels while holding the chunk mutex, so the copies are gathered first.
+		std::vector< std::pair<Region, std::shared_ptr<ApronCopy> > > vecApronCopies;
+		{
+			std::lock_guard<std::mutex> lock(m_mutexChunks);
+
+			Region regChunks = region;
+			regChunks.grow(1);
+			for (int32_t iChunkZ = regChunks.getLowerZ() >> getChunkSideLengthPower(); iChunkZ <= (regChunks.getUpperZ() >> getChunkSideLengthPower()); iChunkZ++)
+			{
+				for (int32_t iChunkY = regChunks.getLowerY() >> getChunkSideLengthPower(); iChunkY <= (regChunks.getUpperY() >> getChunkSideLengthPower()); iChunkY++)
+				{
+					for (int32_t iChunkX = regChunks.getLowerX() >> getChunkSideLengthPower(); iChunkX <= (regChunks.getUpperX() >> getChunkSideLengthPower()); iChunkX++)
+					{
+						const uint32_t uIndex = findChunk(iChunkX, iChunkY, iChunkZ);
+						if (uIndex != uInvalidChunkIndex)
+						{
+							std::shared_ptr<ApronCopy> pApronCopy = std::atomic_load(&(m_arrayChunks[uIndex]->m_pApronCopy));
+							if (pApronCopy)
+							{
+								vecApronCopies.push_back(std::make_pair(getApronRegion(Vector3DInt32(iChunkX, iChunkY, iChunkZ)), std::move(pApronCopy)));
+							}
+						}
+					}
+				}
+			}
+		}
+
+		for (const auto& apronCopy : vecApronCopies)
+		{
+			readRegion(apronCopy.first, apronCopy.second->m_vecData.data());
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns the region covered by the apron copy of the chunk at the given position (in chunk space).
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	Region PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getApronRegion(const Vector3DInt32& v3dChunkPos) const
+	{
+		const Vector3DInt32 v3dLowerCorner = v3dChunkPos * static_cast<int32_t>(getChunkSideLength());
+		Region regApron(v3dLowerCorner, v3dLowerCorner + Vector3DInt32(getChunkMask(), getChunkMask(), getChunkMask()));
+		regApron.grow(1);
+		return regApron;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns the part of the given region which lies in the given chunk.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	Region PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getChunkRegion(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ, const Region& region) const
+	{
+		const Vector3DInt32 v3dLowerCorner(iChunkX << getChunkSideLengthPower(), iChunkY << getChunkSideLengthPower(), iChunkZ << getChunkSideLengthPower());
+		Region regChunk(v3dLowerCorner, v3dLowerCorner + Vector3DInt32(getChunkMask(), getChunkMask(), getChunkMask()));
+		regChunk.cropTo(region);
+		return regChunk;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::isUniformRegion(const Region& region, const VoxelType* pSrc, size_t uStrideX, size_t uStrideY, size_t uStrideZ, const VoxelType& tValue)
+	{
+		for (int32_t z = 0; z < region.getDepthInVoxels(); z++)
+		{
+			for (int32_t y = 0; y < region.getHeightInVoxels(); y++)
+			{
+				const VoxelType* pSrcRow = pSrc + y * uStrideY + z * uStrideZ;
+				for (int32_t x = 0; x < region.getWidthInVoxels(); x++)
+				{
+					if (!isBytewiseEqual(*pSrcRow, tValue))
+					{
+						return false;
+					}
+					pSrcRow += uStrideX;
+				}
+			}
+		}
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Releases a chunk's data so that every voxel has the given value. Unlike Chunk::fill() this is safe while samplers are in the
+	/// chunk. They may still be pointing at the old data, so in this case the chunk holds on to it until they have left (as it does
+	/// when the data is replaced for a snapshot).
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::makeChunkUniform(Chunk* pChunk, const VoxelType& tValue) const
+	{
+		// Readers which see the data pointer become null will read the uniform value instead, so it must be set first.
+		const VoxelType tOldUniformValue = pChunk->m_tUniformValue;
+		pChunk->m_tUniformValue = tValue;
+
+		// Samplers never point into a palette, so it can simply be released.
+		{
+			std::lock_guard<std::mutex> paletteLock(pChunk->m_mutexPalette);
+			pChunk->replacePalette(nullptr);
+		}
+
+		// A sampler entering the chunk increments the count before it reads the data pointer, so either it sees the null or we see it.
+		VoxelType* pData = pChunk->m_tData.exchange(nullptr, std::memory_order_seq_cst);
+		if (!pData)
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+		if (pChunk->m_uNoOfSamplers.load(std::memory_order_seq_cst) > 0)
+		{
+			pChunk->m_vecRetainedChunks.push_back(std::make_shared<PreservedChunk>(this, pData, tOldUniformValue));
+		}
+		else
+		{
+			pChunk->m_vecRetainedChunks.clear();
+			pChunk->freeData(pData);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Called before the first write to a chunk since the latest snapshot was taken. Every snapshot which is newer than the last
+	/// time this was called for the chunk is given the chunk's current contents, unless it already has an earlier copy (from
+	/// before the chunk was evicted and paged in again). The snapshots which need a copy all share the same one.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::preserveChunkForSnapshots(Chunk* pChunk) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutexChunks);
+
+		const Vector3DInt32& v3dChunkPos = pChunk->m_v3dChunkSpacePosition;
+		const uint64_t uChunkEpoch = pChunk->m_uSnapshotEpoch.load(std::memory_order_relaxed);
+
+		std::shared_ptr<const PreservedChunk> pPreservedChunk;
+		for (auto pSnapshot : m_vecSnapshots)
+		{
+			if ((pSnapshot->m_uEpoch > uChunkEpoch) && (pSnapshot->m_mapPreservedChunks.find(v3dChunkPos) == pSnapshot->m_mapPreservedChunks.end()))
+			{
+				if (!pPreservedChunk)
+				{
+					pPreservedChunk = preserveChunk(pChunk);
+				}
+				pSnapshot->m_mapPreservedChunks[v3dChunkPos] = pPreservedChunk;
+			}
+		}
+
+		if (pChunk->m_uNoOfSamplers == 0)
+		{
+			pChunk->m_vecRetainedChunks.clear();
+		}
+
+		// Writers which see the new epoch can skip the above, so the copy must be complete before they do.
+		pChunk->m_uSnapshotEpoch.store(m_uSnapshotEpoch, std::memory_order_release);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Makes a copy of a chunk's contents for one or more snapshots. Usually the snapshots get the copy and the chunk keeps its
+	/// data, but if a snapshot is already reading the data then it must not change. In this case the snapshots keep the data and
+	/// the chunk gets the copy instead. Samplers of the volume might also be pointing at the data (they continue to see it until they
+	/// leave the chunk, as they do for any other change made after they enter it) so the chunk also holds on to it while they exist.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	std::shared_ptr<const typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PreservedChunk> PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::preserveChunk(Chunk* pChunk) const
+	{
+		const Palette* pPalette = nullptr;
+		VoxelType* pData = pChunk->loadData(pPalette);
+		if (!pData)
+		{
+			// Snapshots never read a palette directly (see setSnapshotChunk()), so they can just be given a copy of its voxels.
+			return std::make_shared<PreservedChunk>(this, pPalette ? pChunk->decodePalette(*pPalette) : nullptr, pChunk->m_tUniformValue);
+		}
+
+		VoxelType* pCopiedData = pChunk->copyData();
+		if (pChunk->m_uNoOfSnapshotReaders == 0)
+		{
+			return std::make_shared<PreservedChunk>(this, pCopiedData, pChunk->m_tUniformValue);
+		}
+
+		auto pPreservedChunk = std::make_shared<PreservedChunk>(this, pData, pChunk->m_tUniformValue);
+
+		// A sampler entering the chunk increments the count before it reads the data pointer, so either it sees the new data or we see it.
+		pChunk->m_tData.store(pCopiedData, std::memory_order_seq_cst);
+		if (pChunk->m_uNoOfSamplers.load(std::memory_order_seq_cst) > 0)
+		{
+			pChunk->m_vecRetainedChunks.push_back(pPreservedChunk);
+		}
+
+		return pPreservedChunk;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Points a snapshot at the data it should use for the given chunk. This is the copy which was made for it when the chunk was
+	/// written to, or the chunk in the volume if it has not been written to since the snapshot was taken.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::setSnapshotChunk(const PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>& snapshot, int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const
+	{
+		std::unique_lock<std::mutex> lock(m_mutexChunks);
+		releaseSnapshotChunk(snapshot);
+
+		const Vector3DInt32 v3dChunkPos(iChunkX, iChunkY, iChunkZ);
+		auto iterPreserved = snapshot.m_mapPreservedChunks.find(v3dChunkPos);
+		if (iterPreserved == snapshot.m_mapPreservedChunks.end())
+		{
+			// The chunk may have to be paged in, which is done without holding the lock. It could be written to meanwhile, in
+			// which case the snapshot will have been given a copy of it.
+			lock.unlock();
+			std::shared_ptr<Chunk> pChunk = acquireChunk(iChunkX, iChunkY, iChunkZ);
+			lock.lock();
+
+			iterPreserved = snapshot.m_mapPreservedChunks.find(v3dChunkPos);
+			if (iterPreserved == snapshot.m_mapPreservedChunks.end())
+			{
+				// While we are registered as a reader the next write to the chunk will leave this data for us (see preserveChunk()).
+				pChunk->m_uNoOfSnapshotReaders++;
+				snapshot.m_pLiveChunk = pChunk;
+				// Snapshots read the data directly, so a palette has to be expanded.
+				snapshot.m_pChunkData = pChunk->isUniform() ? nullptr : pChunk->getData();
+				snapshot.m_tChunkUniformValue = pChunk->m_tUniformValue;
+			}
+		}
+
+		if (iterPreserved != snapshot.m_mapPreservedChunks.end())
+		{
+			snapshot.m_pPreservedChunk = iterPreserved->second;
+			snapshot.m_pChunkData = iterPreserved->second->m_pData;
+			snapshot.m_tChunkUniformValue = iterPreserved->second->m_tUniformValue;
+		}
+
+		snapshot.m_iChunkX = iChunkX;
+		snapshot.m_iChunkY = iChunkY;
+		snapshot.m_iChunkZ = iChunkZ;
+		snapshot.m_bHasChunk = true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Releases the chunk which a snapshot was reading. The caller must hold the chunk mutex.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::releaseSnapshotChunk(const PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>& snapshot) const
+	{
+		if (snapshot.m_pLiveChunk)
+		{
+			snapshot.m_pLiveChunk->m_uNoOfSnapshotReaders--;
+			snapshot.m_pLiveChunk = nullptr;
+		}
+
+		snapshot.m_pPreservedChunk = nullptr;
+		snapshot.m_pChunkData = nullptr;
+		snapshot.m_bHasChunk = false;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Called when a snapshot is destroyed. Its copies of chunks are released after the lock, as this may free their data.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::releaseSnapshot(PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>& snapshot) const
+	{
+		std::unordered_map<Vector3DInt32, std::shared_ptr<const PreservedChunk>, ChunkPositionHasher> mapPreservedChunks;
+		std::vector< std::shared_ptr<const PreservedChunk> > vecRetainedChunks;
+		{
+			std::lock_guard<std::mutex> lock(m_mutexChunks);
+
+			releaseSnapshotChunk(snapshot);
+			m_vecSnapshots.erase(std::find(m_vecSnapshots.begin(), m_vecSnapshots.end(), &snapshot));
+			mapPreservedChunks.swap(snapshot.m_mapPreservedChunks);
+
+			// Once the last snapshot has gone nothing else will clear out the data which chunks are holding on to for samplers,
+			// so do it now for any chunk which no longer has a sampler in it. Chunks which still do keep theirs until they are next written.
+			if (m_vecSnapshots.empty())
+			{
+				for (auto& pChunk : m_arrayChunks)
+				{
+					if (pChunk && !pChunk->m_vecRetainedChunks.empty() && (pChunk->m_uNoOfSamplers.load() == 0))
+					{
+						std::move(pChunk->m_vecRetainedChunks.begin(), pChunk->m_vecRetainedChunks.end(), std::back_inserter(vecRetainedChunks));
+						pChunk->m_vecRetainedChunks.clear();
+					}
+				}
+			}
+		}
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PreservedChunk::PreservedChunk(const PagedVolume* pVolume, VoxelType* pData, const VoxelType& tUniformValue)
+		:m_pVolume(pVolume)
+		, m_pData(pData)
+		, m_tUniformValue(tUniformValue)
+	{
+		m_pVolume->m_uNoOfPreservedChunks++;
+		if (m_pData)
+		{
+			m_pVolume->m_uNoOfPreservedSlabs++;
+		}
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PreservedChunk::~PreservedChunk()
+	{
+		if (m_pData)
+		{
+			const uint32_t uNoOfVoxels = m_pVolume->getChunkSideLength() * m_pVolume->getChunkSideLength() * m_pVolume->getChunkSideLength();
+			for (uint32_t uVoxel = 0; uVoxel < uNoOfVoxels; uVoxel++)
+			{
+				m_pData[uVoxel].~VoxelType();
+			}
+
+			m_pVolume->m_pChunkAllocator->deallocate(m_pData);
+			m_pVolume->m_uNoOfPreservedSlabs--;
+		}
+
+		m_pVolume->m_uNoOfPreservedChunks--;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::ApronCopy::ApronCopy(const PagedVolume* pVolume, uint32_t uNoOfVoxels)
+		:m_pVolume(pVolume)
+		, m_vecData(uNoOfVoxels)
+	{
+		m_pVolume->m_uNoOfApronCopies++;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::ApronCopy::~ApronCopy()
+	{
+		m_pVolume->m_uNoOfApronCopies--;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Palette::Palette(const PagedVolume* pVolume, uint8_t uIndexBitsPower, uint32_t uNoOfVoxels)
+		:m_pVolume(pVolume)
+		, m_uNoOfWords(0)
+		, m_uIndexBitsPower(uIndexBitsPower)
+		, m_uIndicesPerWordPower(static_cast<uint8_t>(5 - uIndexBitsPower))
+		, m_uIndicesPerWordMinusOne((1u << (5 - uIndexBitsPower)) - 1)
+		, m_uIndexMask((1u << (1 << uIndexBitsPower)) - 1)
+		, m_uNoOfValues(0)
+	{
+		POLYVOX_ASSERT(uIndexBitsPower <= 3, "Palette indices cannot have more than 8 bits.");
+
+		m_uNoOfWords = (uNoOfVoxels + m_uIndicesPerWordMinusOne) >> m_uIndicesPerWordPower;
+		m_arrayValues.reset(new VoxelType[getCapacity()]);
+		m_arrayWords.reset(new std::atomic<uint32_t>[m_uNoOfWords]);
+		for (uint32_t uWord = 0; uWord < m_uNoOfWords; uWord++)
+		{
+			m_arrayWords[uWord].store(0, std::memory_order_relaxed);
+		}
+
+		m_pVolume->m_uPaletteSizeInBytes += calculateSizeInBytes();
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Palette::~Palette()
+	{
+		m_pVolume->m_uPaletteSizeInBytes -= calculateSizeInBytes();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Sets the index of a voxel's value. Only one thread may write to the palette at a time, but others can read it meanwhile.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Palette::setIndex(uint32_t uVoxelIndex, uint32_t uIndex)
+	{
+		std::atomic<uint32_t>& uWord = m_arrayWords[uVoxelIndex >> m_uIndicesPerWordPower];
+		const uint8_t uShift = static_cast<uint8_t>((uVoxelIndex & m_uIndicesPerWordMinusOne) << m_uIndexBitsPower);
+		const uint32_t uOldWord = uWord.load(std::memory_order_relaxed);
+		uWord.store((uOldWord & ~(m_uIndexMask << uShift)) | (uIndex << uShift), std::memory_order_release);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns the index of the value in the palette, or the number of values if it is not there.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint32_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Palette::findValue(const VoxelType& tValue) const
+	{
+		uint32_t uIndex = 0;
+		while ((uIndex < m_uNoOfValues) && !isBytewiseEqual(m_arrayValues[uIndex], tValue))
+		{
+			uIndex++;
+		}
+		return uIndex;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint64_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Palette::calculateSizeInBytes(void) const
+	{
+		return sizeof(Palette) + static_cast<uint64_t>(getCapacity()) * sizeof(VoxelType) + static_cast<uint64_t>(m_uNoOfWords) * sizeof(uint32_t);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Adds a chunk to the front of the list of chunks, making it the most recently used.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::linkChunk(Chunk* pChunk) const
+	{
+		pChunk->m_pMoreRecentChunk = nullptr;
+		pChunk->m_pLessRecentChunk = m_pMostRecentChunk;
+
+		if (m_pMostRecentChunk)
+		{
+			m_pMostRecentChunk->m_pMoreRecentChunk = pChunk;
+		}
+		else
+		{
+			m_pLeastRecentChunk = pChunk;
+		}
+
+		m_pMostRecentChunk = pChunk;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Removes a chunk from the list of chunks, without affecting the chunk array.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::unlinkChunk(Chunk* pChunk) const
+	{
+		if (pChunk == m_pPackCursor)
+		{
+			m_pPackCursor = pChunk->m_pLessRecentChunk;
+		}
+
+		if (pChunk->m_pMoreRecentChunk)
+		{
+			pChunk->m_pMoreRecentChunk->m_pLessRecentChunk = pChunk->m_pLessRecentChunk;
+		}
+		else
+		{
+			m_pMostRecentChunk = pChunk->m_pLessRecentChunk;
+		}
+
+		if (pChunk->m_pLessRecentChunk)
+		{
+			pChunk->m_pLessRecentChunk->m_pMoreRecentChunk = pChunk->m_pMoreRecentChunk;
+		}
+		else
+		{
+			m_pLeastRecentChunk = pChunk->m_pMoreRecentChunk;
+		}
+
+		pChunk->m_pMoreRecentChunk = nullptr;
+		pChunk->m_pLessRecentChunk = nullptr;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Removes a chunk from the volume and returns it. The chunk is destroyed (and so paged out) if the caller discards the
+	/// returned pointer and nothing else is referencing it.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	std::shared_ptr<typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk> PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::eraseChunk(uint32_t uChunkIndex) const
+	{
+		POLYVOX_ASSERT(m_arrayChunks[uChunkIndex], "Attempting to erase a chunk which does not exist");
+
+		// Take the chunk out of the array. It is only destroyed after the array is consistent again.
+		std::shared_ptr<Chunk> pErasedChunk = std::move(m_arrayChunks[uChunkIndex]);
+		unlinkChunk(pErasedChunk.get());
+		m_uChunkCount--;
+
+		// The volume keeps the changes which were recorded in the chunk, as they are still needed after its data has gone.
+		collectChunkChanges(pErasedChunk.get());
+
+		// Writes to the chunk's neighbours can't find it to keep its apron copy up to date, so the copy is made again if the chunk returns.
+		std::atomic_store(&(pErasedChunk->m_pApronCopy), std::shared_ptr<ApronCopy>());
+
+		// Chunks which follow the erased one in the array may have been placed there because their preferred slot was taken. These
+		// are moved back to fill the gap (when that does not take them before their preferred slot), so lookups can still stop at
+		// the first empty slot and we don't need to leave markers for deleted chunks.
+		const uint32_t uMask = static_cast<uint32_t>(m_arrayChunks.size()) - 1;
+		uint32_t uEmptyIndex = uChunkIndex;
+		uint32_t uIndex = (uChunkIndex + 1) & uMask;
+		while (m_arrayChunks[uIndex])
+		{
+			const Vector3DInt32& v3dPos = m_arrayChunks[uIndex]->m_v3dChunkSpacePosition;
+			const uint32_t uPreferredIndex = hashChunkPosition(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ()) & uMask;
+			if (((uIndex - uPreferredIndex) & uMask) >= ((uIndex - uEmptyIndex) & uMask))
+			{
+				m_arrayChunks[uEmptyIndex] = std::move(m_arrayChunks[uIndex]);
+				m_arrayChunks[uEmptyIndex]->m_uChunkArrayIndex = uEmptyIndex;
+				uEmptyIndex = uIndex;
+			}
+
+			uIndex = (uIndex + 1) & uMask;
+		}
+
+		return pErasedChunk;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::isThreadSafe(void) const
+	{
+		return m_bThreadSafe;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint16_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getChunkSideLength(void) const
+	{
+		return (ChunkSideLength != 0) ? ChunkSideLength : m_uChunkSideLength;
 	}
 }
 
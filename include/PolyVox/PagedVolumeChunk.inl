@@ -22,51 +22,52 @@
 * SOFTWARE.
 *******************************************************************************/
 
-#include "Impl/Morton.h"
 #include "Impl/Utility.h"
 
+#include <type_traits>
+
 namespace PolyVox
 {
-	template <typename VoxelType>
-	PagedVolume<VoxelType>::Chunk::Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager)
-		:m_uChunkLastAccessed(0)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager)
+		:m_pMoreRecentChunk(nullptr)
+		, m_pLessRecentChunk(nullptr)
+		, m_uChunkArrayIndex(0)
 		, m_bDataModified(true)
-		, m_tData(0)
+		, m_bLoaded(false)
+		, m_bLoadFailed(false)
+		, m_bPageOutQueued(false)
+		, m_bBeingPagedOut(false)
+		, m_uNoOfPins(0)
+		, m_uSnapshotEpoch(0)
+		, m_uNoOfSnapshotReaders(0)
+		, m_uNoOfSamplers(0)
+		, m_uChangedBounds(0)
+		, m_tData(nullptr)
+		, m_tUniformValue()
+		, m_pAllocator(nullptr)
+		, m_pVolume(nullptr)
 		, m_uSideLength(0)
 		, m_uSideLengthPower(0)
 		, m_pPager(pPager)
 		, m_v3dChunkSpacePosition(v3dPosition)
+		, m_pPalette(nullptr)
+		, m_uPaletteVersion(0)
 	{
 		POLYVOX_ASSERT(m_pPager, "No valid pager supplied to chunk constructor.");
 		POLYVOX_ASSERT(uSideLength <= 256, "Chunk side length cannot be greater than 256.");
+		POLYVOX_ASSERT(uSideLength >= ChunkLayout::uMinChunkSideLength, "Chunk side length is too small for the chunk layout.");
 
 		// Compute the side length               
 		m_uSideLength = uSideLength;
 		m_uSideLengthPower = logBase2(uSideLength);
 
-		// Allocate the data
-		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
-		m_tData = new VoxelType[uNoOfVoxels];
-
-		// Pass the chunk to the Pager to give it a chance to initialise it with any data
-		// From the coordinates of the chunk we deduce the coordinates of the contained voxels.
-		Vector3DInt32 v3dLower = m_v3dChunkSpacePosition * static_cast<int32_t>(m_uSideLength);
-		Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(m_uSideLength - 1, m_uSideLength - 1, m_uSideLength - 1);
-		Region reg(v3dLower, v3dUpper);
-
-		// A valid pager is normally present - this check is mostly to ease unit testing.
-		if (m_pPager)
-		{
-			// Page the data in
-			m_pPager->pageIn(reg, this);
-		}
-
-		// We'll use this later to decide if data needs to be paged out again.
-		m_bDataModified = false;
+		// The chunk starts out uniform, so no data is allocated yet. It is initialised by the volume, which passes the chunk to the
+		// Pager once it has been added to the chunk array. This allows the paging to happen without blocking other threads.
 	}
 
-	template <typename VoxelType>
-	PagedVolume<VoxelType>::Chunk::~Chunk()
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::~Chunk()
 	{
 		if (m_bDataModified && m_pPager)
 		{
@@ -75,92 +76,557 @@ namespace PolyVox
 			Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(m_uSideLength - 1, m_uSideLength - 1, m_uSideLength - 1);
 
 			// Page the data out
+			Timer timer;
 			m_pPager->pageOut(Region(v3dLower, v3dUpper), this);
+			if (m_pVolume)
+			{
+				m_pVolume->m_uPageOutTimeInNanoSeconds += timer.elapsedTimeInNanoSeconds();
+				m_pVolume->m_uNoOfPageOuts++;
+			}
+		}
+
+		if (m_bDataModified && m_pVolume)
+		{
+			m_pVolume->m_uNoOfModifiedChunks--;
 		}
 
-		delete[] m_tData;
-		m_tData = 0;
+		VoxelType* pData = m_tData.exchange(nullptr);
+		if (pData)
+		{
+			freeData(pData);
+		}
+
+		replacePalette(nullptr);
+		m_vecRetiredPalettes.clear();
 	}
 
-	template <typename VoxelType>
-	VoxelType* PagedVolume<VoxelType>::Chunk::getData(void) const
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns the voxel data in the order given by the volume's chunk layout (Morton order by default). If the chunk is uniform then this allocates the data (filled with the
+	/// uniform value) so that it can be written to, which means the chunk is no longer uniform. Likewise a chunk which is storing its
+	/// voxels in a palette (see PagedVolume::setChunkPaletteEnabled()) expands it into the data.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType* PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::getData(void) const
 	{
-		return m_tData;
+		VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		return pData ? pData : allocateData();
 	}
 
-	template <typename VoxelType>
-	uint32_t PagedVolume<VoxelType>::Chunk::getDataSizeInBytes(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint32_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::getDataSizeInBytes(void) const
 	{
 		return m_uSideLength * m_uSideLength * m_uSideLength * sizeof(VoxelType);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Chunk::getVoxel(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos) const
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns true if every voxel in the chunk has the same value and the chunk is storing just that value, rather than
+	/// having allocated data for all the voxels.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::isUniform(void) const
+	{
+		const Palette* pPalette = nullptr;
+		return (loadData(pPalette) == nullptr) && (pPalette == nullptr);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Sets every voxel in the chunk to the given value, and releases the chunk's data so that it only stores that value. A Pager
+	/// can call this from pageIn() when it knows that a chunk is uniform (for example, if it is entirely air) which is much faster
+	/// and uses much less memory than writing the value to every voxel. This must not be called while the chunk is being accessed
+	/// elsewhere, such as by a sampler or another thread.
+	/// \param tValue The value to give to every voxel.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::fill(VoxelType tValue)
+	{
+		m_tUniformValue = tValue;
+
+		VoxelType* pData = m_tData.exchange(nullptr);
+		if (pData)
+		{
+			freeData(pData);
+		}
+		replacePalette(nullptr);
+
+		// Filling a chunk of a volume while it is being paged in does not modify it.
+		if (m_bLoaded || !m_pVolume)
+		{
+			setDataModified(true);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Makes the chunk's data a private memory mapping of part of a file, instead of the Pager reading the data in. The voxels are then
+	/// read straight from the system's file cache, without being copied or using any memory of their own, and each page of the data
+	/// is only copied (by the system) when it is first written to. Writes never reach the file, so modified chunks are still paged
+	/// out as usual. The file must hold the data in the volume's chunk layout, and that part of the file must not change until the
+	/// chunk is destroyed (or made uniform) and no snapshot of the volume is reading the chunk's data.
+	///
+	/// This is only possible on Linux, for chunks which belong to a volume and whose data is a whole number of memory pages, and
+	/// the offset must be a multiple of the page size. Otherwise this returns false and the Pager should read the data instead.
+	/// \param iFileDescriptor The file to map, which must have been opened for reading.
+	/// \param uOffset The position of the chunk's data in the file.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::mapData(int iFileDescriptor, uint64_t uOffset)
+	{
+		if (!m_pAllocator || !m_pAllocator->canMapFiles())
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutexPalette);
+		VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		if (pData)
+		{
+			return m_pAllocator->mapFile(pData, iFileDescriptor, uOffset);
+		}
+
+		// New data doesn't need to be filled with the uniform value first, as the mapping replaces it.
+		pData = static_cast<VoxelType*>(m_pAllocator->allocate());
+		if (!m_pAllocator->mapFile(pData, iFileDescriptor, uOffset))
+		{
+			m_pAllocator->deallocate(pData);
+			return false;
+		}
+
+		// Readers check for the data before the palette, so it has to be set first.
+		m_tData.store(pData, std::memory_order_seq_cst);
+		replacePalette(nullptr);
+		return true;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType* PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::allocateData(void) const
+	{
+		// Another thread may have allocated the data first, in which case we use that instead.
+		std::lock_guard<std::mutex> lock(m_mutexPalette);
+		VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		return pData ? pData : createData();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gives a chunk which has no data its data, filled with the uniform value or from the palette. The caller must hold the palette mutex.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType* PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::createData(void) const
+	{
+		const Palette* pPalette = m_pPalette.load(std::memory_order_relaxed);
+		VoxelType* pNewData = nullptr;
+		if (pPalette)
+		{
+			pNewData = decodePalette(*pPalette);
+		}
+		else
+		{
+			// Chunks which belong to a volume get their memory from its allocator, while other chunks just use the heap.
+			const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+			void* pMemory = m_pAllocator ? m_pAllocator->allocate() : ::operator new(uNoOfVoxels * sizeof(VoxelType));
+			pNewData = static_cast<VoxelType*>(pMemory);
+			std::uninitialized_fill_n(pNewData, uNoOfVoxels, m_tUniformValue);
+		}
+
+		// Readers check for the data before the palette, so it has to be set first.
+		m_tData.store(pNewData, std::memory_order_seq_cst);
+		if (pPalette)
+		{
+			replacePalette(nullptr);
+		}
+
+		return pNewData;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType* PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::copyData(void) const
+	{
+		// The chunk must not be uniform, and nothing must write to it until the copy is complete.
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		const VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		void* pMemory = m_pAllocator ? m_pAllocator->allocate() : ::operator new(uNoOfVoxels * sizeof(VoxelType));
+		VoxelType* pNewData = static_cast<VoxelType*>(pMemory);
+		std::uninitialized_copy(pData, pData + uNoOfVoxels, pNewData);
+		return pNewData;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::freeData(VoxelType* pData) const
+	{
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		for (uint32_t uVoxel = 0; uVoxel < uNoOfVoxels; uVoxel++)
+		{
+			pData[uVoxel].~VoxelType();
+		}
+
+		if (m_pAllocator)
+		{
+			m_pAllocator->deallocate(pData);
+		}
+		else
+		{
+			::operator delete(pData);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns the chunk's data if it has any. Otherwise this returns null and gives the chunk's palette, which is also null if the chunk is uniform.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType* PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::loadData(const Palette*& pPalette) const
+	{
+		pPalette = nullptr;
+		VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		if (!pData)
+		{
+			pPalette = m_pPalette.load(std::memory_order_seq_cst);
+			if (!pPalette)
+			{
+				// The palette may have just been expanded, in which case the data was set before the palette was released.
+				pData = m_tData.load(std::memory_order_seq_cst);
+			}
+		}
+		return pData;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Allocates data for the chunk (without giving it to the chunk) and fills it with the voxels from the palette.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType* PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::decodePalette(const Palette& palette) const
+	{
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		void* pMemory = m_pAllocator ? m_pAllocator->allocate() : ::operator new(uNoOfVoxels * sizeof(VoxelType));
+		VoxelType* pNewData = static_cast<VoxelType*>(pMemory);
+		for (uint32_t uVoxel = 0; uVoxel < uNoOfVoxels; uVoxel++)
+		{
+			new (pNewData + uVoxel) VoxelType(palette.getVoxel(uVoxel));
+		}
+		return pNewData;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Writes a voxel of a chunk which has no data, by adding the value to the chunk's palette if necessary. A uniform chunk gets a
+	/// palette if they are enabled for the volume, and a palette gets wider indices when it has no room for another value. The caller
+	/// must hold the palette mutex, and has to create the data and write to that instead if this returns false.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::setPaletteVoxel(uint32_t uVoxelIndex, const VoxelType& tValue)
+	{
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+
+		Palette* pPalette = m_pPalette.load(std::memory_order_relaxed);
+		if (!pPalette)
+		{
+			if (!m_pVolume || !m_pVolume->m_bPalettesEnabled.load(std::memory_order_relaxed))
+			{
+				return false;
+			}
+
+			// Every index starts at zero, which refers to the uniform value.
+			pPalette = new Palette(m_pVolume, 0, uNoOfVoxels);
+			pPalette->m_arrayValues[0] = m_tUniformValue;
+			pPalette->m_uNoOfValues = 1;
+			replacePalette(pPalette);
+		}
+
+		uint32_t uValueIndex = pPalette->findValue(tValue);
+		if (uValueIndex == pPalette->m_uNoOfValues)
+		{
+			if (uValueIndex == pPalette->getCapacity())
+			{
+				if (pPalette->m_uIndexBitsPower == 3)
+				{
+					// There are already 256 values, which is as many as a palette can hold.
+					return false;
+				}
+
+				Palette* pWiderPalette = new Palette(m_pVolume, pPalette->m_uIndexBitsPower + 1, uNoOfVoxels);
+				std::copy(pPalette->m_arrayValues.get(), pPalette->m_arrayValues.get() + pPalette->m_uNoOfValues, pWiderPalette->m_arrayValues.get());
+				pWiderPalette->m_uNoOfValues = pPalette->m_uNoOfValues;
+				for (uint32_t uVoxel = 0; uVoxel < uNoOfVoxels; uVoxel++)
+				{
+					pWiderPalette->setIndex(uVoxel, pPalette->getIndex(uVoxel));
+				}
+				replacePalette(pWiderPalette);
+				pPalette = pWiderPalette;
+			}
+
+			// The value is added before any index refers to it, and is never changed afterwards.
+			pPalette->m_arrayValues[uValueIndex] = tValue;
+			pPalette->m_uNoOfValues++;
+		}
+
+		pPalette->setIndex(uVoxelIndex, uValueIndex);
+		m_uPaletteVersion.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Replaces the chunk's data with a palette if it has few enough different values, or releases the data if it only has one. This
+	/// is used by the volume for chunks which are not being used anywhere else, so nothing else can be reading the data or the old
+	/// palettes (which are deleted in any case). Returns whether the data was released.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::packPalette(void)
+	{
+		m_vecRetiredPalettes.clear();
+
+		VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		if (!pData)
+		{
+			return false;
+		}
+
+		// The different values are found with a small hash table, which is twice the size of the largest palette. Values are compared
+		// and hashed bytewise, as for the uniform value. Neighbouring voxels are often the same, so we check the previous one first.
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		const uint32_t uHashTableSize = 512;
+		std::vector<uint16_t> vecHashTable(uHashTableSize, 0); // The index of a value plus one, or zero if the slot is empty.
+		std::vector<VoxelType> vecValues;
+		std::vector<uint8_t> vecIndices(uNoOfVoxels);
+		for (uint32_t uVoxel = 0; uVoxel < uNoOfVoxels; uVoxel++)
+		{
+			if ((uVoxel > 0) && isBytewiseEqual(pData[uVoxel], pData[uVoxel - 1]))
+			{
+				vecIndices[uVoxel] = vecIndices[uVoxel - 1];
+				continue;
+			}
+
+			// FNV-1a
+			const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData + uVoxel);
+			uint32_t uHash = 2166136261u;
+			for (uint32_t uByte = 0; uByte < sizeof(VoxelType); uByte++)
+			{
+				uHash = (uHash ^ pBytes[uByte]) * 16777619u;
+			}
+
+			uint32_t uSlot = uHash & (uHashTableSize - 1);
+			while (vecHashTable[uSlot] && !isBytewiseEqual(vecValues[vecHashTable[uSlot] - 1], pData[uVoxel]))
+			{
+				uSlot = (uSlot + 1) & (uHashTableSize - 1);
+			}
+
+			if (!vecHashTable[uSlot])
+			{
+				if (vecValues.size() == 256)
+				{
+					return false;
+				}
+				vecValues.push_back(pData[uVoxel]);
+				vecHashTable[uSlot] = static_cast<uint16_t>(vecValues.size());
+			}
+			vecIndices[uVoxel] = static_cast<uint8_t>(vecHashTable[uSlot] - 1);
+		}
+
+		if (vecValues.size() == 1)
+		{
+			m_tUniformValue = vecValues[0];
+		}
+		else
+		{
+			const uint8_t uIndexBitsPower = (vecValues.size() <= 2) ? 0 : (vecValues.size() <= 4) ? 1 : (vecValues.size() <= 16) ? 2 : 3;
+			Palette* pPalette = new Palette(m_pVolume, uIndexBitsPower, uNoOfVoxels);
+			std::copy(vecValues.begin(), vecValues.end(), pPalette->m_arrayValues.get());
+			pPalette->m_uNoOfValues = static_cast<uint32_t>(vecValues.size());
+			for (uint32_t uVoxel = 0; uVoxel < uNoOfVoxels; uVoxel++)
+			{
+				pPalette->setIndex(uVoxel, vecIndices[uVoxel]);
+			}
+			replacePalette(pPalette);
+			m_uPaletteVersion.fetch_add(1, std::memory_order_release);
+		}
+
+		m_tData.store(nullptr, std::memory_order_seq_cst);
+		freeData(pData);
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gives the chunk a new palette (or none) in place of the current one. The old palette is deleted, unless the chunk belongs to a
+	/// thread safe volume in which case other threads may still be reading it. The caller must hold the palette mutex if the chunk
+	/// could be in use elsewhere.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::replacePalette(Palette* pNewPalette) const
+	{
+		Palette* pOldPalette = m_pPalette.exchange(pNewPalette, std::memory_order_seq_cst);
+		if (!pOldPalette)
+		{
+			if (pNewPalette && m_pVolume)
+			{
+				m_pVolume->m_uNoOfPaletteChunks++;
+			}
+			return;
+		}
+
+		if (!pNewPalette && m_pVolume)
+		{
+			m_pVolume->m_uNoOfPaletteChunks--;
+		}
+
+		if (m_pVolume && m_pVolume->m_bThreadSafe)
+		{
+			m_vecRetiredPalettes.emplace_back(pOldPalette);
+		}
+		else
+		{
+			delete pOldPalette;
+		}
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::getVoxel(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos) const
 	{
 		// This code is not usually expected to be called by the user, with the exception of when implementing paging 
 		// of uncompressed data. It's a performance critical code path so we use asserts rather than exceptions.
 		POLYVOX_ASSERT(uXPos < m_uSideLength, "Supplied position is outside of the chunk");
 		POLYVOX_ASSERT(uYPos < m_uSideLength, "Supplied position is outside of the chunk");
 		POLYVOX_ASSERT(uZPos < m_uSideLength, "Supplied position is outside of the chunk");
-		POLYVOX_ASSERT(m_tData, "No uncompressed data - chunk must be decompressed before accessing voxels.");
 
-		uint32_t index = morton256_x[uXPos] | morton256_y[uYPos] | morton256_z[uZPos];
+		const VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		if (!pData)
+		{
+			return getVoxelWithoutData(getVoxelIndexInChunk(uXPos, uYPos, uZPos, m_uSideLengthPower));
+		}
+
+		uint32_t index = getVoxelIndexInChunk(uXPos, uYPos, uZPos, m_uSideLengthPower);
 
-		return m_tData[index];
+		return pData[index];
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Reads a voxel from the chunk's palette or its uniform value. This is kept separate from getVoxel() so that the common case stays small.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::getVoxelWithoutData(uint32_t uVoxelIndex) const
+	{
+		const Palette* pPalette = nullptr;
+		const VoxelType* pData = loadData(pPalette);
+		if (pData)
+		{
+			return pData[uVoxelIndex];
+		}
+		return pPalette ? pPalette->getVoxel(uVoxelIndex) : m_tUniformValue;
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Chunk::getVoxel(const Vector3DUint16& v3dPos) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::getVoxel(const Vector3DUint16& v3dPos) const
 	{
 		return getVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ());
 	}
 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Chunk::setVoxel(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos, VoxelType tValue)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::setVoxel(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos, VoxelType tValue)
 	{
 		// This code is not usually expected to be called by the user, with the exception of when implementing paging 
 		// of uncompressed data. It's a performance critical code path so we use asserts rather than exceptions.
 		POLYVOX_ASSERT(uXPos < m_uSideLength, "Supplied position is outside of the chunk");
 		POLYVOX_ASSERT(uYPos < m_uSideLength, "Supplied position is outside of the chunk");
 		POLYVOX_ASSERT(uZPos < m_uSideLength, "Supplied position is outside of the chunk");
-		POLYVOX_ASSERT(m_tData, "No uncompressed data - chunk must be decompressed before accessing voxels.");
 
-		uint32_t index = morton256_x[uXPos] | morton256_y[uYPos] | morton256_z[uZPos];
+		uint32_t index = getVoxelIndexInChunk(uXPos, uYPos, uZPos, m_uSideLengthPower);
 
-		m_tData[index] = tValue;
+		VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		if (!pData)
+		{
+			// Uniform chunks and palettes are only changed under the lock, and the data may have been created while we waited for it.
+			// The lock is not needed if the volume is not thread safe, as then only one thread writes to it. Other threads only expand
+			// palettes for snapshots, which happens under the volume's chunk mutex before the writer is allowed to change the chunk.
+			std::unique_lock<std::mutex> lock(m_mutexPalette, std::defer_lock);
+			if (!m_pVolume || m_pVolume->m_bThreadSafe)
+			{
+				lock.lock();
+			}
+			pData = m_tData.load(std::memory_order_acquire);
+			if (!pData)
+			{
+				// Writing the value which the chunk already holds leaves it uniform.
+				if (!m_pPalette.load(std::memory_order_relaxed) && isBytewiseEqual(tValue, m_tUniformValue))
+				{
+					return;
+				}
 
-		this->m_bDataModified = true;
+				if (!setPaletteVoxel(index, tValue))
+				{
+					pData = createData();
+				}
+			}
+		}
+
+		if (pData)
+		{
+			pData[index] = tValue;
+		}
+
+		// Most writes are to chunks which are already modified, and checking first means these don't have to write to the flag.
+		// A relaxed load is sufficient, as the flag is only read by the volume once the chunk is no longer in use.
+		if (!this->m_bDataModified.load(std::memory_order_relaxed))
+		{
+			setDataModified(true);
+		}
 	}
 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Chunk::setVoxel(const Vector3DUint16& v3dPos, VoxelType tValue)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::setVoxel(const Vector3DUint16& v3dPos, VoxelType tValue)
 	{
 		setVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ(), tValue);
 	}
 
-	template <typename VoxelType>
-	uint32_t PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(void)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint64_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::calculateSizeInBytes(void)
 	{
-		// Call through to the static version
-		return calculateSizeInBytes(m_uSideLength);
+		// A uniform chunk only needs the chunk itself, and a chunk with a palette also needs the palette. Otherwise we call through
+		// to the static version.
+		const Palette* pPalette = nullptr;
+		if (loadData(pPalette))
+		{
+			return calculateSizeInBytes(m_uSideLength);
+		}
+		return pPalette ? sizeof(Chunk) + pPalette->calculateSizeInBytes() : sizeof(Chunk);
 	}
 
-	template <typename VoxelType>
-	uint32_t PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(uint32_t uSideLength)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	uint64_t PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::calculateSizeInBytes(uint32_t uSideLength)
 	{
-		// Note: We disregard the size of the other class members as they are likely to be very small compared to the size of the
-		// allocated voxel data. This also keeps the reported size as a power of two, which makes other memory calculations easier.
-		uint32_t uSizeInBytes = uSideLength * uSideLength * uSideLength * sizeof(VoxelType);
+		// This is the size of a chunk which has allocated its data. The chunk's other members are small compared to the data,
+		// but they are still significant when there are many small chunks.
+		uint64_t uSizeInBytes = static_cast<uint64_t>(uSideLength) * uSideLength * uSideLength * sizeof(VoxelType) + sizeof(Chunk);
 		return  uSizeInBytes;
 	}
 
-	// This convienience function exists for historical reasons. Chunks used to store their data in 'linear' order but now we
-	// use Morton encoding. Users who still have data in linear order (on disk, in databases, etc) will need to call this function
-	// if they load the data in by memcpy()ing it via the raw pointer. On the other hand, if they set the data using setVoxel()
-	// then the ordering is automatically handled correctly. 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Chunk::changeLinearOrderingToMorton(void)
+	////////////////////////////////////////////////////////////////////////////////
+	/// Sets whether the chunk has been modified since it was paged in, and keeps the volume's count of modified chunks up to date.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::setDataModified(bool bModified)
 	{
+		if ((m_bDataModified.exchange(bModified, std::memory_order_relaxed) != bModified) && m_pVolume)
+		{
+			if (bModified)
+			{
+				m_pVolume->m_uNoOfModifiedChunks++;
+			}
+			else
+			{
+				m_pVolume->m_uNoOfModifiedChunks--;
+			}
+		}
+	}
+
+	// This convienience function exists for historical reasons. Chunks used to store their data in 'linear' order but now they
+	// use the volume's chunk layout (Morton encoding by default). Users who still have data in linear order (on disk, in databases,
+	// etc) will need to call this function if they load the data in by memcpy()ing it via the raw pointer. On the other hand, if
+	// they set the data using setVoxel() then the ordering is automatically handled correctly. Volumes which use LinearChunkLayout
+	// already store the data in this order, and then this function does nothing (so a Pager can copy the data in directly).
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::changeLinearOrderingToMorton(void)
+	{
+		// The ordering makes no difference to a uniform chunk.
+		if (isUniform() || std::is_same<ChunkLayout, LinearChunkLayout>::value)
+		{
+			return;
+		}
+		VoxelType* pData = getData();
+
 		VoxelType* pTempBuffer = new VoxelType[m_uSideLength * m_uSideLength * m_uSideLength];
 
 		// We should prehaps restructure this loop. From: https://fgiesen.wordpress.com/2011/01/17/texture-tiling-and-swizzling/
@@ -180,22 +646,29 @@ namespace PolyVox
 				for (uint16_t x = 0; x < m_uSideLength; x++)
 				{
 					uint32_t uLinearIndex = x + y * m_uSideLength + z * m_uSideLength * m_uSideLength;
-					uint32_t uMortonIndex = morton256_x[x] | morton256_y[y] | morton256_z[z];
-					pTempBuffer[uMortonIndex] = m_tData[uLinearIndex];
+					uint32_t uLayoutIndex = getVoxelIndexInChunk(x, y, z, m_uSideLengthPower);
+					pTempBuffer[uLayoutIndex] = pData[uLinearIndex];
 				}
 			}
 		}
 
-		std::memcpy(m_tData, pTempBuffer, getDataSizeInBytes());
+		std::memcpy(pData, pTempBuffer, getDataSizeInBytes());
 
 		delete[] pTempBuffer;
 	}
 
 	// Like the above function, this is provided fot easing backwards compatibility. In Cubiquity we have some
 	// old databases which use linear ordering, and we need to continue to save such data in linear order.
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Chunk::changeMortonOrderingToLinear(void)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk::changeMortonOrderingToLinear(void)
 	{
+		// The ordering makes no difference to a uniform chunk.
+		if (isUniform() || std::is_same<ChunkLayout, LinearChunkLayout>::value)
+		{
+			return;
+		}
+		VoxelType* pData = getData();
+
 		VoxelType* pTempBuffer = new VoxelType[m_uSideLength * m_uSideLength * m_uSideLength];
 		for (uint16_t z = 0; z < m_uSideLength; z++)
 		{
@@ -204,13 +677,13 @@ namespace PolyVox
 				for (uint16_t x = 0; x < m_uSideLength; x++)
 				{
 					uint32_t uLinearIndex = x + y * m_uSideLength + z * m_uSideLength * m_uSideLength;
-					uint32_t uMortonIndex = morton256_x[x] | morton256_y[y] | morton256_z[z];
-					pTempBuffer[uLinearIndex] = m_tData[uMortonIndex];
+					uint32_t uLayoutIndex = getVoxelIndexInChunk(x, y, z, m_uSideLengthPower);
+					pTempBuffer[uLinearIndex] = pData[uLayoutIndex];
 				}
 			}
 		}
 
-		std::memcpy(m_tData, pTempBuffer, getDataSizeInBytes());
+		std::memcpy(pData, pTempBuffer, getDataSizeInBytes());
 
 		delete[] pTempBuffer;
 	}
@@ -25,86 +25,395 @@
 #include <array>
 
 #define CAN_GO_NEG_X(val) (val > 0)
-#define CAN_GO_POS_X(val)  (val < this->m_uChunkSideLengthMinusOne)
+#define CAN_GO_POS_X(val)  (val < this->getChunkSideLengthMinusOne())
 #define CAN_GO_NEG_Y(val) (val > 0)
-#define CAN_GO_POS_Y(val)  (val < this->m_uChunkSideLengthMinusOne)
+#define CAN_GO_POS_Y(val)  (val < this->getChunkSideLengthMinusOne())
 #define CAN_GO_NEG_Z(val) (val > 0)
-#define CAN_GO_POS_Z(val)  (val < this->m_uChunkSideLengthMinusOne)
+#define CAN_GO_POS_Z(val)  (val < this->getChunkSideLengthMinusOne())
 
-#define NEG_X_DELTA (-(deltaX[this->m_uXPosInChunk-1]))
-#define POS_X_DELTA (deltaX[this->m_uXPosInChunk])
-#define NEG_Y_DELTA (-(deltaY[this->m_uYPosInChunk-1]))
-#define POS_Y_DELTA (deltaY[this->m_uYPosInChunk])
-#define NEG_Z_DELTA (-(deltaZ[this->m_uZPosInChunk-1]))
-#define POS_Z_DELTA (deltaZ[this->m_uZPosInChunk])
+#define NEG_X_DELTA (-(this->m_pDeltaX[this->m_uXPosInChunk-1]))
+#define POS_X_DELTA (this->m_pDeltaX[this->m_uXPosInChunk])
+#define NEG_Y_DELTA (-(this->m_pDeltaY[this->m_uYPosInChunk-1]))
+#define POS_Y_DELTA (this->m_pDeltaY[this->m_uYPosInChunk])
+#define NEG_Z_DELTA (-(this->m_pDeltaZ[this->m_uZPosInChunk-1]))
+#define POS_Z_DELTA (this->m_pDeltaZ[this->m_uZPosInChunk])
+
+#define APRON_OFFSET(x, y, z) ((x) + (y) * this->m_iApronStrideY + (z) * this->m_iApronStrideZ)
 
 namespace PolyVox
 {
-	// These precomputed offset are used to determine how much we move our pointer by to move a single voxel in the x, y, or z direction given an x, y, or z starting position inside a chunk.
-	// More information in this discussion: https://bitbucket.org/volumesoffun/polyvox/issue/61/experiment-with-morton-ordering-of-voxel
-	static const std::array<int32_t, 256> deltaX = { 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 3511, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 28087, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 3511, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 224695, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 3511, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 28087, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 3511, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 1797559, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 3511, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 28087, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 3511, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 224695, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 3511, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 28087, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1, 3511, 1, 7, 1, 55, 1, 7, 1, 439, 1, 7, 1, 55, 1, 7, 1 };
-	static const std::array<int32_t, 256> deltaY = { 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 7022, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 56174, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 7022, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 449390, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 7022, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 56174, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 7022, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 3595118, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 7022, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 56174, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 7022, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 449390, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 7022, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 56174, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2, 7022, 2, 14, 2, 110, 2, 14, 2, 878, 2, 14, 2, 110, 2, 14, 2 };
-	static const std::array<int32_t, 256> deltaZ = { 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 14044, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 112348, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 14044, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 898780, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 14044, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 112348, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 14044, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 7190236, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 14044, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 112348, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 14044, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 898780, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 14044, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 112348, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4, 14044, 4, 28, 4, 220, 4, 28, 4, 1756, 4, 28, 4, 220, 4, 28, 4 };
+	// Used in place of the volume's deltas when the sampler is in a uniform chunk, so that all the voxels in the chunk map to the same value.
+	static const std::array<int32_t, 256> deltaUniform = {};
+	// Wraps a sampler's chunk slot (0, 1 or 2 along each axis) plus an offset of -1, 0 or 1 back into that range. The index is offset by one.
+	static const std::array<uint8_t, 5> nextChunkSlot = { 2, 0, 1, 2, 0 };
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::Sampler(PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>* volume)
+		:BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >(volume)
+		, m_pCurrentChunk(nullptr)
+		, m_pDeltaX(volume->m_vecDeltaX.data())
+		, m_pDeltaY(volume->m_vecDeltaY.data())
+		, m_pDeltaZ(volume->m_vecDeltaZ.data())
+		, m_iApronStrideY(0)
+		, m_iApronStrideZ(0)
+		, m_uChunkSideLengthMinusOne(volume->m_uChunkSideLength - 1)
+	{
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::Sampler(const Sampler& rhs)
+		:BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >(rhs)
+		, mCurrentVoxel(rhs.mCurrentVoxel)
+		, m_uXPosInChunk(rhs.m_uXPosInChunk)
+		, m_uYPosInChunk(rhs.m_uYPosInChunk)
+		, m_uZPosInChunk(rhs.m_uZPosInChunk)
+		, m_uXChunkSlot(rhs.m_uXChunkSlot)
+		, m_uYChunkSlot(rhs.m_uYChunkSlot)
+		, m_uZChunkSlot(rhs.m_uZChunkSlot)
+		, m_pCurrentChunk(rhs.m_pCurrentChunk)
+		, m_pDeltaX(rhs.m_pDeltaX)
+		, m_pDeltaY(rhs.m_pDeltaY)
+		, m_pDeltaZ(rhs.m_pDeltaZ)
+		, m_pApronCopy(rhs.m_pApronCopy)
+		, m_iApronStrideY(rhs.m_iApronStrideY)
+		, m_iApronStrideZ(rhs.m_iApronStrideZ)
+		, m_arrayPaletteCopies(rhs.m_arrayPaletteCopies)
+		, m_uChunkSideLengthMinusOne(rhs.m_uChunkSideLengthMinusOne)
+	{
+		setCachedChunks(rhs.m_arrayCachedChunks);
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::~Sampler()
+	{
+		releaseCachedChunks();
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler& PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::operator=(const Sampler& rhs)
+	{
+		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >::operator=(rhs);
+
+		mCurrentVoxel = rhs.mCurrentVoxel;
+		m_uXPosInChunk = rhs.m_uXPosInChunk;
+		m_uYPosInChunk = rhs.m_uYPosInChunk;
+		m_uZPosInChunk = rhs.m_uZPosInChunk;
+		m_uXChunkSlot = rhs.m_uXChunkSlot;
+		m_uYChunkSlot = rhs.m_uYChunkSlot;
+		m_uZChunkSlot = rhs.m_uZChunkSlot;
+		m_pCurrentChunk = rhs.m_pCurrentChunk;
+		m_pDeltaX = rhs.m_pDeltaX;
+		m_pDeltaY = rhs.m_pDeltaY;
+		m_pDeltaZ = rhs.m_pDeltaZ;
+		m_pApronCopy = rhs.m_pApronCopy;
+		m_iApronStrideY = rhs.m_iApronStrideY;
+		m_iApronStrideZ = rhs.m_iApronStrideZ;
+		m_uChunkSideLengthMinusOne = rhs.m_uChunkSideLengthMinusOne;
+		setCachedChunks(rhs.m_arrayCachedChunks);
+		m_arrayPaletteCopies = rhs.m_arrayPaletteCopies;
+
+		return *this;
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::getVoxel(void) const
+	{
+		return *mCurrentVoxel;
+	}
 
-	template <typename VoxelType>
-	PagedVolume<VoxelType>::Sampler::Sampler(PagedVolume<VoxelType>* volume)
-		:BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >(volume), m_uChunkSideLengthMinusOne(volume->m_uChunkSideLength - 1)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::setPosition(const Vector3DInt32& v3dNewPos)
 	{
+		setPosition(v3dNewPos.getX(), v3dNewPos.getY(), v3dNewPos.getZ());
 	}
 
-	template <typename VoxelType>
-	PagedVolume<VoxelType>::Sampler::~Sampler()
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::setPosition(int32_t xPos, int32_t yPos, int32_t zPos)
 	{
+		// Base version updates position and validity flags.
+		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >::setPosition(xPos, yPos, zPos);
+
+		// Then we update the voxel pointer
+		const int32_t uXChunk = this->mXPosInVolume >> this->mVolume->getChunkSideLengthPower();
+		const int32_t uYChunk = this->mYPosInVolume >> this->mVolume->getChunkSideLengthPower();
+		const int32_t uZChunk = this->mZPosInVolume >> this->mVolume->getChunkSideLengthPower();
+
+		m_uXPosInChunk = static_cast<uint16_t>(this->mXPosInVolume - (uXChunk << this->mVolume->getChunkSideLengthPower()));
+		m_uYPosInChunk = static_cast<uint16_t>(this->mYPosInVolume - (uYChunk << this->mVolume->getChunkSideLengthPower()));
+		m_uZPosInChunk = static_cast<uint16_t>(this->mZPosInVolume - (uZChunk << this->mVolume->getChunkSideLengthPower()));
+
+		// The new chunk is usually the current one or one we have already peeked into, and then we don't need to ask the volume
+		// for it (which would also replace the volume's record of the last accessed chunk).
+		m_uXChunkSlot = static_cast<uint8_t>(((uXChunk % 3) + 3) % 3);
+		m_uYChunkSlot = static_cast<uint8_t>(((uYChunk % 3) + 3) % 3);
+		m_uZChunkSlot = static_cast<uint8_t>(((uZChunk % 3) + 3) % 3);
+		const uint32_t uSlot = m_uXChunkSlot + m_uYChunkSlot * 3 + m_uZChunkSlot * 9;
+		Chunk* pCurrentChunk = getCachedChunk(uSlot, uXChunk, uYChunk, uZChunk);
+		m_pCurrentChunk = pCurrentChunk;
+
+		// The apron copy includes the voxels around the chunk, so peeks across the chunk's faces can be made within it. It is kept up
+		// to date by writes to the volume, so unlike the chunk's own data we see them even if the chunk was uniform.
+		if (this->mVolume->m_bApronsEnabled.load(std::memory_order_relaxed))
+		{
+			m_pApronCopy = this->mVolume->getApronCopy(pCurrentChunk);
+			m_iApronStrideY = this->mVolume->m_vecApronDeltaY[0];
+			m_iApronStrideZ = this->mVolume->m_vecApronDeltaZ[0];
+			mCurrentVoxel = m_pApronCopy->m_vecData.data() + APRON_OFFSET(m_uXPosInChunk + 1, m_uYPosInChunk + 1, m_uZPosInChunk + 1);
+			m_pDeltaX = this->mVolume->m_vecApronDeltaX.data();
+			m_pDeltaY = this->mVolume->m_vecApronDeltaY.data();
+			m_pDeltaZ = this->mVolume->m_vecApronDeltaZ.data();
+			return;
+		}
+		m_pApronCopy.reset();
+
+		// Note that if the chunk is written to after this point then it may stop being uniform. We then continue to see the
+		// old value until the next call to this function, just as we don't see changes made by other samplers or threads. The
+		// same applies to a chunk which is storing its voxels in a palette, as we read from a copy of it. The chunk's data can
+		// also be replaced when it is written after a snapshot has been taken (see PagedVolume::preserveChunk()), and this load
+		// must not be moved before the chunk's count of samplers is incremented.
+		VoxelType* pData = pCurrentChunk->m_tData.load(std::memory_order_seq_cst);
+		if (!pData && !pCurrentChunk->isUniform())
+		{
+			pData = getPaletteCopy(uSlot, pCurrentChunk);
+		}
+
+		if (pData)
+		{
+			mCurrentVoxel = pData + getVoxelIndexInChunk(m_uXPosInChunk, m_uYPosInChunk, m_uZPosInChunk, this->mVolume->getChunkSideLengthPower());
+			m_pDeltaX = this->mVolume->m_vecDeltaX.data();
+			m_pDeltaY = this->mVolume->m_vecDeltaY.data();
+			m_pDeltaZ = this->mVolume->m_vecDeltaZ.data();
+		}
+		else
+		{
+			mCurrentVoxel = &(pCurrentChunk->m_tUniformValue);
+			m_pDeltaX = deltaUniform.data();
+			m_pDeltaY = deltaUniform.data();
+			m_pDeltaZ = deltaUniform.data();
+		}
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::getVoxel(void) const
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns the chunk at the given position (in chunk space), which should be kept in the given slot. If it isn't already
+	/// there we ask the volume for it, and it replaces whatever chunk was in the slot.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk* PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::getCachedChunk(uint32_t uSlot, int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const
 	{
-		return *mCurrentVoxel;
+		std::shared_ptr<Chunk>& pChunk = m_arrayCachedChunks[uSlot];
+		if (!pChunk || (pChunk->m_v3dChunkSpacePosition.getX() != iChunkX) || (pChunk->m_v3dChunkSpacePosition.getY() != iChunkY) || (pChunk->m_v3dChunkSpacePosition.getZ() != iChunkZ))
+		{
+			// We count as a sampler of every chunk we hold, as we may read from their data at any time.
+			std::shared_ptr<Chunk> pNewChunk = this->mVolume->acquireChunk(iChunkX, iChunkY, iChunkZ);
+			pNewChunk->m_uNoOfSamplers++;
+			if (pChunk)
+			{
+				pChunk->m_uNoOfSamplers--;
+			}
+			pChunk = std::move(pNewChunk);
+			m_arrayPaletteCopies[uSlot].reset();
+		}
+		return pChunk.get();
 	}
 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Sampler::setPosition(const Vector3DInt32& v3dNewPos)
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns our copy of the voxels of a chunk which is storing them in a palette, decoding the palette again if it has changed
+	/// since the copy was made. If the chunk no longer has a palette then this returns its data instead (or null if it is uniform).
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType* PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::getPaletteCopy(uint32_t uSlot, const Chunk* pChunk) const
 	{
-		setPosition(v3dNewPos.getX(), v3dNewPos.getY(), v3dNewPos.getZ());
+		// The version is read before the palette, so a change which is made while we are decoding it makes us decode it again next time.
+		const uint32_t uPaletteVersion = pChunk->m_uPaletteVersion.load(std::memory_order_acquire);
+		const Palette* pPalette = nullptr;
+		VoxelType* pData = pChunk->loadData(pPalette);
+		if (!pPalette)
+		{
+			return pData;
+		}
+
+		std::shared_ptr<PaletteCopy>& pCopy = m_arrayPaletteCopies[uSlot];
+		if (!pCopy || (pCopy->m_uPaletteVersion != uPaletteVersion))
+		{
+			const uint32_t uNoOfVoxels = pChunk->m_uSideLength * pChunk->m_uSideLength * pChunk->m_uSideLength;
+			std::shared_ptr<PaletteCopy> pNewCopy = std::make_shared<PaletteCopy>();
+			pNewCopy->m_uPaletteVersion = uPaletteVersion;
+			pNewCopy->m_vecData.reserve(uNoOfVoxels);
+			for (uint32_t uVoxel = 0; uVoxel < uNoOfVoxels; uVoxel++)
+			{
+				pNewCopy->m_vecData.push_back(pPalette->getVoxel(uVoxel));
+			}
+			pCopy = std::move(pNewCopy);
+		}
+		return pCopy->m_vecData.data();
 	}
 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Sampler::setPosition(int32_t xPos, int32_t yPos, int32_t zPos)
+	////////////////////////////////////////////////////////////////////////////////
+	/// Holds on to the given chunks in place of the current ones, and keeps the chunks' counts of samplers up to date.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::setCachedChunks(const std::array<std::shared_ptr<Chunk>, 27>& arrayChunks)
 	{
-		// Base version updates position and validity flags.
-		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::setPosition(xPos, yPos, zPos);
+		for (const auto& pChunk : arrayChunks)
+		{
+			if (pChunk)
+			{
+				pChunk->m_uNoOfSamplers++;
+			}
+		}
+		releaseCachedChunks();
+		m_arrayCachedChunks = arrayChunks;
+	}
 
-		// Then we update the voxel pointer
-		const int32_t uXChunk = this->mXPosInVolume >> this->mVolume->m_uChunkSideLengthPower;
-		const int32_t uYChunk = this->mYPosInVolume >> this->mVolume->m_uChunkSideLengthPower;
-		const int32_t uZChunk = this->mZPosInVolume >> this->mVolume->m_uChunkSideLengthPower;
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::releaseCachedChunks(void)
+	{
+		for (auto& pChunk : m_arrayCachedChunks)
+		{
+			if (pChunk)
+			{
+				pChunk->m_uNoOfSamplers--;
+				pChunk.reset();
+			}
+		}
+		for (auto& pCopy : m_arrayPaletteCopies)
+		{
+			pCopy.reset();
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Reads a voxel next to the sampler which is in one of the neighbouring chunks. Unlike the current chunk, we look at the
+	/// chunk's data every time, so we always see the latest value (as PagedVolume::getVoxel() would). If the sampler is using an
+	/// apron copy then the voxel is in that instead, so the aprons only cost the peek functions anything at the chunk boundaries.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxelInNeighbour(int32_t iDeltaX, int32_t iDeltaY, int32_t iDeltaZ) const
+	{
+		if (m_pApronCopy)
+		{
+			return *(mCurrentVoxel + APRON_OFFSET(iDeltaX, iDeltaY, iDeltaZ));
+		}
 
-		m_uXPosInChunk = static_cast<uint16_t>(this->mXPosInVolume - (uXChunk << this->mVolume->m_uChunkSideLengthPower));
-		m_uYPosInChunk = static_cast<uint16_t>(this->mYPosInVolume - (uYChunk << this->mVolume->m_uChunkSideLengthPower));
-		m_uZPosInChunk = static_cast<uint16_t>(this->mZPosInVolume - (uZChunk << this->mVolume->m_uChunkSideLengthPower));
+		const int32_t iMask = this->getChunkSideLengthMinusOne();
+		const int32_t x = m_uXPosInChunk + iDeltaX;
+		const int32_t y = m_uYPosInChunk + iDeltaY;
+		const int32_t z = m_uZPosInChunk + iDeltaZ;
 
-		uint32_t uVoxelIndexInChunk = morton256_x[m_uXPosInChunk] | morton256_y[m_uYPosInChunk] | morton256_z[m_uZPosInChunk];
+		// The neighbour is at most one chunk away along each axis, and is kept in the next slot along in that direction.
+		const int32_t iChunkDeltaX = x >> this->mVolume->getChunkSideLengthPower();
+		const int32_t iChunkDeltaY = y >> this->mVolume->getChunkSideLengthPower();
+		const int32_t iChunkDeltaZ = z >> this->mVolume->getChunkSideLengthPower();
+		const uint32_t uSlot = nextChunkSlot[m_uXChunkSlot + iChunkDeltaX + 1] + nextChunkSlot[m_uYChunkSlot + iChunkDeltaY + 1] * 3 + nextChunkSlot[m_uZChunkSlot + iChunkDeltaZ + 1] * 9;
 
-		auto pCurrentChunk = this->mVolume->canReuseLastAccessedChunk(uXChunk, uYChunk, uZChunk) ?
-			this->mVolume->m_pLastAccessedChunk : this->mVolume->getChunk(uXChunk, uYChunk, uZChunk);
+		const Vector3DInt32& v3dChunkPos = m_pCurrentChunk->m_v3dChunkSpacePosition;
+		const Chunk* pChunk = getCachedChunk(uSlot, v3dChunkPos.getX() + iChunkDeltaX, v3dChunkPos.getY() + iChunkDeltaY, v3dChunkPos.getZ() + iChunkDeltaZ);
 
-		mCurrentVoxel = pCurrentChunk->m_tData + uVoxelIndexInChunk;
+		// As in setPosition(), this load must come after the chunk's count of samplers is incremented. Neighbouring chunks are not
+		// expanded if they are storing their voxels in a palette, so we may have to read from that instead.
+		const uint32_t uVoxelIndexInChunk = getVoxelIndexInChunk(x & iMask, y & iMask, z & iMask, this->mVolume->getChunkSideLengthPower());
+		const VoxelType* pData = pChunk->m_tData.load(std::memory_order_seq_cst);
+		if (!pData)
+		{
+			const Palette* pPalette = nullptr;
+			pData = pChunk->loadData(pPalette);
+			if (!pData)
+			{
+				return pPalette ? pPalette->getVoxel(uVoxelIndexInChunk) : pChunk->m_tUniformValue;
+			}
+		}
+		return pData[uVoxelIndexInChunk];
 	}
 
-	template <typename VoxelType>
-	bool PagedVolume<VoxelType>::Sampler::setVoxel(VoxelType tValue)
+	////////////////////////////////////////////////////////////////////////////////
+	/// This has the same effect as calling PagedVolume::setVoxel() for the sampler's position, but the sampler already holds a
+	/// reference to the chunk (so it cannot have been evicted) and there is no need to look it up. Other samplers which are in a
+	/// uniform chunk will not see the write until they next call setPosition(), as described there.
+	/// \return Always true, as every position is inside a PagedVolume.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	bool PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::setVoxel(VoxelType tValue)
 	{
-		//Need to think what effect this has on any existing iterators.
-		POLYVOX_THROW(not_implemented, "This function cannot be used on PagedVolume samplers.");
-		return false;
+		// The volume updates the chunk and the apron copies, which usually include ours. We write ours as well in case the aprons
+		// have since been disabled, so that the sampler still sees its own writes.
+		if (m_pApronCopy)
+		{
+			this->mVolume->setVoxel(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume, tValue);
+			*mCurrentVoxel = tValue;
+			return true;
+		}
+
+		Chunk* pChunk = m_pCurrentChunk;
+
+		// The first write to a chunk after a snapshot has been taken must keep the chunk's current contents for the snapshot.
+		if (pChunk->m_uSnapshotEpoch.load(std::memory_order_acquire) != this->mVolume->m_uSnapshotEpoch.load(std::memory_order_relaxed))
+		{
+			this->mVolume->preserveChunkForSnapshots(pChunk);
+		}
+
+		// The chunk's data may have been allocated or replaced since the sampler moved here (if it was uniform, or was preserved
+		// for a snapshot), in which case the sampler is pointing at the old data and has to be moved to the new data first.
+		const uint32_t uVoxelIndexInChunk = getVoxelIndexInChunk(m_uXPosInChunk, m_uYPosInChunk, m_uZPosInChunk, this->mVolume->getChunkSideLengthPower());
+		VoxelType* pData = pChunk->m_tData.load(std::memory_order_acquire);
+		if (pData)
+		{
+			if (mCurrentVoxel != pData + uVoxelIndexInChunk)
+			{
+				mCurrentVoxel = pData + uVoxelIndexInChunk;
+				m_pDeltaX = this->mVolume->m_vecDeltaX.data();
+				m_pDeltaY = this->mVolume->m_vecDeltaY.data();
+				m_pDeltaZ = this->mVolume->m_vecDeltaZ.data();
+			}
+
+			*mCurrentVoxel = tValue;
+			if (!pChunk->m_bDataModified.load(std::memory_order_relaxed))
+			{
+				pChunk->setDataModified(true);
+			}
+		}
+		else
+		{
+			// Writing to a uniform chunk allocates its data, unless the value is the same as the chunk's. It may give the chunk a
+			// palette instead (or write to its existing one), in which case we move to our copy of the palette so that we can see
+			// our own write. If the copy was up to date before the write then it only needs that write, rather than decoding the
+			// whole palette again, unless it is shared with a sampler which this one was copied from (or to).
+			const uint32_t uSlot = m_uXChunkSlot + m_uYChunkSlot * 3 + m_uZChunkSlot * 9;
+			const uint32_t uPaletteVersion = pChunk->m_uPaletteVersion.load(std::memory_order_acquire);
+			pChunk->setVoxel(m_uXPosInChunk, m_uYPosInChunk, m_uZPosInChunk, tValue);
+			const std::shared_ptr<PaletteCopy>& pCopy = m_arrayPaletteCopies[uSlot];
+			if (pCopy && (pCopy.use_count() == 1) && (pCopy->m_uPaletteVersion == uPaletteVersion) && (pChunk->m_uPaletteVersion.load(std::memory_order_acquire) == uPaletteVersion + 1))
+			{
+				pCopy->m_vecData[uVoxelIndexInChunk] = tValue;
+				pCopy->m_uPaletteVersion = uPaletteVersion + 1;
+			}
+			pData = pChunk->isUniform() ? nullptr : getPaletteCopy(uSlot, pChunk);
+			if (pData)
+			{
+				mCurrentVoxel = pData + uVoxelIndexInChunk;
+				m_pDeltaX = this->mVolume->m_vecDeltaX.data();
+				m_pDeltaY = this->mVolume->m_vecDeltaY.data();
+				m_pDeltaZ = this->mVolume->m_vecDeltaZ.data();
+			}
+		}
+
+		if (this->mVolume->m_bTrackChanges.load(std::memory_order_relaxed))
+		{
+			ChangeTracker::recordChange(pChunk->m_uChangedBounds, m_uXPosInChunk, m_uYPosInChunk, m_uZPosInChunk);
+		}
+
+		// This sampler isn't using the aprons, but other samplers (or the neighbouring chunks' copies) may still contain the voxel.
+		if (this->mVolume->m_bApronsEnabled.load(std::memory_order_relaxed))
+		{
+			this->mVolume->updateApronCopies(pChunk, m_uXPosInChunk, m_uYPosInChunk, m_uZPosInChunk, tValue);
+		}
+		return true;
 	}
 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Sampler::movePositiveX(void)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::movePositiveX(void)
 	{
 		// Base version updates position and validity flags.
-		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::movePositiveX();
+		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >::movePositiveX();
 
 		// Then we update the voxel pointer
 		if (CAN_GO_POS_X(this->m_uXPosInChunk))
@@ -120,11 +429,11 @@ namespace PolyVox
 		}
 	}
 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Sampler::movePositiveY(void)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::movePositiveY(void)
 	{
 		// Base version updates position and validity flags.
-		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::movePositiveY();
+		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >::movePositiveY();
 
 		// Then we update the voxel pointer
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk))
@@ -140,11 +449,11 @@ namespace PolyVox
 		}
 	}
 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Sampler::movePositiveZ(void)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::movePositiveZ(void)
 	{
 		// Base version updates position and validity flags.
-		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::movePositiveZ();
+		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >::movePositiveZ();
 
 		// Then we update the voxel pointer
 		if (CAN_GO_POS_Z(this->m_uZPosInChunk))
@@ -160,11 +469,11 @@ namespace PolyVox
 		}
 	}
 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Sampler::moveNegativeX(void)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::moveNegativeX(void)
 	{
 		// Base version updates position and validity flags.
-		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::moveNegativeX();
+		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >::moveNegativeX();
 
 		// Then we update the voxel pointer
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk))
@@ -180,11 +489,11 @@ namespace PolyVox
 		}
 	}
 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Sampler::moveNegativeY(void)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::moveNegativeY(void)
 	{
 		// Base version updates position and validity flags.
-		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::moveNegativeY();
+		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >::moveNegativeY();
 
 		// Then we update the voxel pointer
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk))
@@ -200,11 +509,11 @@ namespace PolyVox
 		}
 	}
 
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::Sampler::moveNegativeZ(void)
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	void PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::moveNegativeZ(void)
 	{
 		// Base version updates position and validity flags.
-		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::moveNegativeZ();
+		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType, ChunkSideLength, ChunkLayout> >::moveNegativeZ();
 
 		// Then we update the voxel pointer
 		if (CAN_GO_NEG_Z(this->m_uZPosInChunk))
@@ -220,274 +529,274 @@ namespace PolyVox
 		}
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1nx1ny1nz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1nx1ny1nz(void) const
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume - 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbour(-1, -1, -1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1nx1ny0pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1nx1ny0pz(void) const
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume - 1, this->mZPosInVolume);
+		return peekVoxelInNeighbour(-1, -1, 0);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1nx1ny1pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1nx1ny1pz(void) const
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume - 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbour(-1, -1, 1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1nx0py1nz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1nx0py1nz(void) const
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbour(-1, 0, -1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1nx0py0pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1nx0py0pz(void) const
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_X_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume, this->mZPosInVolume);
+		return peekVoxelInNeighbour(-1, 0, 0);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1nx0py1pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1nx0py1pz(void) const
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_X_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbour(-1, 0, 1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1nx1py1nz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1nx1py1nz(void) const
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_X_DELTA + POS_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume + 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbour(-1, 1, -1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1nx1py0pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1nx1py0pz(void) const
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_X_DELTA + POS_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume + 1, this->mZPosInVolume);
+		return peekVoxelInNeighbour(-1, 1, 0);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1nx1py1pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1nx1py1pz(void) const
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_X_DELTA + POS_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume + 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbour(-1, 1, 1);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px1ny1nz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel0px1ny1nz(void) const
 	{
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume - 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbour(0, -1, -1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px1ny0pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel0px1ny0pz(void) const
 	{
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume - 1, this->mZPosInVolume);
+		return peekVoxelInNeighbour(0, -1, 0);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px1ny1pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel0px1ny1pz(void) const
 	{
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume - 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbour(0, -1, 1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px0py1nz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel0px0py1nz(void) const
 	{
 		if (CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbour(0, 0, -1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px0py0pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel0px0py0pz(void) const
 	{
 		return *mCurrentVoxel;
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px0py1pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel0px0py1pz(void) const
 	{
 		if (CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbour(0, 0, 1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px1py1nz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel0px1py1nz(void) const
 	{
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume + 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbour(0, 1, -1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px1py0pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel0px1py0pz(void) const
 	{
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume + 1, this->mZPosInVolume);
+		return peekVoxelInNeighbour(0, 1, 0);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px1py1pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel0px1py1pz(void) const
 	{
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume + 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbour(0, 1, 1);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1px1ny1nz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1px1ny1nz(void) const
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_X_DELTA + NEG_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume - 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbour(1, -1, -1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1px1ny0pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1px1ny0pz(void) const
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_X_DELTA + NEG_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume - 1, this->mZPosInVolume);
+		return peekVoxelInNeighbour(1, -1, 0);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1px1ny1pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1px1ny1pz(void) const
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_X_DELTA + NEG_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume - 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbour(1, -1, 1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1px0py1nz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1px0py1nz(void) const
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_X_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbour(1, 0, -1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1px0py0pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1px0py0pz(void) const
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_X_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume, this->mZPosInVolume);
+		return peekVoxelInNeighbour(1, 0, 0);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1px0py1pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1px0py1pz(void) const
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_X_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbour(1, 0, 1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1px1py1nz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1px1py1nz(void) const
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_X_DELTA + POS_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume + 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbour(1, 1, -1);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1px1py0pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1px1py0pz(void) const
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_X_DELTA + POS_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume + 1, this->mZPosInVolume);
+		return peekVoxelInNeighbour(1, 1, 0);
 	}
 
-	template <typename VoxelType>
-	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel1px1py1pz(void) const
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::peekVoxel1px1py1pz(void) const
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
 			return *(mCurrentVoxel + POS_X_DELTA + POS_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume + 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbour(1, 1, 1);
 	}
 }
 
@@ -503,4 +812,6 @@ namespace PolyVox
 #undef NEG_Y_DELTA
 #undef POS_Y_DELTA
 #undef NEG_Z_DELTA
-#undef POS_Z_DELTA
\ No newline at end of file
+#undef POS_Z_DELTA
+
+#undef APRON_OFFSET
\ No newline at end of file
@@ -0,0 +1,103 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_PagedVolumeSnapshot_H__
+#define __PolyVox_PagedVolumeSnapshot_H__
+
+#include "BaseVolume.h"
+#include "PagedVolume.h"
+#include "Vector.h"
+
+#include <memory>
+#include <unordered_map>
+
+namespace PolyVox
+{
+	/// A read-only view of a PagedVolume as it was at a particular time, which is created by calling PagedVolume::snapshot(). It
+	/// can be used in the same way as other volumes (for example, it can be passed to the surface extractors) but it cannot be
+	/// written to. Chunks which have not been written to since the snapshot was taken are read from the volume, while those which
+	/// have been are read from copies which were made before the first write. See PagedVolume::snapshot() for more details.
+	///
+	/// A snapshot must only be used by one thread at a time, and must be destroyed before the volume it was taken from.
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	class PagedVolumeSnapshot : public BaseVolume<VoxelType>
+	{
+		friend class PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>;
+
+	public:
+#ifndef SWIG
+#if defined(_MSC_VER)
+		class Sampler : public BaseVolume<VoxelType>::Sampler< PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout> > //This line works on VS2010
+#else
+		class Sampler : public BaseVolume<VoxelType>::template Sampler< PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout> > //This line works on GCC
+#endif
+		{
+		public:
+			Sampler(PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>* volume);
+		};
+#endif // SWIG
+
+		/// Destructor
+		~PagedVolumeSnapshot();
+
+		/// Gets a voxel at the position given by <tt>x,y,z</tt> coordinates
+		VoxelType getVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos) const;
+		/// Gets a voxel at the position given by a 3D vector
+		VoxelType getVoxel(const Vector3DInt32& v3dPos) const;
+
+	private:
+		typedef typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::Chunk Chunk;
+		typedef typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::PreservedChunk PreservedChunk;
+
+		PagedVolumeSnapshot(const PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>* pVolume, uint64_t uEpoch);
+
+		PagedVolumeSnapshot(const PagedVolumeSnapshot& /*rhs*/) = delete;
+		PagedVolumeSnapshot& operator=(const PagedVolumeSnapshot& /*rhs*/) = delete;
+
+		const PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>* m_pVolume;
+		uint64_t m_uEpoch;
+
+		// The contents of the chunks which the volume has written to since the snapshot was taken. These may be shared with other
+		// snapshots. This is maintained by the volume under its chunk mutex.
+		std::unordered_map<Vector3DInt32, std::shared_ptr<const PreservedChunk>, typename PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::ChunkPositionHasher> m_mapPreservedChunks;
+
+		// The chunk which was most recently accessed, and the data to read for it. This is either a chunk in the volume (which holds
+		// a reference to stop it being evicted) or one of the preserved chunks. If the data is null then the chunk is uniform.
+		mutable int32_t m_iChunkX;
+		mutable int32_t m_iChunkY;
+		mutable int32_t m_iChunkZ;
+		mutable bool m_bHasChunk;
+		mutable std::shared_ptr<Chunk> m_pLiveChunk;
+		mutable std::shared_ptr<const PreservedChunk> m_pPreservedChunk;
+		mutable const VoxelType* m_pChunkData;
+		mutable VoxelType m_tChunkUniformValue;
+
+		uint8_t m_uChunkSideLengthPower;
+		int32_t m_iChunkMask;
+	};
+}
+
+#include "PagedVolumeSnapshot.inl"
+
+#endif //__PolyVox_PagedVolumeSnapshot_H__
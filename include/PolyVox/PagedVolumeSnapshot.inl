@@ -0,0 +1,97 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+
+namespace PolyVox
+{
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>::Sampler::Sampler(PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>* volume)
+		:BaseVolume<VoxelType>::template Sampler< PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout> >(volume)
+	{
+	}
+
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>::PagedVolumeSnapshot(const PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>* pVolume, uint64_t uEpoch)
+		:BaseVolume<VoxelType>()
+		, m_pVolume(pVolume)
+		, m_uEpoch(uEpoch)
+		, m_iChunkX(0)
+		, m_iChunkY(0)
+		, m_iChunkZ(0)
+		, m_bHasChunk(false)
+		, m_pChunkData(nullptr)
+		, m_tChunkUniformValue()
+		, m_uChunkSideLengthPower(pVolume->getChunkSideLengthPower())
+		, m_iChunkMask(pVolume->getChunkMask())
+	{
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Releases the copies of chunks which were made for this snapshot, unless they are also used by other snapshots.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>::~PagedVolumeSnapshot()
+	{
+		m_pVolume->releaseSnapshot(*this);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param uXPos The \c x position of the voxel
+	/// \param uYPos The \c y position of the voxel
+	/// \param uZPos The \c z position of the voxel
+	/// \return The value the voxel had when the snapshot was taken
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>::getVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos) const
+	{
+		const int32_t chunkX = uXPos >> m_uChunkSideLengthPower;
+		const int32_t chunkY = uYPos >> m_uChunkSideLengthPower;
+		const int32_t chunkZ = uZPos >> m_uChunkSideLengthPower;
+
+		if ((chunkX != m_iChunkX) || (chunkY != m_iChunkY) || (chunkZ != m_iChunkZ) || (!m_bHasChunk))
+		{
+			m_pVolume->setSnapshotChunk(*this, chunkX, chunkY, chunkZ);
+		}
+
+		if (!m_pChunkData)
+		{
+			return m_tChunkUniformValue;
+		}
+
+		const uint32_t xOffset = static_cast<uint32_t>(uXPos & m_iChunkMask);
+		const uint32_t yOffset = static_cast<uint32_t>(uYPos & m_iChunkMask);
+		const uint32_t zOffset = static_cast<uint32_t>(uZPos & m_iChunkMask);
+		return m_pChunkData[PagedVolume<VoxelType, ChunkSideLength, ChunkLayout>::getVoxelIndexInChunk(xOffset, yOffset, zOffset, m_uChunkSideLengthPower)];
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param v3dPos The 3D position of the voxel
+	/// \return The value the voxel had when the snapshot was taken
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType, uint16_t ChunkSideLength, typename ChunkLayout>
+	VoxelType PagedVolumeSnapshot<VoxelType, ChunkSideLength, ChunkLayout>::getVoxel(const Vector3DInt32& v3dPos) const
+	{
+		return getVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ());
+	}
+}
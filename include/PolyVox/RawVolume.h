@@ -29,10 +29,15 @@
 #include "Region.h"
 #include "Vector.h"
 
+#include "Impl/ChangeTracker.h"
+
+#include <algorithm>
+#include <atomic>
 #include <cstdlib> //For abort()
 #include <limits>
 #include <memory>
 #include <stdexcept> //For invalid_argument
+#include <vector>
 
 namespace PolyVox
 {
@@ -154,9 +159,34 @@ namespace PolyVox
 		/// Sets the voxel at the position given by a 3D vector
 		void setVoxel(const Vector3DInt32& v3dPos, VoxelType tValue);
 
+		/// Copies the voxels in a region into a buffer
+		void readRegion(const Region& region, VoxelType* pDst, RegionLayout eLayout = RegionLayouts::XYZ) const;
+		/// Copies the voxels in a region from a buffer
+		void writeRegion(const Region& region, const VoxelType* pSrc, RegionLayout eLayout = RegionLayouts::XYZ);
+		/// Sets every voxel in a region to the same value
+		void fill(const Region& region, VoxelType tValue);
+
 		/// Calculates approximatly how many bytes of memory the volume is currently using.
 		uint32_t calculateSizeInBytes(void);
 
+		/// Describes the changes which have been made to a single chunk, as returned by getChangedChunks().
+		typedef ChangeTracker::ChangedChunk ChangedChunk;
+
+		/// The RawVolume does not store its data in chunks, but divides the volume into chunks of this size when tracking changes.
+		static const uint32_t uChangeTrackingChunkSideLengthPower = 5;
+		static const uint32_t uChangeTrackingChunkSideLength = 1 << uChangeTrackingChunkSideLengthPower;
+
+		/// Sets whether the volume records which voxels are modified.
+		void setChangeTrackingEnabled(bool bEnabled);
+		/// Returns whether the volume records which voxels are modified.
+		bool isChangeTrackingEnabled(void) const;
+		/// Returns the chunks which have been modified since the changes were last consumed.
+		std::vector<ChangedChunk> getChangedChunks(void) const;
+		/// Returns how many times changes to the chunk at the given position (in chunk space) have been recorded.
+		uint32_t getChunkVersion(const Vector3DInt32& v3dChunkPos) const;
+		/// Returns the extraction regions which need updating because of the changes since this was last called.
+		std::vector<Region> consumeChangedRegions(const Vector3DInt32& v3dRegionSize);
+
 	protected:
 		/// Copy constructor
 		RawVolume(const RawVolume& rhs);
@@ -167,6 +197,12 @@ namespace PolyVox
 	private:
 		void initialise(const Region& regValidRegion);
 
+		size_t getIndex(int32_t iXPos, int32_t iYPos, int32_t iZPos) const;
+
+		void recordChange(int32_t iXPos, int32_t iYPos, int32_t iZPos);
+		void recordChanges(const Region& region);
+		void collectChanges(void) const;
+
 		//The size of the volume
 		Region m_regValidRegion;
 
@@ -175,6 +211,12 @@ namespace PolyVox
 
 		//The voxel data
 		VoxelType* m_pData;
+
+		// When changes are being tracked this holds the bounds of the changes to each chunk which overlaps the volume (packed by
+		// ChangeTracker::recordChange()) until they are collected by the tracker. It is null when changes are not being tracked.
+		std::unique_ptr< std::atomic<uint64_t>[] > m_pChangedBounds;
+		Region m_regChangeTrackingChunks;
+		mutable ChangeTracker m_changeTracker;
 	};
 }
 
@@ -203,6 +203,11 @@ namespace PolyVox
 				iLocalYPos * this->getWidth() +
 				iLocalZPos * this->getWidth() * this->getHeight()
 			] = tValue;
+
+		if (m_pChangedBounds)
+		{
+			recordChange(uXPos, uYPos, uZPos);
+		}
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -215,6 +220,150 @@ namespace PolyVox
 		setVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ(), tValue);
 	}
 
+	////////////////////////////////////////////////////////////////////////////////
+	/// This gives the same result as calling getVoxel() for every voxel in the region, but copies whole rows of voxels at a time.
+	/// Voxels outside the volume are given the border value.
+	/// \param region The voxels to copy.
+	/// \param pDst A buffer with space for every voxel in the region.
+	/// \param eLayout How the voxels should be arranged in the buffer.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::readRegion(const Region& region, VoxelType* pDst, RegionLayout eLayout) const
+	{
+		POLYVOX_THROW_IF(!region.isValid(), std::invalid_argument, "Cannot read an invalid region");
+		POLYVOX_THROW_IF(!pDst, std::invalid_argument, "Destination buffer must not be null");
+
+		size_t uStrideX, uStrideY, uStrideZ;
+		this->calculateRegionStrides(region, eLayout, uStrideX, uStrideY, uStrideZ);
+
+		// The part of each row which is inside the volume.
+		const int32_t iLowerX = (std::max)(region.getLowerX(), m_regValidRegion.getLowerX());
+		const int32_t iUpperX = (std::min)(region.getUpperX(), m_regValidRegion.getUpperX());
+
+		for (int32_t z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+		{
+			for (int32_t y = region.getLowerY(); y <= region.getUpperY(); y++)
+			{
+				VoxelType* pDstRow = pDst + (y - region.getLowerY()) * uStrideY + (z - region.getLowerZ()) * uStrideZ;
+				if (!m_regValidRegion.containsPointInY(y) || !m_regValidRegion.containsPointInZ(z) || (iLowerX > iUpperX))
+				{
+					for (int32_t x = region.getLowerX(); x <= region.getUpperX(); x++)
+					{
+						*pDstRow = m_tBorderValue;
+						pDstRow += uStrideX;
+					}
+					continue;
+				}
+
+				for (int32_t x = region.getLowerX(); x < iLowerX; x++)
+				{
+					*pDstRow = m_tBorderValue;
+					pDstRow += uStrideX;
+				}
+
+				const VoxelType* pSrcRow = m_pData + getIndex(iLowerX, y, z);
+				if (uStrideX == 1)
+				{
+					pDstRow = std::copy(pSrcRow, pSrcRow + (iUpperX - iLowerX + 1), pDstRow);
+				}
+				else
+				{
+					for (int32_t x = iLowerX; x <= iUpperX; x++)
+					{
+						*pDstRow = *pSrcRow++;
+						pDstRow += uStrideX;
+					}
+				}
+
+				for (int32_t x = iUpperX + 1; x <= region.getUpperX(); x++)
+				{
+					*pDstRow = m_tBorderValue;
+					pDstRow += uStrideX;
+				}
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This gives the same result as calling setVoxel() for every voxel in the region, but copies whole rows of voxels at a time.
+	/// \param region The voxels to set, which must be inside the volume.
+	/// \param pSrc A buffer containing a value for every voxel in the region.
+	/// \param eLayout How the voxels are arranged in the buffer.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::writeRegion(const Region& region, const VoxelType* pSrc, RegionLayout eLayout)
+	{
+		POLYVOX_THROW_IF(!region.isValid(), std::invalid_argument, "Cannot write an invalid region");
+		POLYVOX_THROW_IF(!pSrc, std::invalid_argument, "Source buffer must not be null");
+		POLYVOX_THROW_IF(!m_regValidRegion.containsRegion(region), std::out_of_range, "Region is outside valid region");
+
+		size_t uStrideX, uStrideY, uStrideZ;
+		this->calculateRegionStrides(region, eLayout, uStrideX, uStrideY, uStrideZ);
+
+		for (int32_t z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+		{
+			for (int32_t y = region.getLowerY(); y <= region.getUpperY(); y++)
+			{
+				const VoxelType* pSrcRow = pSrc + (y - region.getLowerY()) * uStrideY + (z - region.getLowerZ()) * uStrideZ;
+				VoxelType* pDstRow = m_pData + getIndex(region.getLowerX(), y, z);
+				if (uStrideX == 1)
+				{
+					std::copy(pSrcRow, pSrcRow + region.getWidthInVoxels(), pDstRow);
+				}
+				else
+				{
+					for (int32_t x = region.getLowerX(); x <= region.getUpperX(); x++)
+					{
+						*pDstRow++ = *pSrcRow;
+						pSrcRow += uStrideX;
+					}
+				}
+			}
+		}
+
+		if (m_pChangedBounds)
+		{
+			recordChanges(region);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This gives the same result as calling setVoxel() for every voxel in the region, but fills whole rows of voxels at a time.
+	/// \param region The voxels to set, which must be inside the volume.
+	/// \param tValue The value to give to every voxel in the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::fill(const Region& region, VoxelType tValue)
+	{
+		POLYVOX_THROW_IF(!region.isValid(), std::invalid_argument, "Cannot fill an invalid region");
+		POLYVOX_THROW_IF(!m_regValidRegion.containsRegion(region), std::out_of_range, "Region is outside valid region");
+
+		// If the region covers whole slices of the volume then they are contiguous, and can be filled in one go.
+		if ((region.getLowerX() == m_regValidRegion.getLowerX()) && (region.getUpperX() == m_regValidRegion.getUpperX()) &&
+			(region.getLowerY() == m_regValidRegion.getLowerY()) && (region.getUpperY() == m_regValidRegion.getUpperY()))
+		{
+			VoxelType* pFirst = m_pData + getIndex(region.getLowerX(), region.getLowerY(), region.getLowerZ());
+			VoxelType* pLast = m_pData + getIndex(region.getUpperX(), region.getUpperY(), region.getUpperZ());
+			std::fill(pFirst, pLast + 1, tValue);
+		}
+		else
+		{
+			for (int32_t z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+			{
+				for (int32_t y = region.getLowerY(); y <= region.getUpperY(); y++)
+				{
+					VoxelType* pRow = m_pData + getIndex(region.getLowerX(), y, z);
+					std::fill(pRow, pRow + region.getWidthInVoxels(), tValue);
+				}
+			}
+		}
+
+		if (m_pChangedBounds)
+		{
+			recordChanges(region);
+		}
+	}
+
 	////////////////////////////////////////////////////////////////////////////////
 	/// This function should probably be made internal...
 	////////////////////////////////////////////////////////////////////////////////
@@ -251,5 +400,149 @@ namespace PolyVox
 	{
 		return this->getWidth() * this->getHeight() * this->getDepth() * sizeof(VoxelType);
 	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// When change tracking is enabled the volume records which voxels are written through setVoxel() and through its samplers. See
+	/// PagedVolume::setChangeTrackingEnabled() for details. The changes are recorded for chunks of uChangeTrackingChunkSideLength
+	/// voxels on each side, in the same way as for a PagedVolume which uses chunks of that size.
+	/// \param bEnabled Whether changes should be recorded.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::setChangeTrackingEnabled(bool bEnabled)
+	{
+		if (bEnabled == isChangeTrackingEnabled())
+		{
+			return;
+		}
+
+		if (bEnabled)
+		{
+			Region regChunks = m_regValidRegion;
+			regChunks.setLowerCorner(Vector3DInt32(m_regValidRegion.getLowerX() >> uChangeTrackingChunkSideLengthPower,
+				m_regValidRegion.getLowerY() >> uChangeTrackingChunkSideLengthPower, m_regValidRegion.getLowerZ() >> uChangeTrackingChunkSideLengthPower));
+			regChunks.setUpperCorner(Vector3DInt32(m_regValidRegion.getUpperX() >> uChangeTrackingChunkSideLengthPower,
+				m_regValidRegion.getUpperY() >> uChangeTrackingChunkSideLengthPower, m_regValidRegion.getUpperZ() >> uChangeTrackingChunkSideLengthPower));
+
+			const uint32_t uNoOfChunks = regChunks.getWidthInVoxels() * regChunks.getHeightInVoxels() * regChunks.getDepthInVoxels();
+			m_pChangedBounds.reset(new std::atomic<uint64_t>[uNoOfChunks]());
+			m_regChangeTrackingChunks = regChunks;
+		}
+		else
+		{
+			m_pChangedBounds.reset();
+			m_changeTracker.clear();
+		}
+	}
+
+	template <typename VoxelType>
+	bool RawVolume<VoxelType>::isChangeTrackingEnabled(void) const
+	{
+		return m_pChangedBounds != nullptr;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \return The chunks which have been modified since the changes were last consumed, ordered by position.
+	/// \sa PagedVolume::getChangedChunks()
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	std::vector<typename RawVolume<VoxelType>::ChangedChunk> RawVolume<VoxelType>::getChangedChunks(void) const
+	{
+		collectChanges();
+		return m_changeTracker.getChangedChunks();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param v3dChunkPos The position of the chunk in chunk space (i.e. the position of a voxel in it divided by uChangeTrackingChunkSideLength).
+	/// \return The chunk's version, which is zero for chunks which have not been modified since change tracking was enabled.
+	/// \sa PagedVolume::getChunkVersion()
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint32_t RawVolume<VoxelType>::getChunkVersion(const Vector3DInt32& v3dChunkPos) const
+	{
+		collectChanges();
+		return m_changeTracker.getVersion(v3dChunkPos);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param v3dRegionSize The size of the extraction regions, which must be at least one voxel on each side.
+	/// \return The regions which need extracting, ordered by position.
+	/// \sa PagedVolume::consumeChangedRegions()
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	std::vector<Region> RawVolume<VoxelType>::consumeChangedRegions(const Vector3DInt32& v3dRegionSize)
+	{
+		collectChanges();
+		return m_changeTracker.consumeChangedRegions(v3dRegionSize);
+	}
+
+	template <typename VoxelType>
+	size_t RawVolume<VoxelType>::getIndex(int32_t iXPos, int32_t iYPos, int32_t iZPos) const
+	{
+		return (iXPos - m_regValidRegion.getLowerX()) +
+			(iYPos - m_regValidRegion.getLowerY()) * static_cast<size_t>(this->getWidth()) +
+			(iZPos - m_regValidRegion.getLowerZ()) * static_cast<size_t>(this->getWidth()) * this->getHeight();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Records a change to every voxel in the region. The changes to each chunk are recorded as a box, so recording the opposite
+	/// corners of the part of the region in each chunk covers all of it.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::recordChanges(const Region& region)
+	{
+		for (int32_t iChunkZ = region.getLowerZ() >> uChangeTrackingChunkSideLengthPower; iChunkZ <= (region.getUpperZ() >> uChangeTrackingChunkSideLengthPower); iChunkZ++)
+		{
+			for (int32_t iChunkY = region.getLowerY() >> uChangeTrackingChunkSideLengthPower; iChunkY <= (region.getUpperY() >> uChangeTrackingChunkSideLengthPower); iChunkY++)
+			{
+				for (int32_t iChunkX = region.getLowerX() >> uChangeTrackingChunkSideLengthPower; iChunkX <= (region.getUpperX() >> uChangeTrackingChunkSideLengthPower); iChunkX++)
+				{
+					const Vector3DInt32 v3dLowerCorner = Vector3DInt32(iChunkX, iChunkY, iChunkZ) * static_cast<int32_t>(uChangeTrackingChunkSideLength);
+					Region regChunk(v3dLowerCorner, v3dLowerCorner + Vector3DInt32(uChangeTrackingChunkSideLength - 1, uChangeTrackingChunkSideLength - 1, uChangeTrackingChunkSideLength - 1));
+					regChunk.cropTo(region);
+
+					recordChange(regChunk.getLowerX(), regChunk.getLowerY(), regChunk.getLowerZ());
+					recordChange(regChunk.getUpperX(), regChunk.getUpperY(), regChunk.getUpperZ());
+				}
+			}
+		}
+	}
+
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::recordChange(int32_t iXPos, int32_t iYPos, int32_t iZPos)
+	{
+		const int32_t iMask = uChangeTrackingChunkSideLength - 1;
+		const int32_t iChunkX = (iXPos >> uChangeTrackingChunkSideLengthPower) - m_regChangeTrackingChunks.getLowerX();
+		const int32_t iChunkY = (iYPos >> uChangeTrackingChunkSideLengthPower) - m_regChangeTrackingChunks.getLowerY();
+		const int32_t iChunkZ = (iZPos >> uChangeTrackingChunkSideLengthPower) - m_regChangeTrackingChunks.getLowerZ();
+
+		const int32_t iChunkIndex = iChunkX + (iChunkY + iChunkZ * m_regChangeTrackingChunks.getHeightInVoxels()) * m_regChangeTrackingChunks.getWidthInVoxels();
+		ChangeTracker::recordChange(m_pChangedBounds[iChunkIndex], iXPos & iMask, iYPos & iMask, iZPos & iMask);
+	}
+
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::collectChanges(void) const
+	{
+		if (!m_pChangedBounds)
+		{
+			return;
+		}
+
+		uint32_t uChunkIndex = 0;
+		for (int32_t z = m_regChangeTrackingChunks.getLowerZ(); z <= m_regChangeTrackingChunks.getUpperZ(); z++)
+		{
+			for (int32_t y = m_regChangeTrackingChunks.getLowerY(); y <= m_regChangeTrackingChunks.getUpperY(); y++)
+			{
+				for (int32_t x = m_regChangeTrackingChunks.getLowerX(); x <= m_regChangeTrackingChunks.getUpperX(); x++)
+				{
+					const uint64_t uChangedBounds = m_pChangedBounds[uChunkIndex++].exchange(0, std::memory_order_relaxed);
+					if (uChangedBounds != 0)
+					{
+						const Vector3DInt32 v3dChunkPos(x, y, z);
+						m_changeTracker.addChanges(v3dChunkPos, ChangeTracker::unpackBounds(uChangedBounds, v3dChunkPos * static_cast<int32_t>(uChangeTrackingChunkSideLength)));
+					}
+				}
+			}
+		}
+	}
 }
 
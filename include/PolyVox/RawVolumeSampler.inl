@@ -108,6 +108,10 @@ namespace PolyVox
 		if (this->m_bIsCurrentPositionValidInX && this->m_bIsCurrentPositionValidInY && this->m_bIsCurrentPositionValidInZ)
 		{
 			*mCurrentVoxel = tValue;
+			if (this->mVolume->m_pChangedBounds)
+			{
+				this->mVolume->recordChange(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume);
+			}
 			return true;
 		}
 		else
@@ -0,0 +1,261 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_SparseOctreeVolume_H__
+#define __PolyVox_SparseOctreeVolume_H__
+
+#include "BaseVolume.h"
+#include "Region.h"
+#include "Vector.h"
+
+#include "Impl/Utility.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace PolyVox
+{
+	/// A fixed size volume which stores its data in an octree, for very large volumes in which most of the space has the same value
+	/// (such as a world which is mostly air).
+	///
+	/// Each node of the octree either has a single value for every voxel it contains, has eight children, or (at the lowest level)
+	/// stores its voxels in a dense 'brick'. Writing to a uniform node splits it, and nodes which become uniform again are collapsed,
+	/// so the memory used depends on how much detail the volume contains rather than on its size. Reading a voxel means walking down
+	/// the tree, but the Sampler remembers the node it is in and only does this when it leaves it.
+	///
+	/// The volume can be used with the surface extractors, raycasting and pathfinding in the same way as a RawVolume. However, writing
+	/// to the volume (other than through a sampler's own setVoxel()) invalidates any samplers which exist, and they must be given a
+	/// new position before they are used again. The volume must only be used by one thread at a time.
+	template <typename VoxelType>
+	class SparseOctreeVolume : public BaseVolume<VoxelType>
+	{
+	private:
+		// Describes the part of a leaf node which is inside the volume, and where to find its voxels.
+		struct Leaf
+		{
+			const VoxelType* getVoxel(int32_t iXPos, int32_t iYPos, int32_t iZPos) const
+			{
+				return m_pLowerCornerVoxel + (iXPos - m_region.getLowerX()) * m_iStrideX + (iYPos - m_region.getLowerY()) * m_iStrideY + (iZPos - m_region.getLowerZ()) * m_iStrideZ;
+			}
+
+			Region m_region;
+			// The voxel at the lower corner of the leaf. For a uniform leaf (or a position outside the volume) all the voxels are the
+			// same, and the strides are zero.
+			const VoxelType* m_pLowerCornerVoxel;
+			int32_t m_iStrideX;
+			int32_t m_iStrideY;
+			int32_t m_iStrideZ;
+		};
+
+	public:
+#ifndef SWIG
+#if defined(_MSC_VER)
+		class Sampler : public BaseVolume<VoxelType>::Sampler< SparseOctreeVolume<VoxelType> > //This line works on VS2010
+#else
+		class Sampler : public BaseVolume<VoxelType>::template Sampler< SparseOctreeVolume<VoxelType> > //This line works on GCC
+#endif
+		{
+		public:
+			Sampler(SparseOctreeVolume<VoxelType>* volume);
+			~Sampler();
+
+			inline VoxelType getVoxel(void) const;
+
+			void setPosition(const Vector3DInt32& v3dNewPos);
+			void setPosition(int32_t xPos, int32_t yPos, int32_t zPos);
+			inline bool setVoxel(VoxelType tValue);
+
+			void movePositiveX(void);
+			void movePositiveY(void);
+			void movePositiveZ(void);
+
+			void moveNegativeX(void);
+			void moveNegativeY(void);
+			void moveNegativeZ(void);
+
+			inline VoxelType peekVoxel1nx1ny1nz(void) const;
+			inline VoxelType peekVoxel1nx1ny0pz(void) const;
+			inline VoxelType peekVoxel1nx1ny1pz(void) const;
+			inline VoxelType peekVoxel1nx0py1nz(void) const;
+			inline VoxelType peekVoxel1nx0py0pz(void) const;
+			inline VoxelType peekVoxel1nx0py1pz(void) const;
+			inline VoxelType peekVoxel1nx1py1nz(void) const;
+			inline VoxelType peekVoxel1nx1py0pz(void) const;
+			inline VoxelType peekVoxel1nx1py1pz(void) const;
+
+			inline VoxelType peekVoxel0px1ny1nz(void) const;
+			inline VoxelType peekVoxel0px1ny0pz(void) const;
+			inline VoxelType peekVoxel0px1ny1pz(void) const;
+			inline VoxelType peekVoxel0px0py1nz(void) const;
+			inline VoxelType peekVoxel0px0py0pz(void) const;
+			inline VoxelType peekVoxel0px0py1pz(void) const;
+			inline VoxelType peekVoxel0px1py1nz(void) const;
+			inline VoxelType peekVoxel0px1py0pz(void) const;
+			inline VoxelType peekVoxel0px1py1pz(void) const;
+
+			inline VoxelType peekVoxel1px1ny1nz(void) const;
+			inline VoxelType peekVoxel1px1ny0pz(void) const;
+			inline VoxelType peekVoxel1px1ny1pz(void) const;
+			inline VoxelType peekVoxel1px0py1nz(void) const;
+			inline VoxelType peekVoxel1px0py0pz(void) const;
+			inline VoxelType peekVoxel1px0py1pz(void) const;
+			inline VoxelType peekVoxel1px1py1nz(void) const;
+			inline VoxelType peekVoxel1px1py0pz(void) const;
+			inline VoxelType peekVoxel1px1py1pz(void) const;
+
+		private:
+			inline VoxelType peekVoxel(int32_t iXOffset, int32_t iYOffset, int32_t iZOffset) const;
+
+			// Finds the leaf containing the current position.
+			void updateCurrentLeaf(void);
+
+			// The voxel at the current position, and the leaf which contains it. The sampler can move around inside this leaf without
+			// searching the tree.
+			const VoxelType* mCurrentVoxel;
+			Leaf m_currentLeaf;
+
+			// The leaf in which a neighbouring voxel was most recently found. Peeks which fall outside the current leaf usually land
+			// in the same neighbour as the previous one, so remembering it saves searching the tree for most of them.
+			mutable Leaf m_neighbourLeaf;
+		};
+#endif // SWIG
+
+	public:
+		/// Constructor for creating a fixed size volume.
+		SparseOctreeVolume(const Region& regValid, uint16_t uBrickSideLength = 8);
+
+		/// Destructor
+		~SparseOctreeVolume();
+
+		/// Gets the value used for voxels which are outside the volume
+		VoxelType getBorderValue(void) const;
+		/// Gets a Region representing the extents of the Volume.
+		const Region& getEnclosingRegion(void) const;
+
+		/// Gets the width of the volume in voxels.
+		int32_t getWidth(void) const;
+		/// Gets the height of the volume in voxels.
+		int32_t getHeight(void) const;
+		/// Gets the depth of the volume in voxels.
+		int32_t getDepth(void) const;
+
+		/// Gets a voxel at the position given by <tt>x,y,z</tt> coordinates
+		VoxelType getVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos) const;
+		/// Gets a voxel at the position given by a 3D vector
+		VoxelType getVoxel(const Vector3DInt32& v3dPos) const;
+
+		/// Sets the value used for voxels which are outside the volume
+		void setBorderValue(const VoxelType& tBorder);
+		/// Sets the voxel at the position given by <tt>x,y,z</tt> coordinates
+		void setVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos, VoxelType tValue);
+		/// Sets the voxel at the position given by a 3D vector
+		void setVoxel(const Vector3DInt32& v3dPos, VoxelType tValue);
+
+		/// Copies the voxels in a region into a buffer
+		void readRegion(const Region& region, VoxelType* pDst, RegionLayout eLayout = RegionLayouts::XYZ) const;
+		/// Copies the voxels in a region from a buffer
+		void writeRegion(const Region& region, const VoxelType* pSrc, RegionLayout eLayout = RegionLayouts::XYZ);
+		/// Sets every voxel in a region to the same value
+		void fill(const Region& region, VoxelType tValue);
+
+		/// Gets the number of nodes in the octree.
+		uint32_t getNoOfNodes(void) const;
+		/// Gets the number of nodes which store their voxels in a brick.
+		uint32_t getNoOfBricks(void) const;
+
+		/// Calculates approximately how many bytes of memory the volume is currently using.
+		uint64_t calculateSizeInBytes(void);
+
+	protected:
+		/// Copy constructor
+		SparseOctreeVolume(const SparseOctreeVolume& rhs);
+
+		/// Assignment operator
+		SparseOctreeVolume& operator=(const SparseOctreeVolume& rhs);
+
+	private:
+		enum NodeType
+		{
+			UniformNode,
+			BranchNode,
+			BrickNode
+		};
+
+		struct Node
+		{
+			// The value of every voxel in a uniform node.
+			VoxelType m_tValue;
+			// For a branch this is the index of the first of its eight children in m_vecNodes, and for a brick it is the index of its
+			// voxels in m_vecBricks. It is not used by uniform nodes.
+			uint32_t m_uIndex;
+			uint8_t m_uType;
+		};
+
+		// Finds the leaf which contains a voxel. Positions outside the volume are given a leaf containing just that voxel, which holds the border value.
+		void findLeaf(int32_t iXPos, int32_t iYPos, int32_t iZPos, Leaf& leaf) const;
+
+		uint32_t getBrickIndex(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos) const;
+		static Vector3DInt32 getNodeLowerCorner(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos, uint8_t uSideLengthPower);
+
+		void fillNode(uint32_t uNode, const Vector3DInt32& v3dLowerCorner, uint8_t uSideLengthPower, const Region& regFill, const VoxelType& tValue);
+		void splitNode(uint32_t uNode, uint8_t uSideLengthPower);
+		bool collapseNode(uint32_t uNode, const Vector3DInt32& v3dLowerCorner, uint8_t uSideLengthPower);
+		void makeNodeUniform(uint32_t uNode, const VoxelType& tValue);
+		void releaseChildren(uint32_t uNode);
+		uint32_t countDifferentVoxels(const VoxelType* pBrick, const Vector3DInt32& v3dLowerCorner) const;
+
+
+		//The size of the volume
+		Region m_regValidRegion;
+
+		//The border value
+		VoxelType m_tBorderValue;
+
+		uint16_t m_uBrickSideLength;
+		uint8_t m_uBrickSideLengthPower;
+		uint32_t m_uBrickMask;
+
+		// The root node covers a cube with this power of two side length, starting at the lower corner of the volume.
+		uint8_t m_uRootSideLengthPower;
+
+		// The nodes of the tree, with the root first. The children of a node are stored together in blocks of eight.
+		std::vector<Node> m_vecNodes;
+		std::vector<uint32_t> m_vecFreeNodeBlocks;
+
+		// The voxel data of the bricks. The data of a brick which is no longer in use is released and the index is reused.
+		std::vector< std::unique_ptr<VoxelType[]> > m_vecBricks;
+		std::vector<uint32_t> m_vecFreeBricks;
+
+		// For each brick, the number of its voxels inside the volume which differ from its first voxel. A brick can be collapsed when
+		// this is zero.
+		std::vector<uint32_t> m_vecNoOfDifferentVoxels;
+	};
+}
+
+#include "SparseOctreeVolume.inl"
+#include "SparseOctreeVolumeSampler.inl"
+
+#endif //__PolyVox_SparseOctreeVolume_H__
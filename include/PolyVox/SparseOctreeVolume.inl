@@ -0,0 +1,709 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#include "Impl/ErrorHandling.h"
+#include "Impl/Utility.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace PolyVox
+{
+	////////////////////////////////////////////////////////////////////////////////
+	/// This constructor creates a volume with a fixed size which is specified as a parameter. Every voxel initially has the default
+	/// value, which needs just a single node.
+	/// \param regValid Specifies the minimum and maximum valid voxel positions.
+	/// \param uBrickSideLength The size of the bricks which store the voxels of non-uniform parts of the volume. Smaller bricks let the
+	/// volume follow the detail more closely, but mean there are more nodes.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	SparseOctreeVolume<VoxelType>::SparseOctreeVolume(const Region& regValid, uint16_t uBrickSideLength)
+		:BaseVolume<VoxelType>()
+		, m_regValidRegion(regValid)
+		, m_tBorderValue()
+		, m_uBrickSideLength(uBrickSideLength)
+	{
+		POLYVOX_THROW_IF(!regValid.isValid(), std::invalid_argument, "Volume region must be valid.");
+		POLYVOX_THROW_IF(m_uBrickSideLength == 0, std::invalid_argument, "Brick side length cannot be zero.");
+		POLYVOX_THROW_IF(m_uBrickSideLength > 32, std::invalid_argument, "Brick size is too large to be practical.");
+		POLYVOX_THROW_IF(!isPowerOf2(m_uBrickSideLength), std::invalid_argument, "Brick side length must be a power of two.");
+
+		m_uBrickSideLengthPower = logBase2(m_uBrickSideLength);
+		m_uBrickMask = m_uBrickSideLength - 1;
+
+		// The root must be large enough to cover the volume, and is never smaller than a brick.
+		const int32_t iLargestSide = (std::max)((std::max)(getWidth(), getHeight()), getDepth());
+		POLYVOX_THROW_IF(iLargestSide > (1 << 30), std::invalid_argument, "Volume is too large.");
+		m_uRootSideLengthPower = m_uBrickSideLengthPower;
+		while ((1 << m_uRootSideLengthPower) < iLargestSide)
+		{
+			m_uRootSideLengthPower++;
+		}
+
+		Node root;
+		root.m_tValue = VoxelType();
+		root.m_uIndex = 0;
+		root.m_uType = UniformNode;
+		m_vecNodes.push_back(root);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This function should never be called. Copying volumes by value would be expensive, and we want to prevent users from doing
+	/// it by accident (such as when passing them as paramenters to functions). That said, there are times when you really do want to
+	/// make a copy of a volume and in this case you should look at the VolumeResampler.
+	///
+	/// \sa VolumeResampler
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	SparseOctreeVolume<VoxelType>::SparseOctreeVolume(const SparseOctreeVolume<VoxelType>& /*rhs*/)
+	{
+		POLYVOX_THROW(not_implemented, "Volume copy constructor not implemented for performance reasons.");
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Destroys the volume
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	SparseOctreeVolume<VoxelType>::~SparseOctreeVolume()
+	{
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This function should never be called. Copying volumes by value would be expensive, and we want to prevent users from doing
+	/// it by accident (such as when passing them as paramenters to functions). That said, there are times when you really do want to
+	/// make a copy of a volume and in this case you should look at the VolumeResampler.
+	///
+	/// \sa VolumeResampler
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	SparseOctreeVolume<VoxelType>& SparseOctreeVolume<VoxelType>::operator=(const SparseOctreeVolume<VoxelType>& /*rhs*/)
+	{
+		POLYVOX_THROW(not_implemented, "Volume assignment operator not implemented for performance reasons.");
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The border value is returned whenever an attempt is made to read a voxel which
+	/// is outside the extents of the volume.
+	/// \return The value used for voxels outside of the volume
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::getBorderValue(void) const
+	{
+		return m_tBorderValue;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \return A Region representing the extent of the volume.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	const Region& SparseOctreeVolume<VoxelType>::getEnclosingRegion(void) const
+	{
+		return m_regValidRegion;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \return The width of the volume in voxels. Note that this value is inclusive, so that if the valid range is e.g. 0 to 63 then the width is 64.
+	/// \sa getHeight(), getDepth()
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	int32_t SparseOctreeVolume<VoxelType>::getWidth(void) const
+	{
+		return m_regValidRegion.getWidthInVoxels();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \return The height of the volume in voxels. Note that this value is inclusive, so that if the valid range is e.g. 0 to 63 then the height is 64.
+	/// \sa getWidth(), getDepth()
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	int32_t SparseOctreeVolume<VoxelType>::getHeight(void) const
+	{
+		return m_regValidRegion.getHeightInVoxels();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \return The depth of the volume in voxels. Note that this value is inclusive, so that if the valid range is e.g. 0 to 63 then the depth is 64.
+	/// \sa getWidth(), getHeight()
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	int32_t SparseOctreeVolume<VoxelType>::getDepth(void) const
+	{
+		return m_regValidRegion.getDepthInVoxels();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param uXPos The \c x position of the voxel
+	/// \param uYPos The \c y position of the voxel
+	/// \param uZPos The \c z position of the voxel
+	/// \return The voxel value
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::getVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos) const
+	{
+		if (!m_regValidRegion.containsPoint(uXPos, uYPos, uZPos))
+		{
+			return m_tBorderValue;
+		}
+
+		const uint32_t uLocalXPos = static_cast<uint32_t>(uXPos - m_regValidRegion.getLowerX());
+		const uint32_t uLocalYPos = static_cast<uint32_t>(uYPos - m_regValidRegion.getLowerY());
+		const uint32_t uLocalZPos = static_cast<uint32_t>(uZPos - m_regValidRegion.getLowerZ());
+
+		// Each level down the tree halves the side length, and the corresponding bit of the position picks the child.
+		const Node* pNode = &(m_vecNodes[0]);
+		uint32_t uSideLength = 1 << m_uRootSideLengthPower;
+		while (pNode->m_uType == BranchNode)
+		{
+			uSideLength >>= 1;
+			const uint32_t uChild = ((uLocalXPos & uSideLength) ? 1 : 0) | ((uLocalYPos & uSideLength) ? 2 : 0) | ((uLocalZPos & uSideLength) ? 4 : 0);
+			pNode = &(m_vecNodes[pNode->m_uIndex + uChild]);
+		}
+
+		if (pNode->m_uType == UniformNode)
+		{
+			return pNode->m_tValue;
+		}
+
+		return m_vecBricks[pNode->m_uIndex][getBrickIndex(uLocalXPos, uLocalYPos, uLocalZPos)];
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param v3dPos The 3D position of the voxel
+	/// \return The voxel value
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::getVoxel(const Vector3DInt32& v3dPos) const
+	{
+		return getVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ());
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param tBorder The value to use for voxels outside the volume.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::setBorderValue(const VoxelType& tBorder)
+	{
+		m_tBorderValue = tBorder;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Writing to a uniform node splits it (unless it already has the value) and writing to a brick can collapse it, along with any
+	/// of its parents which then have eight uniform children with the same value.
+	/// \param uXPos the \c x position of the voxel
+	/// \param uYPos the \c y position of the voxel
+	/// \param uZPos the \c z position of the voxel
+	/// \param tValue the value to which the voxel will be set
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::setVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos, VoxelType tValue)
+	{
+		if (!m_regValidRegion.containsPoint(uXPos, uYPos, uZPos))
+		{
+			POLYVOX_THROW(std::out_of_range, "Position is outside valid region");
+		}
+
+		const uint32_t uLocalXPos = static_cast<uint32_t>(uXPos - m_regValidRegion.getLowerX());
+		const uint32_t uLocalYPos = static_cast<uint32_t>(uYPos - m_regValidRegion.getLowerY());
+		const uint32_t uLocalZPos = static_cast<uint32_t>(uZPos - m_regValidRegion.getLowerZ());
+
+		// Nodes are referred to by index, as splitting a node can reallocate the array. The path is kept so that we can collapse
+		// the parents afterwards.
+		uint32_t auPath[32];
+		uint32_t uDepth = 0;
+		uint32_t uNode = 0;
+		uint8_t uSideLengthPower = m_uRootSideLengthPower;
+		while (true)
+		{
+			if (m_vecNodes[uNode].m_uType == UniformNode)
+			{
+				if (isBytewiseEqual(m_vecNodes[uNode].m_tValue, tValue))
+				{
+					return;
+				}
+				splitNode(uNode, uSideLengthPower);
+			}
+
+			if (m_vecNodes[uNode].m_uType == BrickNode)
+			{
+				break;
+			}
+
+			auPath[uDepth++] = uNode;
+			uSideLengthPower--;
+			const uint32_t uSideLength = 1 << uSideLengthPower;
+			const uint32_t uChild = ((uLocalXPos & uSideLength) ? 1 : 0) | ((uLocalYPos & uSideLength) ? 2 : 0) | ((uLocalZPos & uSideLength) ? 4 : 0);
+			uNode = m_vecNodes[uNode].m_uIndex + uChild;
+		}
+
+		// Keep count of the voxels which differ from the first one, so that we know when the brick can be collapsed without looking
+		// at all of it. Only writing the first voxel itself means they all have to be counted again.
+		const uint32_t uBrick = m_vecNodes[uNode].m_uIndex;
+		VoxelType* pBrick = m_vecBricks[uBrick].get();
+		const uint32_t uVoxel = getBrickIndex(uLocalXPos, uLocalYPos, uLocalZPos);
+		if (isBytewiseEqual(pBrick[uVoxel], tValue))
+		{
+			return;
+		}
+
+		const Vector3DInt32 v3dBrickLowerCorner = getNodeLowerCorner(uLocalXPos, uLocalYPos, uLocalZPos, m_uBrickSideLengthPower);
+		if (uVoxel == 0)
+		{
+			pBrick[0] = tValue;
+			m_vecNoOfDifferentVoxels[uBrick] = countDifferentVoxels(pBrick, v3dBrickLowerCorner);
+		}
+		else
+		{
+			if (isBytewiseEqual(pBrick[uVoxel], pBrick[0]))
+			{
+				m_vecNoOfDifferentVoxels[uBrick]++;
+			}
+			else if (isBytewiseEqual(tValue, pBrick[0]))
+			{
+				m_vecNoOfDifferentVoxels[uBrick]--;
+			}
+			pBrick[uVoxel] = tValue;
+		}
+
+		if (collapseNode(uNode, v3dBrickLowerCorner, m_uBrickSideLengthPower))
+		{
+			while (uDepth > 0)
+			{
+				uDepth--;
+				const uint8_t uParentSideLengthPower = static_cast<uint8_t>(m_uRootSideLengthPower - uDepth);
+				if (!collapseNode(auPath[uDepth], getNodeLowerCorner(uLocalXPos, uLocalYPos, uLocalZPos, uParentSideLengthPower), uParentSideLengthPower))
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param v3dPos the 3D position of the voxel
+	/// \param tValue the value to which the voxel will be set
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::setVoxel(const Vector3DInt32& v3dPos, VoxelType tValue)
+	{
+		setVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ(), tValue);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This gives the same result as calling getVoxel() for every voxel in the region, but only searches the tree when it moves into
+	/// a different node. Voxels outside the volume are given the border value.
+	/// \param region The voxels to copy.
+	/// \param pDst A buffer with space for every voxel in the region.
+	/// \param eLayout How the voxels should be arranged in the buffer.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::readRegion(const Region& region, VoxelType* pDst, RegionLayout eLayout) const
+	{
+		POLYVOX_THROW_IF(!region.isValid(), std::invalid_argument, "Cannot read an invalid region");
+		POLYVOX_THROW_IF(!pDst, std::invalid_argument, "Destination buffer must not be null");
+
+		size_t uStrideX, uStrideY, uStrideZ;
+		this->calculateRegionStrides(region, eLayout, uStrideX, uStrideY, uStrideZ);
+
+		// The sampler doesn't modify the volume.
+		Sampler sampler(const_cast<SparseOctreeVolume<VoxelType>*>(this));
+		for (int32_t z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+		{
+			for (int32_t y = region.getLowerY(); y <= region.getUpperY(); y++)
+			{
+				VoxelType* pDstRow = pDst + (y - region.getLowerY()) * uStrideY + (z - region.getLowerZ()) * uStrideZ;
+				sampler.setPosition(region.getLowerX(), y, z);
+				for (int32_t x = region.getLowerX(); x <= region.getUpperX(); x++)
+				{
+					*pDstRow = sampler.getVoxel();
+					pDstRow += uStrideX;
+					sampler.movePositiveX();
+				}
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This gives the same result as calling setVoxel() for every voxel in the region.
+	/// \param region The voxels to set, which must be inside the volume.
+	/// \param pSrc A buffer containing a value for every voxel in the region.
+	/// \param eLayout How the voxels are arranged in the buffer.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::writeRegion(const Region& region, const VoxelType* pSrc, RegionLayout eLayout)
+	{
+		POLYVOX_THROW_IF(!region.isValid(), std::invalid_argument, "Cannot write an invalid region");
+		POLYVOX_THROW_IF(!pSrc, std::invalid_argument, "Source buffer must not be null");
+		POLYVOX_THROW_IF(!m_regValidRegion.containsRegion(region), std::out_of_range, "Region is outside valid region");
+
+		size_t uStrideX, uStrideY, uStrideZ;
+		this->calculateRegionStrides(region, eLayout, uStrideX, uStrideY, uStrideZ);
+
+		for (int32_t z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+		{
+			for (int32_t y = region.getLowerY(); y <= region.getUpperY(); y++)
+			{
+				const VoxelType* pSrcRow = pSrc + (y - region.getLowerY()) * uStrideY + (z - region.getLowerZ()) * uStrideZ;
+				for (int32_t x = region.getLowerX(); x <= region.getUpperX(); x++)
+				{
+					setVoxel(x, y, z, *pSrcRow);
+					pSrcRow += uStrideX;
+				}
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This gives the same result as calling setVoxel() for every voxel in the region, but nodes which are entirely inside the region
+	/// are simply made uniform, so the cost depends on the area of the region's surface rather than on its volume.
+	/// \param region The voxels to set, which must be inside the volume.
+	/// \param tValue The value to give to every voxel in the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::fill(const Region& region, VoxelType tValue)
+	{
+		POLYVOX_THROW_IF(!region.isValid(), std::invalid_argument, "Cannot fill an invalid region");
+		POLYVOX_THROW_IF(!m_regValidRegion.containsRegion(region), std::out_of_range, "Region is outside valid region");
+
+		Region regLocalFill = region;
+		regLocalFill.shift(Vector3DInt32(0, 0, 0) - m_regValidRegion.getLowerCorner());
+		fillNode(0, Vector3DInt32(0, 0, 0), m_uRootSideLengthPower, regLocalFill, tValue);
+	}
+
+	template <typename VoxelType>
+	uint32_t SparseOctreeVolume<VoxelType>::getNoOfNodes(void) const
+	{
+		return static_cast<uint32_t>(m_vecNodes.size() - m_vecFreeNodeBlocks.size() * 8);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Bricks are also counted by getNoOfNodes(), but most of the volume's memory is used by bricks so this is usually more useful.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint32_t SparseOctreeVolume<VoxelType>::getNoOfBricks(void) const
+	{
+		return static_cast<uint32_t>(m_vecBricks.size() - m_vecFreeBricks.size());
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This includes the space which has been allocated for nodes which are not currently in use, as it is not given back.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint64_t SparseOctreeVolume<VoxelType>::calculateSizeInBytes(void)
+	{
+		const uint64_t uBrickSizeInBytes = static_cast<uint64_t>(m_uBrickSideLength) * m_uBrickSideLength * m_uBrickSideLength * sizeof(VoxelType);
+		return sizeof(SparseOctreeVolume<VoxelType>) +
+			m_vecNodes.capacity() * sizeof(Node) +
+			m_vecBricks.capacity() * sizeof(std::unique_ptr<VoxelType[]>) +
+			(m_vecFreeNodeBlocks.capacity() + m_vecFreeBricks.capacity()) * sizeof(uint32_t) +
+			getNoOfBricks() * uBrickSizeInBytes;
+	}
+
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::findLeaf(int32_t iXPos, int32_t iYPos, int32_t iZPos, Leaf& leaf) const
+	{
+		const Vector3DInt32 v3dPos(iXPos, iYPos, iZPos);
+		if (!m_regValidRegion.containsPoint(v3dPos))
+		{
+			leaf.m_region = Region(v3dPos, v3dPos);
+			leaf.m_pLowerCornerVoxel = &m_tBorderValue;
+			leaf.m_iStrideX = 0;
+			leaf.m_iStrideY = 0;
+			leaf.m_iStrideZ = 0;
+			return;
+		}
+
+		const uint32_t uLocalXPos = static_cast<uint32_t>(iXPos - m_regValidRegion.getLowerX());
+		const uint32_t uLocalYPos = static_cast<uint32_t>(iYPos - m_regValidRegion.getLowerY());
+		const uint32_t uLocalZPos = static_cast<uint32_t>(iZPos - m_regValidRegion.getLowerZ());
+
+		const Node* pNode = &(m_vecNodes[0]);
+		uint32_t uSideLength = 1 << m_uRootSideLengthPower;
+		while (pNode->m_uType == BranchNode)
+		{
+			uSideLength >>= 1;
+			const uint32_t uChild = ((uLocalXPos & uSideLength) ? 1 : 0) | ((uLocalYPos & uSideLength) ? 2 : 0) | ((uLocalZPos & uSideLength) ? 4 : 0);
+			pNode = &(m_vecNodes[pNode->m_uIndex + uChild]);
+		}
+
+		// The side length is a power of two, so clearing the lower bits of the position gives the corner of the leaf. The leaves are
+		// aligned to the lower corner of the volume, so only their upper corners can be outside it.
+		const uint32_t uMask = ~(uSideLength - 1);
+		const Vector3DInt32 v3dLowerCorner = m_regValidRegion.getLowerCorner() + Vector3DInt32(uLocalXPos & uMask, uLocalYPos & uMask, uLocalZPos & uMask);
+		leaf.m_region = Region(v3dLowerCorner, v3dLowerCorner + Vector3DInt32(uSideLength - 1, uSideLength - 1, uSideLength - 1));
+		leaf.m_region.cropTo(m_regValidRegion);
+
+		if (pNode->m_uType == UniformNode)
+		{
+			leaf.m_pLowerCornerVoxel = &(pNode->m_tValue);
+			leaf.m_iStrideX = 0;
+			leaf.m_iStrideY = 0;
+			leaf.m_iStrideZ = 0;
+		}
+		else
+		{
+			leaf.m_pLowerCornerVoxel = m_vecBricks[pNode->m_uIndex].get();
+			leaf.m_iStrideX = 1;
+			leaf.m_iStrideY = m_uBrickSideLength;
+			leaf.m_iStrideZ = m_uBrickSideLength * m_uBrickSideLength;
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \return The lower corner (relative to the lower corner of the volume) of the node with the given side length which contains
+	/// the voxel.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	Vector3DInt32 SparseOctreeVolume<VoxelType>::getNodeLowerCorner(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos, uint8_t uSideLengthPower)
+	{
+		const uint32_t uMask = ~((1u << uSideLengthPower) - 1);
+		return Vector3DInt32(static_cast<int32_t>(uXPos & uMask), static_cast<int32_t>(uYPos & uMask), static_cast<int32_t>(uZPos & uMask));
+	}
+
+	template <typename VoxelType>
+	uint32_t SparseOctreeVolume<VoxelType>::getBrickIndex(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos) const
+	{
+		return (uXPos & m_uBrickMask) | ((uYPos & m_uBrickMask) << m_uBrickSideLengthPower) | ((uZPos & m_uBrickMask) << (2 * m_uBrickSideLengthPower));
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Sets the voxels of a node which are inside the region (given relative to the lower corner of the volume). Nodes which are
+	/// entirely inside the region are made uniform, and others are split until they are, or until they are bricks.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::fillNode(uint32_t uNode, const Vector3DInt32& v3dLowerCorner, uint8_t uSideLengthPower, const Region& regFill, const VoxelType& tValue)
+	{
+		const int32_t iSideLength = 1 << uSideLengthPower;
+		Region regNode(v3dLowerCorner, v3dLowerCorner + Vector3DInt32(iSideLength - 1, iSideLength - 1, iSideLength - 1));
+		if (!intersects(regNode, regFill))
+		{
+			return;
+		}
+
+		// Parts of the root's children may be outside the volume, but these voxels are never used.
+		regNode.cropTo(Region(Vector3DInt32(0, 0, 0), m_regValidRegion.getDimensionsInVoxels() - Vector3DInt32(1, 1, 1)));
+		if (regFill.containsRegion(regNode))
+		{
+			makeNodeUniform(uNode, tValue);
+			return;
+		}
+
+		if (m_vecNodes[uNode].m_uType == UniformNode)
+		{
+			if (isBytewiseEqual(m_vecNodes[uNode].m_tValue, tValue))
+			{
+				return;
+			}
+			splitNode(uNode, uSideLengthPower);
+		}
+
+		if (m_vecNodes[uNode].m_uType == BrickNode)
+		{
+			VoxelType* pBrick = m_vecBricks[m_vecNodes[uNode].m_uIndex].get();
+			regNode.cropTo(regFill);
+			for (int32_t z = regNode.getLowerZ(); z <= regNode.getUpperZ(); z++)
+			{
+				for (int32_t y = regNode.getLowerY(); y <= regNode.getUpperY(); y++)
+				{
+					for (int32_t x = regNode.getLowerX(); x <= regNode.getUpperX(); x++)
+					{
+						pBrick[getBrickIndex(x, y, z)] = tValue;
+					}
+				}
+			}
+			m_vecNoOfDifferentVoxels[m_vecNodes[uNode].m_uIndex] = countDifferentVoxels(pBrick, v3dLowerCorner);
+		}
+		else
+		{
+			const int32_t iChildSideLength = iSideLength >> 1;
+			for (uint32_t uChild = 0; uChild < 8; uChild++)
+			{
+				const Vector3DInt32 v3dChildOffset((uChild & 1) ? iChildSideLength : 0, (uChild & 2) ? iChildSideLength : 0, (uChild & 4) ? iChildSideLength : 0);
+				fillNode(m_vecNodes[uNode].m_uIndex + uChild, v3dLowerCorner + v3dChildOffset, uSideLengthPower - 1, regFill, tValue);
+			}
+		}
+
+		collapseNode(uNode, v3dLowerCorner, uSideLengthPower);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Turns a uniform node into a brick (if it is the size of one) or into a branch with eight uniform children, without changing
+	/// the value of any voxels.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::splitNode(uint32_t uNode, uint8_t uSideLengthPower)
+	{
+		const VoxelType tValue = m_vecNodes[uNode].m_tValue;
+
+		if (uSideLengthPower == m_uBrickSideLengthPower)
+		{
+			const uint32_t uNoOfVoxels = m_uBrickSideLength * m_uBrickSideLength * m_uBrickSideLength;
+			uint32_t uBrick;
+			if (m_vecFreeBricks.empty())
+			{
+				uBrick = static_cast<uint32_t>(m_vecBricks.size());
+				m_vecBricks.emplace_back();
+				m_vecNoOfDifferentVoxels.emplace_back();
+			}
+			else
+			{
+				uBrick = m_vecFreeBricks.back();
+				m_vecFreeBricks.pop_back();
+			}
+			m_vecBricks[uBrick].reset(new VoxelType[uNoOfVoxels]);
+			std::fill(m_vecBricks[uBrick].get(), m_vecBricks[uBrick].get() + uNoOfVoxels, tValue);
+			m_vecNoOfDifferentVoxels[uBrick] = 0;
+
+			m_vecNodes[uNode].m_uIndex = uBrick;
+			m_vecNodes[uNode].m_uType = BrickNode;
+			return;
+		}
+
+		Node child;
+		child.m_tValue = tValue;
+		child.m_uIndex = 0;
+		child.m_uType = UniformNode;
+
+		uint32_t uFirstChild;
+		if (m_vecFreeNodeBlocks.empty())
+		{
+			// This may reallocate the nodes, which is why they are always referred to by index.
+			uFirstChild = static_cast<uint32_t>(m_vecNodes.size());
+			m_vecNodes.resize(m_vecNodes.size() + 8, child);
+		}
+		else
+		{
+			uFirstChild = m_vecFreeNodeBlocks.back();
+			m_vecFreeNodeBlocks.pop_back();
+			std::fill(m_vecNodes.begin() + uFirstChild, m_vecNodes.begin() + uFirstChild + 8, child);
+		}
+
+		m_vecNodes[uNode].m_uIndex = uFirstChild;
+		m_vecNodes[uNode].m_uType = BranchNode;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Makes a node uniform if all of its voxels have the same value, which is the case for a brick whose voxels are all the same
+	/// or for a branch whose children are all uniform with the same value. Voxels and children outside the volume are never used,
+	/// so they do not stop a node on the upper edge of the volume from collapsing.
+	/// \return Whether the node is now uniform.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool SparseOctreeVolume<VoxelType>::collapseNode(uint32_t uNode, const Vector3DInt32& v3dLowerCorner, uint8_t uSideLengthPower)
+	{
+		const Node& node = m_vecNodes[uNode];
+		if (node.m_uType == BrickNode)
+		{
+			if (m_vecNoOfDifferentVoxels[node.m_uIndex] != 0)
+			{
+				return false;
+			}
+			makeNodeUniform(uNode, m_vecBricks[node.m_uIndex][0]);
+		}
+		else if (node.m_uType == BranchNode)
+		{
+			// The first child is always inside the volume, as the node itself is.
+			const Vector3DInt32 v3dVolumeDimensions = m_regValidRegion.getDimensionsInVoxels();
+			const int32_t iChildSideLength = 1 << (uSideLengthPower - 1);
+			const Node* pChildren = &(m_vecNodes[node.m_uIndex]);
+			for (uint32_t uChild = 0; uChild < 8; uChild++)
+			{
+				const Vector3DInt32 v3dChildLowerCorner = v3dLowerCorner + Vector3DInt32((uChild & 1) ? iChildSideLength : 0, (uChild & 2) ? iChildSideLength : 0, (uChild & 4) ? iChildSideLength : 0);
+				if ((v3dChildLowerCorner.getX() >= v3dVolumeDimensions.getX()) || (v3dChildLowerCorner.getY() >= v3dVolumeDimensions.getY()) || (v3dChildLowerCorner.getZ() >= v3dVolumeDimensions.getZ()))
+				{
+					continue;
+				}
+
+				if ((pChildren[uChild].m_uType != UniformNode) || (!isBytewiseEqual(pChildren[uChild].m_tValue, pChildren[0].m_tValue)))
+				{
+					return false;
+				}
+			}
+			makeNodeUniform(uNode, pChildren[0].m_tValue);
+		}
+
+		return true;
+	}
+
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::makeNodeUniform(uint32_t uNode, const VoxelType& tValue)
+	{
+		// The value may belong to one of the node's children or to its brick, so it is copied before they are released.
+		const VoxelType tNewValue = tValue;
+		releaseChildren(uNode);
+		m_vecNodes[uNode].m_tValue = tNewValue;
+		m_vecNodes[uNode].m_uType = UniformNode;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Releases the children (or brick) of a node, and everything below them, so that they can be reused.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::releaseChildren(uint32_t uNode)
+	{
+		Node& node = m_vecNodes[uNode];
+		if (node.m_uType == BrickNode)
+		{
+			m_vecBricks[node.m_uIndex].reset();
+			m_vecFreeBricks.push_back(node.m_uIndex);
+		}
+		else if (node.m_uType == BranchNode)
+		{
+			for (uint32_t uChild = 0; uChild < 8; uChild++)
+			{
+				releaseChildren(node.m_uIndex + uChild);
+			}
+			m_vecFreeNodeBlocks.push_back(node.m_uIndex);
+		}
+		node.m_uType = UniformNode;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Counts the voxels of a brick which differ from its first voxel. Only the voxels inside the volume are counted, as a brick on
+	/// the upper edge of the volume should collapse once those are all the same.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint32_t SparseOctreeVolume<VoxelType>::countDifferentVoxels(const VoxelType* pBrick, const Vector3DInt32& v3dLowerCorner) const
+	{
+		const Vector3DInt32 v3dVolumeDimensions = m_regValidRegion.getDimensionsInVoxels();
+		const uint32_t uWidth = static_cast<uint32_t>((std::min)(static_cast<int32_t>(m_uBrickSideLength), v3dVolumeDimensions.getX() - v3dLowerCorner.getX()));
+		const uint32_t uHeight = static_cast<uint32_t>((std::min)(static_cast<int32_t>(m_uBrickSideLength), v3dVolumeDimensions.getY() - v3dLowerCorner.getY()));
+		const uint32_t uDepth = static_cast<uint32_t>((std::min)(static_cast<int32_t>(m_uBrickSideLength), v3dVolumeDimensions.getZ() - v3dLowerCorner.getZ()));
+
+		uint32_t uNoOfDifferentVoxels = 0;
+		for (uint32_t z = 0; z < uDepth; z++)
+		{
+			for (uint32_t y = 0; y < uHeight; y++)
+			{
+				for (uint32_t x = 0; x < uWidth; x++)
+				{
+					if (!isBytewiseEqual(pBrick[getBrickIndex(x, y, z)], pBrick[0]))
+					{
+						uNoOfDifferentVoxels++;
+					}
+				}
+			}
+		}
+		return uNoOfDifferentVoxels;
+	}
+}
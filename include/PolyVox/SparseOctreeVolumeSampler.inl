@@ -0,0 +1,379 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+namespace PolyVox
+{
+	template <typename VoxelType>
+	SparseOctreeVolume<VoxelType>::Sampler::Sampler(SparseOctreeVolume<VoxelType>* volume)
+		:BaseVolume<VoxelType>::template Sampler< SparseOctreeVolume<VoxelType> >(volume)
+		, mCurrentVoxel(0)
+	{
+		m_neighbourLeaf.m_region = Region::InvertedRegion();
+		updateCurrentLeaf();
+	}
+
+	template <typename VoxelType>
+	SparseOctreeVolume<VoxelType>::Sampler::~Sampler()
+	{
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::getVoxel(void) const
+	{
+		return *mCurrentVoxel;
+	}
+
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::Sampler::setPosition(const Vector3DInt32& v3dNewPos)
+	{
+		setPosition(v3dNewPos.getX(), v3dNewPos.getY(), v3dNewPos.getZ());
+	}
+
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::Sampler::setPosition(int32_t xPos, int32_t yPos, int32_t zPos)
+	{
+		// Base version updates position.
+		BaseVolume<VoxelType>::template Sampler< SparseOctreeVolume<VoxelType> >::setPosition(xPos, yPos, zPos);
+
+		// The volume may have been written to since the neighbouring leaf was found.
+		m_neighbourLeaf.m_region = Region::InvertedRegion();
+		updateCurrentLeaf();
+	}
+
+	template <typename VoxelType>
+	bool SparseOctreeVolume<VoxelType>::Sampler::setVoxel(VoxelType tValue)
+	{
+		if (!this->mVolume->m_regValidRegion.containsPoint(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume))
+		{
+			return false;
+		}
+
+		// The write can change the structure of the tree, so we have to search it again afterwards.
+		this->mVolume->setVoxel(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume, tValue);
+		m_neighbourLeaf.m_region = Region::InvertedRegion();
+		updateCurrentLeaf();
+		return true;
+	}
+
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::Sampler::movePositiveX(void)
+	{
+		// Base version updates position.
+		BaseVolume<VoxelType>::template Sampler< SparseOctreeVolume<VoxelType> >::movePositiveX();
+
+		if (this->mXPosInVolume <= m_currentLeaf.m_region.getUpperX())
+		{
+			mCurrentVoxel += m_currentLeaf.m_iStrideX;
+		}
+		else
+		{
+			updateCurrentLeaf();
+		}
+	}
+
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::Sampler::movePositiveY(void)
+	{
+		// Base version updates position.
+		BaseVolume<VoxelType>::template Sampler< SparseOctreeVolume<VoxelType> >::movePositiveY();
+
+		if (this->mYPosInVolume <= m_currentLeaf.m_region.getUpperY())
+		{
+			mCurrentVoxel += m_currentLeaf.m_iStrideY;
+		}
+		else
+		{
+			updateCurrentLeaf();
+		}
+	}
+
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::Sampler::movePositiveZ(void)
+	{
+		// Base version updates position.
+		BaseVolume<VoxelType>::template Sampler< SparseOctreeVolume<VoxelType> >::movePositiveZ();
+
+		if (this->mZPosInVolume <= m_currentLeaf.m_region.getUpperZ())
+		{
+			mCurrentVoxel += m_currentLeaf.m_iStrideZ;
+		}
+		else
+		{
+			updateCurrentLeaf();
+		}
+	}
+
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::Sampler::moveNegativeX(void)
+	{
+		// Base version updates position.
+		BaseVolume<VoxelType>::template Sampler< SparseOctreeVolume<VoxelType> >::moveNegativeX();
+
+		if (this->mXPosInVolume >= m_currentLeaf.m_region.getLowerX())
+		{
+			mCurrentVoxel -= m_currentLeaf.m_iStrideX;
+		}
+		else
+		{
+			updateCurrentLeaf();
+		}
+	}
+
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::Sampler::moveNegativeY(void)
+	{
+		// Base version updates position.
+		BaseVolume<VoxelType>::template Sampler< SparseOctreeVolume<VoxelType> >::moveNegativeY();
+
+		if (this->mYPosInVolume >= m_currentLeaf.m_region.getLowerY())
+		{
+			mCurrentVoxel -= m_currentLeaf.m_iStrideY;
+		}
+		else
+		{
+			updateCurrentLeaf();
+		}
+	}
+
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::Sampler::moveNegativeZ(void)
+	{
+		// Base version updates position.
+		BaseVolume<VoxelType>::template Sampler< SparseOctreeVolume<VoxelType> >::moveNegativeZ();
+
+		if (this->mZPosInVolume >= m_currentLeaf.m_region.getLowerZ())
+		{
+			mCurrentVoxel -= m_currentLeaf.m_iStrideZ;
+		}
+		else
+		{
+			updateCurrentLeaf();
+		}
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1nx1ny1nz(void) const
+	{
+		return peekVoxel(-1, -1, -1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1nx1ny0pz(void) const
+	{
+		return peekVoxel(-1, -1, 0);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1nx1ny1pz(void) const
+	{
+		return peekVoxel(-1, -1, 1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1nx0py1nz(void) const
+	{
+		return peekVoxel(-1, 0, -1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1nx0py0pz(void) const
+	{
+		return peekVoxel(-1, 0, 0);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1nx0py1pz(void) const
+	{
+		return peekVoxel(-1, 0, 1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1nx1py1nz(void) const
+	{
+		return peekVoxel(-1, 1, -1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1nx1py0pz(void) const
+	{
+		return peekVoxel(-1, 1, 0);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1nx1py1pz(void) const
+	{
+		return peekVoxel(-1, 1, 1);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel0px1ny1nz(void) const
+	{
+		return peekVoxel(0, -1, -1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel0px1ny0pz(void) const
+	{
+		return peekVoxel(0, -1, 0);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel0px1ny1pz(void) const
+	{
+		return peekVoxel(0, -1, 1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel0px0py1nz(void) const
+	{
+		return peekVoxel(0, 0, -1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel0px0py0pz(void) const
+	{
+		return *mCurrentVoxel;
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel0px0py1pz(void) const
+	{
+		return peekVoxel(0, 0, 1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel0px1py1nz(void) const
+	{
+		return peekVoxel(0, 1, -1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel0px1py0pz(void) const
+	{
+		return peekVoxel(0, 1, 0);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel0px1py1pz(void) const
+	{
+		return peekVoxel(0, 1, 1);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1px1ny1nz(void) const
+	{
+		return peekVoxel(1, -1, -1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1px1ny0pz(void) const
+	{
+		return peekVoxel(1, -1, 0);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1px1ny1pz(void) const
+	{
+		return peekVoxel(1, -1, 1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1px0py1nz(void) const
+	{
+		return peekVoxel(1, 0, -1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1px0py0pz(void) const
+	{
+		return peekVoxel(1, 0, 0);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1px0py1pz(void) const
+	{
+		return peekVoxel(1, 0, 1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1px1py1nz(void) const
+	{
+		return peekVoxel(1, 1, -1);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1px1py0pz(void) const
+	{
+		return peekVoxel(1, 1, 0);
+	}
+
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel1px1py1pz(void) const
+	{
+		return peekVoxel(1, 1, 1);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Neighbours in the current leaf are found directly, and others are found in the most recently used neighbouring leaf if possible.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	VoxelType SparseOctreeVolume<VoxelType>::Sampler::peekVoxel(int32_t iXOffset, int32_t iYOffset, int32_t iZOffset) const
+	{
+		const int32_t iXPos = this->mXPosInVolume + iXOffset;
+		const int32_t iYPos = this->mYPosInVolume + iYOffset;
+		const int32_t iZPos = this->mZPosInVolume + iZOffset;
+		if (m_currentLeaf.m_region.containsPoint(iXPos, iYPos, iZPos))
+		{
+			return *(mCurrentVoxel + iXOffset * m_currentLeaf.m_iStrideX + iYOffset * m_currentLeaf.m_iStrideY + iZOffset * m_currentLeaf.m_iStrideZ);
+		}
+
+		if (!m_neighbourLeaf.m_region.containsPoint(iXPos, iYPos, iZPos))
+		{
+			this->mVolume->findLeaf(iXPos, iYPos, iZPos, m_neighbourLeaf);
+		}
+		return *(m_neighbourLeaf.getVoxel(iXPos, iYPos, iZPos));
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// When the sampler moves out of its leaf it has often moved into the neighbouring leaf which it has been peeking into.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void SparseOctreeVolume<VoxelType>::Sampler::updateCurrentLeaf(void)
+	{
+		if (m_neighbourLeaf.m_region.containsPoint(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume))
+		{
+			std::swap(m_currentLeaf, m_neighbourLeaf);
+		}
+		else
+		{
+			this->mVolume->findLeaf(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume, m_currentLeaf);
+		}
+
+		mCurrentVoxel = m_currentLeaf.getVoxel(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume);
+	}
+}
@@ -0,0 +1,126 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_VolumePyramid_H__
+#define __PolyVox_VolumePyramid_H__
+
+#include "RawVolume.h"
+#include "Region.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace PolyVox
+{
+	namespace DownsampleModes
+	{
+		/// Specifies how each voxel of a VolumePyramid level is calculated from the eight voxels it covers in the level below.
+		enum DownsampleMode
+		{
+			Average = 0, ///< The average of the voxels, which suits densities.
+			Majority = 1 ///< The most common of the voxels, which suits materials. Ties are won by the voxel with the lowest position.
+		};
+	}
+	typedef DownsampleModes::DownsampleMode DownsampleMode;
+
+	/// Maintains a series of lower resolution copies of part of a volume, for extracting meshes of distant regions.
+	///
+	/// Each level of the pyramid is a RawVolume at half the resolution of the level below it, with level zero being the source
+	/// volume itself. A voxel (x,y,z) of level n covers the voxels (2x..2x+1, 2y..2y+1, 2z..2z+1) of level n-1, and so covers a
+	/// block of 2^n voxels on each side of the source. Meshes extracted from a level therefore need to be scaled by 2^n.
+	///
+	/// The levels are divided into chunks, and only the chunks which have been marked as dirty are rebuilt by update(). Changes to
+	/// the source volume are not detected automatically, so pass the regions which have been written (for example those returned by
+	/// consumeChangedRegions()) to markDirty(). When averaging, voxels are summed as AccumulationType, which must be able to hold the
+	/// sum of eight voxels (see LowPassFilter).
+	template <typename VolumeType, typename AccumulationType>
+	class VolumePyramid
+	{
+	public:
+		typedef typename VolumeType::VoxelType VoxelType;
+
+		/// Creates the pyramid for a region of the source volume. All the chunks start out dirty.
+		VolumePyramid(VolumeType* pVolume, const Region& regSource, uint32_t uNoOfLevels, uint16_t uChunkSideLength = 16, DownsampleMode eMode = DownsampleModes::Average);
+
+		/// Gets the number of levels above the source volume.
+		uint32_t getNoOfLevels(void) const;
+		/// Gets a level of the pyramid, where level one is half the resolution of the source volume.
+		RawVolume<VoxelType>* getLevel(uint32_t uLevel);
+		/// Gets the region of the source volume which the pyramid covers.
+		const Region& getSourceRegion(void) const;
+
+		/// Gets how a level is calculated from the level below it.
+		DownsampleMode getDownsampleMode(uint32_t uLevel) const;
+		/// Sets how a level is calculated from the level below it. The level and those above it will be rebuilt by the next update().
+		void setDownsampleMode(uint32_t uLevel, DownsampleMode eMode);
+
+		/// Marks the parts of the pyramid which depend on a region of the source volume as needing to be rebuilt.
+		void markDirty(const Region& regChanged);
+		/// Marks the parts of the pyramid which depend on several regions of the source volume as needing to be rebuilt.
+		void markDirty(const std::vector<Region>& vecChangedRegions);
+		/// Returns whether any chunks need to be rebuilt.
+		bool isDirty(void) const;
+
+		/// Rebuilds the dirty chunks of every level, and returns how many chunks were rebuilt.
+		uint32_t update(void);
+
+	private:
+		struct Level
+		{
+			std::unique_ptr< RawVolume<VoxelType> > m_pVolume;
+			DownsampleMode m_eMode;
+			// The number of chunks on each side, and a flag for each chunk (with x varying fastest) which is set when it needs to be rebuilt.
+			Vector3DInt32 m_v3dNoOfChunks;
+			std::vector<uint8_t> m_vecDirtyChunks;
+			uint32_t m_uNoOfDirtyChunks;
+		};
+
+		// Marks the chunks of a level which overlap a region (in the coordinates of that level) as dirty.
+		void markChunksDirty(uint32_t uLevel, const Region& region);
+		// Calculates the region of a chunk, in the coordinates of its level.
+		Region getChunkRegion(uint32_t uLevel, const Vector3DInt32& v3dChunkPos) const;
+		// Rebuilds a region of a level from the level below it.
+		void rebuildRegion(uint32_t uLevel, const Region& region);
+		// Gets the region of level zero or of one of the levels above it.
+		const Region& getLevelRegion(uint32_t uLevel) const;
+
+		static Region halveRegion(const Region& region);
+
+		VolumeType* m_pVolume;
+		Region m_regSource;
+		uint16_t m_uChunkSideLength;
+
+		// Level n of the pyramid is stored at index n-1.
+		std::vector<Level> m_vecLevels;
+
+		// Buffers which are reused between rebuilds.
+		std::vector<VoxelType> m_vecSrcBuffer;
+		std::vector<VoxelType> m_vecDstBuffer;
+	};
+}
+
+#include "VolumePyramid.inl"
+
+#endif //__PolyVox_VolumePyramid_H__
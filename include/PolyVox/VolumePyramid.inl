@@ -0,0 +1,329 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#include "Impl/ErrorHandling.h"
+#include "Impl/Utility.h"
+
+#include <algorithm>
+#include <stdexcept> //For invalid_argument, out_of_range
+
+namespace PolyVox
+{
+	////////////////////////////////////////////////////////////////////////////////
+	/// The levels are created immediately but are not filled until update() is called.
+	/// \param pVolume The volume to build the pyramid from.
+	/// \param regSource The region of the volume which the pyramid covers.
+	/// \param uNoOfLevels The number of levels to build above the source volume.
+	/// \param uChunkSideLength The side length of the chunks which are rebuilt when part of a level is dirty.
+	/// \param eMode How each level is calculated from the one below it. This can be changed per level by setDownsampleMode().
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VolumeType, typename AccumulationType>
+	VolumePyramid<VolumeType, AccumulationType>::VolumePyramid(VolumeType* pVolume, const Region& regSource, uint32_t uNoOfLevels, uint16_t uChunkSideLength, DownsampleMode eMode)
+		:m_pVolume(pVolume)
+		, m_regSource(regSource)
+		, m_uChunkSideLength(uChunkSideLength)
+	{
+		POLYVOX_THROW_IF(pVolume == nullptr, std::invalid_argument, "A VolumePyramid must have a source volume");
+		POLYVOX_THROW_IF(!regSource.isValid(), std::invalid_argument, "Source region must be valid");
+		POLYVOX_THROW_IF(uNoOfLevels == 0, std::invalid_argument, "A VolumePyramid must have at least one level");
+		POLYVOX_THROW_IF(uChunkSideLength == 0, std::invalid_argument, "Chunk side length cannot be zero");
+
+		Region regLevel = regSource;
+		m_vecLevels.resize(uNoOfLevels);
+		for (auto& level : m_vecLevels)
+		{
+			regLevel = halveRegion(regLevel);
+			level.m_pVolume.reset(new RawVolume<VoxelType>(regLevel));
+			level.m_eMode = eMode;
+			level.m_v3dNoOfChunks = Vector3DInt32(
+				(regLevel.getWidthInVoxels() + uChunkSideLength - 1) / uChunkSideLength,
+				(regLevel.getHeightInVoxels() + uChunkSideLength - 1) / uChunkSideLength,
+				(regLevel.getDepthInVoxels() + uChunkSideLength - 1) / uChunkSideLength);
+			level.m_vecDirtyChunks.assign(level.m_v3dNoOfChunks.getX() * level.m_v3dNoOfChunks.getY() * level.m_v3dNoOfChunks.getZ(), 1);
+			level.m_uNoOfDirtyChunks = static_cast<uint32_t>(level.m_vecDirtyChunks.size());
+		}
+	}
+
+	template <typename VolumeType, typename AccumulationType>
+	uint32_t VolumePyramid<VolumeType, AccumulationType>::getNoOfLevels(void) const
+	{
+		return static_cast<uint32_t>(m_vecLevels.size());
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The returned volume should not be written to, as any changes will be lost when its chunks are rebuilt.
+	/// \param uLevel The level to get, which must be between one and getNoOfLevels().
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VolumeType, typename AccumulationType>
+	RawVolume<typename VolumePyramid<VolumeType, AccumulationType>::VoxelType>* VolumePyramid<VolumeType, AccumulationType>::getLevel(uint32_t uLevel)
+	{
+		POLYVOX_THROW_IF((uLevel == 0) || (uLevel > m_vecLevels.size()), std::out_of_range, "Level is not part of the pyramid");
+		return m_vecLevels[uLevel - 1].m_pVolume.get();
+	}
+
+	template <typename VolumeType, typename AccumulationType>
+	const Region& VolumePyramid<VolumeType, AccumulationType>::getSourceRegion(void) const
+	{
+		return m_regSource;
+	}
+
+	template <typename VolumeType, typename AccumulationType>
+	DownsampleMode VolumePyramid<VolumeType, AccumulationType>::getDownsampleMode(uint32_t uLevel) const
+	{
+		POLYVOX_THROW_IF((uLevel == 0) || (uLevel > m_vecLevels.size()), std::out_of_range, "Level is not part of the pyramid");
+		return m_vecLevels[uLevel - 1].m_eMode;
+	}
+
+	template <typename VolumeType, typename AccumulationType>
+	void VolumePyramid<VolumeType, AccumulationType>::setDownsampleMode(uint32_t uLevel, DownsampleMode eMode)
+	{
+		POLYVOX_THROW_IF((uLevel == 0) || (uLevel > m_vecLevels.size()), std::out_of_range, "Level is not part of the pyramid");
+		if (m_vecLevels[uLevel - 1].m_eMode != eMode)
+		{
+			m_vecLevels[uLevel - 1].m_eMode = eMode;
+
+			// Marking the whole level is enough, as update() marks the levels above it as it goes.
+			markChunksDirty(uLevel, m_vecLevels[uLevel - 1].m_pVolume->getEnclosingRegion());
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Parts of the region which are outside the source region are ignored.
+	/// \param regChanged The region of the source volume which has been modified.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VolumeType, typename AccumulationType>
+	void VolumePyramid<VolumeType, AccumulationType>::markDirty(const Region& regChanged)
+	{
+		Region regCropped = regChanged;
+		regCropped.cropTo(m_regSource);
+		if (regCropped.isValid())
+		{
+			markChunksDirty(1, halveRegion(regCropped));
+		}
+	}
+
+	template <typename VolumeType, typename AccumulationType>
+	void VolumePyramid<VolumeType, AccumulationType>::markDirty(const std::vector<Region>& vecChangedRegions)
+	{
+		for (const auto& regChanged : vecChangedRegions)
+		{
+			markDirty(regChanged);
+		}
+	}
+
+	template <typename VolumeType, typename AccumulationType>
+	bool VolumePyramid<VolumeType, AccumulationType>::isDirty(void) const
+	{
+		for (const auto& level : m_vecLevels)
+		{
+			if (level.m_uNoOfDirtyChunks > 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The levels are rebuilt from the bottom up, and each rebuilt chunk marks the part of the level above it which it affects.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VolumeType, typename AccumulationType>
+	uint32_t VolumePyramid<VolumeType, AccumulationType>::update(void)
+	{
+		uint32_t uNoOfRebuiltChunks = 0;
+		for (uint32_t uLevel = 1; uLevel <= m_vecLevels.size(); uLevel++)
+		{
+			Level& level = m_vecLevels[uLevel - 1];
+			if (level.m_uNoOfDirtyChunks == 0)
+			{
+				continue;
+			}
+
+			uint32_t uIndex = 0;
+			for (int32_t z = 0; z < level.m_v3dNoOfChunks.getZ(); z++)
+			{
+				for (int32_t y = 0; y < level.m_v3dNoOfChunks.getY(); y++)
+				{
+					for (int32_t x = 0; x < level.m_v3dNoOfChunks.getX(); x++, uIndex++)
+					{
+						if (level.m_vecDirtyChunks[uIndex] == 0)
+						{
+							continue;
+						}
+
+						const Region regChunk = getChunkRegion(uLevel, Vector3DInt32(x, y, z));
+						rebuildRegion(uLevel, regChunk);
+						level.m_vecDirtyChunks[uIndex] = 0;
+						uNoOfRebuiltChunks++;
+
+						if (uLevel < m_vecLevels.size())
+						{
+							markChunksDirty(uLevel + 1, halveRegion(regChunk));
+						}
+					}
+				}
+			}
+			level.m_uNoOfDirtyChunks = 0;
+		}
+		return uNoOfRebuiltChunks;
+	}
+
+	template <typename VolumeType, typename AccumulationType>
+	void VolumePyramid<VolumeType, AccumulationType>::markChunksDirty(uint32_t uLevel, const Region& region)
+	{
+		Level& level = m_vecLevels[uLevel - 1];
+		const Vector3DInt32& v3dLevelLowerCorner = level.m_pVolume->getEnclosingRegion().getLowerCorner();
+		const Vector3DInt32 v3dLowerChunk = (region.getLowerCorner() - v3dLevelLowerCorner) / static_cast<int32_t>(m_uChunkSideLength);
+		const Vector3DInt32 v3dUpperChunk = (region.getUpperCorner() - v3dLevelLowerCorner) / static_cast<int32_t>(m_uChunkSideLength);
+
+		for (int32_t z = v3dLowerChunk.getZ(); z <= v3dUpperChunk.getZ(); z++)
+		{
+			for (int32_t y = v3dLowerChunk.getY(); y <= v3dUpperChunk.getY(); y++)
+			{
+				for (int32_t x = v3dLowerChunk.getX(); x <= v3dUpperChunk.getX(); x++)
+				{
+					uint8_t& uDirty = level.m_vecDirtyChunks[x + (y + z * level.m_v3dNoOfChunks.getY()) * level.m_v3dNoOfChunks.getX()];
+					if (uDirty == 0)
+					{
+						uDirty = 1;
+						level.m_uNoOfDirtyChunks++;
+					}
+				}
+			}
+		}
+	}
+
+	template <typename VolumeType, typename AccumulationType>
+	Region VolumePyramid<VolumeType, AccumulationType>::getChunkRegion(uint32_t uLevel, const Vector3DInt32& v3dChunkPos) const
+	{
+		const Region& regLevel = getLevelRegion(uLevel);
+		const Vector3DInt32 v3dLowerCorner = regLevel.getLowerCorner() + v3dChunkPos * static_cast<int32_t>(m_uChunkSideLength);
+		Region regChunk(v3dLowerCorner, v3dLowerCorner + Vector3DInt32(m_uChunkSideLength - 1, m_uChunkSideLength - 1, m_uChunkSideLength - 1));
+		regChunk.cropTo(regLevel);
+		return regChunk;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The voxels below the region are copied into a buffer in one go, and any of them which are outside the level below are ignored
+	/// rather than being read as its border value.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VolumeType, typename AccumulationType>
+	void VolumePyramid<VolumeType, AccumulationType>::rebuildRegion(uint32_t uLevel, const Region& region)
+	{
+		Region regSrc(region.getLowerCorner() * 2, region.getUpperCorner() * 2 + Vector3DInt32(1, 1, 1));
+		regSrc.cropTo(getLevelRegion(uLevel - 1));
+
+		const int32_t iSrcWidth = regSrc.getWidthInVoxels();
+		const int32_t iSrcHeight = regSrc.getHeightInVoxels();
+		m_vecSrcBuffer.resize(static_cast<size_t>(iSrcWidth) * iSrcHeight * regSrc.getDepthInVoxels());
+		if (uLevel == 1)
+		{
+			m_pVolume->readRegion(regSrc, m_vecSrcBuffer.data());
+		}
+		else
+		{
+			m_vecLevels[uLevel - 2].m_pVolume->readRegion(regSrc, m_vecSrcBuffer.data());
+		}
+
+		const DownsampleMode eMode = m_vecLevels[uLevel - 1].m_eMode;
+		m_vecDstBuffer.resize(static_cast<size_t>(region.getWidthInVoxels()) * region.getHeightInVoxels() * region.getDepthInVoxels());
+		auto dstIter = m_vecDstBuffer.begin();
+
+		VoxelType tChildren[8];
+		for (int32_t z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+		{
+			for (int32_t y = region.getLowerY(); y <= region.getUpperY(); y++)
+			{
+				for (int32_t x = region.getLowerX(); x <= region.getUpperX(); x++)
+				{
+					// Gather the children which are inside the level below.
+					uint32_t uNoOfChildren = 0;
+					for (int32_t cz = (std::max)(z * 2, regSrc.getLowerZ()); cz <= (std::min)(z * 2 + 1, regSrc.getUpperZ()); cz++)
+					{
+						for (int32_t cy = (std::max)(y * 2, regSrc.getLowerY()); cy <= (std::min)(y * 2 + 1, regSrc.getUpperY()); cy++)
+						{
+							for (int32_t cx = (std::max)(x * 2, regSrc.getLowerX()); cx <= (std::min)(x * 2 + 1, regSrc.getUpperX()); cx++)
+							{
+								tChildren[uNoOfChildren++] = m_vecSrcBuffer[(cx - regSrc.getLowerX()) + ((cy - regSrc.getLowerY()) + (cz - regSrc.getLowerZ()) * iSrcHeight) * iSrcWidth];
+							}
+						}
+					}
+
+					if (eMode == DownsampleModes::Average)
+					{
+						AccumulationType tSum = AccumulationType();
+						for (uint32_t ct = 0; ct < uNoOfChildren; ct++)
+						{
+							tSum += static_cast<AccumulationType>(tChildren[ct]);
+						}
+						tSum /= uNoOfChildren;
+						*dstIter = static_cast<VoxelType>(tSum);
+					}
+					else
+					{
+						uint32_t uBestChild = 0;
+						uint32_t uBestCount = 0;
+						for (uint32_t ct = 0; ct < uNoOfChildren; ct++)
+						{
+							uint32_t uCount = 0;
+							for (uint32_t other = ct; other < uNoOfChildren; other++)
+							{
+								if (isBytewiseEqual(tChildren[other], tChildren[ct]))
+								{
+									uCount++;
+								}
+							}
+
+							if (uCount > uBestCount)
+							{
+								uBestChild = ct;
+								uBestCount = uCount;
+							}
+						}
+						*dstIter = tChildren[uBestChild];
+					}
+					++dstIter;
+				}
+			}
+		}
+
+		m_vecLevels[uLevel - 1].m_pVolume->writeRegion(region, m_vecDstBuffer.data());
+	}
+
+	template <typename VolumeType, typename AccumulationType>
+	const Region& VolumePyramid<VolumeType, AccumulationType>::getLevelRegion(uint32_t uLevel) const
+	{
+		return (uLevel == 0) ? m_regSource : m_vecLevels[uLevel - 1].m_pVolume->getEnclosingRegion();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Shifting rounds towards negative infinity, so a voxel with a negative coordinate is halved in the same way as a positive one.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VolumeType, typename AccumulationType>
+	Region VolumePyramid<VolumeType, AccumulationType>::halveRegion(const Region& region)
+	{
+		return Region(region.getLowerX() >> 1, region.getLowerY() >> 1, region.getLowerZ() >> 1,
+			region.getUpperX() >> 1, region.getUpperY() >> 1, region.getUpperZ() >> 1);
+	}
+}
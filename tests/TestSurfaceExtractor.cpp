@@ -228,4 +228,20 @@ void TestSurfaceExtractor::testNoiseVolumePerformance()
 	QCOMPARE(noiseMesh.getNoOfVertices(), uint16_t(35672));
 }
 
+void TestSurfaceExtractor::testNoiseVolumeWithApronPerformance()
+{
+	// As above, but the extractor peeks into apron copies of the chunks. These are made by the first extraction, so we measure the
+	// next one (as when a region is extracted again after it has been edited) and check the extra memory which they are using.
+	auto noiseVol = createAndFillVolumeWithNoise< PagedVolume<float> >(128, 128, -1.0f, 1.0f);
+	noiseVol->setChunkApronEnabled(true);
+	Mesh< MarchingCubesVertex< float >, uint16_t > noiseMesh;
+	extractMarchingCubesMeshCustom(noiseVol, Region(32, 32, 32, 63, 63, 63), &noiseMesh);
+	QBENCHMARK{ extractMarchingCubesMeshCustom(noiseVol, Region(32, 32, 32, 63, 63, 63), &noiseMesh); }
+	QCOMPARE(noiseMesh.getNoOfVertices(), uint16_t(35672));
+
+	const PagedVolume<float>::Statistics statistics = noiseVol->getStatistics();
+	QCOMPARE(statistics.uNoOfApronCopies, static_cast<uint32_t>(4));
+	QVERIFY(statistics.uApronSizeInBytes >= statistics.uNoOfApronCopies * 34 * 34 * 34 * sizeof(float));
+}
+
 QTEST_MAIN(TestSurfaceExtractor)
@@ -35,6 +35,7 @@ class TestSurfaceExtractor: public QObject
 		void testBehaviour();
 		void testEmptyVolumePerformance();
 		void testNoiseVolumePerformance();
+		void testNoiseVolumeWithApronPerformance();
 };
 
 #endif
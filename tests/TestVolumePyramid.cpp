@@ -0,0 +1,246 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#include "TestVolumePyramid.h"
+
+#include "PolyVox/PagedVolume.h"
+#include "PolyVox/RawVolume.h"
+#include "PolyVox/VolumePyramid.h"
+
+#include <QtTest>
+
+using namespace PolyVox;
+
+// Fills a volume with a pattern which has some large uniform areas (for the majority tests) and some noise.
+template <typename VolumeType>
+void fillVolume(VolumeType* volData, const Region& region)
+{
+	for (int32_t z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int32_t y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			for (int32_t x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				uint8_t uValue = (y < 4) ? 200 : 0;
+				if ((x * 7 + y * 13 + z * 29) % 11 == 0)
+				{
+					uValue = static_cast<uint8_t>(x * y + z);
+				}
+				volData->setVoxel(x, y, z, uValue);
+			}
+		}
+	}
+}
+
+// Calculates a level of the pyramid the slow way, from the level below, and counts the voxels which do not match it.
+template <typename VolumeType>
+uint32_t countMismatches(VolumeType* pBelow, const Region& regBelow, RawVolume<uint8_t>* pLevel, DownsampleMode eMode)
+{
+	uint32_t uNoOfMismatches = 0;
+	const Region& regLevel = pLevel->getEnclosingRegion();
+	for (int32_t z = regLevel.getLowerZ(); z <= regLevel.getUpperZ(); z++)
+	{
+		for (int32_t y = regLevel.getLowerY(); y <= regLevel.getUpperY(); y++)
+		{
+			for (int32_t x = regLevel.getLowerX(); x <= regLevel.getUpperX(); x++)
+			{
+				std::vector<uint8_t> vecChildren;
+				for (int32_t cz = z * 2; cz <= z * 2 + 1; cz++)
+				{
+					for (int32_t cy = y * 2; cy <= y * 2 + 1; cy++)
+					{
+						for (int32_t cx = x * 2; cx <= x * 2 + 1; cx++)
+						{
+							if (regBelow.containsPoint(cx, cy, cz))
+							{
+								vecChildren.push_back(pBelow->getVoxel(cx, cy, cz));
+							}
+						}
+					}
+				}
+
+				uint8_t uExpected = 0;
+				if (eMode == DownsampleModes::Average)
+				{
+					uint32_t uSum = 0;
+					for (uint8_t uChild : vecChildren)
+					{
+						uSum += uChild;
+					}
+					uExpected = static_cast<uint8_t>(uSum / vecChildren.size());
+				}
+				else
+				{
+					size_t uBestCount = 0;
+					for (uint8_t uChild : vecChildren)
+					{
+						size_t uCount = std::count(vecChildren.begin(), vecChildren.end(), uChild);
+						if (uCount > uBestCount)
+						{
+							uExpected = uChild;
+							uBestCount = uCount;
+						}
+					}
+				}
+
+				if (pLevel->getVoxel(x, y, z) != uExpected)
+				{
+					uNoOfMismatches++;
+				}
+			}
+		}
+	}
+	return uNoOfMismatches;
+}
+
+template <typename VolumeType>
+uint32_t countMismatches(VolumeType* volData, VolumePyramid<VolumeType, uint32_t>& pyramid)
+{
+	uint32_t uNoOfMismatches = countMismatches(volData, pyramid.getSourceRegion(), pyramid.getLevel(1), pyramid.getDownsampleMode(1));
+	for (uint32_t uLevel = 2; uLevel <= pyramid.getNoOfLevels(); uLevel++)
+	{
+		RawVolume<uint8_t>* pBelow = pyramid.getLevel(uLevel - 1);
+		uNoOfMismatches += countMismatches(pBelow, pBelow->getEnclosingRegion(), pyramid.getLevel(uLevel), pyramid.getDownsampleMode(uLevel));
+	}
+	return uNoOfMismatches;
+}
+
+class ZeroPager : public PagedVolume<uint8_t>::Pager
+{
+public:
+	virtual void pageIn(const Region& /*region*/, PagedVolume<uint8_t>::Chunk* pChunk)
+	{
+		pChunk->fill(0);
+	}
+
+	virtual void pageOut(const Region& /*region*/, PagedVolume<uint8_t>::Chunk* /*pChunk*/)
+	{
+	}
+};
+
+void TestVolumePyramid::testAverage()
+{
+	// The region has odd sizes and negative coordinates, so some voxels of each level cover fewer than eight voxels below them.
+	const Region reg(-13, -5, 2, 50, 40, 66);
+	RawVolume<uint8_t> volData(reg);
+	fillVolume(&volData, reg);
+
+	VolumePyramid< RawVolume<uint8_t>, uint32_t > pyramid(&volData, reg, 4, 8);
+	QCOMPARE(pyramid.getLevel(1)->getEnclosingRegion(), Region(-7, -3, 1, 25, 20, 33));
+	QCOMPARE(pyramid.getLevel(4)->getEnclosingRegion(), Region(-1, -1, 0, 3, 2, 4));
+	QVERIFY(pyramid.isDirty());
+
+	QBENCHMARK
+	{
+		pyramid.markDirty(reg);
+		pyramid.update();
+	}
+	QVERIFY(!pyramid.isDirty());
+	QCOMPARE(countMismatches(&volData, pyramid), static_cast<uint32_t>(0));
+}
+
+void TestVolumePyramid::testMajority()
+{
+	const Region reg(0, 0, 0, 63, 31, 63);
+	RawVolume<uint8_t> volData(reg);
+	fillVolume(&volData, reg);
+
+	// Use majority for the lower levels and averages above them.
+	VolumePyramid< RawVolume<uint8_t>, uint32_t > pyramid(&volData, reg, 3, 16, DownsampleModes::Majority);
+	pyramid.setDownsampleMode(3, DownsampleModes::Average);
+	pyramid.update();
+	QCOMPARE(countMismatches(&volData, pyramid), static_cast<uint32_t>(0));
+
+	// The noise should have been removed by the majority vote.
+	QCOMPARE(pyramid.getLevel(2)->getVoxel(5, 0, 5), static_cast<uint8_t>(200));
+	QCOMPARE(pyramid.getLevel(2)->getVoxel(5, 7, 5), static_cast<uint8_t>(0));
+
+	// Changing the mode of a level means it has to be rebuilt.
+	pyramid.setDownsampleMode(2, DownsampleModes::Average);
+	QVERIFY(pyramid.isDirty());
+	pyramid.update();
+	QCOMPARE(countMismatches(&volData, pyramid), static_cast<uint32_t>(0));
+
+	// Invalid levels are rejected.
+	bool bExceptionThrown = false;
+	try
+	{
+		pyramid.getLevel(4);
+	}
+	catch (const std::out_of_range&)
+	{
+		bExceptionThrown = true;
+	}
+	QVERIFY(bExceptionThrown);
+}
+
+void TestVolumePyramid::testIncrementalUpdate()
+{
+	const Region reg(0, 0, 0, 255, 63, 255);
+	RawVolume<uint8_t> volData(reg);
+	fillVolume(&volData, reg);
+
+	VolumePyramid< RawVolume<uint8_t>, uint32_t > pyramid(&volData, reg, 3, 16);
+	const uint32_t uNoOfChunks = pyramid.update();
+	QCOMPARE(uNoOfChunks, static_cast<uint32_t>(8 * 2 * 8 + 4 * 1 * 4 + 2 * 1 * 2));
+
+	// An edit inside a single chunk of each level only causes those chunks to be rebuilt.
+	const Region regEdit(40, 10, 40, 47, 17, 47);
+	uint8_t uValue = 0;
+	QBENCHMARK
+	{
+		volData.fill(regEdit, uValue++);
+		pyramid.markDirty(regEdit);
+		QCOMPARE(pyramid.update(), static_cast<uint32_t>(3));
+	}
+	QCOMPARE(countMismatches(&volData, pyramid), static_cast<uint32_t>(0));
+
+	// Edits outside the source region are ignored.
+	pyramid.markDirty(Region(300, 0, 0, 310, 10, 10));
+	QVERIFY(!pyramid.isDirty());
+}
+
+void TestVolumePyramid::testChangeTracking()
+{
+	ZeroPager pager;
+	PagedVolume<uint8_t> volData(&pager, 64 * 1024 * 1024, 32);
+	volData.setChangeTrackingEnabled(true);
+
+	// The pyramid only covers part of the (unbounded) PagedVolume.
+	const Region reg(-64, -32, -64, 63, 31, 63);
+	fillVolume(&volData, reg);
+	VolumePyramid< PagedVolume<uint8_t>, uint32_t > pyramid(&volData, reg, 2, 16);
+	pyramid.update();
+	volData.consumeChangedRegions(Vector3DInt32(32, 32, 32));
+	QCOMPARE(countMismatches(&volData, pyramid), static_cast<uint32_t>(0));
+
+	// The regions which need meshing again also tell the pyramid what to rebuild.
+	volData.setVoxel(-20, 0, 30, 99);
+	volData.fill(Region(0, -20, 0, 40, -10, 5), 50);
+	pyramid.markDirty(volData.consumeChangedRegions(Vector3DInt32(32, 32, 32)));
+	QVERIFY(pyramid.update() > 0);
+	QCOMPARE(countMismatches(&volData, pyramid), static_cast<uint32_t>(0));
+}
+
+QTEST_MAIN(TestVolumePyramid)
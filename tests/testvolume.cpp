@@ -24,14 +24,28 @@
 
 #include "testvolume.h"
 
+#include "PolyVox/AStarPathfinder.h"
+#include "PolyVox/CubicSurfaceExtractor.h"
 #include "PolyVox/FilePager.h"
+#include "PolyVox/MarchingCubesSurfaceExtractor.h"
+#include "PolyVox/PackFilePager.h"
 #include "PolyVox/PagedVolume.h"
 #include "PolyVox/RawVolume.h"
+#include "PolyVox/Raycast.h"
+#include "PolyVox/SparseOctreeVolume.h"
 
 #include <QtGlobal>
 #include <QtTest>
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <future>
+#include <mutex>
 #include <random>
+#include <sstream>
+#include <thread>
 
 using namespace PolyVox;
 
@@ -246,6 +260,115 @@ int32_t testDirectRandomAccess(const VolumeType* volume)
 	return result;
 }
 
+// Fills each chunk with a value computed from its position, and never stores anything. This makes paging very cheap,
+// so that tests which use it mostly measure the cost of the PagedVolume managing its chunks.
+class PositionPager : public PagedVolume<int32_t>::Pager
+{
+public:
+	virtual void pageIn(const Region& region, PagedVolume<int32_t>::Chunk* pChunk)
+	{
+		uint32_t noOfVoxels = region.getWidthInVoxels() * region.getHeightInVoxels() * region.getDepthInVoxels();
+		std::fill(pChunk->getData(), pChunk->getData() + noOfVoxels, region.getLowerX() + region.getLowerY() + region.getLowerZ());
+	}
+
+	virtual void pageOut(const Region& /*region*/, PagedVolume<int32_t>::Chunk* /*pChunk*/)
+	{
+	}
+};
+
+// Counts how many chunks have been paged in.
+class CountingPositionPager : public PositionPager
+{
+public:
+	virtual void pageIn(const Region& region, PagedVolume<int32_t>::Chunk* pChunk)
+	{
+		m_uNoOfPageIns++;
+		PositionPager::pageIn(region, pChunk);
+	}
+
+	uint32_t m_uNoOfPageIns = 0;
+};
+
+// Records the volume's count of modified chunks while each chunk is being paged in.
+class DirtyCountingPager : public PositionPager
+{
+public:
+	virtual void pageIn(const Region& region, PagedVolume<int32_t>::Chunk* pChunk)
+	{
+		m_uNoOfPageIns++;
+		PositionPager::pageIn(region, pChunk);
+		m_uMaxNoOfDirtyChunks = (std::max)(m_uMaxNoOfDirtyChunks, m_pVolume->getStatistics().uNoOfDirtyChunks);
+	}
+
+	PagedVolume<int32_t>* m_pVolume = nullptr;
+	uint32_t m_uNoOfPageIns = 0;
+	uint32_t m_uMaxNoOfDirtyChunks = 0;
+};
+
+// Generates solid ground below y = 0 and air above it. Every chunk is uniform and is reported as such.
+class GroundPager : public PagedVolume<int32_t>::Pager
+{
+public:
+	virtual void pageIn(const Region& region, PagedVolume<int32_t>::Chunk* pChunk)
+	{
+		m_uNoOfPageIns++;
+		pChunk->fill(region.getLowerY() < 0 ? 1 : 0);
+	}
+
+	virtual void pageOut(const Region& /*region*/, PagedVolume<int32_t>::Chunk* /*pChunk*/)
+	{
+	}
+
+	uint32_t m_uNoOfPageIns = 0;
+};
+
+// Behaves like a FilePager which is writing to a slow disk.
+class SlowFilePager : public FilePager<int32_t>
+{
+public:
+	virtual void pageOut(const Region& region, PagedVolume<int32_t>::Chunk* pChunk)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		FilePager<int32_t>::pageOut(region, pChunk);
+	}
+};
+
+// Writes chunks like a FilePager, but holds on to each one for a while afterwards (as if waiting for the disk to catch up)
+// so that a test can use it during a page-out. It can also be told to fail, as if the disk was full.
+class PausingFilePager : public FilePager<int32_t>
+{
+public:
+	virtual void pageOut(const Region& region, PagedVolume<int32_t>::Chunk* pChunk)
+	{
+		if (m_bFailPageOuts)
+		{
+			throw std::runtime_error("Simulated page-out failure");
+		}
+
+		FilePager<int32_t>::pageOut(region, pChunk);
+		m_bPageOutStarted = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	std::atomic<bool> m_bPageOutStarted{ false };
+	std::atomic<bool> m_bFailPageOuts{ false };
+};
+
+// Reads one voxel from each of a sequence of chunks, which is spread over a 16x16xN block so that the chunks hash well.
+int32_t testChunkSequence(PagedVolume<int32_t>* volume, uint16_t uChunkSideLength, uint32_t uNoOfChunks, uint32_t uNoOfAccesses)
+{
+	int32_t result = 0;
+	for (uint32_t ct = 0; ct < uNoOfAccesses; ct++)
+	{
+		uint32_t uChunk = ct % uNoOfChunks;
+		int32_t x = static_cast<int32_t>(uChunk & 0xF) * uChunkSideLength;
+		int32_t y = static_cast<int32_t>((uChunk >> 4) & 0xF) * uChunkSideLength;
+		int32_t z = static_cast<int32_t>(uChunk >> 8) * uChunkSideLength;
+		result = cantorTupleFunction(result, volume->getVoxel(x, y, z));
+	}
+	return result;
+}
+
 TestVolume::TestVolume()
 {
 	m_regVolume = Region(-57, -31, 12, 64, 96, 131); // Deliberatly awkward size
@@ -260,11 +383,16 @@ TestVolume::TestVolume()
 
 	m_pFilePager = new FilePager<int32_t>(".");
 	m_pFilePagerHighMem = new FilePager<int32_t>(".");
+	m_pFilePagerThreadSafe = new FilePager<int32_t>(".");
+	m_pFilePagerStatic = new FilePager<int32_t, m_uChunkSideLength>(".");
 
 	//Create the volumes
 	m_pRawVolume = new RawVolume<int32_t>(m_regVolume);
 	m_pPagedVolume = new PagedVolume<int32_t>(m_pFilePager, 1 * 1024 * 1024, m_uChunkSideLength);
 	m_pPagedVolumeHighMem = new PagedVolume<int32_t>(m_pFilePagerHighMem, 256 * 1024 * 1024, m_uChunkSideLength);
+	m_pPagedVolumeThreadSafe = new PagedVolume<int32_t>(m_pFilePagerThreadSafe, 1 * 1024 * 1024, m_uChunkSideLength, true);
+	m_pStaticPagedVolume = new PagedVolume<int32_t, m_uChunkSideLength>(m_pFilePagerStatic, 1 * 1024 * 1024);
+	m_pSparseOctreeVolume = new SparseOctreeVolume<int32_t>(m_regVolume);
 
 	//Fill the volume with some data
 	for (int z = m_regVolume.getLowerZ(); z <= m_regVolume.getUpperZ(); z++)
@@ -277,6 +405,9 @@ TestVolume::TestVolume()
 				m_pRawVolume->setVoxel(x, y, z, value);
 				m_pPagedVolume->setVoxel(x, y, z, value);
 				m_pPagedVolumeHighMem->setVoxel(x, y, z, value);
+				m_pPagedVolumeThreadSafe->setVoxel(x, y, z, value);
+				m_pStaticPagedVolume->setVoxel(x, y, z, value);
+				m_pSparseOctreeVolume->setVoxel(x, y, z, value);
 			}
 		}
 	}
@@ -301,8 +432,13 @@ TestVolume::~TestVolume()
 
 	delete m_pRawVolume;
 	delete m_pPagedVolume;
+	delete m_pPagedVolumeThreadSafe;
+	delete m_pStaticPagedVolume;
+	delete m_pSparseOctreeVolume;
 
 	delete m_pFilePager;
+	delete m_pFilePagerThreadSafe;
+	delete m_pFilePagerStatic;
 }
 
 /*
@@ -481,6 +617,202 @@ void TestVolume::testPagedVolumeSamplersWithExternalBackwards()
 	QCOMPARE(result, static_cast<int32_t>(-993539594));
 }
 
+/*
+ * PagedVolume (with the chunk side length as a template parameter) Tests
+ */
+
+void TestVolume::testStaticPagedVolumeDirectAccessAllInternalForwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingForwards(m_pStaticPagedVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(1004598054));
+}
+
+void TestVolume::testStaticPagedVolumeSamplersAllInternalForwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingForwards(m_pStaticPagedVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(1004598054));
+}
+
+void TestVolume::testStaticPagedVolumeDirectAccessWithExternalForwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingForwards(m_pStaticPagedVolume, m_regExternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(337227750));
+}
+
+void TestVolume::testStaticPagedVolumeSamplersWithExternalForwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingForwards(m_pStaticPagedVolume, m_regExternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(337227750));
+}
+
+void TestVolume::testStaticPagedVolumeDirectAccessAllInternalBackwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingBackwards(m_pStaticPagedVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(-269366578));
+}
+
+void TestVolume::testStaticPagedVolumeSamplersAllInternalBackwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingBackwards(m_pStaticPagedVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(-269366578));
+}
+
+void TestVolume::testStaticPagedVolumeDirectAccessWithExternalBackwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingBackwards(m_pStaticPagedVolume, m_regExternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(-993539594));
+}
+
+void TestVolume::testStaticPagedVolumeSamplersWithExternalBackwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingBackwards(m_pStaticPagedVolume, m_regExternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(-993539594));
+}
+
+void TestVolume::testStaticPagedVolumeChunkSideLength()
+{
+	QCOMPARE(m_pStaticPagedVolume->getChunkSideLength(), static_cast<uint16_t>(m_uChunkSideLength));
+	QCOMPARE(m_pPagedVolume->getChunkSideLength(), static_cast<uint16_t>(m_uChunkSideLength));
+
+	// The constructor's chunk side length must agree with the template parameter.
+	FilePager<int32_t, 16> pager(".");
+	bool bExceptionThrown = false;
+	try
+	{
+		PagedVolume<int32_t, 16> volume(&pager, 1 * 1024 * 1024, 32);
+	}
+	catch (const std::invalid_argument&)
+	{
+		bExceptionThrown = true;
+	}
+	QVERIFY(bExceptionThrown);
+
+	// Otherwise the volume behaves just like one with a runtime side length.
+	PagedVolume<int32_t, 16> volume(&pager, 1 * 1024 * 1024);
+	QCOMPARE(volume.getChunkSideLength(), static_cast<uint16_t>(16));
+	volume.setVoxel(-17, 5, 40, 123);
+	QCOMPARE(volume.getVoxel(-17, 5, 40), static_cast<int32_t>(123));
+	PagedVolume<int32_t, 16>::Sampler sampler(&volume);
+	sampler.setPosition(-16, 5, 40);
+	QCOMPARE(sampler.peekVoxel1nx0py0pz(), static_cast<int32_t>(123));
+}
+
+/*
+ * SparseOctreeVolume Tests
+ */
+
+void TestVolume::testSparseOctreeVolumeDirectAccessAllInternalForwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingForwards(m_pSparseOctreeVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(1004598054));
+}
+
+void TestVolume::testSparseOctreeVolumeSamplersAllInternalForwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingForwards(m_pSparseOctreeVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(1004598054));
+}
+
+void TestVolume::testSparseOctreeVolumeDirectAccessWithExternalForwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingForwards(m_pSparseOctreeVolume, m_regExternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(337227750));
+}
+
+void TestVolume::testSparseOctreeVolumeSamplersWithExternalForwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingForwards(m_pSparseOctreeVolume, m_regExternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(337227750));
+}
+
+void TestVolume::testSparseOctreeVolumeDirectAccessAllInternalBackwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingBackwards(m_pSparseOctreeVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(-269366578));
+}
+
+void TestVolume::testSparseOctreeVolumeSamplersAllInternalBackwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingBackwards(m_pSparseOctreeVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(-269366578));
+}
+
+void TestVolume::testSparseOctreeVolumeDirectAccessWithExternalBackwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingBackwards(m_pSparseOctreeVolume, m_regExternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(-993539594));
+}
+
+void TestVolume::testSparseOctreeVolumeSamplersWithExternalBackwards()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingBackwards(m_pSparseOctreeVolume, m_regExternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(-993539594));
+}
+
 /*
  * Random access tests
  */
@@ -600,4 +932,2090 @@ void TestVolume::testPagedVolumeChunkRandomAccess()
 	QCOMPARE(result, static_cast<int32_t>(71649197));
 }
 
+/*
+ * Threaded tests
+ */
+
+void TestVolume::testPagedVolumeThreadedReads()
+{
+	std::vector<int32_t> results(m_uNoOfThreads, 0);
+	QBENCHMARK
+	{
+		std::vector<std::thread> threads;
+		for (uint32_t ct = 0; ct < m_uNoOfThreads; ct++)
+		{
+			// Mix direct access and samplers, as these hold on to chunks in different ways. The volume has a small
+			// memory limit so that the threads also contend for paging chunks in and out.
+			threads.push_back(std::thread([this, ct, &results]()
+			{
+				results[ct] = (ct % 2 == 0) ?
+					testDirectAccessWithWrappingForwards(m_pPagedVolumeThreadSafe, m_regInternal) :
+					testSamplersWithWrappingForwards(m_pPagedVolumeThreadSafe, m_regInternal);
+			}));
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	for (uint32_t ct = 0; ct < m_uNoOfThreads; ct++)
+	{
+		QCOMPARE(results[ct], static_cast<int32_t>(1004598054));
+	}
+}
+
+void TestVolume::testPagedVolumeThreadedWrites()
+{
+	FilePager<int32_t> filePager(".");
+	PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, m_uChunkSideLength, true);
+
+	QBENCHMARK
+	{
+		std::vector<std::thread> threads;
+		for (uint32_t ct = 0; ct < m_uNoOfThreads; ct++)
+		{
+			// Each thread writes every n'th slice, so several threads are usually writing to the same chunk at the same time.
+			threads.push_back(std::thread([this, ct, &volume]()
+			{
+				for (int z = m_regVolume.getLowerZ() + ct; z <= m_regVolume.getUpperZ(); z += m_uNoOfThreads)
+				{
+					for (int y = m_regVolume.getLowerY(); y <= m_regVolume.getUpperY(); y++)
+					{
+						for (int x = m_regVolume.getLowerX(); x <= m_regVolume.getUpperX(); x++)
+						{
+							volume.setVoxel(x, y, z, x + y + z);
+						}
+					}
+				}
+			}));
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	int32_t result = testDirectAccessWithWrappingForwards(&volume, m_regInternal);
+	QCOMPARE(result, static_cast<int32_t>(1004598054));
+}
+
+void TestVolume::testPagedVolumeShortLivedThreads()
+{
+	FilePager<int32_t> filePager(".");
+	PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, m_uChunkSideLength, true);
+
+	// Each thread writes to its own chunk, which stays in the thread's cache until the thread exits. The threads wait for each
+	// other before exiting, so that they cannot reuse the ids of those which have already finished.
+	const uint32_t uNoOfThreads = 100;
+	std::mutex mutex;
+	std::condition_variable cvWritten;
+	uint32_t uNoOfWrites = 0;
+
+	std::vector<std::thread> threads;
+	for (uint32_t ct = 0; ct < uNoOfThreads; ct++)
+	{
+		threads.push_back(std::thread([this, ct, &volume, &mutex, &cvWritten, &uNoOfWrites]()
+		{
+			volume.setVoxel(ct * m_uChunkSideLength, 0, 0, ct + 1);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			uNoOfWrites++;
+			cvWritten.notify_all();
+			cvWritten.wait(lock, [&uNoOfWrites, uNoOfThreads]() { return uNoOfWrites == uNoOfThreads; });
+		}));
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	// The caches of the threads which have exited must not keep their chunks in memory.
+	volume.flushAll();
+	PagedVolume<int32_t>::Statistics statistics = volume.getStatistics();
+	QCOMPARE(statistics.uNoOfResidentChunks, static_cast<uint32_t>(0));
+	QCOMPARE(statistics.uNoOfPageOuts, static_cast<uint64_t>(uNoOfThreads));
+	QCOMPARE(statistics.uNoOfChunkCacheMisses, static_cast<uint64_t>(uNoOfThreads));
+
+	int32_t iErrors = 0;
+	for (uint32_t ct = 0; ct < uNoOfThreads; ct++)
+	{
+		iErrors += (volume.getVoxel(ct * m_uChunkSideLength, 0, 0) == static_cast<int32_t>(ct + 1)) ? 0 : 1;
+	}
+	QCOMPARE(iErrors, static_cast<int32_t>(0));
+}
+
+/*
+ * Chunk miss tests
+ */
+
+int32_t TestVolume::testPagedVolumeMissCost(uint32_t uTargetMemoryUsageInBytes)
+{
+	// Small chunks keep the cost of paging them in low compared to the cost of finding and evicting chunks.
+	const uint16_t uChunkSideLength = 8;
+	const uint32_t uNoOfResidentChunks = uTargetMemoryUsageInBytes / (uChunkSideLength * uChunkSideLength * uChunkSideLength * sizeof(int32_t));
+
+	PositionPager pager;
+	PagedVolume<int32_t> volume(&pager, uTargetMemoryUsageInBytes, uChunkSideLength);
+
+	// The sequence covers twice as many chunks as the volume can hold, and the chunks are visited in order. With least
+	// recently used eviction this means every access is a miss, and the volume is kept full so every miss evicts a chunk.
+	const uint32_t uNoOfChunks = uNoOfResidentChunks * 2;
+	const uint32_t uNoOfAccesses = 16384;
+	testChunkSequence(&volume, uChunkSideLength, uNoOfChunks, uNoOfChunks);
+
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testChunkSequence(&volume, uChunkSideLength, uNoOfChunks, uNoOfAccesses);
+	}
+	return result;
+}
+
+void TestVolume::testPagedVolumeMissCostFewChunks()
+{
+	int32_t result = testPagedVolumeMissCost(1 * 1024 * 1024); // 512 resident chunks
+	QCOMPARE(result, static_cast<int32_t>(-271542535));
+}
+
+void TestVolume::testPagedVolumeMissCostManyChunks()
+{
+	int32_t result = testPagedVolumeMissCost(32 * 1024 * 1024); // 16384 resident chunks
+	QCOMPARE(result, static_cast<int32_t>(681404593));
+}
+
+void TestVolume::testPagedVolumeLargeChunkCount()
+{
+	// The chunk array used to have a fixed size, which limited a volume to 32768 chunks.
+	const uint16_t uChunkSideLength = 8;
+	const uint32_t uNoOfChunks = 65536;
+	const uint64_t uChunkSizeInBytes = uChunkSideLength * uChunkSideLength * uChunkSideLength + sizeof(PagedVolume<uint8_t>::Chunk);
+
+	FilePager<uint8_t> pager(".");
+	PagedVolume<uint8_t> volume(&pager, uNoOfChunks * uChunkSizeInBytes, uChunkSideLength);
+
+	// Touch a block of 64x64x16 chunks around the origin. The values are never zero, so every chunk has to allocate its data.
+	for (uint32_t ct = 0; ct < uNoOfChunks; ct++)
+	{
+		int32_t x = (static_cast<int32_t>(ct & 0x3F) - 32) * uChunkSideLength;
+		int32_t y = (static_cast<int32_t>((ct >> 6) & 0x3F) - 32) * uChunkSideLength;
+		int32_t z = (static_cast<int32_t>(ct >> 12) - 8) * uChunkSideLength;
+		volume.setVoxel(x, y, z, static_cast<uint8_t>(ct % 255 + 1));
+	}
+
+	QCOMPARE(volume.calculateSizeInBytes(), uNoOfChunks * uChunkSizeInBytes);
+
+	// All the chunks should still be resident, with the values we wrote.
+	uint32_t uNoOfMismatches = 0;
+	for (uint32_t ct = 0; ct < uNoOfChunks; ct++)
+	{
+		int32_t x = (static_cast<int32_t>(ct & 0x3F) - 32) * uChunkSideLength;
+		int32_t y = (static_cast<int32_t>((ct >> 6) & 0x3F) - 32) * uChunkSideLength;
+		int32_t z = (static_cast<int32_t>(ct >> 12) - 8) * uChunkSideLength;
+		if (volume.getVoxel(x, y, z) != static_cast<uint8_t>(ct % 255 + 1))
+		{
+			uNoOfMismatches++;
+		}
+	}
+
+	QCOMPARE(uNoOfMismatches, static_cast<uint32_t>(0));
+	QCOMPARE(volume.calculateSizeInBytes(), uNoOfChunks * uChunkSizeInBytes);
+}
+
+/*
+ * Paging tests
+ */
+
+void TestVolume::testPagedVolumePrefetchAsync()
+{
+	PositionPager pager;
+	PagedVolume<int32_t> volume(&pager, 64 * 1024 * 1024, m_uChunkSideLength);
+
+	// Two overlapping requests, so some chunks are requested while they are already being paged in.
+	std::future<void> future = volume.prefetchAsync(m_regVolume);
+	std::future<void> futureHighPriority = volume.prefetchAsync(m_regInternal, 1);
+
+	// Reading while the prefetch is in progress should either find chunks which are already loaded, or wait for them.
+	int32_t result = testSamplersWithWrappingForwards(&volume, m_regInternal);
+
+	future.get();
+	futureHighPriority.get();
+
+	// m_regVolume covers 5x5x5 chunks, and all of them should now be loaded.
+	QCOMPARE(volume.calculateSizeInBytes(), static_cast<uint64_t>(5 * 5 * 5 * (m_uChunkSideLength * m_uChunkSideLength * m_uChunkSideLength * sizeof(int32_t) + sizeof(PagedVolume<int32_t>::Chunk))));
+	QCOMPARE(result, testSamplersWithWrappingForwards(&volume, m_regInternal));
+
+	// An invalid region is rejected, rather than returning a future which is never completed.
+	bool bThrown = false;
+	try
+	{
+		volume.prefetchAsync(Region(10, 10, 10, 0, 0, 0));
+	}
+	catch (const std::invalid_argument&)
+	{
+		bThrown = true;
+	}
+	QVERIFY(bThrown);
+}
+
+void TestVolume::testPagedVolumePageOutQueue()
+{
+	SlowFilePager filePager;
+	PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, m_uChunkSideLength, true);
+
+	// A short queue, so that writing the volume is often held up waiting for the writer thread.
+	volume.setPageOutQueueLength(4);
+
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		for (int z = m_regVolume.getLowerZ(); z <= m_regVolume.getUpperZ(); z++)
+		{
+			for (int y = m_regVolume.getLowerY(); y <= m_regVolume.getUpperY(); y++)
+			{
+				for (int x = m_regVolume.getLowerX(); x <= m_regVolume.getUpperX(); x++)
+				{
+					volume.setVoxel(x, y, z, x + y + z);
+				}
+			}
+		}
+
+		// Reading back in the opposite order first finds the chunks which are still loaded, and then those which were
+		// evicted most recently. With a slow Pager these are still queued and are brought back without being paged in.
+		result = testDirectAccessWithWrappingBackwards(&volume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(-269366578));
+}
+
+void TestVolume::testPagedVolumeWriteDuringPageOut()
+{
+	const uint16_t uChunkSideLength = 16;
+	PausingFilePager filePager;
+
+	{
+		PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, uChunkSideLength, true);
+		volume.setPageOutQueueLength(4);
+		volume.setVoxel(0, 0, 0, 1);
+
+		// Read other chunks until the modified one is evicted and the Pager has copied its data.
+		for (int32_t x = uChunkSideLength; !filePager.m_bPageOutStarted; x += uChunkSideLength)
+		{
+			volume.getVoxel(x, 0, 0);
+		}
+
+		// One thread brings the chunk back and another writes to it, both while the page-out is still in progress.
+		std::thread reader([&volume]{ volume.getVoxel(1, 0, 0); });
+		std::thread writer([&volume]
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			volume.setVoxel(0, 0, 0, 42);
+		});
+		reader.join();
+		writer.join();
+
+		volume.flushAll();
+		QCOMPARE(volume.getVoxel(0, 0, 0), static_cast<int32_t>(42));
+	}
+
+	{
+		PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, uChunkSideLength, true);
+		QCOMPARE(volume.getVoxel(0, 0, 0), static_cast<int32_t>(42));
+
+		// A chunk which fails to page out is kept, and still modified, so that it can be read back and written by the next flush.
+		volume.setPageOutQueueLength(4);
+		volume.setVoxel(0, 0, 0, 43);
+		filePager.m_bFailPageOuts = true;
+		volume.flushAll();
+		QCOMPARE(volume.getStatistics().uNoOfQueuedChunks, static_cast<uint32_t>(1));
+		QCOMPARE(volume.getVoxel(0, 0, 0), static_cast<int32_t>(43));
+		filePager.m_bFailPageOuts = false;
+		volume.flushAll();
+		QCOMPARE(volume.getStatistics().uNoOfQueuedChunks, static_cast<uint32_t>(0));
+	}
+
+	{
+		PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, uChunkSideLength, true);
+		QCOMPARE(volume.getVoxel(0, 0, 0), static_cast<int32_t>(43));
+	}
+}
+
+void TestVolume::testPagedVolumeCompression()
+{
+	// Small chunks so that the volume holds 32 uncompressed chunks and has space left for compressed ones.
+	const uint16_t uChunkSideLength = 16;
+
+	FilePager<int32_t> filePager(".");
+	PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, uChunkSideLength, true);
+	volume.setChunkCompression(ChunkCompressions::RLEAndLZ);
+	volume.setPageOutQueueLength(4);
+
+	// Every voxel is different so this data barely compresses, and many modified chunks are passed on to the Pager
+	// from the compressed tier. Reading it back then finds chunks in each tier as well as in the Pager.
+	for (int z = m_regVolume.getLowerZ(); z <= m_regVolume.getUpperZ(); z++)
+	{
+		for (int y = m_regVolume.getLowerY(); y <= m_regVolume.getUpperY(); y++)
+		{
+			for (int x = m_regVolume.getLowerX(); x <= m_regVolume.getUpperX(); x++)
+			{
+				volume.setVoxel(x, y, z, x + y + z);
+			}
+		}
+	}
+
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingBackwards(&volume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(-269366578));
+	QVERIFY(volume.calculateSizeInBytes() <= 1 * 1024 * 1024);
+}
+
+void TestVolume::testPagedVolumeCompressionAvoidsPaging()
+{
+	const uint16_t uChunkSideLength = 16;
+	const uint32_t uNoOfChunks = 1024;
+
+	CountingPositionPager pager;
+	PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, uChunkSideLength);
+	volume.setChunkCompression(ChunkCompressions::RLE);
+
+	// Only 32 chunks fit uncompressed, but each of these chunks holds a single value and so compresses to almost nothing.
+	int32_t expectedResult = testChunkSequence(&volume, uChunkSideLength, uNoOfChunks, uNoOfChunks);
+	QCOMPARE(pager.m_uNoOfPageIns, uNoOfChunks);
+
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testChunkSequence(&volume, uChunkSideLength, uNoOfChunks, uNoOfChunks);
+	}
+
+	// Revisiting the chunks should only have required them to be decompressed.
+	QCOMPARE(result, expectedResult);
+	QCOMPARE(pager.m_uNoOfPageIns, uNoOfChunks);
+	QVERIFY(volume.calculateSizeInBytes() <= 1 * 1024 * 1024);
+}
+
+void TestVolume::testPagedVolumeUniformChunks()
+{
+	const uint16_t uChunkSideLength = 16;
+	const uint32_t uNoOfChunks = 4096;
+
+	GroundPager pager;
+	PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, uChunkSideLength);
+
+	// Only 64 chunks would fit if they allocated their data, but uniform chunks are much smaller so all of these stay loaded.
+	int32_t expectedResult = testChunkSequence(&volume, uChunkSideLength, uNoOfChunks, uNoOfChunks);
+	QCOMPARE(testChunkSequence(&volume, uChunkSideLength, uNoOfChunks, uNoOfChunks), expectedResult);
+	QCOMPARE(pager.m_uNoOfPageIns, uNoOfChunks);
+	QVERIFY(volume.calculateSizeInBytes() < 1 * 1024 * 1024);
+
+	// Writing a value which a chunk already has leaves it uniform, while other values cause the data to be allocated.
+	Region region(-20, -20, -20, 19, 19, 19);
+	for (int32_t z = region.getLowerZ(); z <= region.getUpperZ(); z += 4)
+	{
+		for (int32_t y = region.getLowerY(); y <= region.getUpperY(); y += 4)
+		{
+			for (int32_t x = region.getLowerX(); x <= region.getUpperX(); x += 4)
+			{
+				volume.setVoxel(x, y, z, (x == 0) ? 2 : volume.getVoxel(x, y, z));
+			}
+		}
+	}
+	QVERIFY(volume.calculateSizeInBytes() < 1 * 1024 * 1024);
+
+	// Samplers see the same values in uniform and non-uniform chunks as direct access does.
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingForwards(&volume, region);
+	}
+	QCOMPARE(result, testDirectAccessWithWrappingForwards(&volume, region));
+	QCOMPARE(volume.getVoxel(0, -20, 0), static_cast<int32_t>(2));
+	QCOMPARE(volume.getVoxel(0, 0, 1), static_cast<int32_t>(0));
+	QCOMPARE(volume.getVoxel(1, -1, 0), static_cast<int32_t>(1));
+}
+
+void TestVolume::testPagedVolumeChunkAllocator()
+{
+	const uint16_t uChunkSideLength = 16;
+	const uint32_t uNoOfChunks = 256;
+	const uint32_t uChunkSizeInBytes = uChunkSideLength * uChunkSideLength * uChunkSideLength * sizeof(int32_t);
+
+	PositionPager pager;
+	PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, uChunkSideLength);
+
+	// The volume only holds 64 chunks, so most of these accesses evict a chunk and reuse the memory it was using.
+	int32_t expectedResult = testChunkSequence(&volume, uChunkSideLength, uNoOfChunks, uNoOfChunks * 4);
+
+	SlabAllocator::Statistics statistics = volume.getChunkAllocatorStatistics();
+	QCOMPARE(statistics.uSlabSizeInBytes, uChunkSizeInBytes);
+	QCOMPARE(statistics.uNoOfAllocations, static_cast<uint64_t>(uNoOfChunks * 4));
+	QVERIFY(statistics.uNoOfRecycledAllocations >= statistics.uNoOfAllocations - 65);
+	QVERIFY(statistics.uNoOfSlabsInUse <= 64);
+	QCOMPARE(statistics.uReservedSizeInBytes, static_cast<uint64_t>(statistics.uNoOfSlabsInUse + statistics.uNoOfFreeSlabs) * uChunkSizeInBytes);
+	QCOMPARE(statistics.uNoOfHugePageBlocks, static_cast<uint32_t>(0));
+
+	// Using huge pages does not change the contents of the volume, only where the chunk data is stored.
+	PagedVolume<int32_t> hugePageVolume(&pager, 1 * 1024 * 1024, uChunkSideLength);
+	hugePageVolume.setUseHugePages(true);
+
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testChunkSequence(&hugePageVolume, uChunkSideLength, uNoOfChunks, uNoOfChunks * 4);
+	}
+	QCOMPARE(result, expectedResult);
+
+	statistics = hugePageVolume.getChunkAllocatorStatistics();
+	QVERIFY(statistics.uNoOfSlabsInUse <= 64);
+#if POLYVOX_HUGE_PAGES_SUPPORTED
+	QVERIFY(statistics.uNoOfHugePageBlocks > 0);
+	QCOMPARE(statistics.uReservedSizeInBytes, static_cast<uint64_t>(statistics.uNoOfHugePageBlocks) * SlabAllocator::uHugePageSize);
+#endif
+
+	// Memory is kept for reuse when chunks are flushed, rather than being returned to the system.
+	hugePageVolume.flushAll();
+	statistics = hugePageVolume.getChunkAllocatorStatistics();
+	QCOMPARE(statistics.uNoOfSlabsInUse, static_cast<uint32_t>(0));
+	QVERIFY(statistics.uNoOfFreeSlabs >= 64);
+}
+
+void TestVolume::testPagedVolumeStatistics()
+{
+	const uint16_t uChunkSideLength = 16;
+	const uint32_t uNoOfChunks = 256;
+	const uint64_t uChunkSizeInBytes = uChunkSideLength * uChunkSideLength * uChunkSideLength * sizeof(int32_t) + sizeof(PagedVolume<int32_t>::Chunk);
+	const uint32_t uNoOfResidentChunks = static_cast<uint32_t>((1 * 1024 * 1024) / uChunkSizeInBytes);
+
+	PositionPager pager;
+	PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, uChunkSideLength);
+
+	// Every access is to a different chunk, so each one misses the chunk cache and has to be paged in.
+	testChunkSequence(&volume, uChunkSideLength, uNoOfChunks, uNoOfChunks);
+	PagedVolume<int32_t>::Statistics statistics = volume.getStatistics();
+	QCOMPARE(statistics.uNoOfResidentChunks, uNoOfResidentChunks);
+	QCOMPARE(statistics.uResidentSizeInBytes, uNoOfResidentChunks * uChunkSizeInBytes);
+	QCOMPARE(statistics.uNoOfDirtyChunks, static_cast<uint32_t>(0));
+	QCOMPARE(statistics.uNoOfPageIns, static_cast<uint64_t>(uNoOfChunks));
+	QCOMPARE(statistics.uNoOfEvictions, static_cast<uint64_t>(uNoOfChunks - uNoOfResidentChunks));
+	QCOMPARE(statistics.uNoOfChunkCacheHits, static_cast<uint64_t>(0));
+	QCOMPARE(statistics.uNoOfChunkCacheMisses, static_cast<uint64_t>(uNoOfChunks));
+	QVERIFY(statistics.uPageInTimeInNanoSeconds > 0);
+
+	// Reading every voxel of the last chunk only hits the cache. The PositionPager fills it with the sum of its lower corner.
+	uint32_t uNoOfMismatches = 0;
+	for (int32_t z = 0; z < uChunkSideLength; z++)
+	{
+		for (int32_t y = 15 * uChunkSideLength; y < 16 * uChunkSideLength; y++)
+		{
+			for (int32_t x = 15 * uChunkSideLength; x < 16 * uChunkSideLength; x++)
+			{
+				if (volume.getVoxel(x, y, z) != 30 * uChunkSideLength)
+				{
+					uNoOfMismatches++;
+				}
+			}
+		}
+	}
+	QCOMPARE(uNoOfMismatches, static_cast<uint32_t>(0));
+	statistics = volume.getStatistics();
+	QCOMPARE(statistics.uNoOfChunkCacheMisses, static_cast<uint64_t>(uNoOfChunks));
+	QCOMPARE(statistics.uNoOfChunkCacheHits, static_cast<uint64_t>(uChunkSideLength * uChunkSideLength * uChunkSideLength));
+	QVERIFY(statistics.fChunkCacheHitRate > 0.9f);
+
+	// Modified chunks are counted until they are paged out.
+	volume.setVoxel(15 * uChunkSideLength, 15 * uChunkSideLength, 0, 1);
+	volume.setVoxel(15 * uChunkSideLength + 1, 15 * uChunkSideLength, 0, 2);
+	volume.setVoxel(14 * uChunkSideLength, 15 * uChunkSideLength, 0, 3);
+	QCOMPARE(volume.getStatistics().uNoOfDirtyChunks, static_cast<uint32_t>(2));
+	QCOMPARE(volume.getStatistics().uNoOfPageOuts, static_cast<uint64_t>(0));
+
+	volume.flushAll();
+	statistics = volume.getStatistics();
+	QCOMPARE(statistics.uNoOfDirtyChunks, static_cast<uint32_t>(0));
+	QCOMPARE(statistics.uNoOfPageOuts, static_cast<uint64_t>(2));
+	QCOMPARE(statistics.uNoOfResidentChunks, static_cast<uint32_t>(0));
+	QCOMPARE(statistics.uResidentSizeInBytes, static_cast<uint64_t>(0));
+
+	// Chunks are only counted as modified once they are written, and not while they are being paged in. Chunks which are overwritten
+	// without being paged in are counted straight away.
+	DirtyCountingPager dirtyCountingPager;
+	PagedVolume<int32_t> countedVolume(&dirtyCountingPager, 1 * 1024 * 1024, uChunkSideLength);
+	dirtyCountingPager.m_pVolume = &countedVolume;
+	countedVolume.setVoxel(0, 0, 0, 1);
+	QCOMPARE(countedVolume.getVoxel(uChunkSideLength, 0, 0), static_cast<int32_t>(uChunkSideLength));
+	QCOMPARE(countedVolume.getVoxel(0, uChunkSideLength, 0), static_cast<int32_t>(uChunkSideLength));
+	QCOMPARE(dirtyCountingPager.m_uNoOfPageIns, static_cast<uint32_t>(3));
+	QCOMPARE(dirtyCountingPager.m_uMaxNoOfDirtyChunks, static_cast<uint32_t>(1));
+	QCOMPARE(countedVolume.getStatistics().uNoOfDirtyChunks, static_cast<uint32_t>(1));
+	countedVolume.fill(Region(0, 0, 4 * uChunkSideLength, 2 * uChunkSideLength - 1, uChunkSideLength - 1, 5 * uChunkSideLength - 1), 5);
+	QCOMPARE(dirtyCountingPager.m_uNoOfPageIns, static_cast<uint32_t>(3));
+	QCOMPARE(countedVolume.getStatistics().uNoOfDirtyChunks, static_cast<uint32_t>(3));
+
+	// With compression the evicted chunks move to the compressed tier, and modified ones stay dirty until they leave it.
+	PagedVolume<int32_t> compressedVolume(&pager, 1 * 1024 * 1024, uChunkSideLength, true);
+	compressedVolume.setChunkCompression(ChunkCompressions::RLE);
+	compressedVolume.setVoxel(0, 0, 0, 1);
+	testChunkSequence(&compressedVolume, uChunkSideLength, uNoOfChunks, uNoOfChunks);
+	statistics = compressedVolume.getStatistics();
+	QCOMPARE(statistics.uNoOfResidentChunks + statistics.uNoOfCompressedChunks, uNoOfChunks);
+	QCOMPARE(statistics.uNoOfDirtyChunks, static_cast<uint32_t>(1));
+	QCOMPARE(statistics.uNoOfChunkCacheMisses, static_cast<uint64_t>(uNoOfChunks));
+	QCOMPARE(statistics.uResidentSizeInBytes + statistics.uCompressedSizeInBytes, compressedVolume.calculateSizeInBytes());
+	QVERIFY(statistics.uCompressedSizeInBytes > 0);
+}
+
+void TestVolume::testPagedVolumePinning()
+{
+	const uint16_t uChunkSideLength = 16;
+	const uint32_t uNoOfChunks = 256;
+
+	CountingPositionPager pager;
+	PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, uChunkSideLength);
+
+	// Pin a block of 3x3x3 chunks which is away from the chunks used by testChunkSequence().
+	Region regPinned(0, 0, 4 * uChunkSideLength, 3 * uChunkSideLength - 1, 3 * uChunkSideLength - 1, 7 * uChunkSideLength - 1);
+	PagedVolume<int32_t>::PinnedRegion pinnedRegion = volume.pin(regPinned);
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(27));
+	QCOMPARE(volume.getStatistics().uNoOfPinnedChunks, static_cast<uint32_t>(27));
+
+	// Accessing many other chunks evicts everything except the pinned chunks, so reading those does not page anything in. The
+	// region we read is shrunk by a voxel, as the reads also cover the neighbours of each voxel.
+	int32_t expectedResult = testChunkSequence(&volume, uChunkSideLength, uNoOfChunks, uNoOfChunks);
+	uint32_t uNoOfPageIns = pager.m_uNoOfPageIns;
+	Region regRead = regPinned;
+	regRead.shrink(1);
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingForwards(&volume, regRead);
+	}
+	QCOMPARE(pager.m_uNoOfPageIns, uNoOfPageIns);
+	QVERIFY(volume.getStatistics().uNoOfResidentChunks <= (1 * 1024 * 1024) / (uChunkSideLength * uChunkSideLength * uChunkSideLength * sizeof(int32_t)));
+
+	// Overlapping regions can be pinned, but pinning too many chunks fails without pinning any of them.
+	PagedVolume<int32_t>::PinnedRegion overlappingRegion = volume.pin(Region(0, 0, 4 * uChunkSideLength, 0, 0, 4 * uChunkSideLength));
+	QCOMPARE(volume.getStatistics().uNoOfPinnedChunks, static_cast<uint32_t>(27));
+
+	uint32_t uNoOfFailures = 0;
+	try
+	{
+		// This region is too large to pin on its own.
+		volume.pin(Region(0, 0, 8 * uChunkSideLength, 3 * uChunkSideLength - 1, 3 * uChunkSideLength - 1, 11 * uChunkSideLength - 1));
+	}
+	catch (const invalid_operation&)
+	{
+		uNoOfFailures++;
+	}
+	try
+	{
+		// This one could be pinned on its own, but not as well as the first region. The chunks it pinned before failing are unpinned.
+		volume.pin(Region(0, 0, 8 * uChunkSideLength, 3 * uChunkSideLength - 1, 3 * uChunkSideLength - 1, 9 * uChunkSideLength - 1));
+	}
+	catch (const invalid_operation&)
+	{
+		uNoOfFailures++;
+	}
+	QCOMPARE(uNoOfFailures, static_cast<uint32_t>(2));
+	QCOMPARE(volume.getStatistics().uNoOfPinnedChunks, static_cast<uint32_t>(27));
+
+	// Moving the region keeps the chunks pinned, and they can be evicted once it is released.
+	PagedVolume<int32_t>::PinnedRegion movedRegion(std::move(pinnedRegion));
+	QCOMPARE(movedRegion.getRegion().getLowerZ(), 4 * uChunkSideLength);
+	pinnedRegion.release();
+	QCOMPARE(volume.getStatistics().uNoOfPinnedChunks, static_cast<uint32_t>(27));
+
+	movedRegion.release();
+	overlappingRegion.release();
+	QCOMPARE(volume.getStatistics().uNoOfPinnedChunks, static_cast<uint32_t>(0));
+
+	QCOMPARE(testChunkSequence(&volume, uChunkSideLength, uNoOfChunks, uNoOfChunks), expectedResult);
+	uNoOfPageIns = pager.m_uNoOfPageIns;
+	QCOMPARE(testDirectAccessWithWrappingForwards(&volume, regRead), result);
+	QVERIFY(pager.m_uNoOfPageIns > uNoOfPageIns);
+}
+
+void TestVolume::testPagedVolumeSnapshot()
+{
+	FilePager<int32_t> filePager(".");
+	PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, m_uChunkSideLength, true);
+	for (int z = m_regVolume.getLowerZ(); z <= m_regVolume.getUpperZ(); z++)
+	{
+		for (int y = m_regVolume.getLowerY(); y <= m_regVolume.getUpperY(); y++)
+		{
+			for (int x = m_regVolume.getLowerX(); x <= m_regVolume.getUpperX(); x++)
+			{
+				volume.setVoxel(x, y, z, x + y + z);
+			}
+		}
+	}
+
+	// Read a snapshot on another thread while the volume is overwritten. The region is too large to fit in the volume's memory limit,
+	// so many of the modified chunks are also paged out and in again, but the snapshot should only see the original values.
+	std::unique_ptr< PagedVolumeSnapshot<int32_t> > pSnapshot = volume.snapshot();
+	std::future<int32_t> futureResult = std::async(std::launch::async, [this, &pSnapshot]()
+	{
+		return testSamplersWithWrappingForwards(pSnapshot.get(), m_regInternal);
+	});
+
+	for (int z = m_regVolume.getLowerZ(); z <= m_regVolume.getUpperZ(); z++)
+	{
+		for (int y = m_regVolume.getLowerY(); y <= m_regVolume.getUpperY(); y++)
+		{
+			for (int x = m_regVolume.getLowerX(); x <= m_regVolume.getUpperX(); x++)
+			{
+				volume.setVoxel(x, y, z, x - y + z);
+			}
+		}
+	}
+
+	QCOMPARE(futureResult.get(), static_cast<int32_t>(1004598054));
+	QCOMPARE(testDirectAccessWithWrappingForwards(pSnapshot.get(), m_regInternal), static_cast<int32_t>(1004598054));
+
+	PagedVolume<int32_t>::Statistics statistics = volume.getStatistics();
+	QCOMPARE(statistics.uNoOfSnapshots, static_cast<uint32_t>(1));
+	QVERIFY(statistics.uSnapshotSizeInBytes > 0);
+
+	// A new snapshot sees the current values. Reading it doesn't copy anything, as nothing has been written since it was taken.
+	std::unique_ptr< PagedVolumeSnapshot<int32_t> > pNewSnapshot = volume.snapshot();
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testDirectAccessWithWrappingForwards(pNewSnapshot.get(), m_regInternal);
+	}
+	QCOMPARE(result, testDirectAccessWithWrappingForwards(&volume, m_regInternal));
+	QVERIFY(result != static_cast<int32_t>(1004598054));
+	QCOMPARE(volume.getStatistics().uSnapshotSizeInBytes, statistics.uSnapshotSizeInBytes);
+
+	// The copies are freed once the snapshots which use them are destroyed.
+	pSnapshot.reset();
+	pNewSnapshot.reset();
+	statistics = volume.getStatistics();
+	QCOMPARE(statistics.uNoOfSnapshots, static_cast<uint32_t>(0));
+	QCOMPARE(statistics.uSnapshotSizeInBytes, static_cast<uint64_t>(0));
+}
+
+// Both volumes use chunks of 32 voxels when tracking changes (the PagedVolume because that is what it was created with).
+template <typename VolumeType>
+void testChangeTracking(VolumeType* volume)
+{
+	const Vector3DInt32 v3dRegionSize(32, 32, 32);
+
+	// Nothing is recorded until change tracking is enabled.
+	volume->setVoxel(1, 2, 3, 1);
+	QCOMPARE(volume->getChangedChunks().size(), static_cast<size_t>(0));
+	volume->setChangeTrackingEnabled(true);
+
+	// A voxel inside a region, one on the upper x face of the same region, and one on the upper x face of the region below it.
+	volume->setVoxel(10, 10, 10, 1);
+	volume->setVoxel(31, 5, 5, 1);
+	volume->setVoxel(-1, 0, 0, 1);
+
+	std::vector<typename VolumeType::ChangedChunk> vecChangedChunks = volume->getChangedChunks();
+	QCOMPARE(vecChangedChunks.size(), static_cast<size_t>(2));
+	QCOMPARE(vecChangedChunks[0].v3dChunkPos, Vector3DInt32(-1, 0, 0));
+	QCOMPARE(vecChangedChunks[0].regChanged, Region(-1, 0, 0, -1, 0, 0));
+	QCOMPARE(vecChangedChunks[1].v3dChunkPos, Vector3DInt32(0, 0, 0));
+	QCOMPARE(vecChangedChunks[1].regChanged, Region(10, 5, 5, 31, 10, 10));
+	QCOMPARE(volume->getChunkVersion(Vector3DInt32(0, 0, 0)), static_cast<uint32_t>(1));
+
+	// Each voxel on a face also affects the region above it, but each region is only returned once.
+	std::vector<Region> vecRegions = volume->consumeChangedRegions(v3dRegionSize);
+	QCOMPARE(vecRegions.size(), static_cast<size_t>(3));
+	QCOMPARE(vecRegions[0], Region(-32, 0, 0, -1, 31, 31));
+	QCOMPARE(vecRegions[1], Region(0, 0, 0, 31, 31, 31));
+	QCOMPARE(vecRegions[2], Region(32, 0, 0, 63, 31, 31));
+	QCOMPARE(volume->consumeChangedRegions(v3dRegionSize).size(), static_cast<size_t>(0));
+
+	// Versions are kept after the changes are consumed, and are incremented by later changes.
+	QCOMPARE(volume->getChunkVersion(Vector3DInt32(0, 0, 0)), static_cast<uint32_t>(1));
+	volume->setVoxel(20, 20, 20, 2);
+	QCOMPARE(volume->getChunkVersion(Vector3DInt32(0, 0, 0)), static_cast<uint32_t>(2));
+	QCOMPARE(volume->getChunkVersion(Vector3DInt32(-1, 0, 0)), static_cast<uint32_t>(1));
+
+	// Regions of other sizes don't need to line up with the chunks.
+	vecRegions = volume->consumeChangedRegions(Vector3DInt32(16, 64, 8));
+	QCOMPARE(vecRegions.size(), static_cast<size_t>(1));
+	QCOMPARE(vecRegions[0], Region(16, 0, 16, 31, 63, 23));
+
+	volume->setChangeTrackingEnabled(false);
+	QCOMPARE(volume->getChunkVersion(Vector3DInt32(0, 0, 0)), static_cast<uint32_t>(0));
+}
+
+void TestVolume::testRawVolumeChangeTracking()
+{
+	RawVolume<int32_t> volume(Region(-40, -8, -8, 70, 40, 40));
+	testChangeTracking(&volume);
+
+	// Writes through samplers are also recorded.
+	volume.setChangeTrackingEnabled(true);
+	RawVolume<int32_t>::Sampler sampler(&volume);
+	sampler.setPosition(40, 40, 40);
+	sampler.setVoxel(1);
+	std::vector<Region> vecRegions = volume.consumeChangedRegions(Vector3DInt32(64, 64, 64));
+	QCOMPARE(vecRegions.size(), static_cast<size_t>(1));
+	QCOMPARE(vecRegions[0], Region(0, 0, 0, 63, 63, 63));
+}
+
+void TestVolume::testPagedVolumeChangeTracking()
+{
+	FilePager<int32_t> filePager(".");
+	PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, m_uChunkSideLength);
+	testChangeTracking(&volume);
+
+	// Changes to chunks are kept when the chunks are evicted. This writes to more chunks than the volume can hold.
+	volume.setChangeTrackingEnabled(true);
+	const int32_t iNoOfChunks = 256;
+	for (int32_t iChunk = 0; iChunk < iNoOfChunks; iChunk++)
+	{
+		volume.setVoxel(iChunk * m_uChunkSideLength + 1, 0, 0, iChunk);
+	}
+	QVERIFY(volume.getStatistics().uNoOfResidentChunks < static_cast<uint32_t>(iNoOfChunks));
+	QCOMPARE(volume.getChangedChunks().size(), static_cast<size_t>(iNoOfChunks));
+
+	// Recording changes should only add a little to the cost of writing.
+	std::vector<Region> vecRegions;
+	QBENCHMARK
+	{
+		for (int z = m_regInternal.getLowerZ(); z <= m_regInternal.getUpperZ(); z++)
+		{
+			for (int y = m_regInternal.getLowerY(); y <= m_regInternal.getUpperY(); y++)
+			{
+				for (int x = m_regInternal.getLowerX(); x <= m_regInternal.getUpperX(); x++)
+				{
+					volume.setVoxel(x, y, z, x + y + z);
+				}
+			}
+		}
+		vecRegions = volume.consumeChangedRegions(Vector3DInt32(32, 32, 32));
+	}
+	QVERIFY(vecRegions.size() > 0);
+}
+
+// Checks that readRegion() gives the same values as getVoxel() in both layouts, and that writeRegion() sets the voxels it should.
+// The volume is restored afterwards. Returns the number of voxels which were wrong.
+template <typename VolumeType>
+int32_t testRegionCopies(VolumeType* volume, const Region& regRead, const Region& regWrite)
+{
+	int32_t iNoOfErrors = 0;
+
+	const size_t uNoOfVoxels = regRead.getWidthInVoxels() * regRead.getHeightInVoxels() * regRead.getDepthInVoxels();
+	std::vector<int32_t> vecXYZ(uNoOfVoxels), vecZYX(uNoOfVoxels);
+	volume->readRegion(regRead, vecXYZ.data());
+	volume->readRegion(regRead, vecZYX.data(), RegionLayouts::ZYX);
+
+	size_t uIndex = 0;
+	for (int z = regRead.getLowerZ(); z <= regRead.getUpperZ(); z++)
+	{
+		for (int y = regRead.getLowerY(); y <= regRead.getUpperY(); y++)
+		{
+			for (int x = regRead.getLowerX(); x <= regRead.getUpperX(); x++)
+			{
+				const size_t uZYXIndex = (z - regRead.getLowerZ()) + ((y - regRead.getLowerY()) + (x - regRead.getLowerX()) * regRead.getHeightInVoxels()) * regRead.getDepthInVoxels();
+				iNoOfErrors += (vecXYZ[uIndex++] != volume->getVoxel(x, y, z)) ? 1 : 0;
+				iNoOfErrors += (vecZYX[uZYXIndex] != volume->getVoxel(x, y, z)) ? 1 : 0;
+			}
+		}
+	}
+
+	// Write modified values in the other layout. The voxels around the region should not change.
+	const size_t uNoOfWrittenVoxels = regWrite.getWidthInVoxels() * regWrite.getHeightInVoxels() * regWrite.getDepthInVoxels();
+	std::vector<int32_t> vecOriginal(uNoOfWrittenVoxels), vecWritten(uNoOfWrittenVoxels);
+	volume->readRegion(regWrite, vecOriginal.data(), RegionLayouts::ZYX);
+	for (size_t ct = 0; ct < uNoOfWrittenVoxels; ct++)
+	{
+		vecWritten[ct] = vecOriginal[ct] + 1000;
+	}
+
+	Region regAround = regWrite;
+	regAround.grow(1);
+	std::vector<int32_t> vecBefore(regAround.getWidthInVoxels() * regAround.getHeightInVoxels() * regAround.getDepthInVoxels());
+	std::vector<int32_t> vecAfter(vecBefore.size());
+	volume->readRegion(regAround, vecBefore.data());
+	volume->writeRegion(regWrite, vecWritten.data(), RegionLayouts::ZYX);
+	volume->readRegion(regAround, vecAfter.data());
+
+	uIndex = 0;
+	for (int z = regAround.getLowerZ(); z <= regAround.getUpperZ(); z++)
+	{
+		for (int y = regAround.getLowerY(); y <= regAround.getUpperY(); y++)
+		{
+			for (int x = regAround.getLowerX(); x <= regAround.getUpperX(); x++)
+			{
+				const int32_t iExpected = vecBefore[uIndex] + (regWrite.containsPoint(x, y, z) ? 1000 : 0);
+				iNoOfErrors += (vecAfter[uIndex++] != iExpected) ? 1 : 0;
+			}
+		}
+	}
+
+	volume->writeRegion(regWrite, vecOriginal.data(), RegionLayouts::ZYX);
+	return iNoOfErrors;
+}
+
+void TestVolume::testRawVolumeRegionCopies()
+{
+	// The external region includes voxels outside the volume, which should be given the border value.
+	Region regWrite(-20, 0, 20, 30, 33, 70);
+	QCOMPARE(testRegionCopies(m_pRawVolume, m_regExternal, regWrite), static_cast<int32_t>(0));
+	QCOMPARE(testDirectAccessWithWrappingForwards(m_pRawVolume, m_regInternal), static_cast<int32_t>(1004598054));
+
+	std::vector<int32_t> vecVoxels(m_regVolume.getWidthInVoxels() * m_regVolume.getHeightInVoxels() * m_regVolume.getDepthInVoxels());
+	QBENCHMARK
+	{
+		m_pRawVolume->readRegion(m_regVolume, vecVoxels.data());
+	}
+	QCOMPARE(vecVoxels.back(), m_regVolume.getUpperX() + m_regVolume.getUpperY() + m_regVolume.getUpperZ());
+
+	// Unlike reads, writes must be inside the volume.
+	bool bThrown = false;
+	try
+	{
+		m_pRawVolume->writeRegion(m_regExternal, vecVoxels.data());
+	}
+	catch (const std::out_of_range&)
+	{
+		bThrown = true;
+	}
+	QVERIFY(bThrown);
+}
+
+void TestVolume::testPagedVolumeRegionCopies()
+{
+	// The regions deliberately don't line up with the chunks.
+	Region regWrite(-20, 0, 20, 30, 33, 70);
+	QCOMPARE(testRegionCopies(m_pPagedVolumeHighMem, m_regExternal, regWrite), static_cast<int32_t>(0));
+	QCOMPARE(testDirectAccessWithWrappingForwards(m_pPagedVolumeHighMem, m_regInternal), static_cast<int32_t>(1004598054));
+
+	std::vector<int32_t> vecVoxels(m_regVolume.getWidthInVoxels() * m_regVolume.getHeightInVoxels() * m_regVolume.getDepthInVoxels());
+	QBENCHMARK
+	{
+		m_pPagedVolumeHighMem->readRegion(m_regVolume, vecVoxels.data());
+	}
+	QCOMPARE(vecVoxels.back(), m_regVolume.getUpperX() + m_regVolume.getUpperY() + m_regVolume.getUpperZ());
+
+	// Writing the value which uniform chunks already hold doesn't allocate any data for them.
+	const uint32_t uNoOfSlabsInUse = m_pPagedVolumeHighMem->getChunkAllocatorStatistics().uNoOfSlabsInUse;
+	std::fill(vecVoxels.begin(), vecVoxels.end(), 0);
+	m_pPagedVolumeHighMem->writeRegion(Region(1000, 1000, 1000, 1000 + m_regVolume.getWidthInVoxels() - 1, 1000 + m_regVolume.getHeightInVoxels() - 1, 1000 + m_regVolume.getDepthInVoxels() - 1), vecVoxels.data());
+	QCOMPARE(m_pPagedVolumeHighMem->getChunkAllocatorStatistics().uNoOfSlabsInUse, uNoOfSlabsInUse);
+}
+
+// Fills a region and checks that it, and only it, has changed. The volume is restored afterwards. Returns the number of voxels which were wrong.
+template <typename VolumeType>
+int32_t testFill(VolumeType* volume, const Region& regFill, int32_t iValue)
+{
+	int32_t iNoOfErrors = 0;
+
+	std::vector<int32_t> vecOriginal(regFill.getWidthInVoxels() * regFill.getHeightInVoxels() * regFill.getDepthInVoxels());
+	volume->readRegion(regFill, vecOriginal.data());
+
+	Region regAround = regFill;
+	regAround.grow(1);
+	std::vector<int32_t> vecBefore(regAround.getWidthInVoxels() * regAround.getHeightInVoxels() * regAround.getDepthInVoxels());
+	volume->readRegion(regAround, vecBefore.data());
+	volume->fill(regFill, iValue);
+
+	size_t uIndex = 0;
+	for (int z = regAround.getLowerZ(); z <= regAround.getUpperZ(); z++)
+	{
+		for (int y = regAround.getLowerY(); y <= regAround.getUpperY(); y++)
+		{
+			for (int x = regAround.getLowerX(); x <= regAround.getUpperX(); x++)
+			{
+				const int32_t iExpected = regFill.containsPoint(x, y, z) ? iValue : vecBefore[uIndex];
+				iNoOfErrors += (volume->getVoxel(x, y, z) != iExpected) ? 1 : 0;
+				uIndex++;
+			}
+		}
+	}
+
+	volume->writeRegion(regFill, vecOriginal.data());
+	return iNoOfErrors;
+}
+
+void TestVolume::testRawVolumeFill()
+{
+	QCOMPARE(testFill(m_pRawVolume, Region(-20, 0, 20, 30, 33, 70), 1000), static_cast<int32_t>(0));
+	QCOMPARE(testDirectAccessWithWrappingForwards(m_pRawVolume, m_regInternal), static_cast<int32_t>(1004598054));
+
+	// A region covering whole slices of the volume is filled in one go.
+	Region regSlices = m_regVolume;
+	regSlices.shiftLowerCorner(0, 0, 1);
+	regSlices.shiftUpperCorner(0, 0, -1);
+	QCOMPARE(testFill(m_pRawVolume, regSlices, -5), static_cast<int32_t>(0));
+	QCOMPARE(testDirectAccessWithWrappingForwards(m_pRawVolume, m_regInternal), static_cast<int32_t>(1004598054));
+
+	RawVolume<int32_t> volume(m_regVolume);
+	QBENCHMARK
+	{
+		volume.fill(m_regVolume, 1);
+	}
+	QCOMPARE(volume.getVoxel(m_regVolume.getUpperCorner()), static_cast<int32_t>(1));
+
+	bool bThrown = false;
+	try
+	{
+		m_pRawVolume->fill(m_regExternal, 0);
+	}
+	catch (const std::out_of_range&)
+	{
+		bThrown = true;
+	}
+	QVERIFY(bThrown);
+}
+
+void TestVolume::testPagedVolumeFill()
+{
+	// The region deliberately doesn't line up with the chunks.
+	QCOMPARE(testFill(m_pPagedVolumeHighMem, Region(-20, 0, 20, 30, 33, 70), 1000), static_cast<int32_t>(0));
+	QCOMPARE(testDirectAccessWithWrappingForwards(m_pPagedVolumeHighMem, m_regInternal), static_cast<int32_t>(1004598054));
+
+	// Chunks which are entirely inside the region become uniform and release their data, even if a sampler is in one of them or a
+	// snapshot still needs the original values.
+	PositionPager pager;
+	PagedVolume<int32_t> volume(&pager, 64 * 1024 * 1024, 32);
+	const Region regFill(-16, -16, -16, 79, 79, 79);
+	volume.prefetch(regFill);
+	const uint32_t uNoOfSlabsInUse = volume.getChunkAllocatorStatistics().uNoOfSlabsInUse;
+	std::unique_ptr< PagedVolumeSnapshot<int32_t> > pSnapshot = volume.snapshot();
+	{
+		PagedVolume<int32_t>::Sampler sampler(&volume);
+		sampler.setPosition(40, 40, 40);
+		QCOMPARE(testFill(&volume, regFill, 7), static_cast<int32_t>(0));
+		volume.fill(regFill, 7);
+		QCOMPARE(sampler.getVoxel(), static_cast<int32_t>(96));
+	}
+	QCOMPARE(pSnapshot->getVoxel(40, 40, 40), static_cast<int32_t>(96));
+	pSnapshot.reset();
+	volume.fill(regFill, 7);
+
+	// The 2x2x2 chunks in the middle of the region are now uniform.
+	QCOMPARE(volume.getChunkAllocatorStatistics().uNoOfSlabsInUse, uNoOfSlabsInUse - 8);
+	QCOMPARE(volume.getVoxel(40, 40, 40), static_cast<int32_t>(7));
+
+	QBENCHMARK
+	{
+		volume.fill(regFill, 1);
+		volume.fill(regFill, 2);
+	}
+	QCOMPARE(volume.getVoxel(regFill.getLowerCorner()), static_cast<int32_t>(2));
+}
+
+void TestVolume::testPagedVolumeFillAvoidsPaging()
+{
+	CountingPositionPager pager;
+	PagedVolume<int32_t> volume(&pager, 64 * 1024 * 1024, 32);
+	volume.setChangeTrackingEnabled(true);
+
+	// The region touches 4x4x4 chunks, and only the 56 on its edges need their old contents.
+	const Region regFill(-16, -16, -16, 79, 79, 79);
+	volume.fill(regFill, 7);
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(56));
+	QCOMPARE(volume.getVoxel(40, 40, 40), static_cast<int32_t>(7));
+	QCOMPARE(volume.getVoxel(-20, -20, -20), static_cast<int32_t>(-96));
+	QCOMPARE(volume.getStatistics().uNoOfDirtyChunks, static_cast<uint32_t>(64));
+	QCOMPARE(volume.consumeChangedRegions(Vector3DInt32(32, 32, 32)).size(), static_cast<size_t>(64));
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(56));
+
+	// A snapshot needs the contents of the chunks from before the fill, so then they are all paged in.
+	volume.flushAll();
+	std::unique_ptr< PagedVolumeSnapshot<int32_t> > pSnapshot = volume.snapshot();
+	volume.fill(regFill, 8);
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(56 + 64));
+	QCOMPARE(pSnapshot->getVoxel(40, 40, 40), static_cast<int32_t>(96));
+	QCOMPARE(volume.getVoxel(40, 40, 40), static_cast<int32_t>(8));
+	pSnapshot.reset();
+
+	// Older copies of the chunks which are waiting to be compressed or paged out are discarded rather than brought back.
+	FilePager<int32_t> filePager(".");
+	{
+		PagedVolume<int32_t> smallVolume(&filePager, 1 * 1024 * 1024, 16, true);
+		smallVolume.setChunkCompression(ChunkCompressions::RLEAndLZ);
+		smallVolume.setPageOutQueueLength(4);
+		for (int z = regFill.getLowerZ(); z <= regFill.getUpperZ(); z++)
+		{
+			for (int y = regFill.getLowerY(); y <= regFill.getUpperY(); y++)
+			{
+				for (int x = regFill.getLowerX(); x <= regFill.getUpperX(); x++)
+				{
+					smallVolume.setVoxel(x, y, z, x + y + z);
+				}
+			}
+		}
+		smallVolume.fill(regFill, 5);
+		smallVolume.flushAll();
+		QCOMPARE(smallVolume.getStatistics().uNoOfDirtyChunks, static_cast<uint32_t>(0));
+	}
+	PagedVolume<int32_t> reopenedVolume(&filePager, 1 * 1024 * 1024, 16, true);
+	std::vector<int32_t> vecValues(regFill.getWidthInVoxels() * regFill.getHeightInVoxels() * regFill.getDepthInVoxels());
+	reopenedVolume.readRegion(regFill, vecValues.data());
+	QCOMPARE(std::count(vecValues.begin(), vecValues.end(), 5), static_cast<std::ptrdiff_t>(vecValues.size()));
+}
+
+/*
+ * Sampler write tests
+ */
+
+// Streams a value into every voxel of the region, either through a sampler or with setVoxel().
+template <typename VolumeType>
+void streamWrites(VolumeType* volume, const Region& region, int32_t iOffset, bool bUseSampler)
+{
+	typename VolumeType::Sampler sampler(volume);
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			sampler.setPosition(region.getLowerX(), y, z);
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				if (bUseSampler)
+				{
+					sampler.setVoxel(x + y + z + iOffset);
+					sampler.movePositiveX();
+				}
+				else
+				{
+					volume->setVoxel(x, y, z, x + y + z + iOffset);
+				}
+			}
+		}
+	}
+}
+
+// Returns the number of voxels in the region which don't have the values written by streamWrites().
+template <typename VolumeType>
+int32_t countStreamingWriteErrors(VolumeType* volume, const Region& region, int32_t iOffset)
+{
+	int32_t iNoOfErrors = 0;
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				iNoOfErrors += (volume->getVoxel(x, y, z) != x + y + z + iOffset) ? 1 : 0;
+			}
+		}
+	}
+	return iNoOfErrors;
+}
+
+void TestVolume::testPagedVolumeSamplerWrites()
+{
+	// The region is much larger than the memory limit, so chunks are evicted while they are being written and have to be
+	// paged back in from disk to be checked.
+	{
+		FilePager<int32_t> filePager(".");
+		PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, m_uChunkSideLength);
+		streamWrites(&volume, m_regInternal, 5, true);
+		QCOMPARE(countStreamingWriteErrors(&volume, m_regInternal, 5), static_cast<int32_t>(0));
+	}
+
+	// Writing to a uniform chunk gives it data, and the sampler then reads from that data.
+	GroundPager groundPager;
+	PagedVolume<int32_t> groundVolume(&groundPager, 64 * 1024 * 1024, 32);
+	PagedVolume<int32_t>::Sampler groundSampler(&groundVolume);
+	groundSampler.setPosition(10, 10, 10);
+	groundSampler.setVoxel(0);
+	QCOMPARE(groundVolume.getChunkAllocatorStatistics().uNoOfSlabsInUse, static_cast<uint32_t>(0));
+	groundSampler.setVoxel(3);
+	groundSampler.movePositiveX();
+	groundSampler.setVoxel(4);
+	QCOMPARE(groundSampler.peekVoxel1nx0py0pz(), static_cast<int32_t>(3));
+	QCOMPARE(groundVolume.getVoxel(10, 10, 10), static_cast<int32_t>(3));
+	QCOMPARE(groundVolume.getVoxel(11, 10, 10), static_cast<int32_t>(4));
+	QCOMPARE(groundVolume.getVoxel(12, 10, 10), static_cast<int32_t>(0));
+
+	// Snapshots keep the values from before the write, and the sampler sees the new ones.
+	PositionPager positionPager;
+	PagedVolume<int32_t> volume(&positionPager, 64 * 1024 * 1024, 32);
+	PagedVolume<int32_t>::Sampler sampler(&volume);
+	sampler.setPosition(40, 40, 40);
+	std::unique_ptr< PagedVolumeSnapshot<int32_t> > pSnapshot = volume.snapshot();
+	sampler.setVoxel(7);
+	QCOMPARE(sampler.getVoxel(), static_cast<int32_t>(7));
+	QCOMPARE(volume.getVoxel(40, 40, 40), static_cast<int32_t>(7));
+	QCOMPARE(pSnapshot->getVoxel(40, 40, 40), static_cast<int32_t>(96));
+	pSnapshot.reset();
+
+	// Writes through samplers are tracked like any other write.
+	volume.setChangeTrackingEnabled(true);
+	sampler.setVoxel(8);
+	std::vector<Region> vecRegions = volume.consumeChangedRegions(Vector3DInt32(32, 32, 32));
+	QCOMPARE(vecRegions.size(), static_cast<size_t>(1));
+	QCOMPARE(vecRegions[0], Region(32, 32, 32, 63, 63, 63));
+	volume.setChangeTrackingEnabled(false);
+
+	volume.prefetch(m_regInternal);
+	QBENCHMARK
+	{
+		streamWrites(&volume, m_regInternal, 1, true);
+	}
+	QCOMPARE(countStreamingWriteErrors(&volume, m_regInternal, 1), static_cast<int32_t>(0));
+}
+
+void TestVolume::testPagedVolumeDirectWrites()
+{
+	PositionPager positionPager;
+	PagedVolume<int32_t> volume(&positionPager, 64 * 1024 * 1024, 32);
+	volume.prefetch(m_regInternal);
+	QBENCHMARK
+	{
+		streamWrites(&volume, m_regInternal, 1, false);
+	}
+	QCOMPARE(countStreamingWriteErrors(&volume, m_regInternal, 1), static_cast<int32_t>(0));
+}
+
+/*
+ * Sampler neighbour tests
+ */
+
+// Peeks at all 26 neighbours of every voxel in the region, and returns the sum of the values (which is allowed to wrap around).
+template <typename VolumeType>
+uint32_t testSamplerNeighbours(VolumeType* volume, const Region& region)
+{
+	uint32_t result = 0;
+	typename VolumeType::Sampler sampler(volume);
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			sampler.setPosition(region.getLowerX(), y, z);
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				result += sampler.peekVoxel1nx1ny1nz() + sampler.peekVoxel0px1ny1nz() + sampler.peekVoxel1px1ny1nz();
+				result += sampler.peekVoxel1nx0py1nz() + sampler.peekVoxel0px0py1nz() + sampler.peekVoxel1px0py1nz();
+				result += sampler.peekVoxel1nx1py1nz() + sampler.peekVoxel0px1py1nz() + sampler.peekVoxel1px1py1nz();
+				result += sampler.peekVoxel1nx1ny0pz() + sampler.peekVoxel0px1ny0pz() + sampler.peekVoxel1px1ny0pz();
+				result += sampler.peekVoxel1nx0py0pz() + sampler.peekVoxel1px0py0pz();
+				result += sampler.peekVoxel1nx1py0pz() + sampler.peekVoxel0px1py0pz() + sampler.peekVoxel1px1py0pz();
+				result += sampler.peekVoxel1nx1ny1pz() + sampler.peekVoxel0px1ny1pz() + sampler.peekVoxel1px1ny1pz();
+				result += sampler.peekVoxel1nx0py1pz() + sampler.peekVoxel0px0py1pz() + sampler.peekVoxel1px0py1pz();
+				result += sampler.peekVoxel1nx1py1pz() + sampler.peekVoxel0px1py1pz() + sampler.peekVoxel1px1py1pz();
+				sampler.movePositiveX();
+			}
+		}
+	}
+	return result;
+}
+
+void TestVolume::testPagedVolumeSamplerNeighbourChunks()
+{
+	// Samplers keep the neighbouring chunks themselves, so peeking and moving across chunk boundaries doesn't replace the
+	// volume's record of the last accessed chunk.
+	PositionPager positionPager;
+	PagedVolume<int32_t> volume(&positionPager, 64 * 1024 * 1024, 16);
+	QCOMPARE(volume.getVoxel(100, 100, 100), static_cast<int32_t>(288));
+	PagedVolume<int32_t>::Sampler sampler(&volume);
+	sampler.setPosition(15, 15, 15);
+	QCOMPARE(sampler.peekVoxel1px1py1pz(), static_cast<int32_t>(48));
+	QCOMPARE(sampler.peekVoxel1nx0py0pz(), static_cast<int32_t>(0));
+	sampler.movePositiveX();
+	QCOMPARE(sampler.peekVoxel1nx1ny1nz(), static_cast<int32_t>(0));
+	const uint64_t uNoOfChunkCacheHits = volume.getStatistics().uNoOfChunkCacheHits;
+	QCOMPARE(volume.getVoxel(100, 100, 100), static_cast<int32_t>(288));
+	QCOMPARE(volume.getStatistics().uNoOfChunkCacheHits, uNoOfChunkCacheHits + 1);
+
+	// Unlike the current chunk, writes to the neighbouring chunks are seen straight away, even if they were uniform.
+	GroundPager groundPager;
+	PagedVolume<int32_t> groundVolume(&groundPager, 64 * 1024 * 1024, 32);
+	PagedVolume<int32_t>::Sampler groundSampler(&groundVolume);
+	groundSampler.setPosition(31, 0, 0);
+	QCOMPARE(groundSampler.peekVoxel1px1ny0pz(), static_cast<int32_t>(1));
+	QCOMPARE(groundSampler.peekVoxel1px0py0pz(), static_cast<int32_t>(0));
+	groundVolume.setVoxel(32, 0, 0, 5);
+	groundVolume.setVoxel(32, -1, 0, 6);
+	QCOMPARE(groundSampler.peekVoxel1px0py0pz(), static_cast<int32_t>(5));
+	QCOMPARE(groundSampler.peekVoxel1px1ny0pz(), static_cast<int32_t>(6));
+
+	// Sampling every neighbour of every voxel, in a thread safe volume with small chunks so that many peeks cross a boundary.
+	PagedVolume<int32_t> threadSafeVolume(&positionPager, 64 * 1024 * 1024, 16, true);
+	threadSafeVolume.prefetch(m_regExternal);
+	uint32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplerNeighbours(&threadSafeVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<uint32_t>(3718598080u));
+}
+
+/*
+ * Chunk apron tests
+ */
+
+void TestVolume::testPagedVolumeChunkApron()
+{
+	// Samplers see the same values through the apron copies, including in the neighbouring chunks.
+	PositionPager positionPager;
+	PagedVolume<int32_t> volume(&positionPager, 64 * 1024 * 1024, 16);
+	QCOMPARE(volume.isChunkApronEnabled(), false);
+	volume.setChunkApronEnabled(true);
+	QCOMPARE(volume.isChunkApronEnabled(), true);
+	{
+		PagedVolume<int32_t>::Sampler sampler(&volume);
+		sampler.setPosition(15, 15, 15);
+		QCOMPARE(sampler.getVoxel(), static_cast<int32_t>(0));
+		QCOMPARE(sampler.peekVoxel1px1py1pz(), static_cast<int32_t>(48));
+		QCOMPARE(sampler.peekVoxel1nx1ny1nz(), static_cast<int32_t>(0));
+		sampler.movePositiveX();
+		QCOMPARE(sampler.getVoxel(), static_cast<int32_t>(16));
+		QCOMPARE(sampler.peekVoxel1nx0py0pz(), static_cast<int32_t>(0));
+		QCOMPARE(sampler.peekVoxel0px1py1pz(), static_cast<int32_t>(48));
+
+		// Each copy has an extra voxel on every side of the chunk, and is counted separately from the chunks.
+		const PagedVolume<int32_t>::Statistics statistics = volume.getStatistics();
+		QCOMPARE(statistics.uNoOfApronCopies, static_cast<uint32_t>(2));
+		QVERIFY(statistics.uApronSizeInBytes >= 2 * 18 * 18 * 18 * sizeof(int32_t));
+	}
+	volume.flushAll();
+	QCOMPARE(volume.getStatistics().uNoOfApronCopies, static_cast<uint32_t>(0));
+
+	// Writes through the volume or a sampler update the copies of the chunk and of its neighbours, even if they were uniform.
+	GroundPager groundPager;
+	PagedVolume<int32_t> groundVolume(&groundPager, 64 * 1024 * 1024, 32);
+	groundVolume.setChunkApronEnabled(true);
+	PagedVolume<int32_t>::Sampler groundSampler(&groundVolume);
+	PagedVolume<int32_t>::Sampler neighbourSampler(&groundVolume);
+	groundSampler.setPosition(31, 0, 0);
+	neighbourSampler.setPosition(32, 0, 0);
+	QCOMPARE(groundSampler.peekVoxel1px1ny0pz(), static_cast<int32_t>(1));
+	QCOMPARE(groundSampler.peekVoxel1px0py0pz(), static_cast<int32_t>(0));
+	groundVolume.setVoxel(32, 0, 0, 5);
+	groundVolume.setVoxel(32, -1, 0, 6);
+	groundVolume.setVoxel(30, 0, 0, 7);
+	QCOMPARE(groundSampler.peekVoxel1px0py0pz(), static_cast<int32_t>(5));
+	QCOMPARE(groundSampler.peekVoxel1px1ny0pz(), static_cast<int32_t>(6));
+	QCOMPARE(groundSampler.peekVoxel1nx0py0pz(), static_cast<int32_t>(7));
+	QCOMPARE(neighbourSampler.getVoxel(), static_cast<int32_t>(5));
+	QCOMPARE(groundSampler.setVoxel(8), true);
+	QCOMPARE(groundSampler.getVoxel(), static_cast<int32_t>(8));
+	QCOMPARE(groundVolume.getVoxel(31, 0, 0), static_cast<int32_t>(8));
+	QCOMPARE(neighbourSampler.peekVoxel1nx0py0pz(), static_cast<int32_t>(8));
+	groundVolume.fill(Region(32, -1, -1, 40, 1, 1), 3);
+	QCOMPARE(groundSampler.peekVoxel1px1ny0pz(), static_cast<int32_t>(3));
+	QCOMPARE(neighbourSampler.getVoxel(), static_cast<int32_t>(3));
+
+	// Disabling the aprons discards the copies which are not being used by a sampler.
+	groundVolume.setChunkApronEnabled(false);
+	neighbourSampler.setPosition(33, 0, 0);
+	groundSampler.setPosition(31, 0, 0);
+	QCOMPARE(groundVolume.getStatistics().uNoOfApronCopies, static_cast<uint32_t>(0));
+	QCOMPARE(groundSampler.peekVoxel1px0py0pz(), static_cast<int32_t>(3));
+
+	// A sampler which moved while the aprons were disabled doesn't use them, but its writes still reach the copies of other chunks.
+	groundVolume.setChunkApronEnabled(true);
+	neighbourSampler.setPosition(32, 0, 0);
+	QCOMPARE(groundSampler.setVoxel(9), true);
+	QCOMPARE(neighbourSampler.peekVoxel1nx0py0pz(), static_cast<int32_t>(9));
+	groundVolume.setChunkApronEnabled(false);
+
+	// Other threads could be reading the copies which a write has to update, so a thread safe volume can't use them.
+	PagedVolume<int32_t> threadSafeVolume(&positionPager, 64 * 1024 * 1024, 16, true);
+	bool bThrown = false;
+	try
+	{
+		threadSafeVolume.setChunkApronEnabled(true);
+	}
+	catch (const invalid_operation&)
+	{
+		bThrown = true;
+	}
+	QCOMPARE(bThrown, true);
+	QCOMPARE(threadSafeVolume.isChunkApronEnabled(), false);
+
+	// The same benchmark as testPagedVolumeSamplerNeighbourChunks() (but without the thread safety), which shows what the copies
+	// save when peeking across chunk boundaries.
+	PagedVolume<int32_t> apronVolume(&positionPager, 64 * 1024 * 1024, 16);
+	apronVolume.setChunkApronEnabled(true);
+	apronVolume.prefetch(m_regExternal);
+	uint32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplerNeighbours(&apronVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<uint32_t>(3718598080u));
+}
+
+/*
+ * Chunk layout tests
+ */
+
+// Gives each voxel in the region the same value as in the volumes created by the TestVolume constructor.
+template <typename VolumeType>
+void fillWithPositions(VolumeType* volume, const Region& region)
+{
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				volume->setVoxel(x, y, z, x + y + z);
+			}
+		}
+	}
+}
+
+// Reads the voxels from a volume with the given layout in every way we can, and returns the number which are wrong. The memory
+// limit is small enough that most of the chunks are paged out and back in again by the FilePager.
+template <typename ChunkLayout>
+int32_t testChunkLayout(const Region& regVolume, const Region& regExternal)
+{
+	FilePager<int32_t, 0, ChunkLayout> pager(".");
+	PagedVolume<int32_t, 0, ChunkLayout> volume(&pager, 1 * 1024 * 1024, 16);
+	fillWithPositions(&volume, regVolume);
+
+	int32_t iNoOfErrors = 0;
+	iNoOfErrors += (testDirectAccessWithWrappingForwards(&volume, regExternal) != 337227750) ? 1 : 0;
+	iNoOfErrors += (testSamplersWithWrappingForwards(&volume, regExternal) != 337227750) ? 1 : 0;
+	iNoOfErrors += (testSamplersWithWrappingBackwards(&volume, regExternal) != -993539594) ? 1 : 0;
+	iNoOfErrors += testRegionCopies(&volume, regExternal, Region(-20, 0, 20, 30, 33, 70));
+	return iNoOfErrors;
+}
+
+void TestVolume::testPagedVolumeChunkLayouts()
+{
+	QCOMPARE(testChunkLayout<MortonChunkLayout>(m_regVolume, m_regExternal), static_cast<int32_t>(0));
+	QCOMPARE(testChunkLayout<LinearChunkLayout>(m_regVolume, m_regExternal), static_cast<int32_t>(0));
+	QCOMPARE(testChunkLayout<BrickedChunkLayout>(m_regVolume, m_regExternal), static_cast<int32_t>(0));
+
+	// A linear chunk's data is already in linear order, so it doesn't need to be reordered when it is copied in.
+	PagedVolume<int32_t, 0, LinearChunkLayout>::Chunk linearChunk(Vector3DInt32(0, 0, 0), 8);
+	linearChunk.setVoxel(1, 2, 3, 5);
+	QCOMPARE(linearChunk.getData()[1 + 2 * 8 + 3 * 64], static_cast<int32_t>(5));
+	linearChunk.changeLinearOrderingToMorton();
+	QCOMPARE(linearChunk.getData()[1 + 2 * 8 + 3 * 64], static_cast<int32_t>(5));
+
+	// A bricked chunk stores each 4x4x4 brick as a block of 64 voxels, and can still be converted to and from linear order.
+	PagedVolume<int32_t, 0, BrickedChunkLayout>::Chunk brickedChunk(Vector3DInt32(0, 0, 0), 8);
+	brickedChunk.setVoxel(1, 2, 3, 5);
+	brickedChunk.setVoxel(4, 0, 0, 6);
+	brickedChunk.setVoxel(0, 4, 4, 7);
+	QCOMPARE(brickedChunk.getData()[1 + 2 * 4 + 3 * 16], static_cast<int32_t>(5));
+	QCOMPARE(brickedChunk.getData()[64], static_cast<int32_t>(6));
+	QCOMPARE(brickedChunk.getData()[128 + 256], static_cast<int32_t>(7));
+	brickedChunk.changeMortonOrderingToLinear();
+	QCOMPARE(brickedChunk.getData()[1 + 2 * 8 + 3 * 64], static_cast<int32_t>(5));
+	brickedChunk.changeLinearOrderingToMorton();
+	QCOMPARE(brickedChunk.getVoxel(1, 2, 3), static_cast<int32_t>(5));
+	QCOMPARE(brickedChunk.getVoxel(0, 4, 4), static_cast<int32_t>(7));
+
+	// Chunks must be large enough to hold at least one brick.
+	FilePager<int32_t, 0, BrickedChunkLayout> pager(".");
+	bool bExceptionThrown = false;
+	try
+	{
+		PagedVolume<int32_t, 0, BrickedChunkLayout> volume(&pager, 1 * 1024 * 1024, 2);
+	}
+	catch (const std::invalid_argument&)
+	{
+		bExceptionThrown = true;
+	}
+	QVERIFY(bExceptionThrown);
+}
+
+// The same benchmark as testPagedVolumeSamplerNeighbourChunks() for each of the layouts, with the chunks already in memory.
+void TestVolume::testPagedVolumeMortonLayoutPerformance()
+{
+	FilePager<int32_t, 0, MortonChunkLayout> pager(".");
+	PagedVolume<int32_t, 0, MortonChunkLayout> volume(&pager, 64 * 1024 * 1024, m_uChunkSideLength);
+	fillWithPositions(&volume, m_regVolume);
+	uint32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplerNeighbours(&volume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<uint32_t>(409050204u));
+}
+
+void TestVolume::testPagedVolumeLinearLayoutPerformance()
+{
+	FilePager<int32_t, 0, LinearChunkLayout> pager(".");
+	PagedVolume<int32_t, 0, LinearChunkLayout> volume(&pager, 64 * 1024 * 1024, m_uChunkSideLength);
+	fillWithPositions(&volume, m_regVolume);
+	uint32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplerNeighbours(&volume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<uint32_t>(409050204u));
+}
+
+void TestVolume::testPagedVolumeBrickedLayoutPerformance()
+{
+	FilePager<int32_t, 0, BrickedChunkLayout> pager(".");
+	PagedVolume<int32_t, 0, BrickedChunkLayout> volume(&pager, 64 * 1024 * 1024, m_uChunkSideLength);
+	fillWithPositions(&volume, m_regVolume);
+	uint32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplerNeighbours(&volume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<uint32_t>(409050204u));
+}
+
+/*
+ * Chunk palette tests
+ */
+
+// Generates horizontal layers of eight different materials, each four voxels thick. The data is allocated first, so that the chunks
+// are only stored as palettes if the volume packs them.
+class LayerPager : public PagedVolume<int32_t>::Pager
+{
+public:
+	virtual void pageIn(const Region& region, PagedVolume<int32_t>::Chunk* pChunk)
+	{
+		m_uNoOfPageIns++;
+		pChunk->getData();
+		for (int z = 0; z < region.getDepthInVoxels(); z++)
+		{
+			for (int y = 0; y < region.getHeightInVoxels(); y++)
+			{
+				for (int x = 0; x < region.getWidthInVoxels(); x++)
+				{
+					pChunk->setVoxel(x, y, z, getMaterial(region.getLowerY() + y));
+				}
+			}
+		}
+	}
+
+	virtual void pageOut(const Region& /*region*/, PagedVolume<int32_t>::Chunk* /*pChunk*/)
+	{
+	}
+
+	static int32_t getMaterial(int32_t y)
+	{
+		return ((y >> 2) & 7) * 10;
+	}
+
+	uint32_t m_uNoOfPageIns = 0;
+};
+
+// Reads the region twice, and returns the number of voxels which were wrong.
+int32_t testLayerVolume(PagedVolume<int32_t>* volume, const Region& region)
+{
+	int32_t iNoOfErrors = 0;
+	for (int iPass = 0; iPass < 2; iPass++)
+	{
+		for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+		{
+			for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+			{
+				for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+				{
+					iNoOfErrors += (volume->getVoxel(x, y, z) != LayerPager::getMaterial(y)) ? 1 : 0;
+				}
+			}
+		}
+	}
+	return iNoOfErrors;
+}
+
+void TestVolume::testPagedVolumeChunkPalette()
+{
+	// Writes to a uniform chunk go into a palette, which gets wider indices as values are added, until it can't hold any more.
+	GroundPager groundPager;
+	PagedVolume<int32_t> volume(&groundPager, 64 * 1024 * 1024, 16);
+	QCOMPARE(volume.isChunkPaletteEnabled(), false);
+	volume.setChunkPaletteEnabled(true);
+	QCOMPARE(volume.isChunkPaletteEnabled(), true);
+	const uint32_t uNoOfSlabsInUse = volume.getChunkAllocatorStatistics().uNoOfSlabsInUse;
+	uint64_t uPaletteSizeInBytes = 0;
+	for (int32_t iValue = 1; iValue < 256; iValue++)
+	{
+		volume.setVoxel(iValue & 15, iValue >> 4, 3, iValue);
+		if ((iValue == 1) || (iValue == 3) || (iValue == 15) || (iValue == 255))
+		{
+			// The palette is widened when it has 2, 4 and 16 values, and these include the ground.
+			const PagedVolume<int32_t>::Statistics statistics = volume.getStatistics();
+			QCOMPARE(statistics.uNoOfPaletteChunks, static_cast<uint32_t>(1));
+			QVERIFY(statistics.uPaletteSizeInBytes > uPaletteSizeInBytes);
+			uPaletteSizeInBytes = statistics.uPaletteSizeInBytes;
+		}
+	}
+	QVERIFY(uPaletteSizeInBytes < 16 * 16 * 16 * sizeof(int32_t) / 2);
+	QCOMPARE(volume.getChunkAllocatorStatistics().uNoOfSlabsInUse, uNoOfSlabsInUse);
+
+	std::vector<int32_t> vecVoxels(16 * 16);
+	volume.readRegion(Region(0, 0, 3, 15, 15, 3), vecVoxels.data());
+	for (int32_t iValue = 0; iValue < 256; iValue++)
+	{
+		QCOMPARE(vecVoxels[iValue], iValue);
+	}
+	QCOMPARE(volume.getVoxel(7, 7, 7), static_cast<int32_t>(0));
+
+	// Samplers read a copy of the palette of the chunk they are in rather than expanding it, and read their neighbours' palettes directly.
+	volume.setVoxel(16, 0, 0, 5);
+	{
+		PagedVolume<int32_t>::Sampler sampler(&volume);
+		sampler.setPosition(15, 15, 3);
+		QCOMPARE(sampler.getVoxel(), static_cast<int32_t>(255));
+		QCOMPARE(sampler.peekVoxel1nx0py0pz(), static_cast<int32_t>(254));
+		QCOMPARE(volume.getStatistics().uNoOfPaletteChunks, static_cast<uint32_t>(2));
+		sampler.setPosition(15, 0, 0);
+		QCOMPARE(sampler.peekVoxel1px0py0pz(), static_cast<int32_t>(5));
+		QCOMPARE(sampler.setVoxel(6), true);
+		QCOMPARE(sampler.getVoxel(), static_cast<int32_t>(6));
+		QCOMPARE(volume.getVoxel(15, 0, 0), static_cast<int32_t>(6));
+
+		// The copy is decoded again when the sampler comes back to the chunk after its palette has changed.
+		volume.setVoxel(14, 0, 0, 9);
+		sampler.movePositiveX();
+		QCOMPARE(sampler.getVoxel(), static_cast<int32_t>(5));
+		sampler.moveNegativeX();
+		QCOMPARE(sampler.getVoxel(), static_cast<int32_t>(6));
+		QCOMPARE(sampler.peekVoxel1nx0py0pz(), static_cast<int32_t>(9));
+		volume.setVoxel(14, 0, 0, 13);
+	}
+	QCOMPARE(volume.getStatistics().uNoOfPaletteChunks, static_cast<uint32_t>(2));
+	QCOMPARE(volume.getChunkAllocatorStatistics().uNoOfSlabsInUse, uNoOfSlabsInUse);
+
+	// A palette which already has 256 values is expanded when another one is written.
+	for (int32_t iValue = 1; iValue < 256; iValue++)
+	{
+		volume.setVoxel(32 + (iValue & 15), iValue >> 4, 0, iValue);
+	}
+	QCOMPARE(volume.getStatistics().uNoOfPaletteChunks, static_cast<uint32_t>(3));
+	volume.setVoxel(32, 0, 1, 256);
+	QCOMPARE(volume.getStatistics().uNoOfPaletteChunks, static_cast<uint32_t>(2));
+	QCOMPARE(volume.getVoxel(32, 0, 1), static_cast<int32_t>(256));
+	QCOMPARE(volume.getVoxel(47, 15, 0), static_cast<int32_t>(255));
+
+	// Snapshots see the chunks as they were when they were taken, whether the palette was expanded for the snapshot to read it or
+	// was copied for the snapshot when it was written to.
+	volume.setVoxel(48, 0, 0, 3);
+	std::unique_ptr< PagedVolumeSnapshot<int32_t> > pSnapshot = volume.snapshot();
+	QCOMPARE(pSnapshot->getVoxel(16, 0, 0), static_cast<int32_t>(5));
+	volume.setVoxel(16, 1, 0, 7);
+	volume.setVoxel(48, 1, 0, 4);
+	QCOMPARE(pSnapshot->getVoxel(16, 1, 0), static_cast<int32_t>(0));
+	QCOMPARE(pSnapshot->getVoxel(48, 0, 0), static_cast<int32_t>(3));
+	QCOMPARE(pSnapshot->getVoxel(48, 1, 0), static_cast<int32_t>(0));
+	QCOMPARE(volume.getVoxel(16, 1, 0), static_cast<int32_t>(7));
+	QCOMPARE(volume.getVoxel(48, 1, 0), static_cast<int32_t>(4));
+	pSnapshot.reset();
+
+	// Filling a chunk releases its palette.
+	QCOMPARE(volume.getStatistics().uNoOfPaletteChunks, static_cast<uint32_t>(2));
+	volume.fill(Region(0, 0, 0, 15, 15, 15), 2);
+	QCOMPARE(volume.getStatistics().uNoOfPaletteChunks, static_cast<uint32_t>(1));
+	volume.fill(Region(48, 0, 0, 63, 15, 15), 2);
+	QCOMPARE(volume.getStatistics().uNoOfPaletteChunks, static_cast<uint32_t>(0));
+	QCOMPARE(volume.getStatistics().uPaletteSizeInBytes, static_cast<uint64_t>(0));
+	QCOMPARE(volume.getVoxel(48, 1, 0), static_cast<int32_t>(2));
+
+	// When there isn't room for every chunk, they are packed into palettes rather than being evicted. Each chunk of the layers only
+	// needs 2-bit indices, so many more chunks fit into the same memory and the region isn't paged in again the second time it is read.
+	const Region regLayers(0, 0, 0, 255, 63, 127);
+	LayerPager layerPager;
+	PagedVolume<int32_t> layerVolume(&layerPager, 2 * 1024 * 1024, 16);
+	QCOMPARE(testLayerVolume(&layerVolume, regLayers), static_cast<int32_t>(0));
+	QVERIFY(layerPager.m_uNoOfPageIns > 512);
+
+	LayerPager paletteLayerPager;
+	PagedVolume<int32_t> paletteLayerVolume(&paletteLayerPager, 2 * 1024 * 1024, 16);
+	paletteLayerVolume.setChunkPaletteEnabled(true);
+	QCOMPARE(testLayerVolume(&paletteLayerVolume, regLayers), static_cast<int32_t>(0));
+	QCOMPARE(paletteLayerPager.m_uNoOfPageIns, static_cast<uint32_t>(512));
+
+	const PagedVolume<int32_t>::Statistics statistics = paletteLayerVolume.getStatistics();
+	QCOMPARE(statistics.uNoOfResidentChunks, static_cast<uint32_t>(512));
+	QCOMPARE(statistics.uNoOfEvictions, static_cast<uint64_t>(0));
+	QVERIFY(statistics.uNoOfPaletteChunks > 400);
+	QVERIFY(statistics.uResidentSizeInBytes <= 2 * 1024 * 1024 + 16 * 16 * 16 * sizeof(int32_t)); // The last chunk was paged in after making room for it.
+
+	// The same benchmark as testPagedVolumeSamplerNeighbourChunks(), with palettes enabled. The chunks are packed as they are evicted,
+	// and the sampler reads them through its own copies of their palettes.
+	PositionPager positionPager;
+	PagedVolume<int32_t> threadSafeVolume(&positionPager, 1 * 1024 * 1024, 16, true);
+	threadSafeVolume.setChunkPaletteEnabled(true);
+	uint32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplerNeighbours(&threadSafeVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<uint32_t>(3718598080u));
+}
+
+/*
+ * Pack file pager tests
+ */
+
+// Counts the voxels which don't have the values given by fillWithPositions(), except for those in the filled region which should have the fill value.
+template <typename VolumeType>
+int32_t countFillErrors(VolumeType* volume, const Region& region, const Region& regFilled, int32_t iFillValue)
+{
+	int32_t iNoOfErrors = 0;
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				int32_t iExpectedValue = regFilled.containsPoint(x, y, z) ? iFillValue : x + y + z;
+				iNoOfErrors += (volume->getVoxel(x, y, z) != iExpectedValue) ? 1 : 0;
+			}
+		}
+	}
+	return iNoOfErrors;
+}
+
+void TestVolume::testPackFilePager()
+{
+	const std::string strFileName = "./testpackfilepager.pack";
+	std::remove(strFileName.c_str());
+
+	// The memory limit is small enough that most of the chunks go through the pack file.
+	{
+		PackFilePager<int32_t> pager(strFileName, 0.0f);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		fillWithPositions(&volume, m_regVolume);
+		QCOMPARE(testDirectAccessWithWrappingForwards(&volume, m_regExternal), static_cast<int32_t>(337227750));
+		QVERIFY(volume.getStatistics().uNoOfPageOuts > 0);
+	}
+
+	// The chunks are still there for a new pager, and making some of them uniform leaves gaps which compaction removes.
+	Region regFilled(-48, -16, 16, 47, 79, 127);
+	{
+		PackFilePager<int32_t> pager(strFileName, 0.0f);
+		QVERIFY(pager.getStatistics().uNoOfChunks > 0);
+
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		QCOMPARE(testDirectAccessWithWrappingForwards(&volume, m_regExternal), static_cast<int32_t>(337227750));
+
+		volume.fill(regFilled, 5);
+		volume.flushAll();
+		pager.flush();
+
+		PackFilePager<int32_t>::Statistics statistics = pager.getStatistics();
+		QVERIFY(statistics.uFreeSizeInBytes > statistics.uFileSizeInBytes / 4);
+
+		pager.compact();
+		PackFilePager<int32_t>::Statistics compactedStatistics = pager.getStatistics();
+		QVERIFY(compactedStatistics.uNoOfChunksMovedByCompaction > 0);
+		QVERIFY(compactedStatistics.uFileSizeInBytes < statistics.uFileSizeInBytes - statistics.uFreeSizeInBytes / 2);
+		QCOMPARE(compactedStatistics.uNoOfChunks, statistics.uNoOfChunks);
+		QCOMPARE(countFillErrors(&volume, m_regVolume, regFilled, 5), static_cast<int32_t>(0));
+	}
+
+	// The compacted file is read back correctly.
+	{
+		PackFilePager<int32_t> pager(strFileName);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		QCOMPARE(countFillErrors(&volume, m_regVolume, regFilled, 5), static_cast<int32_t>(0));
+	}
+
+	// Mapping the chunks gives the same values. Modified chunks are written to new space, and the space they used is not reused.
+	{
+		PackFilePager<int32_t> pager(strFileName, 0.5f, true);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		QCOMPARE(countFillErrors(&volume, m_regVolume, regFilled, 5), static_cast<int32_t>(0));
+#if POLYVOX_FILE_MAPPING_SUPPORTED
+		QVERIFY(pager.getStatistics().uNoOfMappedPageIns > 0);
+		QVERIFY(volume.getChunkAllocatorStatistics().uNoOfMappedSlabs > 0);
+#endif
+
+		volume.fill(Region(-48, -16, 16, 47, 79, 31), 6);
+		QCOMPARE(countFillErrors(&volume, Region(-48, -16, 16, 47, 79, 31), Region(-48, -16, 16, 47, 79, 31), 6), static_cast<int32_t>(0));
+		QCOMPARE(countFillErrors(&volume, Region(-57, -31, 32, 64, 96, 131), regFilled, 5), static_cast<int32_t>(0));
+	}
+	{
+		PackFilePager<int32_t> pager(strFileName);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		QCOMPARE(countFillErrors(&volume, Region(-48, -16, 16, 47, 79, 31), Region(-48, -16, 16, 47, 79, 31), 6), static_cast<int32_t>(0));
+		QCOMPARE(countFillErrors(&volume, Region(-57, -31, 32, 64, 96, 131), regFilled, 5), static_cast<int32_t>(0));
+	}
+
+	// A file which was created with smaller pages than this machine's can still be used. Chunks which are no longer aligned to
+	// the pages are read rather than mapped.
+	{
+		const uint32_t uSmallPageSize = 512;
+		FILE* pFile = fopen(strFileName.c_str(), "r+b");
+		QVERIFY(pFile != nullptr);
+		fseek(pFile, 16, SEEK_SET);
+		fwrite(&uSmallPageSize, sizeof(uSmallPageSize), 1, pFile);
+		fclose(pFile);
+	}
+	{
+		PackFilePager<int32_t> pager(strFileName, 0.5f, true);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		volume.fill(Region(-48, -16, 16, 47, 79, 31), 7);
+		for (int32_t x = -48; x < 48; x += 16)
+		{
+			volume.setVoxel(x, 80, 140, 8);
+		}
+	}
+	{
+		PackFilePager<int32_t> pager(strFileName, 0.5f, true);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		QCOMPARE(countFillErrors(&volume, Region(-48, -16, 16, 47, 79, 31), Region(-48, -16, 16, 47, 79, 31), 7), static_cast<int32_t>(0));
+		QCOMPARE(countFillErrors(&volume, Region(-57, -31, 32, 64, 79, 131), regFilled, 5), static_cast<int32_t>(0));
+		for (int32_t x = -48; x < 48; x += 16)
+		{
+			QCOMPARE(volume.getVoxel(x, 80, 140), static_cast<int32_t>(8));
+		}
+	}
+
+	// Threads can page chunks in and out while the file is compacted and flushed, as none of them hold the mutex during their
+	// disk accesses. Alternating between uniform and non-uniform chunks keeps changing their sizes, which leaves gaps to compact.
+	{
+		PackFilePager<int32_t> pager(strFileName, 0.0f);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16, true);
+		std::atomic<bool> bDone(false);
+		std::atomic<int32_t> iNoOfErrors(0);
+		std::thread compactionThread([&]
+		{
+			while (!bDone)
+			{
+				pager.compact();
+			}
+		});
+
+		std::vector<std::thread> vecThreads;
+		for (int32_t iThread = 0; iThread < 4; iThread++)
+		{
+			vecThreads.emplace_back([&, iThread]
+			{
+				const Region regThread(iThread * 32, -16, 0, iThread * 32 + 31, 47, 63);
+				for (int32_t iPass = 0; iPass < 4; iPass++)
+				{
+					if (iPass % 2 == 0)
+					{
+						volume.fill(regThread, iPass);
+						iNoOfErrors += countFillErrors(&volume, regThread, regThread, iPass);
+					}
+					else
+					{
+						fillWithPositions(&volume, regThread);
+						iNoOfErrors += countFillErrors(&volume, regThread, Region::InvertedRegion(), 0);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : vecThreads)
+		{
+			thread.join();
+		}
+		bDone = true;
+		compactionThread.join();
+
+		QCOMPARE(iNoOfErrors.load(), static_cast<int32_t>(0));
+		QVERIFY(pager.getStatistics().uNoOfChunksMovedByCompaction > 0);
+	}
+	{
+		PackFilePager<int32_t> pager(strFileName);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		QCOMPARE(countFillErrors(&volume, Region(0, -16, 0, 127, 47, 63), Region::InvertedRegion(), 0), static_cast<int32_t>(0));
+	}
+
+	// The file can't be used with a different voxel type.
+	bool bExceptionThrown = false;
+	try
+	{
+		PackFilePager<int16_t> pager(strFileName);
+	}
+	catch (const std::runtime_error&)
+	{
+		bExceptionThrown = true;
+	}
+	QVERIFY(bExceptionThrown);
+
+	std::remove(strFileName.c_str());
+}
+
+// Deletes the files which a persistent FilePager in the current folder writes for the chunks of the region.
+void removeFilePagerFiles(const Region& region, int32_t iChunkSideLength)
+{
+	for (int32_t z = region.getLowerZ(); z <= region.getUpperZ(); z += iChunkSideLength)
+	{
+		for (int32_t y = region.getLowerY(); y <= region.getUpperY(); y += iChunkSideLength)
+		{
+			for (int32_t x = region.getLowerX(); x <= region.getUpperX(); x += iChunkSideLength)
+			{
+				std::stringstream ssFileName;
+				ssFileName << "./" << x << "_" << y << "_" << z << "_"
+					<< x + iChunkSideLength - 1 << "_" << y + iChunkSideLength - 1 << "_" << z + iChunkSideLength - 1;
+				std::remove(ssFileName.str().c_str());
+			}
+		}
+	}
+	std::remove("./chunks.idx");
+}
+
+void TestVolume::testFilePagerPersistence()
+{
+	const Region regChunks(0, 0, 0, 63, 63, 63);
+	const Region regWritten(0, 0, 0, 63, 63, 31);
+	const Region regNotWritten(0, 0, 32, 63, 63, 63);
+	removeFilePagerFiles(regChunks, 16);
+
+	{
+		FilePager<int32_t> pager(".", true);
+		QCOMPARE(pager.getNoOfChunksOnDisk(), static_cast<uint32_t>(0));
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		fillWithPositions(&volume, regWritten);
+	}
+
+	// The chunks which were written are found again, and the others are uniform without their files being looked for.
+	{
+		FilePager<int32_t> pager(".", true);
+		QCOMPARE(pager.getNoOfChunksOnDisk(), static_cast<uint32_t>(32));
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		QCOMPARE(countFillErrors(&volume, regWritten, regNotWritten, 0), static_cast<int32_t>(0));
+		QCOMPARE(countFillErrors(&volume, regNotWritten, regNotWritten, 0), static_cast<int32_t>(0));
+		QCOMPARE(volume.getChunkAllocatorStatistics().uNoOfSlabsInUse, static_cast<uint32_t>(32));
+
+		// Chunks which are written again are only recorded once.
+		volume.setVoxel(1, 2, 3, 4);
+		volume.flushAll();
+		QCOMPARE(pager.getNoOfChunksOnDisk(), static_cast<uint32_t>(32));
+	}
+
+	// A pager which is not persistent does not see the files.
+	{
+		FilePager<int32_t> pager(".");
+		QCOMPARE(pager.getNoOfChunksOnDisk(), static_cast<uint32_t>(0));
+	}
+
+	// The files can't be used with a different voxel type or chunk side length.
+	bool bExceptionThrown = false;
+	try
+	{
+		FilePager<int16_t> pager(".", true);
+	}
+	catch (const std::runtime_error&)
+	{
+		bExceptionThrown = true;
+	}
+	QVERIFY(bExceptionThrown);
+
+	bExceptionThrown = false;
+	try
+	{
+		FilePager<int32_t, 32> pager(".", true);
+	}
+	catch (const std::runtime_error&)
+	{
+		bExceptionThrown = true;
+	}
+	QVERIFY(bExceptionThrown);
+
+	bExceptionThrown = false;
+	try
+	{
+		FilePager<int32_t> pager(".", true);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 32);
+		volume.getVoxel(0, 0, 0);
+	}
+	catch (const std::runtime_error&)
+	{
+		bExceptionThrown = true;
+	}
+	QVERIFY(bExceptionThrown);
+
+	removeFilePagerFiles(regChunks, 16);
+}
+
+/*
+ * Sparse world tests
+ */
+
+// Builds a world which is mostly air, with solid ground below y = 0 and rolling hills on top of it.
+template <typename VolumeType>
+void createSparseWorld(VolumeType* volume, const Region& region)
+{
+	volume->fill(Region(region.getLowerX(), region.getLowerY(), region.getLowerZ(), region.getUpperX(), -1, region.getUpperZ()), 1);
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+		{
+			const int32_t iHeight = static_cast<int32_t>(8.0f + 7.0f * std::sin(x * 0.05f) * std::cos(z * 0.07f));
+			for (int y = 0; y <= iHeight; y++)
+			{
+				volume->setVoxel(x, y, z, 2);
+			}
+		}
+	}
+}
+
+void TestVolume::testSparseOctreeVolumeSparseWorld()
+{
+	const Region regWorld(0, -64, 0, 511, 191, 511);
+	SparseOctreeVolume<int32_t> volume(regWorld);
+	createSparseWorld(&volume, regWorld);
+
+	// The same world in a PagedVolume (with the ground paged in as uniform chunks) uses more memory, as the chunks are much larger
+	// than the bricks so more of them are needed to hold the hills.
+	GroundPager pager;
+	PagedVolume<int32_t> pagedVolume(&pager, 256 * 1024 * 1024, m_uChunkSideLength);
+	createSparseWorld(&pagedVolume, regWorld);
+	QVERIFY(volume.calculateSizeInBytes() * 2 < pagedVolume.calculateSizeInBytes());
+
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingForwards(&volume, Region(1, -8, 1, 254, 23, 254));
+	}
+	QCOMPARE(result, testSamplersWithWrappingForwards(&pagedVolume, Region(1, -8, 1, 254, 23, 254)));
+
+	// Clearing the world collapses the whole tree back to the root.
+	volume.fill(regWorld, 0);
+	QCOMPARE(volume.getNoOfNodes(), static_cast<uint32_t>(1));
+	QCOMPARE(volume.getNoOfBricks(), static_cast<uint32_t>(0));
+
+	// A brick collapses as soon as its last different voxel is written, even when that is its first voxel.
+	volume.setVoxel(1, 0, 0, 2);
+	QCOMPARE(volume.getNoOfBricks(), static_cast<uint32_t>(1));
+	volume.setVoxel(1, 0, 0, 0);
+	QCOMPARE(volume.getNoOfBricks(), static_cast<uint32_t>(0));
+	for (int32_t z = 7; z >= 0; z--)
+	{
+		for (int32_t y = 7; y >= 0; y--)
+		{
+			for (int32_t x = 7; x >= 0; x--)
+			{
+				volume.setVoxel(x, y, z, 3);
+				QCOMPARE(volume.getNoOfBricks(), static_cast<uint32_t>((x + y + z > 0) ? 1 : 0));
+			}
+		}
+	}
+	QCOMPARE(volume.getVoxel(7, 7, 7), static_cast<int32_t>(3));
+}
+
+void TestVolume::testSparseOctreeVolumeNonPowerOfTwo()
+{
+	// The bricks and branches on the upper edges of this volume are partly outside it.
+	const Region regVolume(-5, 3, 10, 94, 52, 46);
+	SparseOctreeVolume<int32_t> volume(regVolume);
+
+	// Writing every voxel collapses the whole tree back to the root.
+	for (int32_t z = regVolume.getLowerZ(); z <= regVolume.getUpperZ(); z++)
+	{
+		for (int32_t y = regVolume.getLowerY(); y <= regVolume.getUpperY(); y++)
+		{
+			for (int32_t x = regVolume.getLowerX(); x <= regVolume.getUpperX(); x++)
+			{
+				volume.setVoxel(x, y, z, 1);
+			}
+		}
+	}
+	QCOMPARE(volume.getNoOfNodes(), static_cast<uint32_t>(1));
+	QCOMPARE(volume.getNoOfBricks(), static_cast<uint32_t>(0));
+	QCOMPARE(volume.getVoxel(94, 52, 46), static_cast<int32_t>(1));
+
+	// So does undoing a write to the last voxel.
+	volume.setVoxel(94, 52, 46, 2);
+	QCOMPARE(volume.getNoOfBricks(), static_cast<uint32_t>(1));
+	QCOMPARE(volume.getVoxel(94, 52, 46), static_cast<int32_t>(2));
+	volume.setVoxel(94, 52, 46, 1);
+	QCOMPARE(volume.getNoOfNodes(), static_cast<uint32_t>(1));
+	QCOMPARE(volume.getNoOfBricks(), static_cast<uint32_t>(0));
+
+	// And writing back every voxel of a region which was filled over the upper edges.
+	const Region regFill(60, 30, 20, 94, 52, 46);
+	volume.fill(regFill, 2);
+	QVERIFY(volume.getNoOfBricks() > 0);
+	QCOMPARE(volume.getVoxel(60, 30, 20), static_cast<int32_t>(2));
+	QCOMPARE(volume.getVoxel(59, 30, 20), static_cast<int32_t>(1));
+	for (int32_t z = regFill.getLowerZ(); z <= regFill.getUpperZ(); z++)
+	{
+		for (int32_t y = regFill.getLowerY(); y <= regFill.getUpperY(); y++)
+		{
+			for (int32_t x = regFill.getLowerX(); x <= regFill.getUpperX(); x++)
+			{
+				volume.setVoxel(x, y, z, 1);
+			}
+		}
+	}
+	QCOMPARE(volume.getNoOfNodes(), static_cast<uint32_t>(1));
+	QCOMPARE(volume.getNoOfBricks(), static_cast<uint32_t>(0));
+	QCOMPARE(volume.getVoxel(60, 30, 20), static_cast<int32_t>(1));
+}
+
+void TestVolume::testPagedVolumeSparseWorld()
+{
+	const Region regWorld(0, -64, 0, 511, 191, 511);
+	GroundPager pager;
+	PagedVolume<int32_t> volume(&pager, 256 * 1024 * 1024, m_uChunkSideLength);
+	createSparseWorld(&volume, regWorld);
+
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplersWithWrappingForwards(&volume, Region(1, -8, 1, 254, 23, 254));
+	}
+	QCOMPARE(result, static_cast<int32_t>(-830989827));
+}
+
+// Stops a ray at the first solid voxel, and counts the voxels it touches.
+template <typename VolumeType>
+class SolidVoxelRaycastFunctor
+{
+public:
+	bool operator()(const typename VolumeType::Sampler& sampler)
+	{
+		m_uVoxelsTouched++;
+		return sampler.getVoxel() == 0;
+	}
+
+	uint32_t m_uVoxelsTouched = 0;
+};
+
+template <typename VolumeType>
+bool isEmptyVoxel(const VolumeType* volume, const Vector3DInt32& v3dPos)
+{
+	return volume->getEnclosingRegion().containsPoint(v3dPos) && (volume->getVoxel(v3dPos) == 0);
+}
+
+// Extracts meshes, casts rays and finds a path through a volume, and combines the results into a single value.
+template <typename VolumeType>
+int32_t testAlgorithms(VolumeType* volume)
+{
+	const Region& region = volume->getEnclosingRegion();
+	int32_t result = 0;
+
+	auto cubicMesh = extractCubicMesh(volume, region);
+	result = cantorTupleFunction(result, cubicMesh.getNoOfVertices());
+	result = cantorTupleFunction(result, static_cast<int32_t>(cubicMesh.getNoOfIndices()));
+
+	auto marchingCubesMesh = extractMarchingCubesMesh(volume, region);
+	result = cantorTupleFunction(result, marchingCubesMesh.getNoOfVertices());
+	result = cantorTupleFunction(result, static_cast<int32_t>(marchingCubesMesh.getNoOfIndices()));
+
+	for (int32_t ct = 0; ct < 32; ct++)
+	{
+		SolidVoxelRaycastFunctor<VolumeType> functor;
+		const Vector3DFloat v3dStart(ct + 0.5f, 30.5f, 5.5f);
+		const Vector3DFloat v3dEnd(20.5f, -5.5f, ct + 0.5f);
+		RaycastResult raycastResult = raycastWithEndpoints(volume, v3dStart, v3dEnd, functor);
+		result = cantorTupleFunction(result, static_cast<int32_t>(functor.m_uVoxelsTouched) + (raycastResult == RaycastResults::Interupted ? 1000 : 0));
+	}
+
+	std::list<Vector3DInt32> listPath;
+	AStarPathfinderParams<VolumeType> params(volume, Vector3DInt32(2, 20, 2), Vector3DInt32(29, 20, 29), &listPath, 1.0f, 100000, TwentySixConnected, &isEmptyVoxel<VolumeType>);
+	AStarPathfinder<VolumeType> pathfinder(params);
+	pathfinder.execute();
+	result = cantorTupleFunction(result, static_cast<int32_t>(listPath.size()));
+
+	return result;
+}
+
+void TestVolume::testSparseOctreeVolumeWithAlgorithms()
+{
+	// A pillar sticks up through the hills, so that the path has to go around it.
+	const Region regWorld(0, -8, 0, 31, 31, 31);
+	RawVolume<uint8_t> rawVolume(regWorld);
+	SparseOctreeVolume<uint8_t> volume(regWorld);
+	createSparseWorld(&rawVolume, regWorld);
+	createSparseWorld(&volume, regWorld);
+	rawVolume.fill(Region(10, 0, 10, 20, 31, 20), 255);
+	volume.fill(Region(10, 0, 10, 20, 31, 20), 255);
+
+	QCOMPARE(testAlgorithms(&volume), testAlgorithms(&rawVolume));
+}
+
 QTEST_MAIN(TestVolume)
@@ -28,6 +28,7 @@
 #include "PolyVox/FilePager.h"
 #include "PolyVox/PagedVolume.h"
 #include "PolyVox/RawVolume.h"
+#include "PolyVox/SparseOctreeVolume.h"
 #include "PolyVox/Region.h"
 
 #include <QObject>
@@ -59,26 +60,91 @@ private slots:
 	void testPagedVolumeDirectAccessWithExternalBackwards();
 	void testPagedVolumeSamplersWithExternalBackwards();
 
+	void testStaticPagedVolumeDirectAccessAllInternalForwards();
+	void testStaticPagedVolumeSamplersAllInternalForwards();
+	void testStaticPagedVolumeDirectAccessWithExternalForwards();
+	void testStaticPagedVolumeSamplersWithExternalForwards();
+	void testStaticPagedVolumeDirectAccessAllInternalBackwards();
+	void testStaticPagedVolumeSamplersAllInternalBackwards();
+	void testStaticPagedVolumeDirectAccessWithExternalBackwards();
+	void testStaticPagedVolumeSamplersWithExternalBackwards();
+	void testStaticPagedVolumeChunkSideLength();
+
+	void testSparseOctreeVolumeDirectAccessAllInternalForwards();
+	void testSparseOctreeVolumeSamplersAllInternalForwards();
+	void testSparseOctreeVolumeDirectAccessWithExternalForwards();
+	void testSparseOctreeVolumeSamplersWithExternalForwards();
+	void testSparseOctreeVolumeDirectAccessAllInternalBackwards();
+	void testSparseOctreeVolumeSamplersAllInternalBackwards();
+	void testSparseOctreeVolumeDirectAccessWithExternalBackwards();
+	void testSparseOctreeVolumeSamplersWithExternalBackwards();
+
 	void testRawVolumeDirectRandomAccess();
 	void testPagedVolumeDirectRandomAccess();
 
 	void testPagedVolumeChunkLocalAccess();
 	void testPagedVolumeChunkRandomAccess();
 
+	void testPagedVolumeThreadedReads();
+	void testPagedVolumeThreadedWrites();
+	void testPagedVolumeShortLivedThreads();
+	void testPagedVolumeMissCostFewChunks();
+	void testPagedVolumeMissCostManyChunks();
+	void testPagedVolumeLargeChunkCount();
+	void testPagedVolumePrefetchAsync();
+	void testPagedVolumePageOutQueue();
+	void testPagedVolumeWriteDuringPageOut();
+	void testPagedVolumeCompression();
+	void testPagedVolumeCompressionAvoidsPaging();
+	void testPagedVolumeUniformChunks();
+	void testPagedVolumeChunkAllocator();
+	void testPagedVolumeStatistics();
+	void testPagedVolumePinning();
+	void testPagedVolumeSnapshot();
+	void testRawVolumeChangeTracking();
+	void testPagedVolumeChangeTracking();
+	void testRawVolumeRegionCopies();
+	void testPagedVolumeRegionCopies();
+	void testRawVolumeFill();
+	void testPagedVolumeFill();
+	void testPagedVolumeFillAvoidsPaging();
+	void testPagedVolumeSamplerWrites();
+	void testPagedVolumeDirectWrites();
+	void testPagedVolumeSamplerNeighbourChunks();
+	void testPagedVolumeChunkApron();
+	void testPagedVolumeChunkLayouts();
+	void testPagedVolumeMortonLayoutPerformance();
+	void testPagedVolumeLinearLayoutPerformance();
+	void testPagedVolumeBrickedLayoutPerformance();
+	void testPagedVolumeChunkPalette();
+	void testPackFilePager();
+	void testFilePagerPersistence();
+	void testSparseOctreeVolumeSparseWorld();
+	void testSparseOctreeVolumeNonPowerOfTwo();
+	void testPagedVolumeSparseWorld();
+	void testSparseOctreeVolumeWithAlgorithms();
+
 private:
 	int32_t testPagedVolumeChunkAccess(uint16_t localityMask);
+	int32_t testPagedVolumeMissCost(uint32_t uTargetMemoryUsageInBytes);
 
 	static const uint16_t m_uChunkSideLength = 32;
+	static const uint32_t m_uNoOfThreads = 4;
 
 	PolyVox::Region m_regVolume;
 	PolyVox::Region m_regInternal;
 	PolyVox::Region m_regExternal;
 	PolyVox::FilePager<int32_t>* m_pFilePager;
 	PolyVox::FilePager<int32_t>* m_pFilePagerHighMem;
+	PolyVox::FilePager<int32_t>* m_pFilePagerThreadSafe;
+	PolyVox::FilePager<int32_t, m_uChunkSideLength>* m_pFilePagerStatic;
 
 	PolyVox::RawVolume<int32_t>* m_pRawVolume;
 	PolyVox::PagedVolume<int32_t>* m_pPagedVolume;
 	PolyVox::PagedVolume<int32_t>* m_pPagedVolumeHighMem;
+	PolyVox::PagedVolume<int32_t>* m_pPagedVolumeThreadSafe;
+	PolyVox::PagedVolume<int32_t, m_uChunkSideLength>* m_pStaticPagedVolume;
+	PolyVox::SparseOctreeVolume<int32_t>* m_pSparseOctreeVolume;
 
 	PolyVox::PagedVolume<uint32_t>::Chunk* m_pPagedVolumeChunk;
 };